@@ -0,0 +1,62 @@
+#pragma once
+
+#include "typedefs.h"
+
+// Minimal benchmark harness for anton_vk_bench. A benchmark runs state.iterations iterations of
+// its kernel, the runner picks the iteration count so one sample takes a few milliseconds and
+// reports the median of several samples.
+
+struct BenchState_t {
+    u64 iterations;
+    u64 itemsPerIteration; // Optional, enables ns/item and items/s
+    u64 bytesPerIteration; // Optional, enables MB/s
+};
+
+typedef void (*BenchFunction_t)(BenchState_t &state);
+typedef void (*BenchReportFunction_t)();
+
+struct BenchRegistrar_t {
+    BenchRegistrar_t(const char *name, BenchFunction_t function);
+    BenchRegistrar_t(const char *name, BenchReportFunction_t function);
+};
+
+#define BENCHMARK(name) \
+    static void name(BenchState_t &state); \
+    static BenchRegistrar_t name##_registrar(#name, name); \
+    static void name(BenchState_t &state)
+
+// Reports run once and print their own table, for things like scaling curves.
+#define BENCHMARK_REPORT(name) \
+    static void name(); \
+    static BenchRegistrar_t name##_registrar(#name, name); \
+    static void name()
+
+extern const void *volatile g_benchSink;
+
+// Keeps the optimiser from throwing away a result. GCC warns when the address of a local is
+// stored in a global, the empty asm takes the address without keeping it.
+template <class T>
+inline void doNotOptimize(const T &value) {
+#ifdef _MSC_VER
+    g_benchSink = &value;
+#else
+    asm volatile("" : : "r"(&value) : "memory");
+#endif
+}
+
+f64 benchNowSeconds();
+
+// Restarts the job system with this many workers, the main thread included.
+void useJobWorkers(u32 workerCount);
+
+// xorshift32, synthetic datasets come from a fixed seed so every run measures the same input.
+inline u32 benchRandom(u32 &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+inline f32 benchRandomUnit(u32 &state) {
+    return (f32) (benchRandom(state) >> 8) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,114 @@
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include "bench.h"
+#include "jobs.h"
+
+#define JOBS_PER_BATCH 64
+
+static
+void emptyJob(void *, u32, u32) {
+}
+
+// Enough work per item that scheduling overhead is not what gets measured.
+static
+void computeJob(void *data, u32 begin, u32 end) {
+    f32 *out = (f32 *) data;
+    for (u32 i = begin; i < end; i++) {
+        f32 x = (f32) i;
+        for (u32 k = 0; k < 256; k++) {
+            x = sqrtf(x * 1.0001f + 1.0f);
+        }
+        out[i] = x;
+    }
+}
+
+static
+void runEmptyBatches(BenchState_t &state) {
+    JobDecl_t jobs[JOBS_PER_BATCH];
+    for (u32 i = 0; i < JOBS_PER_BATCH; i++) {
+        jobs[i] = {emptyJob, nullptr, 0, 1};
+    }
+
+    for (u64 it = 0; it < state.iterations; it++) {
+        JobCounter_t counter;
+        runJobs(jobs, JOBS_PER_BATCH, &counter);
+        waitForCounter(&counter);
+    }
+    state.itemsPerIteration = JOBS_PER_BATCH;
+}
+
+// Push and pop on the main thread only, the cost of the deque and counter.
+BENCHMARK(jobs_spawn_wait_1_worker) {
+    useJobWorkers(1);
+    runEmptyBatches(state);
+}
+
+BENCHMARK(jobs_spawn_wait_all_workers) {
+    useJobWorkers(0 == std::thread::hardware_concurrency() ? 1 : std::thread::hardware_concurrency());
+    runEmptyBatches(state);
+}
+
+// The main thread only spins, so every job is stolen by another worker.
+BENCHMARK(jobs_steal) {
+    u32 workers = std::thread::hardware_concurrency();
+    useJobWorkers(workers < 2 ? 2 : workers);
+
+    JobDecl_t jobs[JOBS_PER_BATCH];
+    for (u32 i = 0; i < JOBS_PER_BATCH; i++) {
+        jobs[i] = {emptyJob, nullptr, 0, 1};
+    }
+
+    for (u64 it = 0; it < state.iterations; it++) {
+        JobCounter_t counter;
+        runJobs(jobs, JOBS_PER_BATCH, &counter);
+        while (!counterDone(&counter)) {
+            std::this_thread::yield();
+        }
+    }
+    state.itemsPerIteration = JOBS_PER_BATCH;
+}
+
+BENCHMARK(jobs_dependency_chain) {
+    useJobWorkers(std::thread::hardware_concurrency() == 0 ? 1 : std::thread::hardware_concurrency());
+
+    JobDecl_t job = {emptyJob, nullptr, 0, 1};
+    for (u64 it = 0; it < state.iterations; it++) {
+        JobCounter_t first, second;
+        runJobs(&job, 1, &first);
+        runJobsAfter(&first, &job, 1, &second);
+        waitForCounter(&second);
+        // The second job can finish before the first one lets go of its counter.
+        waitForCounter(&first);
+    }
+    state.itemsPerIteration = 2;
+}
+
+BENCHMARK_REPORT(jobs_scaling) {
+    const u32 itemCount = 1 << 16;
+    static f32 results[itemCount];
+
+    u32 maxWorkers = std::thread::hardware_concurrency();
+    if (maxWorkers == 0) maxWorkers = 1;
+
+    f64 baseline = 0.0;
+    printf("%8s %12s %10s %12s\n", "workers", "ms", "speedup", "efficiency");
+    for (u32 workers = 1; workers <= maxWorkers; workers++) {
+        useJobWorkers(workers);
+
+        f64 best = 1e9;
+        for (u32 sample = 0; sample < 5; sample++) {
+            f64 start = benchNowSeconds();
+            parallelFor(itemCount, 256, computeJob, results);
+            best = std::fmin(best, benchNowSeconds() - start);
+        }
+        doNotOptimize(results[itemCount - 1]);
+
+        if (workers == 1) baseline = best;
+        f64 speedup = baseline / best;
+        printf("%8u %12.3f %10.2f %11.0f%%\n", workers, best * 1e3, speedup, 100.0 * speedup / workers);
+    }
+
+    shutdownJobSystem();
+}
@@ -0,0 +1,119 @@
+#include <cstdio>
+
+#include "bench.h"
+#include "logger.h"
+
+// Calls per burst, small enough that a burst always fits in the ring so nothing is dropped and
+// only the cost on the calling thread is measured.
+#define LOG_BURST 256
+#define LOG_BURSTS 2000
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+// Opened once and kept open, benchmarks run their kernel for every sample. nullptr when it can
+// not be opened, which is reported the first time.
+static
+FILE *nullOutput() {
+    static FILE *file = [] {
+        FILE *opened = fopen(NULL_DEVICE, "w");
+        if (!opened) printf("could not open %s\n", NULL_DEVICE);
+        return opened;
+    }();
+    return file;
+}
+
+typedef void (*LogBurstFunction_t)(u32 i);
+
+static
+void logNoArgs(u32) {
+    Logger::Trace("Frame submitted");
+}
+
+static
+void logInts(u32 i) {
+    Logger::Trace("vbOffset = %i for mesh %i", i * 64, i);
+}
+
+static
+void logFloatString(u32 i) {
+    Logger::Log("%s took %f ms", "uploadBuffer", (f64) i * 0.25);
+}
+
+static
+void logLongString(u32) {
+    Logger::Warn("%s", "Validation Error: [ VUID-vkCmdDrawIndexed-None-02699 ] Object 0: handle = 0x1, "
+                       "type = VK_OBJECT_TYPE_DESCRIPTOR_SET; descriptor set was never updated");
+}
+
+// What the old synchronous logger paid on the calling thread before any I/O.
+static
+void formatInts(u32 i) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "[TRACE]: vbOffset = %i for mesh %i\n", i * 64, i);
+    doNotOptimize(buffer[0]);
+}
+
+static
+f64 timeBursts(LogBurstFunction_t function) {
+    f64 total = 0.0;
+    for (u32 burst = 0; burst < LOG_BURSTS; burst++) {
+        f64 start = benchNowSeconds();
+        for (u32 i = 0; i < LOG_BURST; i++) {
+            function(i);
+        }
+        total += benchNowSeconds() - start;
+        Logger::Flush();
+    }
+    return total * 1e9 / ((f64) LOG_BURST * LOG_BURSTS);
+}
+
+BENCHMARK_REPORT(logger_call_overhead) {
+    FILE *nullFile = nullOutput();
+    if (!nullFile) return;
+    Logger::SetOutput(nullFile);
+
+    // Warm up the ring and the thread local lookup.
+    timeBursts(logInts);
+    u64 droppedBefore = Logger::DroppedRecords();
+
+    struct {
+        const char *name;
+        LogBurstFunction_t function;
+    } cases[] = {
+            {"no args", logNoArgs},
+            {"2 ints", logInts},
+            {"string + float", logFloatString},
+            {"120 char string", logLongString},
+            {"snprintf baseline", formatInts},
+    };
+
+    printf("%-20s %10s\n", "case", "ns/call");
+    for (auto &c : cases) {
+        printf("%-20s %10.2f\n", c.name, timeBursts(c.function));
+    }
+    printf("dropped records: %llu\n", Logger::DroppedRecords() - droppedBefore);
+
+    Logger::SetOutput(stdout);
+}
+
+// Sustained logging from one thread, faster than the backend drains, so this measures the
+// drop path as much as the record path.
+BENCHMARK(logger_flood) {
+    FILE *nullFile = nullOutput();
+    if (!nullFile) return;
+    Logger::SetOutput(nullFile);
+    u64 droppedBefore = Logger::DroppedRecords();
+
+    for (u64 it = 0; it < state.iterations; it++) {
+        Logger::Trace("vbOffset = %i for mesh %i", (u32) it, 3);
+    }
+    state.itemsPerIteration = 1;
+
+    Logger::Flush();
+    doNotOptimize(Logger::DroppedRecords() - droppedBefore);
+    Logger::SetOutput(stdout);
+}
@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "bench.h"
+#include "jobs.h"
+
+#define BENCH_SAMPLES 7
+#define BENCH_MIN_SAMPLE_SECONDS 0.02
+
+struct BenchEntry_t {
+    const char *name;
+    BenchFunction_t function;
+    BenchReportFunction_t report;
+};
+
+const void *volatile g_benchSink = nullptr;
+
+static std::vector<BenchEntry_t> &benchRegistry() {
+    static std::vector<BenchEntry_t> registry;
+    return registry;
+}
+
+BenchRegistrar_t::BenchRegistrar_t(const char *name, BenchFunction_t function) {
+    benchRegistry().push_back({name, function, nullptr});
+}
+
+BenchRegistrar_t::BenchRegistrar_t(const char *name, BenchReportFunction_t function) {
+    benchRegistry().push_back({name, nullptr, function});
+}
+
+f64 benchNowSeconds() {
+    using namespace std::chrono;
+    return duration<f64>(steady_clock::now().time_since_epoch()).count();
+}
+
+void useJobWorkers(u32 workerCount) {
+    if (getJobWorkerCount() == workerCount) return;
+    shutdownJobSystem();
+    initJobSystem(workerCount);
+}
+
+static
+f64 runSample(const BenchEntry_t &entry, BenchState_t &state) {
+    f64 start = benchNowSeconds();
+    entry.function(state);
+    return benchNowSeconds() - start;
+}
+
+static
+void runBenchmark(const BenchEntry_t &entry) {
+    BenchState_t state = {};
+
+    // One untimed call without iterations, so datasets built on first use do not skew the
+    // iteration count.
+    entry.function(state);
+    state.iterations = 1;
+
+    // Grow the iteration count until one sample is long enough to time reliably.
+    f64 elapsed = runSample(entry, state);
+    while (elapsed < BENCH_MIN_SAMPLE_SECONDS && state.iterations < (1ull << 40)) {
+        f64 scale = elapsed > 0.0 ? 1.5 * BENCH_MIN_SAMPLE_SECONDS / elapsed : 10.0;
+        scale = std::min(std::max(scale, 2.0), 100.0);
+        state.iterations = (u64) (state.iterations * scale);
+        elapsed = runSample(entry, state);
+    }
+
+    f64 samples[BENCH_SAMPLES];
+    for (u32 i = 0; i < BENCH_SAMPLES; i++) {
+        samples[i] = runSample(entry, state) / (f64) state.iterations;
+    }
+    std::sort(samples, samples + BENCH_SAMPLES);
+    f64 secondsPerOp = samples[BENCH_SAMPLES / 2];
+
+    printf("%-40s %12llu iters %14.2f ns/op", entry.name, state.iterations, secondsPerOp * 1e9);
+    if (state.itemsPerIteration) {
+        f64 secondsPerItem = secondsPerOp / (f64) state.itemsPerIteration;
+        printf(" %12.2f ns/item %10.2f Mitems/s", secondsPerItem * 1e9, 1e-6 / secondsPerItem);
+    }
+    if (state.bytesPerIteration) {
+        printf(" %10.1f MB/s", (f64) state.bytesPerIteration / secondsPerOp / (1024.0 * 1024.0));
+    }
+    printf("\n");
+}
+
+int main(int argc, const char **argv) {
+    // Any arguments are substring filters on the benchmark names.
+    auto selected = [&](const char *name) {
+        if (argc < 2) return true;
+        for (int i = 1; i < argc; i++) {
+            if (strstr(name, argv[i])) return true;
+        }
+        return false;
+    };
+
+    for (const BenchEntry_t &entry : benchRegistry()) {
+        if (entry.function && selected(entry.name)) {
+            runBenchmark(entry);
+        }
+    }
+
+    for (const BenchEntry_t &entry : benchRegistry()) {
+        if (entry.report && selected(entry.name)) {
+            printf("\n%s\n", entry.name);
+            entry.report();
+        }
+    }
+
+    return 0;
+}
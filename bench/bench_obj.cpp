@@ -0,0 +1,75 @@
+#include <cstdio>
+#include <filesystem>
+
+#include "bench.h"
+#include "cook.h"
+
+// Height field of OBJ_GRID x OBJ_GRID quads with positions, normals and texture coordinates per
+// grid point. Every point is referenced by up to six triangles, so welding has real work to do.
+#define OBJ_GRID 128
+#define OBJ_SEED 1234
+
+static std::string g_objPath;
+static u64 g_objBytes = 0;
+
+static
+void removeSyntheticObj() {
+    std::error_code error;
+    std::filesystem::remove(g_objPath, error);
+}
+
+// Written once, the timed part is loadObj reading it back from the page cache.
+static
+const std::string &syntheticObj() {
+    if (!g_objPath.empty()) return g_objPath;
+
+    g_objPath = (std::filesystem::temp_directory_path() / "anton_vk_bench.obj").string();
+    FILE *file = fopen(g_objPath.c_str(), "w");
+    ASSERT(file != nullptr);
+
+    u32 state = OBJ_SEED;
+    const u32 points = OBJ_GRID + 1;
+    for (u32 y = 0; y < points; y++) {
+        for (u32 x = 0; x < points; x++) {
+            fprintf(file, "v %f %f %f\n", (f32) x, 0.25f * benchRandomUnit(state), (f32) y);
+        }
+    }
+    for (u32 y = 0; y < points; y++) {
+        for (u32 x = 0; x < points; x++) {
+            f32 tilt = 0.1f * (benchRandomUnit(state) - 0.5f);
+            fprintf(file, "vn %f %f %f\n", tilt, 1.0f, -tilt);
+        }
+    }
+    for (u32 y = 0; y < points; y++) {
+        for (u32 x = 0; x < points; x++) {
+            fprintf(file, "vt %f %f\n", (f32) x / OBJ_GRID, (f32) y / OBJ_GRID);
+        }
+    }
+    for (u32 y = 0; y < OBJ_GRID; y++) {
+        for (u32 x = 0; x < OBJ_GRID; x++) {
+            u32 a = y * points + x + 1; // OBJ indices start at 1
+            u32 b = a + 1;
+            u32 c = a + points;
+            u32 d = c + 1;
+            fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, c, c, c, b, b, b);
+            fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", b, b, b, c, c, c, d, d, d);
+        }
+    }
+    g_objBytes = (u64) ftell(file);
+    fclose(file);
+    atexit(removeSyntheticObj);
+    return g_objPath;
+}
+
+// Parse and vertex welding, as anton_cook does it for every OBJ.
+BENCHMARK(obj_parse_weld) {
+    const std::string &path = syntheticObj();
+    for (u64 it = 0; it < state.iterations; it++) {
+        Mesh_t mesh;
+        bool loaded = loadObj(path, mesh);
+        ASSERT(loaded && mesh.vertices.size() == (OBJ_GRID + 1) * (OBJ_GRID + 1));
+        doNotOptimize(mesh.indices.back());
+    }
+    state.itemsPerIteration = 2 * OBJ_GRID * OBJ_GRID; // Triangles
+    state.bytesPerIteration = g_objBytes;
+}
@@ -0,0 +1,193 @@
+#include <thread>
+
+#include "bench.h"
+#include "drawlist.h"
+
+// 1 + 16 + 16 * 16 transforms per model, three levels like a small skinned prop.
+#define SCENE_MODELS 256
+#define SCENE_CHILDREN 16
+#define SCENE_MESHES 4096
+#define SCENE_SEED 42
+
+static
+glm::mat4 randomTransform(u32 &state, f32 extent) {
+    glm::vec3 position = glm::vec3(benchRandomUnit(state), benchRandomUnit(state), benchRandomUnit(state));
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), (position - glm::vec3(0.5f)) * extent);
+    model = glm::rotate(model, 6.28318531f * benchRandomUnit(state), glm::vec3(0.0f, 1.0f, 0.0f));
+    return glm::scale(model, glm::vec3(0.5f + benchRandomUnit(state)));
+}
+
+static
+void buildHierarchy(TransformHierarchy_t &hierarchy, std::vector<u32> &roots) {
+    u32 state = SCENE_SEED;
+    for (u32 model = 0; model < SCENE_MODELS; model++) {
+        u32 root = addTransform(hierarchy, U32_MAX, randomTransform(state, 100.0f));
+        roots.push_back(root);
+        for (u32 child = 0; child < SCENE_CHILDREN; child++) {
+            u32 parent = addTransform(hierarchy, root, randomTransform(state, 2.0f));
+            for (u32 leaf = 0; leaf < SCENE_CHILDREN; leaf++) {
+                addTransform(hierarchy, parent, randomTransform(state, 0.5f));
+            }
+        }
+    }
+    updateTransforms(hierarchy);
+}
+
+// Moves every step-th root, so dirtyPercent of the hierarchy is recomputed by the update.
+static
+void runTransformUpdates(BenchState_t &state, u32 dirtyPercent) {
+    static TransformHierarchy_t hierarchy;
+    static std::vector<u32> roots;
+    if (roots.empty()) buildHierarchy(hierarchy, roots);
+
+    u32 step = 100 / dirtyPercent;
+    glm::mat4 spin = glm::rotate(glm::mat4(1.0f), 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
+    for (u64 it = 0; it < state.iterations; it++) {
+        for (u32 i = (u32) (it % step); i < roots.size(); i += step) {
+            setLocalTransform(hierarchy, roots[i], spin * hierarchy.local[roots[i]]);
+        }
+        updateTransforms(hierarchy);
+        doNotOptimize(hierarchy.world.back());
+    }
+    state.itemsPerIteration = (u64) hierarchy.parent.size() * dirtyPercent / 100; // Transforms updated
+}
+
+BENCHMARK(transforms_update_all_1_worker) {
+    useJobWorkers(1);
+    runTransformUpdates(state, 100);
+}
+
+BENCHMARK(transforms_update_all_all_workers) {
+    useJobWorkers(std::thread::hardware_concurrency() == 0 ? 1 : std::thread::hardware_concurrency());
+    runTransformUpdates(state, 100);
+}
+
+BENCHMARK(transforms_update_10_percent) {
+    useJobWorkers(1);
+    runTransformUpdates(state, 10);
+}
+
+BENCHMARK(transforms_multiply_batch) {
+    const u32 count = 1024;
+    static glm::mat4 a[count], b[count], out[count];
+    u32 seed = SCENE_SEED;
+    for (u32 i = 0; i < count; i++) {
+        a[i] = randomTransform(seed, 10.0f);
+        b[i] = randomTransform(seed, 10.0f);
+    }
+
+    for (u64 it = 0; it < state.iterations; it++) {
+        multiplyMatricesBatch(a, b, out, count);
+        doNotOptimize(out[count - 1]);
+    }
+    state.itemsPerIteration = count;
+    state.bytesPerIteration = 3 * count * sizeof(glm::mat4);
+}
+
+// Meshes of 16 to 1024 vertices with meshlets, half of them instances of an earlier mesh, the way
+// stress scenes come out of generateStressScene.
+static
+std::vector<Mesh_t> &syntheticMeshes() {
+    static std::vector<Mesh_t> meshes;
+    if (!meshes.empty()) return meshes;
+
+    u32 state = SCENE_SEED;
+    meshes.resize(SCENE_MESHES);
+    for (u32 i = 0; i < SCENE_MESHES; i++) {
+        Mesh_t &mesh = meshes[i];
+        mesh.transformIndex = i;
+        mesh.boundingSphere = glm::vec4(benchRandomUnit(state), benchRandomUnit(state), benchRandomUnit(state), 1.0f);
+        if (i > 0 && benchRandom(state) % 2 == 0) {
+            mesh.sharedGeometry = benchRandom(state) % i;
+            while (meshes[mesh.sharedGeometry].sharedGeometry != U32_MAX) {
+                mesh.sharedGeometry = meshes[mesh.sharedGeometry].sharedGeometry;
+            }
+            continue;
+        }
+
+        u32 vertexCount = 16 + benchRandom(state) % 1009;
+        mesh.vertices.resize(vertexCount);
+        mesh.indices.resize(vertexCount * 3);
+        mesh.indexCount = (u32) mesh.indices.size();
+        u32 meshletCount = (mesh.indexCount + 3 * MESHLET_MAX_TRIANGLES - 1) / (3 * MESHLET_MAX_TRIANGLES);
+        mesh.meshlets.resize(meshletCount);
+        for (u32 m = 0; m < meshletCount; m++) {
+            mesh.meshlets[m] = {};
+            mesh.meshlets[m].firstIndex = m * 3 * MESHLET_MAX_TRIANGLES;
+        }
+    }
+    return meshes;
+}
+
+// The offset pass of sendStaticResources.
+BENCHMARK(static_geometry_place) {
+    std::vector<Mesh_t> &meshes = syntheticMeshes();
+    for (u64 it = 0; it < state.iterations; it++) {
+        u32 vertexBytes, indexBytes;
+        placeStaticGeometry(meshes, vertexBytes, indexBytes);
+        doNotOptimize(vertexBytes);
+        doNotOptimize(indexBytes);
+    }
+    state.itemsPerIteration = SCENE_MESHES;
+}
+
+BENCHMARK(static_geometry_expand_meshlets) {
+    std::vector<Mesh_t> &meshes = syntheticMeshes();
+    u32 vertexBytes, indexBytes;
+    placeStaticGeometry(meshes, vertexBytes, indexBytes);
+
+    std::vector<Meshlet_t> meshlets;
+    for (u64 it = 0; it < state.iterations; it++) {
+        expandMeshlets(meshes, meshlets);
+        doNotOptimize(meshlets.back());
+    }
+    state.itemsPerIteration = meshlets.size();
+    state.bytesPerIteration = meshlets.size() * sizeof(Meshlet_t);
+}
+
+// Every synthetic mesh static, three materials, spread over 200 units so it splits into chunks.
+// Each iteration copies the list and the transforms it consumes, that is part of the time.
+BENCHMARK(static_batch_build) {
+    static std::vector<Mesh_t> meshes;
+    static TransformHierarchy_t transforms;
+    if (meshes.empty()) {
+        meshes = syntheticMeshes();
+        u32 seed = SCENE_SEED;
+        for (u32 i = 0; i < SCENE_MESHES; i++) {
+            meshes[i].isStatic = true;
+            meshes[i].material = i % 3;
+            meshes[i].transformIndex = addTransform(transforms, U32_MAX, randomTransform(seed, 200.0f));
+        }
+    }
+
+    u32 batches = 0;
+    for (u64 it = 0; it < state.iterations; it++) {
+        std::vector<Mesh_t> batched = meshes;
+        TransformHierarchy_t batchedTransforms = transforms;
+        StaticBatchStats_t stats;
+        batchStaticMeshes(batched, batchedTransforms, stats);
+        batches = stats.batches;
+        doNotOptimize(batched.back());
+    }
+    doNotOptimize(batches);
+    state.itemsPerIteration = SCENE_MESHES;
+}
+
+// Front to back draw order as render() builds it every frame, with the frame arena reset in
+// between like the main loop does.
+BENCHMARK(draw_order_build) {
+    std::vector<Mesh_t> &meshes = syntheticMeshes();
+    static std::vector<glm::mat4> world;
+    u32 seed = SCENE_SEED;
+    if (world.empty()) {
+        for (u32 i = 0; i < SCENE_MESHES; i++) world.push_back(randomTransform(seed, 200.0f));
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 150.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    for (u64 it = 0; it < state.iterations; it++) {
+        u32 *order = buildDrawOrder(meshes, world.data(), view, getFrameArena());
+        doNotOptimize(order[0]);
+        resetArena(getFrameArena());
+    }
+    state.itemsPerIteration = SCENE_MESHES;
+}
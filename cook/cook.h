@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "cooked.h"
+
+// anton_cook: turns assets/*.obj into cooked meshes and shaders/*.{vert,frag,comp}.glsl into
+// SPIR-V, packs the SPIR-V into one file and writes the manifest anton_vk loads at startup. Every
+// input is hashed together with the files it pulls in, and only inputs whose hash changed since
+// the last run (or whose output is gone) are cooked again, spread over the job system.
+//
+//   anton_cook [source root] [output directory] [--force] [--glslang <path>]
+//
+// The defaults match the working directory of anton_vk, see COOKED_MANIFEST_PATH.
+
+#define COOK_DEFAULT_SOURCE_ROOT "../.."
+#define COOK_DEFAULT_OUTPUT_DIR "../cooked"
+
+// Bump when the output changes for the same input, so every asset cooks again.
+#define COOK_VERSION 2
+
+#ifndef COOK_GLSLANG_VALIDATOR
+#define COOK_GLSLANG_VALIDATOR "glslangValidator"
+#endif
+
+struct CookItem_t {
+    CookedAssetType_t type;
+    std::string name;
+    std::string source;
+    std::string output; // File name in the output directory
+    const char *define; // Shaders only, compiled with it defined when set
+
+    u64 hash; // Of the source, its includes and COOK_VERSION
+    bool cooked; // This run, false when it was up to date
+    bool failed;
+};
+
+u64 hashBytes(u64 hash, const void *data, u64 size);
+bool readFile(const std::string &path, std::vector<u8> &contents);
+
+// Hash of everything the output depends on, 0 when the source can not be read.
+u64 hashMeshSource(const std::string &source);
+u64 hashShaderSource(const std::string &source);
+
+// Triangulated OBJ to a mesh with welded vertices, no meshlets yet. Every shape is split by the
+// material of its faces into submeshes with contiguous index ranges, bounds and meshlets come later.
+// Kept apart from the rest of the cooker so anton_vk_bench can link it.
+bool loadObj(const std::string &path, Mesh_t &mesh);
+
+bool cookMesh(const std::string &source, const std::string &output);
+// define is passed to the compiler as -D<define> when not nullptr.
+bool cookShader(const std::string &source, const std::string &output, const std::string &glslang,
+                const char *define);
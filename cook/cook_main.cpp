@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#include "cook.h"
+#include "jobs.h"
+
+namespace fs = std::filesystem;
+
+#define COOK_DATABASE_NAME "cook.db"
+#define COOK_MANIFEST_NAME "manifest.txt" // Has to match COOKED_MANIFEST_PATH
+#define COOK_SHADER_PACK_NAME "shaders.pack"
+
+struct CookRun_t {
+    std::vector<CookItem_t> items;
+    std::unordered_map<std::string, u64> previousHashes; // "type name" to hash
+    std::string outputDir;
+    std::string glslang;
+    bool force;
+};
+
+// FNV-1a, plenty for telling whether a file changed.
+u64 hashBytes(u64 hash, const void *data, u64 size) {
+    if (hash == 0) hash = 0xcbf29ce484222325ull;
+    const u8 *bytes = (const u8 *) data;
+    for (u64 i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool readFile(const std::string &path, std::vector<u8> &contents) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        Logger::Error("Could not open %s", path.c_str());
+        return false;
+    }
+    contents.resize((size_t) file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read((char *) contents.data(), contents.size());
+    return (bool) file;
+}
+
+static
+std::string databaseKey(const CookItem_t &item) {
+    return std::string(cookedAssetTypeName(item.type)) + " " + item.name;
+}
+
+static
+void loadDatabase(const std::string &path, std::unordered_map<std::string, u64> &hashes) {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string type, name;
+        u64 hash = 0;
+        if (fields >> type >> name >> std::hex >> hash) hashes[type + " " + name] = hash;
+    }
+}
+
+static
+bool writeDatabase(const std::string &path, const std::vector<CookItem_t> &items) {
+    std::ofstream file(path);
+    if (!file.is_open()) return false;
+    for (const CookItem_t &item : items) {
+        if (item.failed) continue; // No entry, so it is tried again next run
+        file << databaseKey(item) << " " << std::hex << item.hash << std::dec << "\n";
+    }
+    return file.good();
+}
+
+// Every .obj in assets/ and every shader stage in shaders/, the include only .glsl files are
+// picked up through the stages that use them.
+static
+void gatherItems(const fs::path &sourceRoot, std::vector<CookItem_t> &items) {
+    std::error_code error;
+    for (const fs::directory_entry &entry : fs::directory_iterator(sourceRoot / "assets", error)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".obj") continue;
+        CookItem_t item = {};
+        item.type = CookedAsset_Mesh;
+        item.name = entry.path().stem().string();
+        item.source = entry.path().string();
+        item.output = item.name + ".mesh";
+        items.push_back(item);
+    }
+
+    const char *stages[] = {".vert", ".frag", ".comp"};
+    for (const fs::directory_entry &entry : fs::directory_iterator(sourceRoot / "shaders", error)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".glsl") continue;
+        std::string stage = entry.path().stem().extension().string();
+        if (std::find(std::begin(stages), std::end(stages), stage) == std::end(stages)) continue;
+        CookItem_t item = {};
+        item.type = CookedAsset_Shader;
+        item.name = entry.path().stem().string(); // mesh.vert
+        item.source = entry.path().string();
+        item.output = item.name + ".spv";
+        items.push_back(item);
+
+        // Vertex shaders also come as the MULTIVIEW build, see vk_renderprograms.cpp.
+        if (stage == ".vert") {
+            item.name += ".multiview";
+            item.output = item.name + ".spv";
+            item.define = "MULTIVIEW";
+            items.push_back(item);
+        }
+    }
+
+    // Directory order is up to the file system, the manifest should not churn between runs.
+    std::sort(items.begin(), items.end(), [](const CookItem_t &a, const CookItem_t &b) {
+        return a.type != b.type ? a.type < b.type : a.name < b.name;
+    });
+}
+
+static
+void cookJob(void *data, u32 begin, u32 end) {
+    CookRun_t &run = *(CookRun_t *) data;
+    for (u32 i = begin; i < end; i++) {
+        CookItem_t &item = run.items[i];
+        item.hash = item.type == CookedAsset_Mesh ? hashMeshSource(item.source) : hashShaderSource(item.source);
+        if (item.hash == 0) {
+            item.failed = true;
+            continue;
+        }
+
+        std::string output = (fs::path(run.outputDir) / item.output).string();
+        auto previous = run.previousHashes.find(databaseKey(item));
+        bool upToDate = previous != run.previousHashes.end() && previous->second == item.hash &&
+                        fs::exists(output);
+        if (upToDate && !run.force) continue;
+
+        bool ok = item.type == CookedAsset_Mesh ? cookMesh(item.source, output)
+                                                : cookShader(item.source, output, run.glslang, item.define);
+        item.cooked = ok;
+        item.failed = !ok;
+    }
+}
+
+// Every cooked shader in one file, so the runtime maps one file instead of opening one per
+// module. Rewritten every run, a shader that failed or went away must not stay in there since the
+// runtime looks in the pack before the manifest. The modules are small.
+static
+bool packShaders(const CookRun_t &run, std::vector<CookedAsset_t> &manifest) {
+    std::string packPath = (fs::path(run.outputDir) / COOK_SHADER_PACK_NAME).string();
+    std::vector<std::string> names;
+    std::vector<std::vector<u8>> modules;
+    for (const CookItem_t &item : run.items) {
+        if (item.type != CookedAsset_Shader || item.failed) continue;
+        names.push_back(item.name);
+        modules.emplace_back();
+        if (!readFile((fs::path(run.outputDir) / item.output).string(), modules.back())) return false;
+    }
+
+    if (!writeShaderPack(packPath.c_str(), names, modules)) {
+        Logger::Error("Could not write %s", packPath.c_str());
+        return false;
+    }
+    Logger::Trace("Packed %i shaders into %s", (u32) names.size(), packPath.c_str());
+
+    manifest.push_back({CookedAsset_ShaderPack, "shaders", COOK_SHADER_PACK_NAME});
+    return true;
+}
+
+i32 main(i32 argc, const char **argv) {
+    auto start = std::chrono::steady_clock::now();
+
+    CookRun_t run = {};
+    run.glslang = COOK_GLSLANG_VALIDATOR;
+    const char *positional[2] = {COOK_DEFAULT_SOURCE_ROOT, COOK_DEFAULT_OUTPUT_DIR};
+    u32 positionalCount = 0;
+    for (i32 i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--force") == 0) {
+            run.force = true;
+        } else if (strcmp(argv[i], "--glslang") == 0 && i + 1 < argc) {
+            run.glslang = argv[++i];
+        } else if (argv[i][0] != '-' && positionalCount < 2) {
+            positional[positionalCount++] = argv[i];
+        } else {
+            printf("usage: anton_cook [source root] [output directory] [--force] [--glslang <path>]\n");
+            return 1;
+        }
+    }
+    fs::path sourceRoot = positional[0];
+    run.outputDir = positional[1];
+
+    std::error_code error;
+    fs::create_directories(run.outputDir, error);
+    if (error) {
+        Logger::Fatal("Could not create the output directory %s", run.outputDir.c_str());
+    }
+
+    gatherItems(sourceRoot, run.items);
+    if (run.items.empty()) {
+        Logger::Fatal("Nothing to cook under %s", sourceRoot.string().c_str());
+    }
+
+    std::string databasePath = (fs::path(run.outputDir) / COOK_DATABASE_NAME).string();
+    loadDatabase(databasePath, run.previousHashes);
+
+    // OBJ parsing and the shader compiler processes dominate, one item per job.
+    initJobSystem(0);
+    parallelFor((u32) run.items.size(), 1, cookJob, &run);
+    shutdownJobSystem();
+
+    std::vector<CookedAsset_t> manifest;
+    u32 cookedCount = 0, failedCount = 0;
+    for (const CookItem_t &item : run.items) {
+        if (item.cooked) cookedCount++;
+        if (item.failed) {
+            failedCount++;
+            continue;
+        }
+        manifest.push_back({item.type, item.name, item.output});
+    }
+
+    if (!packShaders(run, manifest)) {
+        failedCount++;
+    }
+
+    if (!writeDatabase(databasePath, run.items)) {
+        Logger::Error("Could not write %s", databasePath.c_str());
+    }
+    std::string manifestPath = (fs::path(run.outputDir) / COOK_MANIFEST_NAME).string();
+    if (!writeCookedManifest(manifestPath.c_str(), manifest)) {
+        Logger::Fatal("Could not write %s", manifestPath.c_str());
+    }
+
+    f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+    Logger::Log("Cooked %i of %i assets (%i up to date, %i failed) in %f s", cookedCount,
+                (u32) run.items.size(), (u32) run.items.size() - cookedCount - failedCount, failedCount, seconds);
+    Logger::Flush();
+    return failedCount > 0 ? 1 : 0;
+}
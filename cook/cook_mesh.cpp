@@ -0,0 +1,87 @@
+#include <algorithm>
+
+#include "arena.h"
+#include "cook.h"
+
+// Renumbers the vertices in the order the index list first uses them, after the meshlet build
+// has settled the index order. Vertex fetches then walk the buffer mostly forwards.
+static
+void optimizeVertexFetch(Mesh_t &mesh) {
+    ScratchScope_t scratch;
+    u32 vertexCount = (u32) mesh.vertices.size();
+    u32 *remap = arenaAllocArray<u32>(scratch.arena, vertexCount);
+    for (u32 i = 0; i < vertexCount; i++) remap[i] = U32_MAX;
+
+    std::vector<Vertex_t> ordered;
+    ordered.reserve(vertexCount);
+    for (u32 &index : mesh.indices) {
+        if (remap[index] == U32_MAX) {
+            remap[index] = (u32) ordered.size();
+            ordered.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(ordered); // Drops vertices no triangle uses
+}
+
+// Meshlets per submesh, so a submesh can be drawn and culled on its own. Each index range is
+// reordered in place like buildMeshlets does for a whole mesh.
+static
+void buildSubmeshMeshlets(Mesh_t &mesh) {
+    std::vector<u32> indices;
+    std::vector<Meshlet_t> meshlets;
+    for (Submesh_t &submesh : mesh.submeshes) {
+        u32 *range = mesh.indices.data() + submesh.firstIndex;
+        indices.assign(range, range + submesh.indexCount);
+        meshlets.clear();
+        buildMeshlets(mesh.vertices, indices, meshlets);
+        std::copy(indices.begin(), indices.end(), range);
+
+        submesh.firstMeshlet = (u32) mesh.meshlets.size();
+        submesh.meshletCount = (u32) meshlets.size();
+        for (Meshlet_t meshlet : meshlets) {
+            meshlet.firstIndex += submesh.firstIndex;
+            mesh.meshlets.push_back(meshlet);
+        }
+    }
+}
+
+static
+glm::vec4 computeSubmeshBoundingSphere(const Mesh_t &mesh, const Submesh_t &submesh) {
+    std::vector<Vertex_t> vertices;
+    vertices.reserve(submesh.indexCount);
+    for (u32 i = 0; i < submesh.indexCount; i++) {
+        vertices.push_back(mesh.vertices[mesh.indices[submesh.firstIndex + i]]);
+    }
+    return computeBoundingSphere(vertices);
+}
+
+u64 hashMeshSource(const std::string &source) {
+    std::vector<u8> contents;
+    if (!readFile(source, contents)) return 0;
+    u64 version = COOK_VERSION;
+    u64 hash = hashBytes(0, &version, sizeof(version));
+    return hashBytes(hash, contents.data(), contents.size());
+}
+
+bool cookMesh(const std::string &source, const std::string &output) {
+    Mesh_t mesh;
+    if (!loadObj(source, mesh)) return false;
+
+    buildSubmeshMeshlets(mesh);
+    optimizeVertexFetch(mesh);
+    mesh.boundingSphere = computeBoundingSphere(mesh.vertices);
+    for (Submesh_t &submesh : mesh.submeshes) {
+        submesh.boundingSphere = computeSubmeshBoundingSphere(mesh, submesh);
+    }
+
+    Logger::Trace("%s: %i vertices, %i indices, %i meshlets, %i submeshes", source.c_str(),
+                  (u32) mesh.vertices.size(), mesh.indexCount, (u32) mesh.meshlets.size(),
+                  (u32) mesh.submeshes.size());
+
+    if (!writeCookedMesh(output.c_str(), mesh)) {
+        Logger::Error("Could not write %s", output.c_str());
+        return false;
+    }
+    return true;
+}
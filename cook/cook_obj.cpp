@@ -0,0 +1,95 @@
+#include <algorithm>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "../external/tiny_obj_loader.h"
+
+#include "arena.h"
+#include "cook.h"
+
+bool loadObj(const std::string &path, Mesh_t &mesh) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials; // Only their ids are kept, in the submeshes
+    std::string warn, err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
+        Logger::Error("tinyobj::LoadObj failed for %s: %s", path.c_str(), err.c_str());
+        return false;
+    }
+
+    // Only the final vertex, index and submesh arrays outlive this function, everything else is scratch.
+    ScratchScope_t scratch;
+
+    size_t totalIndexCount = 0;
+    for (const auto& shape: shapes) {
+        totalIndexCount += shape.mesh.indices.size();
+    }
+
+    std::unordered_map<Vertex_t, size_t, std::hash<Vertex_t>, std::equal_to<Vertex_t>,
+            ArenaAllocator_t<std::pair<const Vertex_t, size_t>>>
+            unique_vertices(totalIndexCount, std::hash<Vertex_t>(), std::equal_to<Vertex_t>(),
+                            ArenaAllocator_t<std::pair<const Vertex_t, size_t>>(scratch.arena));
+    ArenaVector_t<Vertex_t> vertices{ArenaAllocator_t<Vertex_t>(scratch.arena)};
+    vertices.reserve(totalIndexCount);
+    mesh.indices.reserve(totalIndexCount);
+
+    for (const auto& shape: shapes) {
+        // Faces grouped by material, in file order within a group. Triangulated, three indices each.
+        u32 faceCount = (u32) (shape.mesh.indices.size() / 3);
+        u32 *faces = arenaAllocArray<u32>(scratch.arena, faceCount);
+        for (u32 f = 0; f < faceCount; f++) faces[f] = f;
+        auto faceMaterial = [&shape](u32 face) {
+            return face < shape.mesh.material_ids.size() ? shape.mesh.material_ids[face] : -1;
+        };
+        std::stable_sort(faces, faces + faceCount, [&faceMaterial](u32 a, u32 b) {
+            return faceMaterial(a) < faceMaterial(b);
+        });
+
+        for (u32 f = 0; f < faceCount; f++) {
+            i32 material = faceMaterial(faces[f]);
+            if (f == 0 || material != faceMaterial(faces[f - 1])) {
+                Submesh_t submesh = {};
+                submesh.firstIndex = (u32) mesh.indices.size();
+                submesh.material = material >= 0 ? (u32) material : U32_MAX;
+                mesh.submeshes.push_back(submesh);
+            }
+
+            for (u32 corner = 0; corner < 3; corner++) {
+                const tinyobj::index_t &index = shape.mesh.indices[3 * faces[f] + corner];
+                Vertex_t vertex = {};
+
+                vertex.pos = {
+                        attrib.vertices[3 * index.vertex_index + 0],
+                        attrib.vertices[3 * index.vertex_index + 1],
+                        attrib.vertices[3 * index.vertex_index + 2]
+                };
+
+                vertex.normal = {
+                        attrib.normals[3 * index.normal_index + 0],
+                        attrib.normals[3 * index.normal_index + 1],
+                        attrib.normals[3 * index.normal_index + 2]
+                };
+
+                // OBJ has v going up, Vulkan samples with v going down.
+                if (index.texcoord_index >= 0) {
+                    vertex.texCoord = {
+                            attrib.texcoords[2 * index.texcoord_index + 0],
+                            1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                    };
+                }
+
+                if(unique_vertices.count(vertex) == 0) {
+                    unique_vertices[vertex] = (u32)vertices.size();
+                    vertices.push_back(vertex);
+                }
+
+                mesh.indices.push_back((u32)unique_vertices[vertex]);
+            }
+            mesh.submeshes.back().indexCount += 3;
+        }
+    }
+
+    mesh.vertices.assign(vertices.begin(), vertices.end());
+    mesh.indexCount = (u32)mesh.indices.size();
+    return true;
+}
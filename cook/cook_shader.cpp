@@ -0,0 +1,65 @@
+#include <cstdlib>
+#include <filesystem>
+
+#include "cook.h"
+
+// Deep enough for any sane include chain, stops cycles.
+#define COOK_MAX_INCLUDE_DEPTH 16
+
+// Hashes the file and then, in order, every file it pulls in with #include "...", relative to the
+// including file like glslangValidator resolves them.
+static
+bool hashShaderFile(const std::filesystem::path &path, u64 &hash, u32 depth) {
+    if (depth > COOK_MAX_INCLUDE_DEPTH) {
+        Logger::Error("Includes nest deeper than %i at %s", COOK_MAX_INCLUDE_DEPTH, path.string().c_str());
+        return false;
+    }
+
+    std::vector<u8> contents;
+    if (!readFile(path.string(), contents)) return false;
+    hash = hashBytes(hash, contents.data(), contents.size());
+
+    std::string text(contents.begin(), contents.end());
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos) lineEnd = text.size();
+
+        size_t directive = text.find_first_not_of(" \t", lineStart);
+        if (directive < lineEnd && text.compare(directive, 8, "#include") == 0) {
+            size_t open = text.find('"', directive);
+            size_t close = open < lineEnd ? text.find('"', open + 1) : std::string::npos;
+            if (close < lineEnd) {
+                std::filesystem::path include = path.parent_path() / text.substr(open + 1, close - open - 1);
+                if (!hashShaderFile(include, hash, depth + 1)) return false;
+            }
+        }
+        lineStart = lineEnd + 1;
+    }
+    return true;
+}
+
+u64 hashShaderSource(const std::string &source) {
+    u64 version = COOK_VERSION;
+    u64 hash = hashBytes(0, &version, sizeof(version));
+    if (!hashShaderFile(source, hash, 0)) return 0;
+    return hash;
+}
+
+bool cookShader(const std::string &source, const std::string &output, const std::string &glslang,
+                const char *define) {
+    // Same flags as shaders/build.bat.
+    std::string command = "\"" + glslang + "\" -V";
+    if (define) command += std::string(" -D") + define;
+    command += " \"" + source + "\" -o \"" + output + "\"";
+#ifdef _WIN32
+    command = "\"" + command + "\""; // cmd.exe strips the outer quotes
+#endif
+    if (std::system(command.c_str()) != 0) {
+        Logger::Error("Compiling %s failed", source.c_str());
+        std::error_code error;
+        std::filesystem::remove(output, error);
+        return false;
+    }
+    return true;
+}
@@ -6,8 +6,14 @@ IF NOT EXIST ..\build mkdir ..\build
 pushd ..\build\
 
 %glslc% ..\shaders\mesh.vert.glsl -o mesh.vert.spv
-@rem %glslc% ..\shaders\gooch.frag.glsl -o gooch.frag.spv
+%glslc% ..\shaders\depth_only.vert.glsl -o depth_only.vert.spv
+%glslc% -DMULTIVIEW ..\shaders\mesh.vert.glsl -o mesh.vert.multiview.spv
+%glslc% -DMULTIVIEW ..\shaders\depth_only.vert.glsl -o depth_only.vert.multiview.spv
+%glslc% ..\shaders\gooch.frag.glsl -o gooch.frag.spv
 %glslc% ..\shaders\lambert.frag.glsl -o lambert.frag.spv
 %glslc% ..\shaders\vertexColors.frag.glsl -o vertexColors.frag.spv
+%glslc% ..\shaders\cluster_cull.comp.glsl -o cluster_cull.comp.spv
+%glslc% ..\shaders\light_bin.comp.glsl -o light_bin.comp.spv
+%glslc% ..\shaders\depth_pyramid.comp.glsl -o depth_pyramid.comp.spv
 
 popd
@@ -0,0 +1,179 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(local_size_x = 64) in;
+
+struct Meshlet {
+    vec4 boundingSphere;
+    vec4 cone;
+    uint firstIndex;
+    uint indexCount;
+    int vertexOffset;
+    uint objectIndex;
+};
+
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, binding = 0) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+struct ObjectData {
+    mat4 model;
+    mat4 normal;
+};
+
+layout(std430, binding = 1) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+// The early or single phase writes the first meshletCount commands, the late phase the next
+// meshletCount and reads the early ones to skip what is drawn already.
+layout(std430, binding = 2) buffer DrawCommands {
+    DrawCommand draws[];
+};
+
+layout(std430, binding = 3) buffer Stats {
+    uint visibleClusters;
+    uint visibleTriangles;
+    uint occludedClusters;
+    uint occludedTriangles;
+    uint lateClusters;
+};
+
+// Max depth, farthest, of the rendered region. Level 0 covers all of it whatever its size.
+layout(binding = 4) uniform sampler2D depthPyramid;
+
+struct OcclusionView {
+    mat4 view;
+    vec4 projection; // proj[0][0], proj[1][1], proj[2][2], proj[3][2]
+    vec4 pyramid; // Level 0 width and height, level count, 0 when there is no pyramid to test against
+};
+
+// 0 is the previous frame, which the pyramid holds during the early phase. 1 is this frame.
+layout(std430, binding = 5) readonly buffer OcclusionViews {
+    OcclusionView occlusionViews[2];
+};
+
+layout(push_constant) uniform CullData {
+    vec4 frustumPlanes[6];
+    vec4 cameraPos;
+    uint meshletCount;
+    uint coneCulling;
+    uint phase;
+} cull;
+
+#define PHASE_SINGLE 0
+#define PHASE_EARLY 1
+#define PHASE_LATE 2
+
+// Screen space bounds of a sphere in front of the near plane, as xy min and max in [0, 1] of
+// the rendered region. 2D Polyhedral Bounds of a Clipped, Perspective-Projected 3D Sphere, Mara
+// and McGuire 2013. c has z pointing away from the camera.
+vec4 projectSphere(vec3 c, float r, float p00, float p11) {
+    vec3 cr = c * r;
+    float czr2 = c.z * c.z - r * r;
+
+    float vx = sqrt(c.x * c.x + czr2);
+    float minx = (vx * c.x - cr.z) / (vx * c.z + cr.x);
+    float maxx = (vx * c.x + cr.z) / (vx * c.z - cr.x);
+
+    float vy = sqrt(c.y * c.y + czr2);
+    float miny = (vy * c.y - cr.z) / (vy * c.z + cr.y);
+    float maxy = (vy * c.y + cr.z) / (vy * c.z - cr.y);
+
+    // proj[1][1] is negative with the flipped y, so the y bounds can come out swapped.
+    vec4 ndc = vec4(minx * p00, min(miny * p11, maxy * p11), maxx * p00, max(miny * p11, maxy * p11));
+    return clamp(ndc * 0.5 + 0.5, 0.0, 1.0);
+}
+
+// False when the whole sphere is behind the depth in the pyramid.
+bool occlusionVisible(vec3 center, float radius, OcclusionView v) {
+    if (v.pyramid.w == 0.0) {
+        return true;
+    }
+
+    vec3 c = (v.view * vec4(center, 1.0)).xyz;
+    c.z = -c.z;
+    float near = v.projection.w / v.projection.z;
+    if (c.z - radius < near) {
+        return true;
+    }
+
+    vec4 bounds = projectSphere(c, radius, v.projection.x, v.projection.y);
+
+    // The level where the bounds are at most a texel across, so they touch at most 2x2 texels.
+    vec2 size = (bounds.zw - bounds.xy) * v.pyramid.xy;
+    int level = int(min(ceil(log2(max(max(size.x, size.y), 1.0))), v.pyramid.z - 1.0));
+    ivec2 levelSize = textureSize(depthPyramid, level);
+    ivec2 lo = clamp(ivec2(bounds.xy * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 hi = clamp(ivec2(bounds.zw * vec2(levelSize)), ivec2(0), levelSize - 1);
+
+    float farthest = max(max(texelFetch(depthPyramid, lo, level).x, texelFetch(depthPyramid, ivec2(hi.x, lo.y), level).x),
+                         max(texelFetch(depthPyramid, ivec2(lo.x, hi.y), level).x, texelFetch(depthPyramid, hi, level).x));
+
+    // Depth of the nearest point of the sphere, the same way the rasterizer gets it.
+    float nearest = -v.projection.z + v.projection.w / (c.z - radius);
+    return nearest <= farthest;
+}
+
+void main() {
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= cull.meshletCount) {
+        return;
+    }
+
+    Meshlet meshlet = meshlets[id];
+    mat4 model = objects[meshlet.objectIndex].model;
+
+    vec3 center = (model * vec4(meshlet.boundingSphere.xyz, 1.0)).xyz;
+    float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+    float radius = meshlet.boundingSphere.w * scale;
+
+    bool visible = true;
+    for (int i = 0; i < 6; ++i) {
+        visible = visible && dot(cull.frustumPlanes[i].xyz, center) + cull.frustumPlanes[i].w > -radius;
+    }
+
+    // Every triangle in the cluster faces away from the camera.
+    if (visible && cull.coneCulling != 0 && meshlet.cone.w < 1.0) {
+        vec3 axis = normalize(mat3(model) * meshlet.cone.xyz);
+        vec3 toCenter = center - cull.cameraPos.xyz;
+        visible = dot(toCenter, axis) < meshlet.cone.w * length(toCenter) + radius;
+    }
+
+    bool late = false;
+    if (cull.phase == PHASE_EARLY) {
+        visible = visible && occlusionVisible(center, radius, occlusionViews[0]);
+    } else if (cull.phase == PHASE_LATE && visible && draws[id].indexCount == 0) {
+        late = occlusionVisible(center, radius, occlusionViews[1]);
+        if (!late) {
+            atomicAdd(occludedClusters, 1);
+            atomicAdd(occludedTriangles, meshlet.indexCount / 3);
+        }
+        visible = late;
+    } else if (cull.phase == PHASE_LATE) {
+        visible = false; // Drawn by the early phase or outside the frustum
+    }
+
+    uint slot = cull.phase == PHASE_LATE ? cull.meshletCount + id : id;
+    draws[slot].indexCount = visible ? meshlet.indexCount : 0;
+    draws[slot].instanceCount = 1;
+    draws[slot].firstIndex = meshlet.firstIndex;
+    draws[slot].vertexOffset = meshlet.vertexOffset;
+    draws[slot].firstInstance = 0;
+
+    if (visible) {
+        atomicAdd(visibleClusters, 1);
+        atomicAdd(visibleTriangles, meshlet.indexCount / 3);
+    }
+    if (late) {
+        atomicAdd(lateClusters, 1);
+    }
+}
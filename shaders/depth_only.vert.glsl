@@ -0,0 +1,48 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Built a second time with MULTIVIEW defined, for passes that draw every view at once.
+#ifdef MULTIVIEW
+#extension GL_EXT_multiview : require
+#define VIEW_INDEX gl_ViewIndex
+#else
+#define VIEW_INDEX 0
+#endif
+
+// Position only version of mesh.vert for the depth pre-pass. The color pass tests with EQUAL
+// against this depth, so gl_Position has to be computed exactly the same way in both shaders.
+
+layout(binding = 0) uniform Uniforms_t {
+   mat4 view;
+   mat4 proj;
+   vec4 cameraPos;
+   vec4 renderSize; // xy in pixels
+   vec4 clusterDepth; // near, far, slice scale, slice bias
+   uvec4 lightInfo; // x = light count
+   vec4 viewInfo; // x = how far an eye is from the camera, y = view count
+   mat4 viewProj[2]; // MAX_VIEWS
+} ubo;
+
+struct ObjectData {
+    mat4 model;
+    mat4 normal;
+};
+
+layout(std430, binding = 1) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+layout(push_constant) uniform PushConsts {
+    uint objectIndex;
+} pc;
+
+layout(location = 0) in vec3 inPosition;
+
+invariant gl_Position;
+
+void main() {
+    ObjectData object = objects[pc.objectIndex];
+    vec4 world_space_vertex = object.model * vec4(inPosition, 1.0);
+
+    gl_Position = ubo.viewProj[VIEW_INDEX] * world_space_vertex;
+}
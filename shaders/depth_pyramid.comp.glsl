@@ -0,0 +1,37 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// One level of the depth pyramid. Every texel keeps the farthest depth of the source texels it
+// covers. Level 0 comes from the depth target and covers the rendered region, whatever its size,
+// so a texel can span up to three source texels per axis. Later levels halve the previous one.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2D source;
+layout(binding = 1, r32f) uniform writeonly image2D destination;
+
+layout(push_constant) uniform PyramidData {
+    uvec2 sourceSize; // Region of the source level to cover
+    uvec2 destinationSize;
+    uint sourceLevel;
+} pyramid;
+
+void main() {
+    uvec2 pos = gl_GlobalInvocationID.xy;
+    if (any(greaterThanEqual(pos, pyramid.destinationSize))) {
+        return;
+    }
+
+    uvec2 begin = pos * pyramid.sourceSize / pyramid.destinationSize;
+    uvec2 end = ((pos + 1) * pyramid.sourceSize + pyramid.destinationSize - 1) / pyramid.destinationSize;
+    end = max(end, begin + 1);
+
+    float depth = 0.0;
+    for (uint y = begin.y; y < end.y; ++y) {
+        for (uint x = begin.x; x < end.x; ++x) {
+            depth = max(depth, texelFetch(source, ivec2(x, y), int(pyramid.sourceLevel)).x);
+        }
+    }
+
+    imageStore(destination, ivec2(pos), vec4(depth));
+}
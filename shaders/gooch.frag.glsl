@@ -1,32 +1,59 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
 
-#define NUM_LIGHTS 2
+#define LIGHT_GRID_ACCESS readonly
+#include "light_clusters.glsl"
+#include "materials.glsl"
+
+// Set per pipeline variant, see vk_variants.h. Clusters list their lights in index order, so a
+// lower cap drops the later lights first.
+layout(constant_id = 0) const uint MAX_SHADED_LIGHTS = 128;
+layout(constant_id = 1) const bool SPECULAR = true;
 
 layout(location = 0) in vec3 Normal;
 layout(location = 1) in vec3 wsVertex;
-layout(location = 2) in vec3 light_dirs[NUM_LIGHTS];
+layout(location = 2) in float viewDepth;
+layout(location = 3) in vec2 texCoord;
+layout(location = 4) flat in uint materialIndex;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
     vec3 n = normalize(Normal);
-    float cosTheta0 = clamp( dot(n, normalize(light_dirs[0])), 0, 1);
-    vec3 view_dir = normalize(light_dirs[1]);
+    vec3 view_dir = normalize(ubo.cameraPos.xyz - wsVertex);
 
-    vec3 c_surface = vec3(0.4, 0.4, 0.4);
+    vec3 c_surface = 0.4f * materialBaseColor(materialIndex, texCoord);
     
     vec3 c_cool = vec3(0.0f, 0.0f, 0.55f) + 0.25f * c_surface;
     vec3 c_warm = vec3(0.5f, 0.2f, 0.0f) + 0.25f * c_surface;
     vec3 c_highlight = vec3(0.97f, 0.97f, 0.97f);
-    float t = (cosTheta0 + 1.0f)/2.0f;
-    vec3 rr = reflect(light_dirs[0], n); // Calcs reflection on other side of normal based on incidence
-    float s = clamp( (100.0f*dot(rr,view_dir)-97.0f), 0, 1);
+
+    // Warmth and highlight summed over the lights of the cluster, weighted by their attenuation.
+    float t = 0.0f;
+    float s = 0.0f;
+    uint cluster = clusterIndex(gl_FragCoord.xy, viewDepth);
+    uint first = cluster * MAX_LIGHTS_PER_CLUSTER;
+    uint count = min(lightCounts[cluster], MAX_SHADED_LIGHTS);
+    for (uint i = 0; i < count; ++i) {
+        PointLight light = lights[lightIndices[first + i]];
+        vec3 toLight = light.positionRadius.xyz - wsVertex;
+        float distance = length(toLight);
+        vec3 l = toLight / distance;
+        float attenuation = lightAttenuation(distance, light.positionRadius.w) * light.colorIntensity.w;
+        float cosTheta = clamp(dot(n, l), 0, 1);
+        t += attenuation * (cosTheta + 1.0f) / 2.0f;
+        if (SPECULAR) {
+            vec3 rr = reflect(-l, n); // Calcs reflection on other side of normal based on incidence
+            s += attenuation * clamp((100.0f*dot(rr,view_dir)-97.0f), 0, 1);
+        }
+    }
+    t = clamp(t, 0, 1);
+    s = clamp(s, 0, 1);
 
     vec3 c_diffuse = mix(c_cool, c_warm, t); // mix(x,y,t) is just lerp: (1-t)*x+y*t
     vec3 color = mix(c_diffuse, c_highlight, s);
     color = clamp(color, 0, 0.98);
     
     outColor = vec4(color, 1.0);
- 
-}	      			
+}
@@ -1,33 +1,41 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
 
-#define NUM_LIGHTS 2
+#define LIGHT_GRID_ACCESS readonly
+#include "light_clusters.glsl"
+#include "materials.glsl"
+
+// Set per pipeline variant, see vk_variants.h. Clusters list their lights in index order, so a
+// lower cap drops the later lights first.
+layout(constant_id = 0) const uint MAX_SHADED_LIGHTS = 128;
 
 layout(location = 0) in vec3 Normal;
 layout(location = 1) in vec3 wsVertex;
-layout(location = 2) in vec3 light_dirs[NUM_LIGHTS];
+layout(location = 2) in float viewDepth;
+layout(location = 3) in vec2 texCoord;
+layout(location = 4) flat in uint materialIndex;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
     vec3 n = normalize(Normal);
-    //vec3 light_dirs[NUM_LIGHTS];
-    //light_dirs[0] = vec3(-1.0f, 1.0f, 8.0f);
-    //light_dirs[1] = vec3(0.0f, 1.0f, -3.0f);
-
-    float cosTheta0 = clamp( dot(n, normalize(light_dirs[0])), 0, 1);
-    float cosTheta1 = clamp( dot(n, normalize(light_dirs[1])), 0, 1);
-
-    vec3 light0Color = vec3(1.0, 1.0, 1.0);
-    vec3 light1Color = vec3(0.5, 0.0, 1.0);
-
-    float lightIntensity0 = 0.5f;
-    float lightIntensity1 = 1.0f;
-    vec3 light0 = lightIntensity0 * light0Color;
-    vec3 light1 = lightIntensity1 * light1Color;
-    
-    vec3 baseDiffuse = {0.2, 0.2, 0.2};
-    vec3 color = baseDiffuse +  (light0 * cosTheta0) + (light1 * cosTheta1) ;
-    
-    outColor = vec4(color, 1.0);
-}	      			
+
+    vec3 ambient = {0.2, 0.2, 0.2};
+    vec3 light_sum = ambient;
+
+    // Only the lights whose radius reaches this cluster.
+    uint cluster = clusterIndex(gl_FragCoord.xy, viewDepth);
+    uint first = cluster * MAX_LIGHTS_PER_CLUSTER;
+    uint count = min(lightCounts[cluster], MAX_SHADED_LIGHTS);
+    for (uint i = 0; i < count; ++i) {
+        PointLight light = lights[lightIndices[first + i]];
+        vec3 toLight = light.positionRadius.xyz - wsVertex;
+        float distance = length(toLight);
+        float cosTheta = clamp(dot(n, toLight / distance), 0, 1);
+        float attenuation = lightAttenuation(distance, light.positionRadius.w);
+        light_sum += light.colorIntensity.rgb * light.colorIntensity.w * cosTheta * attenuation;
+    }
+
+    outColor = vec4(materialBaseColor(materialIndex, texCoord) * light_sum, 1.0);
+}
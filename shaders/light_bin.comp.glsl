@@ -0,0 +1,67 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
+
+// One invocation per cluster. Lights are moved to view space and staged through shared memory a
+// workgroup at a time, every cluster tests each staged light against its view space bounds.
+
+layout(local_size_x = 64) in;
+
+#define LIGHT_GRID_ACCESS writeonly
+#include "light_clusters.glsl"
+
+shared vec4 stagedLights[64]; // xyz = view space position, w = radius
+
+void main() {
+    uint cluster = gl_GlobalInvocationID.x;
+    bool valid = cluster < LIGHT_CLUSTER_COUNT;
+
+    uvec3 c = uvec3(cluster % LIGHT_CLUSTERS_X,
+                    (cluster / LIGHT_CLUSTERS_X) % LIGHT_CLUSTERS_Y,
+                    cluster / (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y));
+
+    // View space bounds of the cluster. A point at view depth d projects to ndc.x = proj[0][0] * x / d,
+    // so the tile edges at d are at x = ndc.x * d / proj[0][0], the same for y.
+    vec2 ndcMin = vec2(c.xy) / vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y) * 2.0 - 1.0;
+    vec2 ndcMax = vec2(c.xy + 1) / vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y) * 2.0 - 1.0;
+    vec2 projScale = vec2(ubo.proj[0][0], ubo.proj[1][1]);
+    float nearDepth = sliceDepth(c.z);
+    float farDepth = sliceDepth(c.z + 1);
+
+    vec2 a = ndcMin * nearDepth / projScale;
+    vec2 b = ndcMax * nearDepth / projScale;
+    vec2 e = ndcMin * farDepth / projScale;
+    vec2 f = ndcMax * farDepth / projScale;
+    vec3 boundsMin = vec3(min(min(a, b), min(e, f)), -farDepth);
+    vec3 boundsMax = vec3(max(max(a, b), max(e, f)), -nearDepth);
+
+    uint lightCount = ubo.lightInfo.x;
+    uint count = 0;
+    for (uint base = 0; base < lightCount; base += 64u) {
+        uint index = base + gl_LocalInvocationIndex;
+        if (index < lightCount) {
+            vec4 light = lights[index].positionRadius;
+            // The clusters are seen from the camera. An eye's cluster is the same one moved sideways
+            // by at most viewInfo.x, growing the light by that covers every eye.
+            stagedLights[gl_LocalInvocationIndex] = vec4((ubo.view * vec4(light.xyz, 1.0)).xyz,
+                                                         light.w + ubo.viewInfo.x);
+        }
+        barrier();
+
+        uint batch = min(64u, lightCount - base);
+        for (uint i = 0; valid && i < batch; ++i) {
+            vec4 light = stagedLights[i];
+            vec3 closest = clamp(light.xyz, boundsMin, boundsMax);
+            vec3 d = closest - light.xyz;
+            if (dot(d, d) <= light.w * light.w && count < MAX_LIGHTS_PER_CLUSTER) {
+                lightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + count] = base + i;
+                count++;
+            }
+        }
+        barrier();
+    }
+
+    if (valid) {
+        lightCounts[cluster] = count;
+    }
+}
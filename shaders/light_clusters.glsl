@@ -0,0 +1,56 @@
+// Shared by the light binning pass and the shading. Must match the LIGHT_CLUSTERS_* defines in
+// vk_common.h.
+
+#define LIGHT_CLUSTERS_X 16u
+#define LIGHT_CLUSTERS_Y 9u
+#define LIGHT_CLUSTERS_Z 24u
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+#define MAX_LIGHTS_PER_CLUSTER 128u
+
+layout(binding = 0) uniform Uniforms_t {
+   mat4 view;
+   mat4 proj;
+   vec4 cameraPos;
+   vec4 renderSize; // xy in pixels
+   vec4 clusterDepth; // near, far, slice scale, slice bias
+   uvec4 lightInfo; // x = light count
+   vec4 viewInfo; // x = how far an eye is from the camera, y = view count
+   mat4 viewProj[2]; // MAX_VIEWS
+} ubo;
+
+struct PointLight {
+    vec4 positionRadius; // World space
+    vec4 colorIntensity;
+};
+
+layout(std430, binding = 2) readonly buffer Lights {
+    PointLight lights[];
+};
+
+// Cluster c owns lightIndices[c * MAX_LIGHTS_PER_CLUSTER] onwards, lightCounts[c] of them are used.
+layout(std430, binding = 3) LIGHT_GRID_ACCESS buffer LightCounts {
+    uint lightCounts[];
+};
+
+layout(std430, binding = 4) LIGHT_GRID_ACCESS buffer LightIndices {
+    uint lightIndices[];
+};
+
+// Slices are spaced exponentially in view depth, so clusters stay roughly cube shaped.
+float sliceDepth(uint slice) {
+    return ubo.clusterDepth.x * pow(ubo.clusterDepth.y / ubo.clusterDepth.x, float(slice) / LIGHT_CLUSTERS_Z);
+}
+
+uint clusterIndex(vec2 fragCoord, float viewDepth) {
+    uvec2 tile = uvec2(fragCoord * vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y) / ubo.renderSize.xy);
+    tile = min(tile, uvec2(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1));
+    float slice = log(max(viewDepth, ubo.clusterDepth.x)) * ubo.clusterDepth.z + ubo.clusterDepth.w;
+    uint z = min(uint(max(slice, 0.0)), LIGHT_CLUSTERS_Z - 1);
+    return tile.x + LIGHT_CLUSTERS_X * (tile.y + LIGHT_CLUSTERS_Y * z);
+}
+
+// Smooth falloff that reaches zero at the light radius, so binning by radius loses nothing.
+float lightAttenuation(float distance, float radius) {
+    float x = clamp(1.0 - (distance * distance) / (radius * radius), 0.0, 1.0);
+    return x * x;
+}
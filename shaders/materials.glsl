@@ -0,0 +1,27 @@
+// Bindless material table, set 1 of the mesh pipeline layout. Has to match Material_t in
+// src/vk_common.h and the layout in src/vk_bindless.cpp. Include in fragment shaders, the vertex
+// shader only reads the per object material index.
+
+struct Material {
+    vec4 baseColor; // Multiplies the base color texture
+    uint baseColorTexture; // Slot in textures, 0 is plain white
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Materials {
+    Material materials[];
+};
+
+// Sized per device, large and partially bound with descriptor indexing, otherwise every slot
+// holds a texture.
+layout(constant_id = 2) const uint TEXTURE_SLOTS = 16;
+layout(set = 1, binding = 2) uniform sampler2D textures[TEXTURE_SLOTS];
+
+// The material index is flat and the same for the whole draw, so the texture index is
+// dynamically uniform.
+vec3 materialBaseColor(uint materialIndex, vec2 uv) {
+    Material material = materials[materialIndex];
+    return material.baseColor.rgb * texture(textures[material.baseColorTexture], uv).rgb;
+}
@@ -1,45 +1,73 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-#define NUM_LIGHTS 2
+// Built a second time with MULTIVIEW defined, for passes that draw every view at once.
+#ifdef MULTIVIEW
+#extension GL_EXT_multiview : require
+#define VIEW_INDEX gl_ViewIndex
+#else
+#define VIEW_INDEX 0
+#endif
 
 layout(binding = 0) uniform Uniforms_t {
    mat4 view;
    mat4 proj;
+   vec4 cameraPos;
+   vec4 renderSize; // xy in pixels
+   vec4 clusterDepth; // near, far, slice scale, slice bias
+   uvec4 lightInfo; // x = light count
+   vec4 viewInfo; // x = how far an eye is from the camera, y = view count
+   mat4 viewProj[2]; // MAX_VIEWS
 } ubo;
 
-layout(push_constant) uniform PushConsts {
+struct ObjectData {
     mat4 model;
-    vec4 lights[NUM_LIGHTS];
+    mat4 normal;
+};
+
+layout(std430, binding = 1) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+// Material of every object, the table itself is in materials.glsl.
+layout(std430, set = 1, binding = 1) readonly buffer ObjectMaterials {
+    uint objectMaterials[];
+};
+
+layout(push_constant) uniform PushConsts {
+    uint objectIndex;
 } pc;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec3 wsVertex;
-layout(location = 2) out vec3 light_dirs[NUM_LIGHTS];
+layout(location = 2) out float viewDepth; // Positive distance along the view axis, picks the cluster slice
+layout(location = 3) out vec2 texCoord;
+layout(location = 4) flat out uint materialIndex;
 
+// Must match depth_only.vert for the EQUAL depth test after the pre-pass.
+invariant gl_Position;
 
 void main() {
-    vec4 world_space_vertex = pc.model * vec4(inPosition, 1.0); //TODO(anton): Make sure ubo.model works!! !?!?!
+    ObjectData object = objects[pc.objectIndex];
+    vec4 world_space_vertex = object.model * vec4(inPosition, 1.0);
     vec4 view_space_vertex = ubo.view * world_space_vertex;
     
-    gl_Position = ubo.proj * view_space_vertex;
+    gl_Position = ubo.viewProj[VIEW_INDEX] * world_space_vertex;
     //gl_Position = vec4(inPosition, 1.0);
 
     wsVertex = world_space_vertex.xyz;
 
-    outNormal = mat3(transpose(inverse(pc.model))) * inNormal;
+    outNormal = mat3(object.normal) * inNormal;
     //outNormal = inNormal;
 
-    for (int i = 0; i < NUM_LIGHTS; ++i)
-    {
-        //light_dirs[i] = pc.matrices[1][i].xyz - world_space_vertex.xyz;
-        light_dirs[i] = pc.lights[i].xyz - world_space_vertex.xyz;
+    viewDepth = -view_space_vertex.z; // The eyes only move sideways, so this is the same for each
 
-    }
-    //viewPos = pc.cameraPos.xyz;
+    texCoord = inTexCoord;
+    materialIndex = objectMaterials[pc.objectIndex];
     
 }
 
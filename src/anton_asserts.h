@@ -8,6 +8,8 @@
 #ifdef ASSERTIONS_ENABLED
 #include <iostream>
 
+#include "logger.h"
+
 #if _MSC_VER
 #include <intrin.h>
 #define debugBreak() __debugbreak();
@@ -44,6 +46,7 @@
 #endif
 
 FORCEINLINE void reportAssertionFailure( const char* expression, const char* message, const char* file, int line ) {
+    Logger::Flush(); // Get whatever led up to the failure out before breaking
     std::cerr << "Assertion Failure: " << expression << ", message: '" << message << "', in file: " << file << ", line: " << line << "\n";
 }
 
@@ -0,0 +1,164 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "anton_asserts.h"
+#include "arena.h"
+
+static
+u8 *blockData(ArenaBlock_t *block) {
+    return (u8 *) block + sizeof(ArenaBlock_t);
+}
+
+static
+ArenaBlock_t *takeBlock(Arena_t &arena, u64 minCapacity) {
+    ArenaBlock_t **link = &arena.freeBlocks;
+    while (*link) {
+        ArenaBlock_t *block = *link;
+        if (block->capacity >= minCapacity) {
+            *link = block->prev;
+            return block;
+        }
+        link = &block->prev;
+    }
+
+    u64 capacity = minCapacity > ARENA_BLOCK_SIZE ? minCapacity : ARENA_BLOCK_SIZE;
+    ArenaBlock_t *block = (ArenaBlock_t *) ::operator new(sizeof(ArenaBlock_t) + capacity);
+    block->capacity = capacity;
+    arena.reservedBytes += capacity;
+    return block;
+}
+
+void *arenaAlloc(Arena_t &arena, u64 size, u64 alignment) {
+    ASSERT((alignment & (alignment - 1)) == 0);
+
+    ArenaBlock_t *block = arena.current;
+    u64 offset = 0;
+    if (block) {
+        u64 address = (u64) (size_t) blockData(block) + block->used;
+        offset = block->used + (((alignment - (address & (alignment - 1))) & (alignment - 1)));
+    }
+
+    if (!block || offset + size > block->capacity) {
+        // Block data starts 16 byte aligned, larger alignments may need some slack.
+        block = takeBlock(arena, size + (alignment > 16 ? alignment : 0));
+        block->prev = arena.current;
+        block->used = 0;
+        arena.current = block;
+
+        u64 address = (u64) (size_t) blockData(block);
+        offset = (alignment - (address & (alignment - 1))) & (alignment - 1);
+    }
+
+    arena.usedBytes += offset + size - block->used;
+    if (arena.usedBytes > arena.peakBytes) arena.peakBytes = arena.usedBytes;
+    block->used = offset + size;
+    return blockData(block) + offset;
+}
+
+ArenaMark_t arenaMark(const Arena_t &arena) {
+    ArenaMark_t mark;
+    mark.block = arena.current;
+    mark.used = arena.current ? arena.current->used : 0;
+    mark.usedBytes = arena.usedBytes;
+    return mark;
+}
+
+void arenaRollback(Arena_t &arena, ArenaMark_t mark) {
+    while (arena.current != mark.block) {
+        ASSERT_MSG(arena.current != nullptr, "Rolled back to a mark from another arena");
+        ArenaBlock_t *block = arena.current;
+        arena.current = block->prev;
+        block->prev = arena.freeBlocks;
+        arena.freeBlocks = block;
+    }
+    if (arena.current) {
+        arena.current->used = mark.used;
+    }
+    arena.usedBytes = mark.usedBytes;
+}
+
+void resetArena(Arena_t &arena) {
+    arenaRollback(arena, {nullptr, 0, 0});
+}
+
+void freeArena(Arena_t &arena) {
+    resetArena(arena);
+    while (arena.freeBlocks) {
+        ArenaBlock_t *block = arena.freeBlocks;
+        arena.freeBlocks = block->prev;
+        ::operator delete(block);
+    }
+    arena.reservedBytes = 0;
+}
+
+// Gives the blocks back when the thread exits.
+struct ThreadArena_t {
+    Arena_t arena;
+    ~ThreadArena_t() { freeArena(arena); }
+};
+
+static thread_local ThreadArena_t t_frameArena;
+static thread_local ThreadArena_t t_scratchArena;
+
+Arena_t &getFrameArena() {
+    return t_frameArena.arena;
+}
+
+Arena_t &getScratchArena() {
+    return t_scratchArena.arena;
+}
+
+#if TRACK_HEAP_ALLOCATIONS
+static std::atomic<u64> g_heapAllocations{0};
+static std::atomic<u64> g_heapFrees{0};
+static std::atomic<u64> g_heapBytes{0};
+static thread_local HeapStats_t t_heapStats = {};
+
+static
+void *countedAlloc(size_t size) {
+    g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    g_heapBytes.fetch_add(size, std::memory_order_relaxed);
+    t_heapStats.allocations += 1;
+    t_heapStats.bytes += size;
+
+    void *memory = malloc(size ? size : 1);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+static
+void countedFree(void *memory) {
+    if (!memory) return;
+    g_heapFrees.fetch_add(1, std::memory_order_relaxed);
+    t_heapStats.frees += 1;
+    free(memory);
+}
+
+void *operator new(size_t size) { return countedAlloc(size); }
+void *operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void *memory) noexcept { countedFree(memory); }
+void operator delete[](void *memory) noexcept { countedFree(memory); }
+void operator delete(void *memory, size_t) noexcept { countedFree(memory); }
+void operator delete[](void *memory, size_t) noexcept { countedFree(memory); }
+
+HeapStats_t getHeapStats() {
+    HeapStats_t stats;
+    stats.allocations = g_heapAllocations.load(std::memory_order_relaxed);
+    stats.frees = g_heapFrees.load(std::memory_order_relaxed);
+    stats.bytes = g_heapBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+HeapStats_t getThreadHeapStats() {
+    return t_heapStats;
+}
+#else
+HeapStats_t getHeapStats() {
+    return {};
+}
+
+HeapStats_t getThreadHeapStats() {
+    return {};
+}
+#endif
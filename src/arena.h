@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "typedefs.h"
+
+// Linear arenas for transient allocations. Allocating is a pointer bump, freeing only happens by
+// rolling back to a mark or resetting the whole arena. Blocks are kept when rolled back, so once
+// an arena has seen its peak usage it never touches the heap again.
+//
+// Every thread has two: the frame arena, reset by the owning loop once per frame or step, and the
+// scratch arena, used through ScratchScope_t for allocations that die with the current function.
+
+// Size of a new block, larger requests get a block of their own.
+#ifndef ARENA_BLOCK_SIZE
+#define ARENA_BLOCK_SIZE (1024 * 1024)
+#endif
+
+// Replace the global operator new/delete with versions that count calls, see getHeapStats().
+#ifndef TRACK_HEAP_ALLOCATIONS
+#define TRACK_HEAP_ALLOCATIONS 1
+#endif
+
+struct alignas(16) ArenaBlock_t {
+    ArenaBlock_t *prev;
+    u64 capacity;
+    u64 used;
+};
+
+struct Arena_t {
+    ArenaBlock_t *current = nullptr;
+    ArenaBlock_t *freeBlocks = nullptr; // Rolled back blocks, reused before allocating new ones
+    u64 usedBytes = 0;
+    u64 peakBytes = 0;
+    u64 reservedBytes = 0;
+};
+
+struct ArenaMark_t {
+    ArenaBlock_t *block;
+    u64 used;
+    u64 usedBytes;
+};
+
+void *arenaAlloc(Arena_t &arena, u64 size, u64 alignment = 16);
+ArenaMark_t arenaMark(const Arena_t &arena);
+void arenaRollback(Arena_t &arena, ArenaMark_t mark);
+void resetArena(Arena_t &arena);
+void freeArena(Arena_t &arena); // Gives every block back to the heap
+
+template<typename T>
+T *arenaAllocArray(Arena_t &arena, u64 count) {
+    return (T *) arenaAlloc(arena, count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16);
+}
+
+// Calling thread's arenas, created on first use.
+Arena_t &getFrameArena();
+Arena_t &getScratchArena();
+
+// Rolls the calling thread's scratch arena back to where it was when the scope was opened.
+// Scopes nest, but memory from an inner scope must not outlive it.
+struct ScratchScope_t {
+    Arena_t &arena;
+    ArenaMark_t mark;
+
+    ScratchScope_t() : arena(getScratchArena()), mark(arenaMark(arena)) {}
+    ~ScratchScope_t() { arenaRollback(arena, mark); }
+
+    ScratchScope_t(const ScratchScope_t &) = delete;
+    ScratchScope_t &operator=(const ScratchScope_t &) = delete;
+};
+
+// STL allocator on top of an arena. deallocate does nothing, the memory comes back with the
+// arena, so containers using it should be reserved up front where the size is known.
+template<typename T>
+struct ArenaAllocator_t {
+    typedef T value_type;
+
+    Arena_t *arena;
+
+    explicit ArenaAllocator_t(Arena_t &arena) : arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator_t(const ArenaAllocator_t<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t count) {
+        return arenaAllocArray<T>(*arena, count);
+    }
+
+    void deallocate(T *, size_t) {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator_t<U> &other) const { return arena == other.arena; }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator_t<U> &other) const { return arena != other.arena; }
+};
+
+template<typename T>
+using ArenaVector_t = std::vector<T, ArenaAllocator_t<T>>;
+
+struct HeapStats_t {
+    u64 allocations; // Calls to operator new since startup
+    u64 frees;
+    u64 bytes; // Total requested bytes, not live bytes
+};
+
+// Process wide, and only for the calling thread. Both are zero with TRACK_HEAP_ALLOCATIONS 0.
+HeapStats_t getHeapStats();
+HeapStats_t getThreadHeapStats();
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "benchmark.h"
+
+struct BenchmarkMetric_t {
+    std::string name;
+    f64 value;
+    bool compared; // Against the baseline, lower is better
+};
+
+static BenchmarkConfig_t g_config;
+static std::vector<BenchmarkFrame_t> g_frames;
+static u32 g_frameIndex = 0; // Including the warmup
+static StaticBatchStats_t g_staticBatches = {};
+
+static
+void logUsage() {
+    Logger::Log("usage: anton_vk --bench [objects=N] [triangles=N] [instancing=0..1] [static=0..1] "
+                "[camera=orbit|flythrough|static] [seed=N] [frames=N] [warmup=N] [headless=0|1] [out=path] "
+                "[baseline=path] [threshold=percent]");
+}
+
+bool parseBenchmarkArgs(i32 argc, const char **argv, BenchmarkConfig_t &config) {
+    for (i32 i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            config.enabled = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--trace") == 0) continue; // Handled by main
+
+        const char *equals = strchr(argv[i], '=');
+        if (!config.enabled || !equals) {
+            Logger::Error("Unknown argument %s", argv[i]);
+            logUsage();
+            return false;
+        }
+        std::string key(argv[i], equals - argv[i]);
+        const char *value = equals + 1;
+
+        if (key == "objects") {
+            config.scene.objectCount = (u32) strtoul(value, nullptr, 10);
+        } else if (key == "triangles") {
+            config.scene.trianglesPerMesh = (u32) strtoul(value, nullptr, 10);
+        } else if (key == "instancing") {
+            config.scene.instancingRatio = strtof(value, nullptr);
+        } else if (key == "static") {
+            config.scene.staticRatio = strtof(value, nullptr);
+        } else if (key == "camera") {
+            u32 path = 0;
+            while (path < CameraPath_Count && strcmp(value, cameraPathName((CameraPath_t) path)) != 0) path++;
+            if (path == CameraPath_Count) {
+                Logger::Error("Unknown camera path %s", value);
+                logUsage();
+                return false;
+            }
+            config.scene.cameraPath = (CameraPath_t) path;
+        } else if (key == "seed") {
+            config.scene.seed = (u32) strtoul(value, nullptr, 10);
+        } else if (key == "frames") {
+            config.frames = (u32) strtoul(value, nullptr, 10);
+        } else if (key == "warmup") {
+            config.warmupFrames = (u32) strtoul(value, nullptr, 10);
+        } else if (key == "headless") {
+            config.headless = strcmp(value, "0") != 0;
+        } else if (key == "out") {
+            config.output = value;
+        } else if (key == "baseline") {
+            config.baseline = value;
+        } else if (key == "threshold") {
+            config.thresholdPercent = strtof(value, nullptr);
+        } else {
+            Logger::Error("Unknown benchmark option %s", key.c_str());
+            logUsage();
+            return false;
+        }
+    }
+
+    if (config.enabled && config.frames == 0) config.frames = 1;
+    if (config.enabled && (config.scene.objectCount == 0 || config.scene.objectCount > STRESS_MAX_OBJECTS)) {
+        Logger::Error("Benchmark object count has to be between 1 and %i", STRESS_MAX_OBJECTS);
+        return false;
+    }
+    return true;
+}
+
+void beginBenchmark(const BenchmarkConfig_t &config) {
+    g_config = config;
+    g_frames.clear();
+    g_frames.reserve(config.frames); // Recording must not allocate during the run
+    g_frameIndex = 0;
+    Logger::Log("Benchmark: %i frames after %i warmup frames, camera %s", config.frames, config.warmupFrames,
+                cameraPathName(config.scene.cameraPath));
+}
+
+void setBenchmarkStaticBatches(const StaticBatchStats_t &stats) {
+    g_staticBatches = stats;
+}
+
+f32 benchmarkCameraTime() {
+    if (g_frameIndex < g_config.warmupFrames) return 0.0f;
+    return (f32) (g_frameIndex - g_config.warmupFrames) / (f32) g_config.frames;
+}
+
+bool recordBenchmarkFrame(const BenchmarkFrame_t &frame) {
+    if (g_frameIndex++ >= g_config.warmupFrames) {
+        g_frames.push_back(frame);
+    }
+    return g_frames.size() >= g_config.frames;
+}
+
+// Nearest rank on a sorted copy.
+static
+f64 percentile(const std::vector<f64> &sorted, f64 p) {
+    if (sorted.empty()) return 0.0;
+    u32 rank = (u32) (p / 100.0 * (f64) (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+}
+
+static
+void addDistribution(std::vector<BenchmarkMetric_t> &metrics, const char *name, std::vector<f64> &values) {
+    std::sort(values.begin(), values.end());
+    f64 sum = 0.0;
+    for (f64 value : values) sum += value;
+    std::string prefix = name;
+    metrics.push_back({prefix + "_mean", values.empty() ? 0.0 : sum / values.size(), true});
+    metrics.push_back({prefix + "_p50", percentile(values, 50.0), true});
+    metrics.push_back({prefix + "_p90", percentile(values, 90.0), true});
+    metrics.push_back({prefix + "_p99", percentile(values, 99.0), true});
+    metrics.push_back({prefix + "_max", values.empty() ? 0.0 : values.back(), false}); // Too noisy to gate on
+}
+
+// Enough JSON for the reports this file writes, keys are unique across the whole report.
+static
+bool findJsonNumber(const std::string &json, const std::string &key, f64 &value) {
+    size_t position = json.find("\"" + key + "\":");
+    if (position == std::string::npos) return false;
+    const char *start = json.c_str() + position + key.size() + 3;
+    char *end = nullptr;
+    value = strtod(start, &end);
+    return end != start;
+}
+
+static
+bool writeReport(const char *path, const std::vector<BenchmarkMetric_t> &metrics) {
+    std::ofstream file(path);
+    if (!file.is_open()) return false;
+
+    const StressSceneParams_t &scene = g_config.scene;
+    file << "{\n";
+    file << "  \"scene\": {\"objects\": " << scene.objectCount << ", \"triangles\": " << scene.trianglesPerMesh
+         << ", \"instancing\": " << scene.instancingRatio << ", \"static\": " << scene.staticRatio
+         << ", \"camera\": \"" << cameraPathName(scene.cameraPath)
+         << "\", \"seed\": " << scene.seed << "},\n";
+    file << "  \"frames\": " << g_frames.size() << ",\n";
+    file << "  \"warmup\": " << g_config.warmupFrames << ",\n";
+    file << "  \"headless\": " << (g_config.headless ? "true" : "false") << ",\n";
+    file << "  \"metrics\": {\n";
+    for (u32 i = 0; i < metrics.size(); i++) {
+        file << "    \"" << metrics[i].name << "\": " << metrics[i].value << (i + 1 < metrics.size() ? ",\n" : "\n");
+    }
+    file << "  }\n";
+    file << "}\n";
+    return file.good();
+}
+
+// Returns the number of metrics that got worse by more than the threshold.
+static
+u32 compareWithBaseline(const char *path, const std::vector<BenchmarkMetric_t> &metrics) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        Logger::Warn("No benchmark baseline at %s", path);
+        return 0;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string baseline = contents.str();
+
+    const char *sceneKeys[] = {"objects", "triangles", "seed"};
+    for (const char *key : sceneKeys) {
+        f64 value = 0.0;
+        if (findJsonNumber(baseline, key, value)) {
+            f64 current = strcmp(key, "objects") == 0 ? g_config.scene.objectCount
+                        : strcmp(key, "triangles") == 0 ? g_config.scene.trianglesPerMesh : g_config.scene.seed;
+            if (value != current) {
+                Logger::Warn("Baseline %s was recorded with %s %f, this run has %f", path, key, value, current);
+            }
+        }
+    }
+
+    u32 regressions = 0;
+    for (const BenchmarkMetric_t &metric : metrics) {
+        f64 previous = 0.0;
+        if (!metric.compared || !findJsonNumber(baseline, metric.name, previous) || previous <= 0.0) continue;
+        f64 change = (metric.value - previous) / previous * 100.0;
+        if (change > g_config.thresholdPercent) {
+            Logger::Error("Regression: %s %f -> %f (+%f%%)", metric.name.c_str(), previous, metric.value, change);
+            regressions++;
+        } else {
+            Logger::Trace("%s %f -> %f (%f%%)", metric.name.c_str(), previous, metric.value, change);
+        }
+    }
+    return regressions;
+}
+
+i32 finishBenchmark() {
+    u32 count = (u32) g_frames.size();
+    std::vector<f64> cpuMs(count), gpuMs(count), frameMs(count);
+    f64 draws = 0.0, clusters = 0.0, occludedClusters = 0.0, occludedTriangles = 0.0, primitives = 0.0, scale = 0.0;
+    u32 maxDraws = 0;
+    u64 maxDeviceBytes = 0;
+    for (u32 i = 0; i < count; i++) {
+        const BenchmarkFrame_t &frame = g_frames[i];
+        cpuMs[i] = frame.cpuMs;
+        gpuMs[i] = frame.gpuMs;
+        frameMs[i] = frame.frameMs;
+        draws += frame.draws;
+        clusters += frame.visibleClusters;
+        occludedClusters += frame.occludedClusters;
+        occludedTriangles += frame.occludedTriangles;
+        primitives += (f64) frame.primitives;
+        scale += frame.renderScale;
+        maxDraws = std::max(maxDraws, frame.draws);
+        maxDeviceBytes = std::max(maxDeviceBytes, frame.deviceBytes);
+    }
+    f64 frames = count > 0 ? (f64) count : 1.0;
+
+    std::vector<BenchmarkMetric_t> metrics;
+    addDistribution(metrics, "cpu_ms", cpuMs);
+    addDistribution(metrics, "gpu_ms", gpuMs);
+    addDistribution(metrics, "frame_ms", frameMs);
+    metrics.push_back({"draws_mean", draws / frames, false});
+    metrics.push_back({"draws_max", (f64) maxDraws, false});
+    metrics.push_back({"static_batched_meshes", (f64) g_staticBatches.mergedMeshes, false});
+    metrics.push_back({"static_batches", (f64) g_staticBatches.batches, false});
+    metrics.push_back({"static_batch_source_mb", g_staticBatches.sourceBytes / (1024.0 * 1024.0), false});
+    metrics.push_back({"static_batch_mb", g_staticBatches.batchBytes / (1024.0 * 1024.0), false});
+    metrics.push_back({"visible_clusters_mean", clusters / frames, false});
+    metrics.push_back({"occluded_clusters_mean", occludedClusters / frames, false});
+    metrics.push_back({"occluded_triangles_mean", occludedTriangles / frames, false});
+    metrics.push_back({"primitives_mean", primitives / frames, false});
+    metrics.push_back({"device_memory_mb_max", (f64) maxDeviceBytes / (1024.0 * 1024.0), true});
+    metrics.push_back({"render_scale_mean", scale / frames, false});
+
+    Logger::Log("Benchmark done: cpu p50 %f p99 %f ms, gpu p50 %f p99 %f ms, %f draws per frame",
+                percentile(cpuMs, 50.0), percentile(cpuMs, 99.0), percentile(gpuMs, 50.0),
+                percentile(gpuMs, 99.0), draws / frames);
+
+    i32 exitCode = 0;
+    if (writeReport(g_config.output.c_str(), metrics)) {
+        Logger::Log("Benchmark report written to %s", g_config.output.c_str());
+    } else {
+        Logger::Error("Could not write the benchmark report to %s", g_config.output.c_str());
+        exitCode = 1;
+    }
+
+    if (!g_config.baseline.empty()) {
+        u32 regressions = compareWithBaseline(g_config.baseline.c_str(), metrics);
+        if (regressions > 0) {
+            Logger::Error("%i metrics regressed by more than %f%% against %s", regressions,
+                          g_config.thresholdPercent, g_config.baseline.c_str());
+            exitCode = BENCHMARK_REGRESSION_EXIT_CODE;
+        } else {
+            Logger::Log("No regressions against %s", g_config.baseline.c_str());
+        }
+    }
+    return exitCode;
+}
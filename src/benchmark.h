@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+
+#include "drawlist.h"
+#include "stress.h"
+
+// Benchmark mode: renders a generated stress scene for a fixed number of frames, writes frame
+// time percentiles, draw counts and memory as JSON and optionally checks them against an earlier
+// report. Started from the command line,
+//
+//   anton_vk --bench objects=100000 triangles=500 instancing=0.95 static=0.5 camera=flythrough seed=2
+//            frames=1000 warmup=100 headless=1 out=bench.json baseline=base.json threshold=5
+//
+// every key is optional. The camera moves by frame number rather than by time so two runs see the
+// same frames. Dynamic resolution still steers the render scale, the mean scale is in the report,
+// build with DYNAMIC_RESOLUTION 0 for runs that have to compare at a fixed resolution.
+
+#define BENCHMARK_DEFAULT_FRAMES 500
+#define BENCHMARK_DEFAULT_WARMUP 60 // Not recorded, pipelines and streaming settle first
+#define BENCHMARK_DEFAULT_THRESHOLD 10.0f // Percent
+
+#define BENCHMARK_REGRESSION_EXIT_CODE 3
+
+struct BenchmarkConfig_t {
+    bool enabled = false;
+    StressSceneParams_t scene;
+    u32 frames = BENCHMARK_DEFAULT_FRAMES;
+    u32 warmupFrames = BENCHMARK_DEFAULT_WARMUP;
+    bool headless = false; // Invisible window, the swapchain still presents
+    std::string output = "benchmark.json";
+    std::string baseline; // Empty for no comparison
+    f32 thresholdPercent = BENCHMARK_DEFAULT_THRESHOLD;
+};
+
+struct BenchmarkFrame_t {
+    f64 cpuMs; // Input sampled to command buffer submitted
+    f64 gpuMs;
+    f64 frameMs; // Start to start
+    u32 draws;
+    u32 visibleClusters;
+    u32 occludedClusters; // In the frustum, hidden by the depth pyramid
+    u32 occludedTriangles;
+    u64 primitives; // That reached the rasterizer
+    u64 deviceBytes; // In device local heaps
+    f32 renderScale;
+};
+
+// False on arguments it does not understand, after logging the usage. Leaves config.enabled false
+// when there is no --bench.
+bool parseBenchmarkArgs(i32 argc, const char **argv, BenchmarkConfig_t &config);
+
+void beginBenchmark(const BenchmarkConfig_t &config);
+
+// What static batching did at load, the report has it next to the draw counts.
+void setBenchmarkStaticBatches(const StaticBatchStats_t &stats);
+
+// Position along the camera path in [0, 1] for the frame about to be drawn.
+f32 benchmarkCameraTime();
+
+// Call once per presented frame, returns true once all frames are recorded.
+bool recordBenchmarkFrame(const BenchmarkFrame_t &frame);
+
+// Writes the report and compares it with the baseline. Returns the process exit code, 0 when
+// nothing regressed past the threshold.
+i32 finishBenchmark();
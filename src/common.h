@@ -9,17 +9,36 @@
 #define VK_USE_PLATFORM_WIN32_KHR
 
 #include "vertex_type.h"
+#include "meshlet.h"
+#include "transforms.h"
 
 struct VPmatrices_t {
     glm::mat4 view;
     glm::mat4 proj;
 };
 
+// A shape or material group of an imported mesh. Stored as is in cooked meshes. Its meshlets never
+// reach into another submesh.
+struct Submesh_t {
+    u32 firstIndex; // Into the mesh index list
+    u32 indexCount;
+    u32 firstMeshlet; // Into the mesh meshlet list
+    u32 meshletCount;
+    u32 material; // Material of the source file, U32_MAX for none
+    u32 pad[3];
+    glm::vec4 boundingSphere; // Object space, xyz = center, w = radius
+};
+
 struct Mesh_t {
-    bool isStatic = false;
+    bool isStatic = false; // Never moves, merged into a batch by batchStaticMeshes
+    u32 material = 0; // Slot in the scene materials, only meshes sharing one are batched together
     std::vector<Vertex_t> vertices;
     std::vector<u32> indices;
-    glm::mat4 modelMatrix;
+    std::vector<Meshlet_t> meshlets;
+    std::vector<Submesh_t> submeshes; // Empty or covering every index, see splitSubmeshes
+    u32 transformIndex = U32_MAX; // Into the scene TransformHierarchy_t
+    glm::vec4 boundingSphere; // Object space, xyz = center, w = radius
+    u32 sharedGeometry = U32_MAX; // Earlier mesh whose vertices and indices this one draws
 
     u32 vertexOffset = 0;
     u32 firstVertex = 0;
@@ -28,5 +47,8 @@ struct Mesh_t {
     u32 firstIndex = 0;
 
     u32 indexCount = 0;
+
+    u32 firstMeshlet = 0;
+    u32 meshletCount = 0;
 };   
 
@@ -0,0 +1,267 @@
+#include <fstream>
+#include <sstream>
+
+#include "cooked.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char *g_assetTypeNames[CookedAsset_Count] = {"mesh", "shader", "shaderpack"};
+
+static MappedFile_t g_shaderPack = {};
+
+// Paths resolved against the manifest directory.
+static std::vector<CookedAsset_t> g_manifest;
+
+const char *cookedAssetTypeName(CookedAssetType_t type) {
+    ASSERT(type < CookedAsset_Count);
+    return g_assetTypeNames[type];
+}
+
+bool loadCookedManifest(const char *path) {
+    g_manifest.clear();
+
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        Logger::Warn("No cooked asset manifest at %s", path);
+        return false;
+    }
+
+    std::string directory = path;
+    size_t slash = directory.find_last_of("/\\");
+    directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+
+    std::string line;
+    std::getline(file, line);
+    u32 version = 0;
+    if (sscanf(line.c_str(), "anton_cook %u", &version) != 1 || version != COOKED_MANIFEST_VERSION) {
+        Logger::Warn("Cooked asset manifest %s is from another cooker version, cook again", path);
+        return false;
+    }
+
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string type;
+        CookedAsset_t asset = {};
+        if (!(fields >> type >> asset.name >> asset.path)) continue;
+
+        u32 typeIndex = 0;
+        while (typeIndex < CookedAsset_Count && type != g_assetTypeNames[typeIndex]) typeIndex++;
+        if (typeIndex == CookedAsset_Count) {
+            Logger::Warn("Unknown cooked asset type %s in %s", type.c_str(), path);
+            continue;
+        }
+        asset.type = (CookedAssetType_t) typeIndex;
+        asset.path = directory + asset.path;
+        g_manifest.push_back(asset);
+    }
+
+    Logger::Trace("Cooked asset manifest %s: %i assets", path, (u32) g_manifest.size());
+    return true;
+}
+
+const char *findCookedAsset(CookedAssetType_t type, const char *name) {
+    for (const CookedAsset_t &asset : g_manifest) {
+        if (asset.type == type && asset.name == name) return asset.path.c_str();
+    }
+    return nullptr;
+}
+
+bool writeCookedManifest(const char *path, const std::vector<CookedAsset_t> &assets) {
+    std::ofstream file(path);
+    if (!file.is_open()) return false;
+
+    file << "anton_cook " << COOKED_MANIFEST_VERSION << "\n";
+    for (const CookedAsset_t &asset : assets) {
+        file << cookedAssetTypeName(asset.type) << " " << asset.name << " " << asset.path << "\n";
+    }
+    return file.good();
+}
+
+bool loadCookedMesh(const char *path, Mesh_t &mesh) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    CookedMeshHeader_t header = {};
+    file.read((char *) &header, sizeof(header));
+    if (!file || header.magic != COOKED_MESH_MAGIC || header.version != COOKED_MESH_VERSION) {
+        Logger::Warn("Cooked mesh %s is not a version %i mesh, cook again", path, COOKED_MESH_VERSION);
+        return false;
+    }
+
+    mesh.vertices.resize(header.vertexCount);
+    mesh.indices.resize(header.indexCount);
+    mesh.meshlets.resize(header.meshletCount);
+    mesh.submeshes.resize(header.submeshCount);
+    file.read((char *) mesh.vertices.data(), header.vertexCount * sizeof(Vertex_t));
+    file.read((char *) mesh.indices.data(), header.indexCount * sizeof(u32));
+    file.read((char *) mesh.meshlets.data(), header.meshletCount * sizeof(Meshlet_t));
+    file.read((char *) mesh.submeshes.data(), header.submeshCount * sizeof(Submesh_t));
+    if (!file) {
+        Logger::Warn("Cooked mesh %s is truncated", path);
+        return false;
+    }
+
+    mesh.indexCount = header.indexCount;
+    mesh.boundingSphere = header.boundingSphere;
+    return true;
+}
+
+bool writeCookedMesh(const char *path, const Mesh_t &mesh) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    CookedMeshHeader_t header = {};
+    header.magic = COOKED_MESH_MAGIC;
+    header.version = COOKED_MESH_VERSION;
+    header.vertexCount = (u32) mesh.vertices.size();
+    header.indexCount = (u32) mesh.indices.size();
+    header.meshletCount = (u32) mesh.meshlets.size();
+    header.submeshCount = (u32) mesh.submeshes.size();
+    header.boundingSphere = mesh.boundingSphere;
+
+    file.write((const char *) &header, sizeof(header));
+    file.write((const char *) mesh.vertices.data(), header.vertexCount * sizeof(Vertex_t));
+    file.write((const char *) mesh.indices.data(), header.indexCount * sizeof(u32));
+    file.write((const char *) mesh.meshlets.data(), header.meshletCount * sizeof(Meshlet_t));
+    file.write((const char *) mesh.submeshes.data(), header.submeshCount * sizeof(Submesh_t));
+    return file.good();
+}
+
+bool mapFile(const char *path, MappedFile_t &mapped) {
+    mapped = {};
+#ifdef _WIN32
+    mapped.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mapped.file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(mapped.file, &size);
+    mapped.size = (u64) size.QuadPart;
+    mapped.mapping = CreateFileMappingA(mapped.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapped.mapping) {
+        mapped.data = (const u8 *) MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!mapped.data) {
+        if (mapped.mapping) CloseHandle(mapped.mapping);
+        CloseHandle(mapped.file);
+        mapped = {};
+        return false;
+    }
+#else
+    i32 fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file
+    if (data == MAP_FAILED) return false;
+    mapped.data = (const u8 *) data;
+    mapped.size = (u64) info.st_size;
+#endif
+    return true;
+}
+
+void unmapFile(MappedFile_t &mapped) {
+    if (!mapped.data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapped.data);
+    CloseHandle(mapped.mapping);
+    CloseHandle(mapped.file);
+#else
+    munmap((void *) mapped.data, (size_t) mapped.size);
+#endif
+    mapped = {};
+}
+
+bool openShaderPack() {
+    closeShaderPack();
+    const char *path = nullptr;
+    for (const CookedAsset_t &asset : g_manifest) {
+        if (asset.type == CookedAsset_ShaderPack) path = asset.path.c_str();
+    }
+    if (!path || !mapFile(path, g_shaderPack)) return false;
+
+    // Checked once here so lookups can trust the table.
+    const ShaderPackHeader_t *header = (const ShaderPackHeader_t *) g_shaderPack.data;
+    bool valid = g_shaderPack.size >= sizeof(ShaderPackHeader_t) && header->magic == SHADER_PACK_MAGIC &&
+                 header->version == SHADER_PACK_VERSION &&
+                 header->shaderCount <= (g_shaderPack.size - sizeof(ShaderPackHeader_t)) / sizeof(ShaderPackEntry_t);
+    const ShaderPackEntry_t *entries = (const ShaderPackEntry_t *) (header + 1);
+    for (u32 i = 0; valid && i < header->shaderCount; i++) {
+        const ShaderPackEntry_t &entry = entries[i];
+        valid = entry.offset % SHADER_PACK_ALIGNMENT == 0 && entry.size % 4 == 0 &&
+                entry.offset <= g_shaderPack.size && entry.size <= g_shaderPack.size - entry.offset &&
+                entry.name[SHADER_PACK_NAME_LENGTH - 1] == 0;
+    }
+    if (!valid) {
+        Logger::Warn("Shader pack %s is corrupt or from another cooker version, cook again", path);
+        unmapFile(g_shaderPack);
+        return false;
+    }
+
+    Logger::Trace("Shader pack %s: %i shaders, %i bytes", path, header->shaderCount, (u32) g_shaderPack.size);
+    return true;
+}
+
+const u32 *findPackedShader(const char *name, u64 &size) {
+    if (!g_shaderPack.data) return nullptr;
+    const ShaderPackHeader_t *header = (const ShaderPackHeader_t *) g_shaderPack.data;
+    const ShaderPackEntry_t *entries = (const ShaderPackEntry_t *) (header + 1);
+    for (u32 i = 0; i < header->shaderCount; i++) {
+        if (strcmp(entries[i].name, name) == 0) {
+            size = entries[i].size;
+            return (const u32 *) (g_shaderPack.data + entries[i].offset);
+        }
+    }
+    return nullptr;
+}
+
+void closeShaderPack() {
+    unmapFile(g_shaderPack);
+}
+
+bool writeShaderPack(const char *path, const std::vector<std::string> &names,
+                     const std::vector<std::vector<u8>> &modules) {
+    ASSERT(names.size() == modules.size());
+    ShaderPackHeader_t header = {};
+    header.magic = SHADER_PACK_MAGIC;
+    header.version = SHADER_PACK_VERSION;
+    header.shaderCount = (u32) names.size();
+
+    std::vector<ShaderPackEntry_t> entries(names.size());
+    u64 offset = sizeof(header) + entries.size() * sizeof(ShaderPackEntry_t);
+    for (u32 i = 0; i < entries.size(); i++) {
+        if (names[i].size() >= SHADER_PACK_NAME_LENGTH) {
+            Logger::Error("Shader name %s is too long for the shader pack", names[i].c_str());
+            return false;
+        }
+        offset = (offset + SHADER_PACK_ALIGNMENT - 1) & ~(u64) (SHADER_PACK_ALIGNMENT - 1);
+        memcpy(entries[i].name, names[i].c_str(), names[i].size() + 1);
+        entries[i].offset = (u32) offset;
+        entries[i].size = (u32) modules[i].size();
+        offset += modules[i].size();
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    file.write((const char *) &header, sizeof(header));
+    file.write((const char *) entries.data(), entries.size() * sizeof(ShaderPackEntry_t));
+    u64 written = sizeof(header) + entries.size() * sizeof(ShaderPackEntry_t);
+    const char padding[SHADER_PACK_ALIGNMENT] = {};
+    for (u32 i = 0; i < entries.size(); i++) {
+        file.write(padding, entries[i].offset - written);
+        file.write((const char *) modules[i].data(), modules[i].size());
+        written = entries[i].offset + modules[i].size();
+    }
+    return file.good();
+}
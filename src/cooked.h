@@ -0,0 +1,104 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+// Runtime side of the assets anton_cook produces, see cook/cook.h. The manifest lists every
+// cooked asset by name, meshes are stored exactly as Mesh_t holds them so loading is a few reads.
+
+// Relative to the working directory of anton_vk, next to the build.bat shader output.
+#ifndef COOKED_MANIFEST_PATH
+#define COOKED_MANIFEST_PATH "../cooked/manifest.txt"
+#endif
+
+#define COOKED_MANIFEST_VERSION 1
+
+#define COOKED_MESH_MAGIC 0x48534d41 // "AMSH"
+#define COOKED_MESH_VERSION 2
+
+#define SHADER_PACK_MAGIC 0x4b505341 // "ASPK"
+#define SHADER_PACK_VERSION 1
+#define SHADER_PACK_NAME_LENGTH 48
+#define SHADER_PACK_ALIGNMENT 16
+
+enum CookedAssetType_t : u32 {
+    CookedAsset_Mesh,
+    CookedAsset_Shader,
+    CookedAsset_ShaderPack, // Every shader in one file, see openShaderPack
+    CookedAsset_Count
+};
+
+struct CookedAsset_t {
+    CookedAssetType_t type;
+    std::string name; // Source file name without the directory and the .obj/.glsl extension
+    std::string path; // Relative to the manifest
+};
+
+struct CookedMeshHeader_t {
+    u32 magic;
+    u32 version;
+    u32 vertexCount;
+    u32 indexCount;
+    u32 meshletCount;
+    u32 submeshCount;
+    u32 pad[2];
+    glm::vec4 boundingSphere;
+    // Followed by the Vertex_t, u32 index, Meshlet_t and Submesh_t arrays.
+};
+
+struct MappedFile_t {
+    const u8 *data;
+    u64 size;
+#ifdef _WIN32
+    void *file; // HANDLEs
+    void *mapping;
+#endif
+};
+
+// Read only mapping of a whole file, the pages come in as they are touched. Reads from the mapping
+// are safe from any thread.
+bool mapFile(const char *path, MappedFile_t &mapped);
+void unmapFile(MappedFile_t &mapped);
+
+const char *cookedAssetTypeName(CookedAssetType_t type);
+
+// Replaces the loaded manifest, false when it is missing or from another cooker version.
+bool loadCookedManifest(const char *path);
+
+// Path of a cooked asset in the loaded manifest, nullptr when it is not in there.
+const char *findCookedAsset(CookedAssetType_t type, const char *name);
+
+bool writeCookedManifest(const char *path, const std::vector<CookedAsset_t> &assets);
+
+// All SPIR-V modules back to back, each at a SHADER_PACK_ALIGNMENT offset from the file start.
+struct ShaderPackHeader_t {
+    u32 magic;
+    u32 version;
+    u32 shaderCount;
+    u32 pad;
+    // Followed by shaderCount ShaderPackEntry_t, then the modules.
+};
+
+struct ShaderPackEntry_t {
+    char name[SHADER_PACK_NAME_LENGTH]; // Same as the CookedAsset_Shader name, zero terminated
+    u32 offset;
+    u32 size;
+    u32 pad[2];
+};
+
+// Maps the shader pack of the loaded manifest, false when there is none or it does not check out.
+bool openShaderPack();
+
+// SPIR-V inside the mapping, valid until closeShaderPack. nullptr when the pack does not have it.
+const u32 *findPackedShader(const char *name, u64 &size);
+
+void closeShaderPack();
+
+bool writeShaderPack(const char *path, const std::vector<std::string> &names,
+                     const std::vector<std::vector<u8>> &modules);
+
+// Fills vertices, indices, meshlets, submeshes, indexCount and boundingSphere.
+bool loadCookedMesh(const char *path, Mesh_t &mesh);
+bool writeCookedMesh(const char *path, const Mesh_t &mesh);
@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <cfloat>
+
+#include "drawlist.h"
+
+struct DrawOrder_t {
+    f32 depth;
+    u32 meshIndex;
+};
+
+struct StaticBatchKey_t {
+    u32 material;
+    glm::ivec3 cell;
+    u32 meshIndex;
+};
+
+static
+bool batchKeyLess(const StaticBatchKey_t &a, const StaticBatchKey_t &b) {
+    if (a.material != b.material) return a.material < b.material;
+    if (a.cell.x != b.cell.x) return a.cell.x < b.cell.x;
+    if (a.cell.y != b.cell.y) return a.cell.y < b.cell.y;
+    if (a.cell.z != b.cell.z) return a.cell.z < b.cell.z;
+    return a.meshIndex < b.meshIndex;
+}
+
+static
+bool sameBatch(const StaticBatchKey_t &a, const StaticBatchKey_t &b) {
+    return a.material == b.material && a.cell == b.cell;
+}
+
+// Walks up the parents, the hierarchy has not been updated yet at load.
+static
+glm::mat4 staticWorldMatrix(const TransformHierarchy_t &transforms, u32 index) {
+    glm::mat4 world = transforms.local[index];
+    for (u32 parent = transforms.parent[index]; parent != U32_MAX; parent = transforms.parent[parent]) {
+        world = transforms.local[parent] * world;
+    }
+    return world;
+}
+
+static
+void appendToBatch(Mesh_t &batch, const Mesh_t &geometry, const glm::mat4 &world) {
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+    f32 scale = glm::max(glm::length(glm::vec3(world[0])),
+                         glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+
+    u32 firstVertex = (u32) batch.vertices.size();
+    u32 firstIndex = (u32) batch.indices.size();
+    for (Vertex_t vertex : geometry.vertices) {
+        vertex.pos = glm::vec3(world * glm::vec4(vertex.pos, 1.0f));
+        vertex.normal = glm::normalize(normalMatrix * vertex.normal);
+        batch.vertices.push_back(vertex);
+    }
+    for (u32 index : geometry.indices) {
+        batch.indices.push_back(firstVertex + index);
+    }
+
+    // Same transform of the bounds as the cull shader does for a model matrix.
+    for (Meshlet_t meshlet : geometry.meshlets) {
+        meshlet.firstIndex += firstIndex;
+        glm::vec3 center = glm::vec3(world * glm::vec4(glm::vec3(meshlet.boundingSphere), 1.0f));
+        meshlet.boundingSphere = glm::vec4(center, meshlet.boundingSphere.w * scale);
+        glm::vec3 axis = glm::mat3(world) * glm::vec3(meshlet.cone);
+        f32 axisLength = glm::length(axis);
+        meshlet.cone = glm::vec4(axisLength > 0.0f ? axis / axisLength : axis, meshlet.cone.w);
+        batch.meshlets.push_back(meshlet);
+    }
+}
+
+static
+void splitSubmesh(const Mesh_t &mesh, const Submesh_t &submesh, Mesh_t &part, std::vector<u32> &remap) {
+    // Vertices in the order the range first uses them, like the cooker lays out a whole mesh.
+    std::fill(remap.begin(), remap.end(), U32_MAX);
+    part.indices.reserve(submesh.indexCount);
+    for (u32 i = 0; i < submesh.indexCount; i++) {
+        u32 index = mesh.indices[submesh.firstIndex + i];
+        if (remap[index] == U32_MAX) {
+            remap[index] = (u32) part.vertices.size();
+            part.vertices.push_back(mesh.vertices[index]);
+        }
+        part.indices.push_back(remap[index]);
+    }
+
+    for (u32 i = 0; i < submesh.meshletCount; i++) {
+        Meshlet_t meshlet = mesh.meshlets[submesh.firstMeshlet + i];
+        meshlet.firstIndex -= submesh.firstIndex;
+        part.meshlets.push_back(meshlet);
+    }
+
+    part.isStatic = mesh.isStatic;
+    part.boundingSphere = submesh.boundingSphere;
+    part.indexCount = submesh.indexCount;
+}
+
+void splitSubmeshes(std::vector<Mesh_t> &meshList, TransformHierarchy_t &transforms) {
+    u32 count = (u32) meshList.size();
+    std::vector<u8> shared(count, 0);
+    for (const Mesh_t &mesh : meshList) {
+        if (mesh.sharedGeometry != U32_MAX) shared[mesh.sharedGeometry] = 1;
+    }
+
+    std::vector<Mesh_t> split;
+    std::vector<u32> remap;
+    std::vector<u32> newIndex(count);
+    split.reserve(count);
+    for (u32 i = 0; i < count; i++) {
+        Mesh_t &mesh = meshList[i];
+        newIndex[i] = (u32) split.size();
+        if (mesh.submeshes.size() <= 1 || mesh.sharedGeometry != U32_MAX || shared[i]) {
+            split.push_back(std::move(mesh));
+            continue;
+        }
+
+        remap.resize(mesh.vertices.size());
+        for (const Submesh_t &submesh : mesh.submeshes) {
+            Mesh_t part = {};
+            splitSubmesh(mesh, submesh, part, remap);
+            part.material = mesh.material + (submesh.material != U32_MAX ? submesh.material : 0);
+            part.transformIndex = addTransform(transforms, mesh.transformIndex, glm::mat4(1.0f));
+            split.push_back(std::move(part));
+        }
+    }
+
+    for (Mesh_t &mesh : split) {
+        if (mesh.sharedGeometry != U32_MAX) mesh.sharedGeometry = newIndex[mesh.sharedGeometry];
+    }
+    meshList.swap(split);
+}
+
+void batchStaticMeshes(std::vector<Mesh_t> &meshList, TransformHierarchy_t &transforms, StaticBatchStats_t &stats) {
+    stats = {};
+    u32 count = (u32) meshList.size();
+
+    // Geometry a moving instance draws has to stay where it is.
+    std::vector<u8> merged(count, 0);
+    for (u32 i = 0; i < count; i++) {
+        merged[i] = meshList[i].isStatic ? 1 : 0;
+    }
+    for (u32 i = 0; i < count; i++) {
+        u32 source = meshList[i].sharedGeometry;
+        if (!meshList[i].isStatic && source != U32_MAX) merged[source] = 0;
+    }
+
+    std::vector<glm::mat4> world(count);
+    std::vector<StaticBatchKey_t> keys;
+    for (u32 i = 0; i < count; i++) {
+        if (!merged[i]) continue;
+        const Mesh_t &mesh = meshList[i];
+        world[i] = staticWorldMatrix(transforms, mesh.transformIndex);
+        glm::vec3 center = glm::vec3(world[i] * glm::vec4(glm::vec3(mesh.boundingSphere), 1.0f));
+        glm::ivec3 cell = glm::ivec3(glm::floor(center / STATIC_BATCH_CHUNK_SIZE));
+        keys.push_back({mesh.material, cell, i});
+    }
+    std::sort(keys.begin(), keys.end(), batchKeyLess);
+
+    // A batch of one saves no draw, that mesh stays as it is. The geometry it draws then stays too,
+    // which can leave another batch with one mesh, that one is kept as a batch.
+    for (u32 begin = 0; begin < keys.size();) {
+        u32 end = begin + 1;
+        while (end < keys.size() && sameBatch(keys[begin], keys[end])) end++;
+        if (end - begin == 1) {
+            u32 mesh = keys[begin].meshIndex;
+            merged[mesh] = 0;
+            if (meshList[mesh].sharedGeometry != U32_MAX) merged[meshList[mesh].sharedGeometry] = 0;
+        }
+        begin = end;
+    }
+
+    std::vector<u8> sourceCounted(count, 0);
+    for (const StaticBatchKey_t &key : keys) {
+        if (!merged[key.meshIndex]) continue;
+        const Mesh_t &mesh = meshList[key.meshIndex];
+        u32 source = mesh.sharedGeometry != U32_MAX ? mesh.sharedGeometry : key.meshIndex;
+        if (sourceCounted[source]) continue;
+        sourceCounted[source] = 1;
+        stats.sourceBytes += meshList[source].vertices.size() * sizeof(Vertex_t) +
+                             meshList[source].indices.size() * sizeof(u32);
+    }
+
+    std::vector<Mesh_t> batches;
+    for (u32 begin = 0; begin < keys.size();) {
+        u32 end = begin + 1;
+        while (end < keys.size() && sameBatch(keys[begin], keys[end])) end++;
+
+        Mesh_t batch = {};
+        batch.isStatic = true;
+        batch.material = keys[begin].material;
+        glm::vec3 minPos = glm::vec3(FLT_MAX);
+        glm::vec3 maxPos = glm::vec3(-FLT_MAX);
+        u32 meshCount = 0;
+        for (u32 k = begin; k < end; k++) {
+            u32 i = keys[k].meshIndex;
+            if (!merged[i]) continue;
+            const Mesh_t &mesh = meshList[i];
+            const Mesh_t &geometry = mesh.sharedGeometry != U32_MAX ? meshList[mesh.sharedGeometry] : mesh;
+            appendToBatch(batch, geometry, world[i]);
+
+            f32 scale = glm::max(glm::length(glm::vec3(world[i][0])),
+                                 glm::max(glm::length(glm::vec3(world[i][1])), glm::length(glm::vec3(world[i][2]))));
+            glm::vec3 center = glm::vec3(world[i] * glm::vec4(glm::vec3(mesh.boundingSphere), 1.0f));
+            minPos = glm::min(minPos, center - glm::vec3(mesh.boundingSphere.w * scale));
+            maxPos = glm::max(maxPos, center + glm::vec3(mesh.boundingSphere.w * scale));
+            meshCount++;
+        }
+        begin = end;
+        if (meshCount == 0) continue;
+
+        // Around the member spheres, looser than one fitted to the vertices but the vertices may not
+        // be needed otherwise.
+        glm::vec3 center = 0.5f * (minPos + maxPos);
+        batch.boundingSphere = glm::vec4(center, glm::length(maxPos - center));
+        batch.indexCount = (u32) batch.indices.size();
+        batch.transformIndex = addTransform(transforms, U32_MAX, glm::mat4(1.0f));
+
+        stats.mergedMeshes += meshCount;
+        stats.batches++;
+        stats.batchBytes += batch.vertices.size() * sizeof(Vertex_t) + batch.indices.size() * sizeof(u32);
+        batches.push_back(std::move(batch));
+    }
+
+    // Compact what is left, instances follow their geometry to its new place.
+    std::vector<u32> remap(count, U32_MAX);
+    u32 kept = 0;
+    for (u32 i = 0; i < count; i++) {
+        if (merged[i]) continue;
+        remap[i] = kept;
+        if (kept != i) meshList[kept] = std::move(meshList[i]);
+        kept++;
+    }
+    meshList.resize(kept);
+    for (Mesh_t &mesh : meshList) {
+        if (mesh.sharedGeometry == U32_MAX) continue;
+        mesh.sharedGeometry = remap[mesh.sharedGeometry];
+        ASSERT(mesh.sharedGeometry != U32_MAX);
+    }
+    for (Mesh_t &batch : batches) {
+        meshList.push_back(std::move(batch));
+    }
+}
+
+void placeStaticGeometry(std::vector<Mesh_t> &meshList, u32 &vertexBytes, u32 &indexBytes) {
+    vertexBytes = 0;
+    indexBytes = 0;
+    for (Mesh_t &mesh : meshList) {
+        if (mesh.sharedGeometry != U32_MAX) {
+            // Instances take their place in the buffers from the mesh they share.
+            const Mesh_t &source = meshList[mesh.sharedGeometry];
+            ASSERT(source.sharedGeometry == U32_MAX);
+            mesh.vertexOffset = source.vertexOffset;
+            mesh.firstVertex = source.firstVertex;
+            mesh.indexOffset = source.indexOffset;
+            mesh.firstIndex = source.firstIndex;
+            mesh.indexCount = source.indexCount;
+            continue;
+        }
+
+        mesh.vertexOffset = vertexBytes;
+        mesh.firstVertex = vertexBytes / sizeof(Vertex_t);
+        vertexBytes += (u32) (mesh.vertices.size() * sizeof(Vertex_t)); // The next mesh starts after this one
+
+        mesh.indexOffset = indexBytes;
+        mesh.firstIndex = indexBytes / sizeof(u32);
+        indexBytes += (u32) (mesh.indices.size() * sizeof(u32));
+    }
+}
+
+void expandMeshlets(std::vector<Mesh_t> &meshList, std::vector<Meshlet_t> &meshlets) {
+    u32 total = 0;
+    for (const Mesh_t &mesh : meshList) {
+        const Mesh_t &geometry = mesh.sharedGeometry != U32_MAX ? meshList[mesh.sharedGeometry] : mesh;
+        total += (u32) geometry.meshlets.size();
+    }
+    meshlets.clear();
+    meshlets.reserve(total);
+
+    // Meshlet index ranges are relative to their mesh until the mesh has a place in the static buffers.
+    for (Mesh_t &mesh : meshList) {
+        const Mesh_t &geometry = mesh.sharedGeometry != U32_MAX ? meshList[mesh.sharedGeometry] : mesh;
+        mesh.firstMeshlet = (u32) meshlets.size();
+        mesh.meshletCount = (u32) geometry.meshlets.size();
+        for (Meshlet_t meshlet : geometry.meshlets) {
+            meshlet.firstIndex += mesh.firstIndex;
+            meshlet.vertexOffset = (i32) mesh.firstVertex;
+            meshlet.objectIndex = mesh.transformIndex;
+            meshlets.push_back(meshlet);
+        }
+    }
+}
+
+u32 *buildDrawOrder(const std::vector<Mesh_t> &meshList, const glm::mat4 *world, const glm::mat4 &view,
+                    Arena_t &arena) {
+    u32 count = (u32) meshList.size();
+    DrawOrder_t *order = arenaAllocArray<DrawOrder_t>(arena, count);
+    for (u32 i = 0; i < count; i++) {
+        const Mesh_t &mesh = meshList[i];
+        glm::vec4 center = world[mesh.transformIndex] * glm::vec4(glm::vec3(mesh.boundingSphere), 1.0f);
+        order[i].depth = -(view * center).z; // Camera looks down -z
+        order[i].meshIndex = i;
+    }
+
+    std::sort(order, order + count, [](const DrawOrder_t &a, const DrawOrder_t &b) {
+        return a.depth < b.depth;
+    });
+
+    u32 *indices = arenaAllocArray<u32>(arena, count);
+    for (u32 i = 0; i < count; i++) {
+        indices[i] = order[i].meshIndex;
+    }
+    return indices;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "arena.h"
+#include "common.h"
+
+// CPU side of turning the mesh list into draws: where each mesh lives in the static buffers and
+// the order the meshes are drawn in each frame. Kept apart from the Vulkan code so anton_vk_bench
+// can time it on its own.
+
+// Merge static meshes into pre-transformed batches at load, see batchStaticMeshes.
+#ifndef STATIC_BATCHING
+#define STATIC_BATCHING 1
+#endif
+
+// Side of the world space grid cells batches are split along, so a batch stays small enough for
+// culling to reject it.
+#ifndef STATIC_BATCH_CHUNK_SIZE
+#define STATIC_BATCH_CHUNK_SIZE 32.0f
+#endif
+
+struct StaticBatchStats_t {
+    u32 mergedMeshes; // Draws the batches replace
+    u32 batches;
+    u64 sourceBytes; // Vertices and indices of the merged meshes, shared geometry counted once
+    u64 batchBytes; // Of the batches, every instance is a copy
+};
+
+// Replaces every mesh with more than one submesh by one mesh per submesh, so culling, the draw
+// order, materials and static batching all see submeshes. Each part gets the vertices its range
+// uses, its meshlets and bounds, and a child transform of the mesh's with an identity local
+// matrix, which gives it its own object and material slot. Its material is the mesh's plus the
+// submesh's material in the source file. Parts go where the mesh was. Meshes that share geometry
+// are left as they are.
+void splitSubmeshes(std::vector<Mesh_t> &meshList, TransformHierarchy_t &transforms);
+
+// Replaces the static meshes with batches, one per material and grid cell of the bounding sphere
+// centers. The vertices are transformed to world space and each batch draws with a new identity
+// transform, its meshlets keep the ones of the merged meshes. Static means the mesh and every
+// transform above it never move. The merged meshes' transforms stay in the hierarchy unused.
+// Other meshes keep their order, the batches go after them. Before placeStaticGeometry.
+void batchStaticMeshes(std::vector<Mesh_t> &meshList, TransformHierarchy_t &transforms, StaticBatchStats_t &stats);
+
+// Assigns vertex and index offsets in the static buffers, meshes packed in list order. Meshes with
+// sharedGeometry take the offsets of the mesh they share. Returns the buffer sizes in bytes.
+void placeStaticGeometry(std::vector<Mesh_t> &meshList, u32 &vertexBytes, u32 &indexBytes);
+
+// Flattens the meshlets of every mesh into one list with index ranges and vertex offsets into the
+// static buffers, after placeStaticGeometry. Sets firstMeshlet and meshletCount.
+void expandMeshlets(std::vector<Mesh_t> &meshList, std::vector<Meshlet_t> &meshlets);
+
+// Mesh indices front to back by view space depth of the bounding sphere center, so early depth
+// rejects as much as it can. Ties on a shared center are fine, the order only has to be roughly
+// right. The list is allocated from arena.
+u32 *buildDrawOrder(const std::vector<Mesh_t> &meshList, const glm::mat4 *world, const glm::mat4 &view,
+                    Arena_t &arena);
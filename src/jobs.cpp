@@ -0,0 +1,432 @@
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "anton_asserts.h"
+#include "logger.h"
+#include "jobs.h"
+
+#define JOB_DEQUE_SIZE 4096 // Must be a power of two
+#define JOB_POOL_SIZE 4096
+#define JOB_IDLE_SPINS 64
+
+struct Job_t {
+    JobFunction_t function;
+    void *data;
+    u32 begin;
+    u32 end;
+    JobCounter_t *counter;
+    Job_t *next; // Link in a counter's continuation list
+    std::atomic<bool> busy{false}; // From allocateJob until it has run, the slot can't be reused before
+};
+
+// Chase-Lev deque, see "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013).
+// Only the owning worker pushes and pops, any thread may steal.
+struct JobDeque_t {
+    std::atomic<i64> top{0};
+    std::atomic<i64> bottom{0};
+    std::atomic<Job_t *> jobs[JOB_DEQUE_SIZE];
+};
+
+struct JobWorker_t {
+    alignas(64) JobDeque_t deque;
+    // Ring of job storage, only the owning worker allocates from it. Slots whose job has not run
+    // yet, queued or parked as a continuation, are skipped.
+    Job_t pool[JOB_POOL_SIZE];
+    u32 poolNext = 0;
+    u32 random = 0;
+    std::thread thread;
+};
+
+static JobWorker_t *g_workers = nullptr;
+static u32 g_workerCount = 0;
+static std::atomic<bool> g_running{false};
+
+// Threads that are not workers (asset threads and so on) hand their jobs over through this queue.
+static std::mutex g_externalMutex;
+static std::vector<Job_t *> g_externalJobs;
+static std::atomic<u32> g_externalJobCount{0};
+static Job_t g_externalPool[JOB_POOL_SIZE];
+static u32 g_externalPoolNext = 0;
+
+static std::mutex g_sleepMutex;
+static std::condition_variable g_sleepCondition;
+static std::atomic<u32> g_sleepingWorkers{0};
+
+// Marks a continuation list that has already been released.
+static Job_t g_closedListSentinel;
+#define JOB_LIST_CLOSED (&g_closedListSentinel)
+
+static thread_local u32 t_workerIndex = U32_MAX;
+
+static
+bool pushDeque(JobDeque_t &deque, Job_t *job) {
+    i64 b = deque.bottom.load(std::memory_order_relaxed);
+    i64 t = deque.top.load(std::memory_order_acquire);
+    if (b - t >= JOB_DEQUE_SIZE) {
+        return false;
+    }
+    deque.jobs[b & (JOB_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+    deque.bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+static
+Job_t *popDeque(JobDeque_t &deque) {
+    i64 b = deque.bottom.load(std::memory_order_relaxed) - 1;
+    deque.bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 t = deque.top.load(std::memory_order_relaxed);
+
+    Job_t *job = nullptr;
+    if (t <= b) {
+        job = deque.jobs[b & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last job, race the thieves for it.
+            if (!deque.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed)) {
+                job = nullptr;
+            }
+            deque.bottom.store(b + 1, std::memory_order_relaxed);
+        }
+    } else {
+        deque.bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+static
+Job_t *stealDeque(JobDeque_t &deque) {
+    i64 t = deque.top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 b = deque.bottom.load(std::memory_order_acquire);
+
+    if (t < b) {
+        Job_t *job = deque.jobs[t & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+        if (!deque.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                               std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return job;
+    }
+    return nullptr;
+}
+
+static
+u32 nextRandom(u32 &state) {
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Next free slot after next. Continuations can wait for any length of time, so a busy slot is
+// never assumed to be done just because the ring came around.
+static
+Job_t *claimPoolSlot(Job_t *pool, u32 &next) {
+    for (u32 i = 0; i < JOB_POOL_SIZE; i++) {
+        Job_t *job = &pool[next];
+        next = (next + 1) % JOB_POOL_SIZE;
+        if (!job->busy.load(std::memory_order_acquire)) {
+            job->busy.store(true, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    Logger::Fatal("Job pool exhausted, more than %i jobs in flight from one thread", JOB_POOL_SIZE);
+}
+
+static
+Job_t *allocateJob() {
+    if (t_workerIndex != U32_MAX) {
+        JobWorker_t &worker = g_workers[t_workerIndex];
+        return claimPoolSlot(worker.pool, worker.poolNext);
+    }
+
+    std::lock_guard<std::mutex> lock(g_externalMutex);
+    return claimPoolSlot(g_externalPool, g_externalPoolNext);
+}
+
+static void executeJob(Job_t *job);
+
+static
+void pushJob(Job_t *job) {
+    if (t_workerIndex != U32_MAX) {
+        if (!pushDeque(g_workers[t_workerIndex].deque, job)) {
+            // Deque is full, running the job right here is the simplest form of back pressure.
+            executeJob(job);
+            return;
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(g_externalMutex);
+        g_externalJobs.push_back(job);
+        g_externalJobCount.fetch_add(1, std::memory_order_release);
+    }
+
+    if (g_sleepingWorkers.load(std::memory_order_relaxed) > 0) {
+        g_sleepCondition.notify_one();
+    }
+}
+
+static
+void releaseContinuations(JobCounter_t *counter) {
+    Job_t *job = counter->continuations.exchange(JOB_LIST_CLOSED, std::memory_order_acq_rel);
+    while (job != nullptr && job != JOB_LIST_CLOSED) {
+        Job_t *next = job->next;
+        pushJob(job);
+        job = next;
+    }
+}
+
+static
+void executeJob(Job_t *job) {
+    job->function(job->data, job->begin, job->end);
+
+    // Nothing below touches the job, its slot can be handed out again.
+    JobCounter_t *counter = job->counter;
+    job->busy.store(false, std::memory_order_release);
+    if (!counter) return;
+
+    // The job that takes the counter to zero releases the continuations. Waiters hold on to the
+    // counter until every job is done touching it, see counterDone.
+    counter->touching.fetch_add(1, std::memory_order_seq_cst);
+    if (counter->value.fetch_sub(1, std::memory_order_seq_cst) == 1) {
+        releaseContinuations(counter);
+    }
+    counter->touching.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+// Every job increments touching before its decrement, so once value reads zero a zero in touching
+// means the last of them is through as well and the counter can go away.
+bool counterDone(JobCounter_t *counter) {
+    return counter->value.load(std::memory_order_seq_cst) <= 0 &&
+           counter->touching.load(std::memory_order_seq_cst) == 0;
+}
+
+static
+Job_t *takeExternalJob() {
+    if (g_externalJobCount.load(std::memory_order_acquire) == 0) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_externalMutex);
+    if (g_externalJobs.empty()) {
+        return nullptr;
+    }
+    Job_t *job = g_externalJobs.back();
+    g_externalJobs.pop_back();
+    g_externalJobCount.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+static
+Job_t *findJob() {
+    u32 index = t_workerIndex;
+    if (index == U32_MAX) {
+        return takeExternalJob();
+    }
+
+    JobWorker_t &self = g_workers[index];
+    Job_t *job = popDeque(self.deque);
+    if (job) return job;
+
+    u32 start = nextRandom(self.random) % g_workerCount;
+    for (u32 i = 0; i < g_workerCount; i++) {
+        u32 victim = (start + i) % g_workerCount;
+        if (victim == index) continue;
+        job = stealDeque(g_workers[victim].deque);
+        if (job) return job;
+    }
+
+    return takeExternalJob();
+}
+
+static
+void workerMain(u32 index) {
+    t_workerIndex = index;
+
+    u32 idleSpins = 0;
+    while (g_running.load(std::memory_order_acquire)) {
+        Job_t *job = findJob();
+        if (job) {
+            executeJob(job);
+            idleSpins = 0;
+            continue;
+        }
+
+        if (++idleSpins < JOB_IDLE_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // The timeout covers a push that races with going to sleep.
+        std::unique_lock<std::mutex> lock(g_sleepMutex);
+        g_sleepingWorkers.fetch_add(1, std::memory_order_relaxed);
+        g_sleepCondition.wait_for(lock, std::chrono::milliseconds(1));
+        g_sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+        idleSpins = 0;
+    }
+
+    t_workerIndex = U32_MAX;
+}
+
+void initJobSystem(u32 workerCount) {
+    ASSERT(g_workers == nullptr);
+
+    if (workerCount == 0) {
+        workerCount = std::thread::hardware_concurrency();
+        if (workerCount == 0) workerCount = 1;
+    }
+
+    g_workerCount = workerCount;
+    g_workers = new JobWorker_t[workerCount];
+    for (u32 i = 0; i < workerCount; i++) {
+        g_workers[i].random = 0x9e3779b9u * (i + 1);
+    }
+
+    g_running.store(true, std::memory_order_release);
+
+    t_workerIndex = 0;
+    for (u32 i = 1; i < workerCount; i++) {
+        g_workers[i].thread = std::thread(workerMain, i);
+    }
+
+    Logger::Trace("Job system started with %i workers", workerCount);
+}
+
+void shutdownJobSystem() {
+    if (g_workers == nullptr) return;
+
+    g_running.store(false, std::memory_order_release);
+    g_sleepCondition.notify_all();
+
+    for (u32 i = 1; i < g_workerCount; i++) {
+        g_workers[i].thread.join();
+    }
+
+    delete[] g_workers;
+    g_workers = nullptr;
+    g_workerCount = 0;
+    t_workerIndex = U32_MAX;
+}
+
+u32 getJobWorkerCount() {
+    return g_workerCount;
+}
+
+u32 getJobWorkerIndex() {
+    return t_workerIndex;
+}
+
+static
+Job_t *makeJob(const JobDecl_t &decl, JobCounter_t *counter) {
+    Job_t *job = allocateJob();
+    job->function = decl.function;
+    job->data = decl.data;
+    job->begin = decl.begin;
+    job->end = decl.end;
+    job->counter = counter;
+    job->next = nullptr;
+    return job;
+}
+
+static
+void addToCounter(JobCounter_t *counter, u32 count) {
+    if (counter && counter->value.fetch_add((i32) count, std::memory_order_acq_rel) == 0) {
+        // Reusing a counter whose continuations were already released.
+        Job_t *expected = JOB_LIST_CLOSED;
+        counter->continuations.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+    }
+}
+
+void runJobs(const JobDecl_t *jobs, u32 count, JobCounter_t *counter) {
+    ASSERT(g_workers != nullptr);
+
+    addToCounter(counter, count);
+    for (u32 i = 0; i < count; i++) {
+        pushJob(makeJob(jobs[i], counter));
+    }
+}
+
+void runJobsAfter(JobCounter_t *dependency, const JobDecl_t *jobs, u32 count, JobCounter_t *counter) {
+    ASSERT(g_workers != nullptr);
+    ASSERT(dependency != nullptr);
+
+    addToCounter(counter, count);
+    for (u32 i = 0; i < count; i++) {
+        Job_t *job = makeJob(jobs[i], counter);
+
+        Job_t *head = dependency->continuations.load(std::memory_order_acquire);
+        bool queued = false;
+        while (head != JOB_LIST_CLOSED) {
+            job->next = head;
+            if (dependency->continuations.compare_exchange_weak(head, job, std::memory_order_acq_rel)) {
+                queued = true;
+                break;
+            }
+        }
+        if (!queued) {
+            job->next = nullptr;
+            pushJob(job);
+        }
+    }
+
+    // The dependency may have finished (or never had any jobs) before the list was extended.
+    if (dependency->value.load(std::memory_order_acquire) == 0) {
+        releaseContinuations(dependency);
+    }
+}
+
+void waitForCounter(JobCounter_t *counter) {
+    while (!counterDone(counter)) {
+        Job_t *job = findJob();
+        if (job) {
+            executeJob(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+u32 runPendingJobs(u32 maxJobs) {
+    u32 ran = 0;
+    while (ran < maxJobs) {
+        Job_t *job = findJob();
+        if (!job) break;
+        executeJob(job);
+        ran += 1;
+    }
+    return ran;
+}
+
+void parallelFor(u32 count, u32 batchSize, JobFunction_t function, void *data) {
+    ASSERT(batchSize > 0);
+
+    if (g_workers == nullptr || count <= batchSize) {
+        function(data, 0, count);
+        return;
+    }
+
+    // Keep well inside the job pool, every batch is in flight at once.
+    u32 batchCount = (count + batchSize - 1) / batchSize;
+    if (batchCount > JOB_POOL_SIZE / 4) {
+        batchCount = JOB_POOL_SIZE / 4;
+        batchSize = (count + batchCount - 1) / batchCount;
+        batchCount = (count + batchSize - 1) / batchSize;
+    }
+
+    JobCounter_t counter;
+    addToCounter(&counter, batchCount);
+    for (u32 batch = 0; batch < batchCount; batch++) {
+        JobDecl_t decl = {};
+        decl.function = function;
+        decl.data = data;
+        decl.begin = batch * batchSize;
+        decl.end = decl.begin + batchSize < count ? decl.begin + batchSize : count;
+        pushJob(makeJob(decl, &counter));
+    }
+
+    waitForCounter(&counter);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+
+#include "typedefs.h"
+
+// Work stealing job system. Every worker thread owns a deque, pushes and pops at the bottom and
+// steals from the top of the other deques when it runs dry. The thread that called
+// initJobSystem is worker 0 and only runs jobs while it waits on a counter or calls
+// runPendingJobs, so it can keep doing its own work in between.
+
+struct Job_t;
+
+// Jobs always cover an index range, single jobs just use [0, 1).
+typedef void (*JobFunction_t)(void *data, u32 begin, u32 end);
+
+struct JobCounter_t {
+    std::atomic<i32> value{0};
+    std::atomic<Job_t *> continuations{nullptr}; // Jobs to start when value reaches zero
+    std::atomic<i32> touching{0}; // Jobs between their decrement and their last access
+};
+
+struct JobDecl_t {
+    JobFunction_t function;
+    void *data;
+    u32 begin;
+    u32 end;
+};
+
+// workerCount includes the calling thread, 0 means one worker per hardware thread.
+void initJobSystem(u32 workerCount);
+void shutdownJobSystem();
+u32 getJobWorkerCount();
+u32 getJobWorkerIndex(); // U32_MAX on threads the job system does not know about
+
+// Adds count to the counter and queues the jobs, each one decrements it when done. Job storage is
+// a fixed pool per thread, a thread with more than a couple of thousand jobs that have not run yet
+// is a fatal error.
+void runJobs(const JobDecl_t *jobs, u32 count, JobCounter_t *counter);
+
+// Same as runJobs, but the jobs are only queued once dependency has reached zero.
+void runJobsAfter(JobCounter_t *dependency, const JobDecl_t *jobs, u32 count, JobCounter_t *counter);
+
+// Runs other jobs until the counter reaches zero and no job uses it any more, after that it can be
+// freed or reused.
+void waitForCounter(JobCounter_t *counter);
+
+// The same condition without waiting, for threads that poll.
+bool counterDone(JobCounter_t *counter);
+
+// Runs queued jobs for at most maxJobs jobs, returns how many ran. Lets the main thread help out
+// between its own work without blocking on anything.
+u32 runPendingJobs(u32 maxJobs);
+
+// Splits [0, count) into batches of batchSize, runs them on all workers and waits.
+void parallelFor(u32 count, u32 batchSize, JobFunction_t function, void *data);
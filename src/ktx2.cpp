@@ -0,0 +1,94 @@
+#include <cstring>
+
+#include "ktx2.h"
+
+static const u8 g_ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+// VkFormat values, this file does not pull in the Vulkan headers.
+#define KTX2_FORMAT_BC1_RGB_UNORM 131
+#define KTX2_FORMAT_BC7_SRGB 146
+
+static
+u32 readU32(const u8 *data, u64 offset) {
+    u32 value;
+    memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+static
+u64 readU64(const u8 *data, u64 offset) {
+    u64 value;
+    memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+// BC1 and BC4 pack a 4x4 block into 8 bytes, BC2, BC3 and BC5 to BC7 into 16. Zero for anything
+// else.
+static
+u32 bcBlockBytes(u32 vkFormat) {
+    if (vkFormat < KTX2_FORMAT_BC1_RGB_UNORM || vkFormat > KTX2_FORMAT_BC7_SRGB) return 0;
+    u32 bc = vkFormat - KTX2_FORMAT_BC1_RGB_UNORM;
+    bool eightBytes = bc <= 3 || bc == 8 || bc == 9; // BC1 RGB/RGBA UNORM/SRGB, BC4 UNORM/SNORM
+    return eightBytes ? 8 : 16;
+}
+
+u64 ktx2IndexSize(u32 levelCount) {
+    return KTX2_HEADER_SIZE + (u64) (levelCount > 0 ? levelCount : 1) * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+}
+
+u32 ktx2MipSize(u32 size, u32 level) {
+    u32 mip = size >> level;
+    return mip > 0 ? mip : 1;
+}
+
+Ktx2Result_t parseKtx2(const u8 *header, u64 headerSize, u64 fileSize, Ktx2Info_t &info) {
+    info = {};
+    if (headerSize < KTX2_HEADER_SIZE || memcmp(header, g_ktx2Identifier, sizeof(g_ktx2Identifier)) != 0) {
+        return Ktx2_NotKtx2;
+    }
+
+    info.vkFormat = readU32(header, 12);
+    info.width = readU32(header, 20);
+    info.height = readU32(header, 24);
+    u32 depth = readU32(header, 28);
+    u32 layerCount = readU32(header, 32);
+    u32 faceCount = readU32(header, 36);
+    info.levelCount = readU32(header, 40);
+    u32 supercompression = readU32(header, 44);
+
+    // Zero levels means the loader should generate mips, the file only has the full size one.
+    if (info.levelCount == 0) info.levelCount = 1;
+
+    if (depth > 0 || layerCount > 0 || faceCount != 1 || supercompression != 0) return Ktx2_Unsupported;
+    if (info.levelCount > KTX2_MAX_LEVELS) return Ktx2_Unsupported;
+
+    info.blockBytes = bcBlockBytes(info.vkFormat);
+    if (info.blockBytes == 0) return Ktx2_Unsupported;
+
+    if (info.width == 0 || info.height == 0) return Ktx2_Corrupt;
+    if (headerSize < ktx2IndexSize(info.levelCount)) return Ktx2_NotKtx2;
+
+    for (u32 level = 0; level < info.levelCount; level++) {
+        u64 entry = KTX2_HEADER_SIZE + (u64) level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+        Ktx2Level_t &mip = info.levels[level];
+        mip.offset = readU64(header, entry);
+        mip.length = readU64(header, entry + 8);
+
+        u64 blocksX = (ktx2MipSize(info.width, level) + 3) / 4;
+        u64 blocksY = (ktx2MipSize(info.height, level) + 3) / 4;
+        if (mip.length != blocksX * blocksY * info.blockBytes) return Ktx2_Corrupt;
+        if (mip.offset > fileSize || mip.length > fileSize - mip.offset) return Ktx2_Corrupt;
+    }
+
+    return Ktx2_Ok;
+}
+
+const char *ktx2ResultName(Ktx2Result_t result) {
+    switch (result) {
+        case Ktx2_Ok: return "ok";
+        case Ktx2_NotKtx2: return "not a KTX2 file";
+        case Ktx2_Unsupported: return "unsupported layout or format";
+        case Ktx2_Corrupt: return "corrupt level index";
+    }
+    return "unknown";
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "typedefs.h"
+
+// Reads the header and level index of KTX2 files, the texel data stays in the file and is read
+// per mip by the texture streamer. Only 2D textures with a single layer and face and no
+// supercompression are accepted, the mips are used as stored.
+
+#define KTX2_HEADER_SIZE 80
+#define KTX2_LEVEL_INDEX_ENTRY_SIZE 24
+#define KTX2_MAX_LEVELS 16
+
+enum Ktx2Result_t : u32 {
+    Ktx2_Ok,
+    Ktx2_NotKtx2, // Wrong identifier or truncated header
+    Ktx2_Unsupported, // 3D, array, cube map, supercompressed or a format without a known block size
+    Ktx2_Corrupt, // Level ranges outside the file or of the wrong size
+};
+
+struct Ktx2Level_t {
+    u64 offset; // From the start of the file
+    u64 length;
+};
+
+struct Ktx2Info_t {
+    u32 vkFormat; // VkFormat, KTX2 stores the Vulkan one directly
+    u32 width, height; // Of mip 0
+    u32 levelCount;
+    u32 blockBytes; // Per 4x4 block
+    Ktx2Level_t levels[KTX2_MAX_LEVELS]; // Index 0 is the full size mip
+};
+
+// Bytes needed from the start of the file to parse a header with levelCount levels.
+u64 ktx2IndexSize(u32 levelCount);
+
+// header has to hold at least KTX2_HEADER_SIZE bytes, and ktx2IndexSize(levelCount) to get
+// Ktx2_Ok, otherwise Ktx2_NotKtx2 asks for more. fileSize bounds the level ranges.
+Ktx2Result_t parseKtx2(const u8 *header, u64 headerSize, u64 fileSize, Ktx2Info_t &info);
+
+const char *ktx2ResultName(Ktx2Result_t result);
+
+// Size of mip level in texels, never below one.
+u32 ktx2MipSize(u32 size, u32 level);
@@ -1,44 +1,371 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <stdarg.h>
-#include <string>
 #include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
 #include "logger.h"
 
-static void writeLog(const char* prepend, const char* message, va_list args) {
-    vprintf( (std::string(prepend)+message+"\n").c_str(), args );   
+// Per thread ring size, must be a power of two.
+#define LOG_RING_SIZE (64 * 1024)
+#define LOG_OUTPUT_BUFFER_SIZE (64 * 1024)
+#define LOG_LEVEL_PADDING 0xffff
+
+static const char *g_levelPrefixes[] = {
+        "[TRACE]: ",
+        "[LOG]: ",
+        "[WARNING]: ",
+        "[ERROR]: ",
+        "[FATAL]: ",
+};
+
+// Single producer single consumer. head and tail only ever grow, the byte offset is them masked
+// by the ring size. Records never wrap, a padding record fills the end of the ring instead.
+struct LogRing_t {
+    alignas(64) std::atomic<u32> head{0};
+    u32 cachedTail = 0;
+    u32 pendingSize = 0; // Bytes the record being written will advance head by, padding included
+    alignas(64) std::atomic<u32> tail{0};
+    std::atomic<u64> dropped{0};
+    std::atomic<bool> owned{true};
+    LogRing_t *next = nullptr;
+    alignas(8) u8 data[LOG_RING_SIZE];
+};
+
+// Rings are never freed, when a thread exits its ring is handed to the next thread that logs.
+struct LogThreadRing_t {
+    LogRing_t *ring = nullptr;
+    ~LogThreadRing_t() {
+        if (ring) ring->owned.store(false, std::memory_order_release);
+    }
+};
+
+struct LogBackend_t {
+    std::mutex ringMutex; // Only taken when a thread grabs a ring
+    std::atomic<LogRing_t *> rings{nullptr};
+
+    std::mutex consumeMutex; // Held by whoever is draining the rings
+    FILE *file = stdout;
+    char output[LOG_OUTPUT_BUFFER_SIZE];
+    u32 outputSize = 0;
+    u64 reportedDrops = 0;
+
+    std::thread thread;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    bool running = false;
+
+    ~LogBackend_t();
+};
+
+static thread_local LogThreadRing_t t_logRing;
+
+static void drainRings(LogBackend_t &backend);
+
+static
+void loggerThreadMain(LogBackend_t *backend) {
+    std::unique_lock<std::mutex> lock(backend->sleepMutex);
+    while (backend->running) {
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> consumeLock(backend->consumeMutex);
+            drainRings(*backend);
+        }
+        lock.lock();
+        backend->sleepCondition.wait_for(lock, std::chrono::milliseconds(1));
+    }
 }
 
-void Logger::Trace( const char* message, ... ){
-    va_list args;
-    va_start(args, message);
-    writeLog("[TRACE]: ", message, args);
-    va_end(args);
+static
+LogBackend_t &getBackend() {
+    static LogBackend_t backend;
+    static std::once_flag started;
+    std::call_once(started, [] {
+        backend.running = true;
+        backend.thread = std::thread(loggerThreadMain, &backend);
+    });
+    return backend;
 }
 
-void Logger::Log( const char* message, ... ){
-    va_list args;
-    va_start(args, message);
-    writeLog("[LOG]: ", message, args);
-    va_end(args);
+LogBackend_t::~LogBackend_t() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running = false;
+    }
+    sleepCondition.notify_one();
+    if (thread.joinable()) thread.join();
+
+    std::lock_guard<std::mutex> consumeLock(consumeMutex);
+    drainRings(*this);
 }
 
-void Logger::Warn( const char* message, ... ){
-    va_list args;
-    va_start(args, message);
-    writeLog("[WARNING]: ", message, args);
-    va_end(args);
+static
+LogRing_t *acquireRing() {
+    LogBackend_t &backend = getBackend();
+    std::lock_guard<std::mutex> lock(backend.ringMutex);
+
+    for (LogRing_t *ring = backend.rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+        if (ring->owned.load(std::memory_order_acquire)) continue;
+        // Whatever the previous owner left is still drained by the consumer, the new owner just
+        // carries on from head.
+        ring->owned.store(true, std::memory_order_relaxed);
+        ring->cachedTail = ring->tail.load(std::memory_order_acquire);
+        return ring;
+    }
+
+    LogRing_t *ring = new LogRing_t();
+    ring->next = backend.rings.load(std::memory_order_relaxed);
+    backend.rings.store(ring, std::memory_order_release);
+    return ring;
 }
 
-void Logger::Error(const char *message, ... ){
-    va_list args;
-    va_start(args, message);
-    writeLog("[ERROR]: ", message, args);
-    va_end(args);
+u8 *logBeginRecord(u32 size) {
+    LogRing_t *ring = t_logRing.ring;
+    if (!ring) {
+        ring = acquireRing();
+        t_logRing.ring = ring;
+    }
+
+    if (size > LOG_RING_SIZE / 4) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    u32 head = ring->head.load(std::memory_order_relaxed);
+    u32 offset = head & (LOG_RING_SIZE - 1);
+    u32 contiguous = LOG_RING_SIZE - offset;
+    u32 needed = contiguous < size ? contiguous + size : size;
+
+    if (LOG_RING_SIZE - (head - ring->cachedTail) < needed) {
+        ring->cachedTail = ring->tail.load(std::memory_order_acquire);
+        if (LOG_RING_SIZE - (head - ring->cachedTail) < needed) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+    }
+
+    ring->pendingSize = needed;
+    if (contiguous < size) {
+        // Sizes are multiples of 8, so there is always room for the size and level.
+        LogRecordHeader_t *padding = (LogRecordHeader_t *) (ring->data + offset);
+        padding->size = contiguous;
+        padding->level = LOG_LEVEL_PADDING;
+        return ring->data;
+    }
+    return ring->data + offset;
+}
+
+void logCommitRecord() {
+    LogRing_t *ring = t_logRing.ring;
+    u32 head = ring->head.load(std::memory_order_relaxed);
+    ring->head.store(head + ring->pendingSize, std::memory_order_release);
 }
 
-void Logger::Fatal( const char* message, ... ){
+static
+void writeOutput(LogBackend_t &backend) {
+    if (backend.outputSize == 0) return;
+    fwrite(backend.output, 1, backend.outputSize, backend.file);
+    fflush(backend.file);
+    backend.outputSize = 0;
+}
+
+static
+void appendOutput(LogBackend_t &backend, const char *text, u32 length) {
+    if (backend.outputSize + length > LOG_OUTPUT_BUFFER_SIZE) {
+        writeOutput(backend);
+    }
+    if (length > LOG_OUTPUT_BUFFER_SIZE) {
+        length = LOG_OUTPUT_BUFFER_SIZE;
+    }
+    memcpy(backend.output + backend.outputSize, text, length);
+    backend.outputSize += length;
+}
+
+static
+void appendFormatted(LogBackend_t &backend, const char *spec, ...) {
+    char text[LOG_MAX_STRING_LENGTH + 64];
     va_list args;
-    va_start(args, message);
-    writeLog("[FATAL]: ", message, args);
+    va_start(args, spec);
+    i32 length = vsnprintf(text, sizeof(text), spec, args);
     va_end(args);
+    if (length < 0) return;
+    appendOutput(backend, text, (u32) length < sizeof(text) ? (u32) length : (u32) sizeof(text) - 1);
+}
+
+// Formats one conversion with the flags, width and precision from the format string, but the
+// length modifier and value type from the recorded argument, so a u32 passed to %i still works.
+static
+const u8 *formatArg(LogBackend_t &backend, const char *specBegin, u32 specLength, char conversion,
+                    const u8 *arg) {
+    char spec[32];
+    if (specLength > sizeof(spec) - 4) specLength = sizeof(spec) - 4;
+    memcpy(spec, specBegin, specLength);
+
+    u8 type = *arg++;
+    const char *string = nullptr;
+    u64 bits = 0;
+    if (type == LOG_ARG_STRING) {
+        u32 length;
+        memcpy(&length, arg, 4);
+        string = (const char *) arg + 4;
+        arg += 4 + length + 1;
+    } else {
+        memcpy(&bits, arg, 8);
+        arg += 8;
+    }
+
+    i64 asInt = 0;
+    u64 asUint = 0;
+    f64 asFloat = 0.0;
+    switch (type) {
+        case LOG_ARG_INT: asInt = (i64) bits; asUint = bits; asFloat = (f64) asInt; break;
+        case LOG_ARG_UINT:
+        case LOG_ARG_POINTER: asInt = (i64) bits; asUint = bits; asFloat = (f64) bits; break;
+        case LOG_ARG_FLOAT: memcpy(&asFloat, &bits, 8); asInt = (i64) asFloat; asUint = (u64) asInt; break;
+        default: break;
+    }
+
+    if (string && conversion != 's') {
+        appendOutput(backend, string, (u32) strlen(string));
+        return arg;
+    }
+
+    switch (conversion) {
+        case 'd': case 'i':
+            memcpy(spec + specLength, "lld", 4);
+            appendFormatted(backend, spec, (long long) asInt);
+            break;
+        case 'u': case 'o': case 'x': case 'X':
+            spec[specLength] = 'l';
+            spec[specLength + 1] = 'l';
+            spec[specLength + 2] = conversion;
+            spec[specLength + 3] = '\0';
+            appendFormatted(backend, spec, (unsigned long long) asUint);
+            break;
+        case 'c':
+            memcpy(spec + specLength, "c", 2);
+            appendFormatted(backend, spec, (i32) asInt);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            spec[specLength] = conversion;
+            spec[specLength + 1] = '\0';
+            appendFormatted(backend, spec, asFloat);
+            break;
+        case 's':
+            memcpy(spec + specLength, "s", 2);
+            if (string) {
+                appendFormatted(backend, spec, string);
+            } else {
+                appendFormatted(backend, "%lld", (long long) asInt);
+            }
+            break;
+        case 'p':
+            memcpy(spec + specLength, "p", 2);
+            appendFormatted(backend, spec, (void *) (size_t) asUint);
+            break;
+        default:
+            appendFormatted(backend, "(bad conversion %c)", conversion);
+            break;
+    }
+    return arg;
+}
+
+static
+void formatRecord(LogBackend_t &backend, const LogRecordHeader_t *header) {
+    const u8 *arg = (const u8 *) header + sizeof(LogRecordHeader_t);
+    u32 argsLeft = header->argCount;
+    const char *prefix = g_levelPrefixes[header->level];
+    appendOutput(backend, prefix, (u32) strlen(prefix));
+
+    const char *p = header->format;
+    while (*p) {
+        if (*p != '%') {
+            const char *runBegin = p;
+            while (*p && *p != '%') p++;
+            appendOutput(backend, runBegin, (u32) (p - runBegin));
+            continue;
+        }
+        if (p[1] == '%') {
+            appendOutput(backend, "%", 1);
+            p += 2;
+            continue;
+        }
+
+        const char *specBegin = p++;
+        while (*p && strchr("-+ #0", *p)) p++;
+        while (*p >= '0' && *p <= '9') p++;
+        if (*p == '.') {
+            p++;
+            while (*p >= '0' && *p <= '9') p++;
+        }
+        u32 specLength = (u32) (p - specBegin);
+        while (*p && strchr("hlLqjzt", *p)) p++;
+        char conversion = *p;
+        if (conversion) p++;
+
+        if (argsLeft == 0) {
+            appendOutput(backend, "(missing)", 9);
+            continue;
+        }
+        arg = formatArg(backend, specBegin, specLength, conversion, arg);
+        argsLeft -= 1;
+    }
+    appendOutput(backend, "\n", 1);
+}
+
+// Caller holds consumeMutex.
+static
+void drainRings(LogBackend_t &backend) {
+    u64 dropped = 0;
+    for (LogRing_t *ring = backend.rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+        u32 tail = ring->tail.load(std::memory_order_relaxed);
+        u32 head = ring->head.load(std::memory_order_acquire);
+        while (tail != head) {
+            const LogRecordHeader_t *header =
+                    (const LogRecordHeader_t *) (ring->data + (tail & (LOG_RING_SIZE - 1)));
+            if (header->level != LOG_LEVEL_PADDING) {
+                formatRecord(backend, header);
+            }
+            tail += header->size;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+
+    if (dropped > backend.reportedDrops) {
+        appendFormatted(backend, "%s%llu log records dropped, ring buffer full\n",
+                        g_levelPrefixes[LOG_LEVEL_WARN], (unsigned long long) (dropped - backend.reportedDrops));
+        backend.reportedDrops = dropped;
+    }
+
+    writeOutput(backend);
+}
+
+void Logger::Flush() {
+    LogBackend_t &backend = getBackend();
+    std::lock_guard<std::mutex> lock(backend.consumeMutex);
+    drainRings(backend);
+}
+
+u64 Logger::DroppedRecords() {
+    u64 dropped = 0;
+    for (LogRing_t *ring = getBackend().rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+void Logger::FlushAndExit() {
+    Flush();
     std::exit(EXIT_FAILURE);
 }
+
+void Logger::SetOutput(FILE *file) {
+    LogBackend_t &backend = getBackend();
+    std::lock_guard<std::mutex> lock(backend.consumeMutex);
+    drainRings(backend);
+    backend.file = file;
+}
@@ -1,10 +1,155 @@
 #pragma once
 
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#include "typedefs.h"
+
+// Asynchronous logger. A log call only copies the format pointer and its arguments as a binary
+// record into a lock free ring owned by the calling thread, a background thread does the
+// formatting and the I/O. The format has to be a string literal since only the pointer is kept,
+// string arguments are copied. When a ring is full the record is dropped and counted.
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_LOG 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_FATAL 4
+
+// Calls below this level write nothing, e.g. LOG_MIN_LEVEL=LOG_LEVEL_WARN strips Trace and Log.
+// Only the record is stripped, the arguments are still evaluated at the call site. Arguments that
+// cost something to compute belong behind an if constexpr on LOG_MIN_LEVEL.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_TRACE
+#endif
+
+// Longer string arguments are truncated.
+#define LOG_MAX_STRING_LENGTH 2048
+
+enum LogArgType_t : u8 {
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_FLOAT,
+    LOG_ARG_STRING,
+    LOG_ARG_POINTER,
+};
+
+struct LogRecordHeader_t {
+    u32 size; // Including the header, always a multiple of 8
+    u16 level;
+    u16 argCount;
+    const char *format;
+};
+
+// Reserves size bytes in the calling thread's ring, nullptr if the record has to be dropped.
+u8 *logBeginRecord(u32 size);
+void logCommitRecord();
+
+template<typename T>
+inline u32 logArgSize(const T &arg) {
+    if constexpr (std::is_same<T, const char *>::value || std::is_same<T, char *>::value) {
+        size_t length = arg ? strlen(arg) : 0;
+        return 1 + 4 + (u32) (length < LOG_MAX_STRING_LENGTH ? length : LOG_MAX_STRING_LENGTH) + 1;
+    } else {
+        return 1 + 8;
+    }
+}
+
+template<typename T>
+inline u8 *logWriteArg(u8 *dst, const T &arg) {
+    if constexpr (std::is_same<T, const char *>::value || std::is_same<T, char *>::value) {
+        const char *string = arg ? arg : "(null)";
+        size_t length = strlen(string);
+        u32 length32 = (u32) (length < LOG_MAX_STRING_LENGTH ? length : LOG_MAX_STRING_LENGTH);
+        *dst++ = LOG_ARG_STRING;
+        memcpy(dst, &length32, 4);
+        memcpy(dst + 4, string, length32);
+        dst[4 + length32] = '\0';
+        return dst + 4 + length32 + 1;
+    } else if constexpr (std::is_floating_point<T>::value) {
+        f64 value = (f64) arg;
+        *dst++ = LOG_ARG_FLOAT;
+        memcpy(dst, &value, 8);
+        return dst + 8;
+    } else if constexpr (std::is_pointer<T>::value) {
+        u64 value = (u64) (size_t) arg;
+        *dst++ = LOG_ARG_POINTER;
+        memcpy(dst, &value, 8);
+        return dst + 8;
+    } else if constexpr (std::is_enum<T>::value || std::is_signed<T>::value) {
+        i64 value = (i64) arg;
+        *dst++ = LOG_ARG_INT;
+        memcpy(dst, &value, 8);
+        return dst + 8;
+    } else {
+        static_assert(std::is_integral<T>::value, "Unsupported log argument type");
+        u64 value = (u64) arg;
+        *dst++ = LOG_ARG_UINT;
+        memcpy(dst, &value, 8);
+        return dst + 8;
+    }
+}
+
+template<typename... Args>
+inline bool logWrite(u32 level, const char *format, const Args &... args) {
+    u32 size = (u32) sizeof(LogRecordHeader_t);
+    ((size += logArgSize(args)), ...);
+    size = (size + 7) & ~7u;
+
+    u8 *record = logBeginRecord(size);
+    if (!record) return false;
+
+    LogRecordHeader_t *header = (LogRecordHeader_t *) record;
+    header->size = size;
+    header->level = (u16) level;
+    header->argCount = (u16) sizeof...(Args);
+    header->format = format;
+
+    u8 *dst = record + sizeof(LogRecordHeader_t);
+    ((dst = logWriteArg(dst, args)), ...);
+    (void) dst; // Unused without arguments
+    logCommitRecord();
+    return true;
+}
+
 class Logger {
 public:
-    static void Trace( const char* message, ... );
-    static void Log( const char* message, ... );
-    static void Warn( const char* message, ... );
-    static void Error( const char* message, ... );
-    static void Fatal( const char* message, ... );    
+    template<typename... Args>
+    static void Trace(const char *message, Args... args) {
+        if constexpr (LOG_MIN_LEVEL <= LOG_LEVEL_TRACE) logWrite(LOG_LEVEL_TRACE, message, args...);
+    }
+
+    template<typename... Args>
+    static void Log(const char *message, Args... args) {
+        if constexpr (LOG_MIN_LEVEL <= LOG_LEVEL_LOG) logWrite(LOG_LEVEL_LOG, message, args...);
+    }
+
+    template<typename... Args>
+    static void Warn(const char *message, Args... args) {
+        if constexpr (LOG_MIN_LEVEL <= LOG_LEVEL_WARN) logWrite(LOG_LEVEL_WARN, message, args...);
+    }
+
+    template<typename... Args>
+    static void Error(const char *message, Args... args) {
+        if constexpr (LOG_MIN_LEVEL <= LOG_LEVEL_ERROR) logWrite(LOG_LEVEL_ERROR, message, args...);
+    }
+
+    // Never stripped, flushes everything logged so far before exiting.
+    template<typename... Args>
+    [[noreturn]] static void Fatal(const char *message, Args... args) {
+        if (!logWrite(LOG_LEVEL_FATAL, message, args...)) {
+            Flush();
+            logWrite(LOG_LEVEL_FATAL, message, args...);
+        }
+        FlushAndExit();
+    }
+
+    // Blocks until every record logged before the call has been written out.
+    static void Flush();
+    static u64 DroppedRecords();
+    static void SetOutput(FILE *file); // stdout by default
+
+private:
+    [[noreturn]] static void FlushAndExit();
 };
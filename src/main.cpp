@@ -3,84 +3,528 @@
 #include <GLFW/glfw3.h>
 #include <GLFW/glfw3native.h>
 
+#include "arena.h"
+#include "benchmark.h"
+#include "cooked.h"
+#include "drawlist.h"
+#include "jobs.h"
+#include "pacing.h"
+#include "profiler.h"
 #include "scene.h"
+#include "sim.h"
+#include "startup.h"
 #include "vk_base.h"
+#include "vk_memory.h"
+#include "vk_swapchain.h"
 
 std::vector<Mesh_t> g_meshes;
+TransformHierarchy_t g_transforms;
 VPmatrices_t g_VPmatrices;
 
 static bool uboBufferCreated = false;
 
+// Frames before this may still grow containers and arenas to their working size.
+#define STEADY_STATE_FRAME 120
+
+static bool g_depthPrepass = DEPTH_PREPASS;
+static bool g_prepassKeyDown = false;
+
+static const VkPresentModeKHR g_presentModes[] = {
+        VK_PRESENT_MODE_FIFO_KHR,
+        VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+        VK_PRESENT_MODE_MAILBOX_KHR,
+        VK_PRESENT_MODE_IMMEDIATE_KHR,
+};
+static u32 g_presentModeIndex = 0;
+static bool g_presentModeKeyDown = false;
+
+static const u32 g_fpsLimits[] = {0, 30, 60, 120, 144}; // Cycled with L, starts at TARGET_FPS
+static u32 g_fpsLimitIndex = 0;
+static bool g_limiterKeyDown = false;
+static FramePacer_t g_pacer;
+
+// Both toggles select prewarmed pipeline variants, see vk_variants.h.
+static ShadingModel_t g_shadingModel = ShadingModel_Lambert;
+static bool g_shadingKeyDown = false;
+static const u32 g_lightCaps[] = {MAX_LIGHTS_PER_CLUSTER, 32, 8}; // Cycled with K
+static u32 g_lightCapIndex = 0;
+static bool g_lightCapKeyDown = false;
+
+// Small lights orbiting the models on top of the two key lights, to give the clustered shading
+// something to bin.
+#define SCENE_POINT_LIGHTS 1024
+
+// Optional block compressed base color texture for the models, streamed. Missing is fine.
+#define SCENE_KTX2_TEXTURE "../../assets/base_color.ktx2"
+
+static std::vector<PointLight_t> g_lights;
+
+// Tints of the scene materials, Mesh_t::material picks one.
+static const glm::vec4 g_materialTints[] = {
+        glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),
+        glm::vec4(1.0f, 0.8f, 0.6f, 1.0f),
+        glm::vec4(0.7f, 0.9f, 1.0f, 1.0f),
+};
+#define SCENE_MATERIAL_COUNT (sizeof(g_materialTints) / sizeof(g_materialTints[0]))
+
+// Spun by simulateStep. Recorded before static batching moves the meshes around.
+static u32 g_spinningTransform = U32_MAX;
+
+// Everything simulateStep advances. With DECOUPLED_SIMULATION it belongs to the simulation thread
+// once that starts, the render loop gets the camera through the snapshots like the transforms.
+struct SimScene_t {
+    TransformHierarchy_t *transforms;
+    VPmatrices_t camera;
+};
+static SimScene_t g_simScene;
+
+// Where the benchmark camera is along its path, from the render loop to simulateStep.
+static std::atomic<f32> g_benchmarkCameraTime{0.0f};
+
+static u32 g_meshletCount = 0;
+static std::vector<ObjectData_t> g_objectData;
+static std::vector<u32> g_objectIndices;
+static std::vector<u32> g_meshTextures; // Streamed texture per mesh, U32_MAX for none
+
+#if DECOUPLED_SIMULATION
+static Simulation_t g_simulation;
+static SceneSnapshot_t g_previousSnapshot;
+static std::vector<u8> g_interpolating; // Transforms that moved between the last two snapshots
+#endif
+
+// Set once the main loop runs, resize callbacks before that only mark the swapchain.
+static bool g_renderLoopRunning = false;
+
+static BenchmarkConfig_t g_benchmark;
+
+static bool g_traceRequested = false; // Starts at the end of the frame, outside the heap count
+static bool g_traceKeyDown = false;
+
 void processKeyInput(GLFWwindow *windowPtr) {
     if (glfwGetKey(windowPtr, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         glfwSetWindowShouldClose(windowPtr, true);
     }
-}
 
-void sendStaticResources(std::vector<Mesh_t> &meshList) {
-    u32 totalVertexSize = 0;
-    u32 totalIndexSize = 0;
-    u32 vbOffset = 0;
-    u32 vbSize = 0;
-    u32 ibOffset = 0;
-    u32 ibSize = 0;
-    u32 meshCount = 0;
-    for (auto &mesh : meshList) {
-        vbSize = mesh.vertices.size() * sizeof(mesh.vertices[0]);
-        totalVertexSize += vbSize;
-        mesh.vertexOffset = vbOffset;
-        mesh.firstVertex = mesh.vertexOffset / sizeof(mesh.vertices[0]);
+    bool prepassKey = glfwGetKey(windowPtr, GLFW_KEY_P) == GLFW_PRESS;
+    if (prepassKey && !g_prepassKeyDown) {
+        g_depthPrepass = !g_depthPrepass;
+        Logger::Log("Depth pre-pass %s", g_depthPrepass ? "on" : "off");
+    }
+    g_prepassKeyDown = prepassKey;
+
+    // Unsupported modes fall back to FIFO when the swapchain is recreated.
+    bool presentModeKey = glfwGetKey(windowPtr, GLFW_KEY_V) == GLFW_PRESS;
+    if (presentModeKey && !g_presentModeKeyDown) {
+        g_presentModeIndex = (g_presentModeIndex + 1) % (sizeof(g_presentModes) / sizeof(g_presentModes[0]));
+        avk_setPresentMode(g_presentModes[g_presentModeIndex]);
+        Logger::Log("Requested present mode %s", presentModeName(g_presentModes[g_presentModeIndex]));
+    }
+    g_presentModeKeyDown = presentModeKey;
 
-        Logger::Trace("vbOffset = %i for mesh %i", mesh.vertexOffset, meshCount);
-        Logger::Trace("firstVertex = %i for mesh %i", mesh.firstVertex, meshCount);
+    bool limiterKey = glfwGetKey(windowPtr, GLFW_KEY_L) == GLFW_PRESS;
+    if (limiterKey && !g_limiterKeyDown) {
+        g_fpsLimitIndex = (g_fpsLimitIndex + 1) % (sizeof(g_fpsLimits) / sizeof(g_fpsLimits[0]));
+        setTargetFps(g_pacer, g_fpsLimits[g_fpsLimitIndex]);
+        Logger::Log("Frame limiter %i fps", g_fpsLimits[g_fpsLimitIndex]);
+    }
+    g_limiterKeyDown = limiterKey;
 
-        vbOffset += vbSize; // The offset of the next mesh will be the size of the current one
+    bool shadingKey = glfwGetKey(windowPtr, GLFW_KEY_G) == GLFW_PRESS;
+    bool lightCapKey = glfwGetKey(windowPtr, GLFW_KEY_K) == GLFW_PRESS;
+    if ((shadingKey && !g_shadingKeyDown) || (lightCapKey && !g_lightCapKeyDown)) {
+        if (shadingKey && !g_shadingKeyDown) {
+            g_shadingModel = g_shadingModel == ShadingModel_Lambert ? ShadingModel_Gooch : ShadingModel_Lambert;
+        }
+        if (lightCapKey && !g_lightCapKeyDown) {
+            g_lightCapIndex = (g_lightCapIndex + 1) % (sizeof(g_lightCaps) / sizeof(g_lightCaps[0]));
+        }
+        avk_setShading(g_shadingModel, g_lightCaps[g_lightCapIndex]);
+        Logger::Log("Shading %s, at most %i lights per fragment",
+                    g_shadingModel == ShadingModel_Gooch ? "gooch" : "lambert", g_lightCaps[g_lightCapIndex]);
+    }
+    g_shadingKeyDown = shadingKey;
+    g_lightCapKeyDown = lightCapKey;
 
-        ibSize = mesh.indices.size() * sizeof(mesh.indices[0]);
-        totalIndexSize += ibSize;
-        mesh.indexOffset = ibOffset;
-        mesh.firstIndex = mesh.indexOffset / sizeof(mesh.indices[0]);
-        Logger::Trace("ibOffset = %i for mesh %i", mesh.indexOffset, meshCount);
-        Logger::Trace("firstIndex = %i for mesh %i", mesh.firstIndex, meshCount);
-        ibOffset += ibSize;
+    bool traceKey = glfwGetKey(windowPtr, GLFW_KEY_T) == GLFW_PRESS;
+    if (traceKey && !g_traceKeyDown && !profilerCapturing()) {
+        g_traceRequested = true;
+    }
+    g_traceKeyDown = traceKey;
+}
 
-        meshCount += 1;
+// Minimized or zero sized, there is nothing to present to.
+static
+bool windowHidden(GLFWwindow *windowPtr) {
+    i32 width, height;
+    glfwGetFramebufferSize(windowPtr, &width, &height);
+    return glfwGetWindowAttrib(windowPtr, GLFW_ICONIFIED) || width == 0 || height == 0;
+}
 
-    }
+void sendStaticResources(std::vector<Mesh_t> &meshList, u32 objectCount) {
+    PROFILE_FUNCTION();
+    u32 totalVertexSize = 0;
+    u32 totalIndexSize = 0;
+    placeStaticGeometry(meshList, totalVertexSize, totalIndexSize);
 
     Logger::Trace("total vertex size: %i", totalVertexSize);
     Logger::Trace("total index size: %i", totalIndexSize);
 
     createStaticBuffers(totalVertexSize, totalIndexSize);
 
-    meshCount = 0;
+    std::vector<Meshlet_t> meshlets;
+    expandMeshlets(meshList, meshlets);
+    g_meshletCount = (u32) meshlets.size();
+
+    Logger::Trace("total meshlet count: %i", g_meshletCount);
+
+    createClusterBuffers(g_meshletCount, objectCount);
+    uploadMeshlets((u32) (meshlets.size() * sizeof(meshlets[0])), 0, meshlets.data());
+
     for (auto &mesh : meshList) {
+        if (mesh.sharedGeometry != U32_MAX) continue;
         u32 vertexSize = mesh.vertices.size() * sizeof(mesh.vertices[0]);
         u32 indexSize = mesh.indices.size() * sizeof(mesh.indices[0]);
         uploadVertices(vertexSize, mesh.vertexOffset, mesh.vertices.data());
         uploadIndices(indexSize, mesh.indexOffset, mesh.indices.data());
-        meshCount += 1;
     }
 }
 
-u32 render(f64 time, std::vector<Mesh_t> &meshList) {
+// Texture streaming sheds mips on its own under pressure, see vk_textures.h. This just makes the
+// situation visible.
+static
+void onMemoryPressure(u32 heapIndex, MemoryPressure_t pressure, const HeapBudget_t &heap, void *data) {
+    const f64 MB = 1024.0 * 1024.0;
+    if (pressure == MemoryPressure_None) {
+        Logger::Log("Memory heap %i back under budget, %f / %f MB", heapIndex, heap.usage / MB, heap.budget / MB);
+    } else {
+        Logger::Warn("Memory heap %i at %s pressure, %f / %f MB", heapIndex,
+                     pressure == MemoryPressure_Critical ? "critical" : "high", heap.usage / MB, heap.budget / MB);
+    }
+}
+
+// Scene update, either called once per frame or at a fixed rate from the simulation thread.
+static
+void simulateStep(f64 time, f64 dt, void *data) {
+    PROFILE_FUNCTION();
+    SimScene_t &scene = *(SimScene_t *) data;
+    TransformHierarchy_t &transforms = *scene.transforms;
+
+    if (g_benchmark.enabled) {
+        f32 cameraTime = g_benchmarkCameraTime.load(std::memory_order_relaxed);
+        scene.camera.view = stressCameraView(g_benchmark.scene.cameraPath, cameraTime);
+    }
+
+    // rotate mesh 1
+
+    if (g_spinningTransform != U32_MAX) {
+        f32 step = 1.0f;
+        f32 degs = dt * step;
+        f32 degs2 = dt * 0.1f*step;
+        glm::vec3 rotDir = glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 rotDir2 = glm::vec3(1.0f, 0.0f, 1.0f);
+        glm::mat4 rotMat = glm::rotate(glm::mat4(1.0f), degs, rotDir);
+        glm::mat4 rotMat2 = glm::rotate(glm::mat4(1.0f), degs2, rotDir2);
+
+        u32 transformIndex = g_spinningTransform;
+        setLocalTransform(transforms, transformIndex, rotMat2 * rotMat * transforms.local[transformIndex]);
+    }
+
+    updateTransforms(transforms);
+}
+
+#if DECOUPLED_SIMULATION
+static
+void publishScene(SceneSnapshot_t &snapshot, void *data) {
+    PROFILE_FUNCTION();
+    const SimScene_t &scene = *(const SimScene_t *) data;
+    const TransformHierarchy_t &transforms = *scene.transforms;
+    snapshot.camera = scene.camera;
+    snapshot.world.assign(transforms.world.begin(), transforms.world.end());
+    snapshot.normal.assign(transforms.normal.begin(), transforms.normal.end());
+}
+
+// Uploads the transforms interpolated between the two newest snapshots. Rendering runs one step
+// behind the simulation so there is almost always a later snapshot to interpolate towards.
+static
+void uploadSnapshotTransforms(f64 renderTime) {
+    PROFILE_FUNCTION();
+    acquireSnapshot(g_simulation.snapshots, g_previousSnapshot);
+    const SceneSnapshot_t &current = currentSnapshot(g_simulation.snapshots);
+    const SceneSnapshot_t &previous = g_previousSnapshot;
+
+    // The render thread's copy, the simulation has its own in g_simScene.
+    g_VPmatrices = current.camera;
+
+    u32 count = (u32) current.world.size();
+    bool uploadAll = g_interpolating.size() != count;
+    bool canInterpolate = previous.world.size() == count;
+    g_interpolating.resize(count, 0);
+
+    f32 alpha = canInterpolate ? snapshotAlpha(previous, current, renderTime) : 1.0f;
+
+    g_objectIndices.clear();
+    g_objectData.clear();
+    for (u32 i = 0; i < count; i++) {
+        bool moving = canInterpolate && previous.world[i] != current.world[i];
+        // Objects that just stopped need one last upload to land exactly on the final transform.
+        if (!uploadAll && !moving && !g_interpolating[i]) continue;
+        g_interpolating[i] = moving ? 1 : 0;
+
+        ObjectData_t object;
+        if (moving) {
+            object.model = previous.world[i] + (current.world[i] - previous.world[i]) * alpha;
+            object.normal = previous.normal[i] + (current.normal[i] - previous.normal[i]) * alpha;
+        } else {
+            object.model = current.world[i];
+            object.normal = current.normal[i];
+        }
+        g_objectIndices.push_back(i);
+        g_objectData.push_back(object);
+    }
+
+    if (!g_objectIndices.empty()) {
+        uploadObjectData(g_objectIndices.data(), g_objectData.data(), (u32) g_objectIndices.size());
+    }
+}
+#else
+static
+void uploadChangedTransforms(const TransformHierarchy_t &transforms) {
+    u32 count = (u32) transforms.changed.size();
+    if (count == 0) return;
+
+    g_objectData.resize(count);
+    for (u32 i = 0; i < count; i++) {
+        u32 index = transforms.changed[i];
+        g_objectData[i].model = transforms.world[index];
+        g_objectData[i].normal = transforms.normal[index];
+    }
+    uploadObjectData(transforms.changed.data(), g_objectData.data(), count);
+}
+#endif
+
+static
+void drawMeshes(const std::vector<Mesh_t> &meshList, const u32 *drawOrder, f64 time) {
+    for (u32 i = 0; i < (u32) meshList.size(); i++) {
+        const Mesh_t &mesh = meshList[drawOrder[i]];
+        uploadObjectIndex(mesh.transformIndex);
+#if CLUSTER_CULLING
+        avk_drawMeshClusters(mesh.firstMeshlet, mesh.meshletCount, time);
+#else
+        avk_drawMesh(mesh.firstVertex, mesh.firstIndex, mesh.indexCount, time);
+#endif
+    }
+}
+
+static
+void setupLights(std::vector<PointLight_t> &lights) {
+    // The two original lights. Their radius covers the whole scene.
+    lights.push_back({glm::vec4(-1.0f, 1.0f, 8.0f, 64.0f), glm::vec4(1.0f, 1.0f, 1.0f, 0.5f)});
+    lights.push_back({glm::vec4(0.0f, 1.0f, -3.0f, 64.0f), glm::vec4(0.5f, 0.0f, 1.0f, 1.0f)});
+
+    for (u32 i = 0; i < SCENE_POINT_LIGHTS; i++) {
+        // Fully saturated hues around the color wheel.
+        glm::vec3 hue = glm::fract(glm::vec3((f32) i / SCENE_POINT_LIGHTS) + glm::vec3(0.0f, 2.0f / 3.0f, 1.0f / 3.0f));
+        glm::vec3 color = glm::clamp(glm::abs(hue * 6.0f - 3.0f) - 1.0f, 0.0f, 1.0f);
+        lights.push_back({glm::vec4(0.0f, 0.0f, 0.0f, 0.75f), glm::vec4(color, 0.6f)});
+    }
+}
+
+// Materials through the bindless table. Meshes use the streamed KTX2 texture when it
+// loads and a generated checkerboard otherwise, meshes without texture coordinates sample the
+// first texel.
+static
+void setupMaterials(const std::vector<Mesh_t> &meshList) {
+    PROFILE_FUNCTION();
+    const u32 size = 64;
+    const u32 square = 8;
+    ScratchScope_t scratch;
+    u32 *checker = arenaAllocArray<u32>(scratch.arena, size * size);
+    for (u32 y = 0; y < size; y++) {
+        for (u32 x = 0; x < size; x++) {
+            bool light = ((x / square) + (y / square)) % 2 == 0;
+            checker[y * size + x] = light ? 0xffffffff : 0xff808080; // ABGR
+        }
+    }
+    u32 checkerTexture = avk_addTexture(checker, size, size);
+
+    u32 streamed = avk_loadTexture(SCENE_KTX2_TEXTURE);
+    if (streamed == U32_MAX) {
+        Logger::Warn("No streamed texture, using the checkerboard");
+    }
+
+    // One material per tint, shared between meshes, so large stress scenes stay under MAX_MATERIALS.
+    u32 materials[SCENE_MATERIAL_COUNT];
+    for (u32 i = 0; i < SCENE_MATERIAL_COUNT; i++) {
+        Material_t material = {};
+        material.baseColor = g_materialTints[i];
+        material.baseColorTexture = streamed != U32_MAX ? avk_textureSlot(streamed) : checkerTexture;
+        materials[i] = avk_addMaterial(material);
+    }
+    for (u32 i = 0; i < meshList.size(); i++) {
+        avk_setObjectMaterial(meshList[i].transformIndex, materials[meshList[i].material]);
+        g_meshTextures.push_back(streamed);
+    }
+}
+
+// Screen height the bounding sphere covers, taken as the size the whole texture is stretched
+// over. Rough, but it only has to pick a mip level.
+static
+void requestTextureResolutions(const std::vector<Mesh_t> &meshList, const glm::mat4 *world, const glm::mat4 &view,
+                               const glm::mat4 &proj, u32 renderHeight) {
+    for (u32 i = 0; i < (u32) meshList.size(); i++) {
+        if (g_meshTextures[i] == U32_MAX) continue;
+        const Mesh_t &mesh = meshList[i];
+        const glm::mat4 &model = world[mesh.transformIndex];
+        f32 scale = glm::max(glm::length(glm::vec3(model[0])),
+                             glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        f32 radius = mesh.boundingSphere.w * scale;
+        glm::vec4 center = view * model * glm::vec4(glm::vec3(mesh.boundingSphere), 1.0f);
+        f32 depth = glm::max(-center.z, radius); // Camera inside the sphere counts as touching it
+        f32 pixels = radius / depth * proj[1][1] * (f32) renderHeight;
+        avk_requestTextureResolution(g_meshTextures[i], pixels);
+    }
+}
+
+static
+void updateLights(std::vector<PointLight_t> &lights, f64 time) {
+    const f32 twoPi = 6.28318531f;
+    f32 angle = (f32) (twoPi * time);
+    lights[0].positionRadius.x = -1.0f + 0.3f * cosf(angle / 4.0f);
+
+    // Rings of lights around the models, each ring at its own height and speed.
+    const u32 ringSize = 64;
+    for (u32 i = 2; i < lights.size(); i++) {
+        u32 light = i - 2;
+        u32 ring = light / ringSize;
+        f32 phase = twoPi * (light % ringSize) / ringSize;
+        f32 radius = 1.5f + 0.25f * ring;
+        f32 speed = (ring % 2 ? 0.1f : -0.1f) * (1.0f + 0.1f * ring);
+        f32 a = phase + angle * speed;
+        lights[i].positionRadius.x = -1.0f + radius * cosf(a);
+        lights[i].positionRadius.y = -0.5f + 0.15f * ring;
+        lights[i].positionRadius.z = radius * sinf(a);
+    }
+}
+
+static
+void drawMainPass(const std::vector<Mesh_t> &meshList, const u32 *drawOrder, f64 time) {
+    // Both passes draw in the same subpass, the pre-pass only differs in pipeline state.
+    if (g_depthPrepass) {
+        avk_setMeshPass(MeshPass_DepthPrepass);
+        drawMeshes(meshList, drawOrder, time);
+        avk_setMeshPass(MeshPass_ColorEqual);
+    } else {
+        avk_setMeshPass(MeshPass_Color);
+    }
+    drawMeshes(meshList, drawOrder, time);
+}
+
+// world is indexed by Mesh_t::transformIndex and only used for the draw order.
+u32 render(f64 time, std::vector<Mesh_t> &meshList, const glm::mat4 *world) {
+    PROFILE_FUNCTION();
 
     u32 imageIndex = avk_prepareFrame(time);
     if (imageIndex == U32_MAX) return imageIndex;
-    u32 meshIndex = 0;
+
+    updateLights(g_lights, time);
+    uploadLights(g_lights.data(), (u32) g_lights.size());
     uploadUniformData(g_VPmatrices.view, g_VPmatrices.proj);
-    for (Mesh_t &mesh : meshList) {
-        uploadModelMatrix(mesh.modelMatrix);
-        avk_drawMesh(mesh.firstVertex, mesh.firstIndex, mesh.indexCount, time); //TODO(anton): Material handle?
-        meshIndex += 1;
+
+    requestTextureResolutions(meshList, world, g_VPmatrices.view, g_VPmatrices.proj,
+                              avk_getResolutionStats().height);
+    avk_updateTextureStreaming();
+
+    u32 *drawOrder = nullptr;
+    {
+        PROFILE_ZONE("buildDrawOrder");
+        drawOrder = buildDrawOrder(meshList, world, g_VPmatrices.view, getFrameArena());
     }
 
+#if CLUSTER_CULLING
+    avk_cullClusters(g_meshletCount);
+#endif
+    avk_binLights();
+
+    avk_beginMainPass();
+    drawMainPass(meshList, drawOrder, time);
+
+#if CLUSTER_CULLING && OCCLUSION_CULLING
+    // The same draws again, now with the clusters the early occlusion phase rejected and the late
+    // one found visible.
+    avk_beginLateMainPass();
+    drawMainPass(meshList, drawOrder, time);
+#endif
+
     avk_endFrame();
 
     return imageIndex;
 }
 
+static
+const glm::mat4 *currentWorld() {
+#if DECOUPLED_SIMULATION
+    return currentSnapshot(g_simulation.snapshots).world.data();
+#else
+    return g_transforms.world.data();
+#endif
+}
+
+// While the window is dragged to a new size the event loop sits inside glfwPollEvents (on Windows
+// in the modal resize loop), so frames are drawn from here for the contents to follow the edge.
+static
+void onFramebufferResize(GLFWwindow *windowPtr, i32 width, i32 height) {
+    avk_surfaceResized();
+    if (!g_renderLoopRunning || width == 0 || height == 0) return;
+
+    render(glfwGetTime(), g_meshes, currentWorld());
+    resetArena(getFrameArena());
+}
+
+static
+void loadSceneJob(void *data, u32 begin, u32 end) {
+    u32 step = beginStartupStep("scene load");
+    if (g_benchmark.enabled) {
+        generateStressScene(g_benchmark.scene, g_meshes, g_transforms, g_VPmatrices, 1280, 720);
+    } else {
+        setupScene(g_meshes, g_transforms, g_VPmatrices, 1280, 720);
+    }
+
+    // Materials go round the tints in list order.
+    for (u32 i = 0; i < g_meshes.size(); i++) {
+        g_meshes[i].material = i % SCENE_MATERIAL_COUNT;
+    }
+    // The second mesh spins, whatever the scene says about it. Its submeshes follow its transform.
+    if (g_meshes.size() > 1) {
+        g_meshes[1].isStatic = false;
+        g_spinningTransform = g_meshes[1].transformIndex;
+    }
+
+    splitSubmeshes(g_meshes, g_transforms);
+    for (Mesh_t &mesh : g_meshes) {
+        mesh.material %= SCENE_MATERIAL_COUNT; // Submeshes count on from their mesh's material
+    }
+
+#if STATIC_BATCHING
+    StaticBatchStats_t batchStats;
+    batchStaticMeshes(g_meshes, g_transforms, batchStats);
+    if (batchStats.batches > 0) {
+        // Instances stop sharing their geometry, fewer draws cost memory.
+        Logger::Log("Static batching: %i meshes in %i batches, %i draws left, geometry %f -> %f MB",
+                    batchStats.mergedMeshes, batchStats.batches, (u32) g_meshes.size(),
+                    batchStats.sourceBytes / (1024.0 * 1024.0), batchStats.batchBytes / (1024.0 * 1024.0));
+    }
+    setBenchmarkStaticBatches(batchStats);
+#endif
+    endStartupStep(step);
+}
+
 i32 main(i32 argc, const char **argv) {
+    startStartupTimeline();
+
+    // --trace records startup and the first frames, T captures frames at any time after.
+    for (i32 i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0) profilerStartCapture(PROFILER_CAPTURE_FRAMES);
+    }
 #ifdef _DEBUG
     Logger::Trace("_DEBUG defined.");
 #endif
@@ -91,22 +535,61 @@ i32 main(i32 argc, const char **argv) {
     Logger::Trace("VK_USE_PLATFORM_WIN32_KHR defined.");
 #endif
 
+    if (!parseBenchmarkArgs(argc, argv, g_benchmark)) {
+        return 1;
+    }
+
+    // Init job system, the main thread is worker 0
+    initJobSystem(0);
+    Logger::Trace("Job system running with %i workers", getJobWorkerCount());
+
+    // Meshes and shaders as anton_cook left them, nothing is processed at startup.
+    loadCookedManifest(COOKED_MANIFEST_PATH);
+
+    // The scene only needs the manifest, it loads on the workers while the window and the device
+    // come up.
+    JobCounter_t sceneLoaded;
+    JobDecl_t sceneJob = {loadSceneJob, nullptr, 0, 1};
+    runJobs(&sceneJob, 1, &sceneLoaded);
+
     // Init GLFW
+    u32 step = beginStartupStep("window");
     i32 rc = glfwInit();
     ASSERT(rc == GLFW_TRUE);
     ASSERT(glfwVulkanSupported() == GLFW_TRUE);
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    if (g_benchmark.headless) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
 
     GLFWwindow *windowPtr;
     windowPtr = glfwCreateWindow(1280, 720, "anton_vk", nullptr, nullptr);
+    endStartupStep(step);
 
     // Init Vulkan
     initialiseVulkan(windowPtr);
+    glfwSetFramebufferSizeCallback(windowPtr, onFramebufferResize);
+
+    initFramePacing();
+    setTargetFps(g_pacer, TARGET_FPS);
+    if (g_benchmark.enabled) {
+        // As fast as the GPU goes, vsync and the limiter would hide the differences.
+        setTargetFps(g_pacer, 0);
+        avk_setPresentMode(VK_PRESENT_MODE_IMMEDIATE_KHR);
+    }
 
     // Init scene
-    setupScene(g_meshes, g_VPmatrices, 1280, 720);
-    sendStaticResources(g_meshes);
+    waitForCounter(&sceneLoaded);
+    step = beginStartupStep("scene upload");
+    sendStaticResources(g_meshes, (u32) g_transforms.parent.size());
+    setupMaterials(g_meshes);
+    setupLights(g_lights);
+    endStartupStep(step);
+
+    addMemoryPressureCallback(onMemoryPressure, nullptr);
+    updateMemoryStats();
+    logMemoryStats();
 
     u32 imageIndex = 0;
     u32 frameCounter = 0;
@@ -115,46 +598,150 @@ i32 main(i32 argc, const char **argv) {
     glfwSetTime(elapsedTime);
     f64 deltaTime = 0;
 
-    f32 degs = 0.0f, degs2 = 0.0f;
+    g_simScene.transforms = &g_transforms;
+    g_simScene.camera = g_VPmatrices;
+#if DECOUPLED_SIMULATION
+    // From here on g_transforms and g_simScene belong to the simulation thread, the render loop
+    // only sees snapshots.
+    updateTransforms(g_transforms);
+    startSimulation(g_simulation, simulateStep, publishScene, &g_simScene);
+#endif
+
+    // Everything is loaded and uploaded, from here on frames should not touch the general heap.
+    u64 heapAllocationsAtFrameStart = getHeapStats().allocations;
+    bool reportedSteadyStateAllocation = false;
+
+    i32 exitCode = 0;
+    f64 benchmarkFrameStart = pacingClock();
+    if (g_benchmark.enabled) {
+        beginBenchmark(g_benchmark);
+    }
+
+    g_renderLoopRunning = true;
     while (!glfwWindowShouldClose(windowPtr)) {
+        // Here rather than at the bottom so the frames that skip rendering reset as well.
+        resetArena(getFrameArena());
+        heapAllocationsAtFrameStart = getHeapStats().allocations;
+
+        // The limiter waits before the input is sampled so the wait is not part of the latency.
+        waitForNextFrame(g_pacer);
+        PROFILE_ZONE("frame");
         glfwPollEvents();
 
-        deltaTime = glfwGetTime() - previousTime;
+        // Block until something changes instead of spinning through skipped frames.
+        if (windowHidden(windowPtr)) {
+            glfwWaitEvents();
+            continue;
+        }
+        stampLatency(LatencyStamp_Input);
 
-        // rotate mesh 1
+        deltaTime = glfwGetTime() - previousTime;
 
-        if(g_meshes.size() > 1) {
-            f32 step = 1.0f;
-            degs = deltaTime * step;
-            degs2 = deltaTime * 0.1f*step;
-            glm::vec3 rotDir = glm::vec3(0.0f, 1.0f, 0.0f);
-            glm::vec3 rotDir2 = glm::vec3(1.0f, 0.0f, 1.0f);
-            glm::mat4 rotMat = glm::rotate(glm::mat4(1.0f), degs, rotDir);
-            glm::mat4 rotMat2 = glm::rotate(glm::mat4(1.0f), degs2, rotDir2);
+        processKeyInput(windowPtr);
 
-            g_meshes[1].modelMatrix = rotMat2 * rotMat * g_meshes[1].modelMatrix;
+        if (g_benchmark.enabled) {
+            g_benchmarkCameraTime.store(benchmarkCameraTime(), std::memory_order_relaxed);
         }
 
-        processKeyInput(windowPtr);
+        // Done before acquiring so that a skipped frame does not lose the changes.
+#if DECOUPLED_SIMULATION
+        uploadSnapshotTransforms(simulationClock() - SIM_STEP_SECONDS);
+#else
+        simulateStep(elapsedTime, deltaTime, &g_simScene);
+        uploadChangedTransforms(g_transforms);
+        g_VPmatrices = g_simScene.camera;
+#endif
 
         // Begin render calls
-        imageIndex = render(elapsedTime, g_meshes);
+        imageIndex = render(elapsedTime, g_meshes, currentWorld());
         if (imageIndex == U32_MAX) continue;
+        finishLatencyFrame();
+        markFirstFrame();
 
         // End render calls
         previousTime = elapsedTime;
         elapsedTime = glfwGetTime();
         frameCounter++;
-        char title[256];
-        sprintf(title, "frame: %i - imageIndex: %i - delta time: %f - elapsed time: %f",
-                frameCounter, imageIndex, deltaTime, elapsedTime);
+
+        HeapStats_t heapStats = getHeapStats();
+        u64 frameAllocations = heapStats.allocations - heapAllocationsAtFrameStart;
+        if (frameCounter > STEADY_STATE_FRAME && frameAllocations > 0 && !reportedSteadyStateAllocation) {
+            Logger::Warn("Frame %i made %i heap allocations in steady state", frameCounter, frameAllocations);
+            reportedSteadyStateAllocation = true;
+        }
+
+        ClusterCullStats_t cullStats = avk_getClusterCullStats();
+        PipelineStats_t pipelineStats = avk_getPipelineStats();
+        ResolutionStats_t resolutionStats = avk_getResolutionStats();
+        LatencyStats_t latency = getLatencyStats();
+        ShaderVariantStats_t variantStats = avk_getShaderVariantStats();
+        TextureStreamingStats_t textureStats = avk_getTextureStreamingStats();
+        u32 renderedPixels = resolutionStats.width * resolutionStats.height * VIEW_COUNT; // Per view
+        f64 overdraw = renderedPixels > 0 ? (f64) pipelineStats.fragmentInvocations / renderedPixels : 0.0;
+        const u32 titleSize = 512;
+        char *title = arenaAllocArray<char>(getFrameArena(), titleSize);
+        const MemoryStats_t &memoryStats = getMemoryStats();
+        VkDeviceSize deviceUsage = 0, deviceBudget = 0;
+        for (u32 i = 0; i < memoryStats.heapCount; i++) {
+            if (!memoryStats.heaps[i].deviceLocal) continue;
+            deviceUsage += memoryStats.heaps[i].usage;
+            deviceBudget += memoryStats.heaps[i].budget;
+        }
+        snprintf(title, titleSize, "frame: %i - imageIndex: %i - delta time: %f - elapsed time: %f - gpu: %.2f ms at %ix%i - clusters: %i/%i (%i late, %i occluded) - fs invocations: %i (%.2fx)%s - heap allocs: %i - vram: %i/%i MB - %s, input to present %.1f ms, to gpu done %.1f ms - variants: %i (%i on demand) - textures: %i/%i MB",
+                 frameCounter, imageIndex, deltaTime, elapsedTime,
+                 resolutionStats.gpuMs, resolutionStats.width, resolutionStats.height,
+                 cullStats.visibleClusters, g_meshletCount, cullStats.lateClusters, cullStats.occludedClusters,
+                 (u32) pipelineStats.fragmentInvocations, overdraw, g_depthPrepass ? " prepass" : "",
+                 (u32) frameAllocations, (u32) (deviceUsage >> 20), (u32) (deviceBudget >> 20),
+                 presentModeName(avk_getPresentMode()), latency.toPresentMs, latency.toGpuDoneMs,
+                 variantStats.variantCount, variantStats.onDemandBuilds,
+                 (u32) (textureStats.residentBytes >> 20), (u32) (textureStats.budgetBytes >> 20));
         glfwSetWindowTitle(windowPtr, title);
+
+        if (g_benchmark.enabled) {
+            f64 now = pacingClock();
+            BenchmarkFrame_t frame = {};
+            frame.cpuMs = getLastFrameLatency().toSubmitMs;
+            frame.gpuMs = resolutionStats.gpuMs;
+            frame.frameMs = (now - benchmarkFrameStart) * 1e3;
+            frame.draws = (u32) g_meshes.size() * (g_depthPrepass ? 2 : 1) *
+                          (CLUSTER_CULLING && OCCLUSION_CULLING ? 2 : 1); // Both main passes draw every mesh
+            frame.visibleClusters = cullStats.visibleClusters;
+            frame.occludedClusters = cullStats.occludedClusters;
+            frame.occludedTriangles = cullStats.occludedTriangles;
+            frame.primitives = pipelineStats.clippingPrimitives;
+            frame.deviceBytes = deviceUsage;
+            frame.renderScale = resolutionStats.scale;
+            benchmarkFrameStart = now;
+            if (recordBenchmarkFrame(frame)) {
+                exitCode = finishBenchmark();
+                glfwSetWindowShouldClose(windowPtr, true);
+            }
+        }
+
+        // Starting and writing a trace allocates, done after the heap check.
+        if (g_traceRequested) {
+            profilerStartCapture(PROFILER_CAPTURE_FRAMES);
+            g_traceRequested = false;
+        } else {
+            profilerFrameEnd();
+        }
     }
 
+    g_renderLoopRunning = false;
+    shutdownFramePacing();
+    avk_logShaderVariants();
+
+#if DECOUPLED_SIMULATION
+    stopSimulation(g_simulation);
+#endif
+
     if (windowPtr) {
         glfwDestroyWindow(windowPtr);
     }
     glfwTerminate();
 
-    return 0;
+    shutdownJobSystem();
+
+    return exitCode;
 }
\ No newline at end of file
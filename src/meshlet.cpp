@@ -0,0 +1,181 @@
+#include <cfloat>
+#include <cmath>
+
+#include "arena.h"
+#include "meshlet.h"
+
+static
+void computeMeshletBounds(Meshlet_t &meshlet, const std::vector<Vertex_t> &vertices, const u32 *indices) {
+    u32 triangleCount = meshlet.indexCount / 3;
+
+    glm::vec3 minPos = glm::vec3(FLT_MAX);
+    glm::vec3 maxPos = glm::vec3(-FLT_MAX);
+    glm::vec3 normalSum = glm::vec3(0.0f);
+    glm::vec3 normals[MESHLET_MAX_TRIANGLES];
+
+    for (u32 t = 0; t < triangleCount; t++) {
+        glm::vec3 a = vertices[indices[3 * t + 0]].pos;
+        glm::vec3 b = vertices[indices[3 * t + 1]].pos;
+        glm::vec3 c = vertices[indices[3 * t + 2]].pos;
+
+        minPos = glm::min(minPos, glm::min(a, glm::min(b, c)));
+        maxPos = glm::max(maxPos, glm::max(a, glm::max(b, c)));
+
+        // Degenerate triangles get a zero normal and are left out of the cone.
+        glm::vec3 n = glm::cross(b - a, c - a);
+        f32 len = glm::length(n);
+        normals[t] = len > 0.0f ? n / len : glm::vec3(0.0f);
+        normalSum += normals[t];
+    }
+
+    glm::vec3 center = 0.5f * (minPos + maxPos);
+    f32 radius = 0.0f;
+    for (u32 i = 0; i < meshlet.indexCount; i++) {
+        radius = glm::max(radius, glm::length(vertices[indices[i]].pos - center));
+    }
+    meshlet.boundingSphere = glm::vec4(center, radius);
+
+    f32 axisLength = glm::length(normalSum);
+    glm::vec3 axis = axisLength > 0.0f ? normalSum / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+
+    f32 minDot = 1.0f;
+    for (u32 t = 0; t < triangleCount; t++) {
+        if (normals[t] != glm::vec3(0.0f)) {
+            minDot = glm::min(minDot, glm::dot(axis, normals[t]));
+        }
+    }
+
+    // The normal cone has half angle acos(minDot). Widening it by 90 degrees gives the set of
+    // view directions from which every triangle is backfacing, and the cosine of that is
+    // sin(acos(minDot)). Cones wider than ~84 degrees are not worth testing.
+    f32 cutoff = minDot <= 0.1f ? 1.0f : sqrtf(1.0f - minDot * minDot);
+    meshlet.cone = glm::vec4(axis, cutoff);
+}
+
+void buildMeshlets(const std::vector<Vertex_t> &vertices, std::vector<u32> &indices,
+                   std::vector<Meshlet_t> &meshlets) {
+    u32 vertexCount = (u32) vertices.size();
+    u32 triangleCount = (u32) indices.size() / 3;
+
+    ScratchScope_t scratch;
+    ArenaAllocator_t<u32> u32Allocator(scratch.arena);
+
+    // Vertex -> triangle adjacency, stored as offsets into one flat list.
+    ArenaVector_t<u32> adjacencyOffsets(vertexCount + 1, 0, u32Allocator);
+    for (u32 index : indices) {
+        adjacencyOffsets[index + 1] += 1;
+    }
+    for (u32 v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+    ArenaVector_t<u32> adjacency(indices.size(), u32Allocator);
+    {
+        ArenaVector_t<u32> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1, u32Allocator);
+        for (u32 i = 0; i < (u32) indices.size(); i++) {
+            adjacency[cursor[indices[i]]++] = i / 3;
+        }
+    }
+
+    ArenaVector_t<u8> emitted(triangleCount, 0, ArenaAllocator_t<u8>(scratch.arena));
+    ArenaVector_t<u32> vertexTag(vertexCount, U32_MAX, u32Allocator); // Last meshlet that referenced the vertex.
+    ArenaVector_t<u32> reordered(u32Allocator);
+    reordered.reserve(indices.size());
+
+    u32 meshletVertices[MESHLET_MAX_VERTICES];
+    u32 meshletVertexCount = 0;
+    u32 meshletTriangleCount = 0;
+    u32 meshletId = 0;
+    u32 seed = 0;
+    u32 emittedCount = 0;
+
+    auto newVertexCount = [&](u32 triangle) {
+        u32 count = 0;
+        for (u32 k = 0; k < 3; k++) {
+            count += vertexTag[indices[3 * triangle + k]] != meshletId ? 1 : 0;
+        }
+        return count;
+    };
+
+    auto addTriangle = [&](u32 triangle) {
+        for (u32 k = 0; k < 3; k++) {
+            u32 v = indices[3 * triangle + k];
+            if (vertexTag[v] != meshletId) {
+                vertexTag[v] = meshletId;
+                meshletVertices[meshletVertexCount++] = v;
+            }
+            reordered.push_back(v);
+        }
+        emitted[triangle] = 1;
+        emittedCount += 1;
+        meshletTriangleCount += 1;
+    };
+
+    while (emittedCount < triangleCount) {
+        u32 firstIndex = (u32) reordered.size();
+        meshletVertexCount = 0;
+        meshletTriangleCount = 0;
+
+        while (emitted[seed]) seed++;
+        addTriangle(seed);
+
+        // Grow the cluster greedily, always taking the neighbouring triangle that adds the fewest
+        // new vertices. This keeps clusters compact, which in turn keeps bounds and cones tight.
+        while (meshletTriangleCount < MESHLET_MAX_TRIANGLES) {
+            u32 best = U32_MAX;
+            u32 bestNew = 4;
+            for (u32 i = 0; i < meshletVertexCount && bestNew > 0; i++) {
+                u32 v = meshletVertices[i];
+                for (u32 a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++) {
+                    u32 triangle = adjacency[a];
+                    if (emitted[triangle]) continue;
+                    u32 count = newVertexCount(triangle);
+                    if (count < bestNew) {
+                        best = triangle;
+                        bestNew = count;
+                        if (count == 0) break;
+                    }
+                }
+            }
+
+            if (best == U32_MAX) {
+                // Nothing connected is left, continue with the next unused triangle in index order.
+                if (emittedCount == triangleCount) break;
+                while (emitted[seed]) seed++;
+                best = seed;
+                bestNew = newVertexCount(best);
+            }
+
+            if (meshletVertexCount + bestNew > MESHLET_MAX_VERTICES) break;
+
+            addTriangle(best);
+        }
+
+        Meshlet_t meshlet = {};
+        meshlet.firstIndex = firstIndex;
+        meshlet.indexCount = meshletTriangleCount * 3;
+        computeMeshletBounds(meshlet, vertices, reordered.data() + firstIndex);
+        meshlets.push_back(meshlet);
+
+        meshletId += 1;
+    }
+
+    // Same size as the input, so this copies in place instead of reallocating.
+    indices.assign(reordered.begin(), reordered.end());
+}
+
+glm::vec4 computeBoundingSphere(const std::vector<Vertex_t> &vertices) {
+    glm::vec3 minPos = glm::vec3(FLT_MAX);
+    glm::vec3 maxPos = glm::vec3(-FLT_MAX);
+    for (const Vertex_t &vertex : vertices) {
+        minPos = glm::min(minPos, vertex.pos);
+        maxPos = glm::max(maxPos, vertex.pos);
+    }
+
+    glm::vec3 center = 0.5f * (minPos + maxPos);
+    f32 radius = 0.0f;
+    for (const Vertex_t &vertex : vertices) {
+        radius = glm::max(radius, glm::length(vertex.pos - center));
+    }
+
+    return glm::vec4(center, radius);
+}
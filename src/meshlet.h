@@ -0,0 +1,26 @@
+#pragma once
+
+#include "typedefs.h"
+#include "vertex_type.h"
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// GPU visible cluster description, matches the Meshlet struct in cluster_cull.comp.glsl (std430).
+struct Meshlet_t {
+    glm::vec4 boundingSphere; // xyz = object space center, w = radius
+    glm::vec4 cone;           // xyz = average triangle normal, w = cutoff (1.0 means never backface cull)
+
+    u32 firstIndex;   // Into the mesh index list at build time, into the static index buffer once uploaded.
+    u32 indexCount;
+    i32 vertexOffset; // firstVertex of the owning mesh in the static vertex buffer.
+    u32 objectIndex;  // Which per-object transform the cluster uses.
+};
+
+// Splits the triangle list into clusters of at most MESHLET_MAX_VERTICES unique vertices and
+// MESHLET_MAX_TRIANGLES triangles. The index list is reordered in place so that every meshlet
+// is a contiguous index range, which means the mesh can still be drawn as a whole.
+void buildMeshlets(const std::vector<Vertex_t> &vertices, std::vector<u32> &indices,
+                   std::vector<Meshlet_t> &meshlets);
+
+glm::vec4 computeBoundingSphere(const std::vector<Vertex_t> &vertices);
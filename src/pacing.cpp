@@ -0,0 +1,111 @@
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+#include "anton_asserts.h"
+#include "pacing.h"
+
+// Weight of a new frame in the latency averages.
+#define LATENCY_SMOOTHING 0.05
+
+static f64 g_stamps[LatencyStamp_Count];
+static LatencyStats_t g_latency = {};
+static LatencyStats_t g_lastFrame = {};
+static bool g_latencyValid = false;
+
+void initFramePacing() {
+#ifdef _WIN32
+    // Sleeps round up to the 15.6 ms default tick otherwise.
+    timeBeginPeriod(1);
+#endif
+}
+
+void shutdownFramePacing() {
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+}
+
+f64 pacingClock() {
+    using namespace std::chrono;
+    return duration<f64>(steady_clock::now().time_since_epoch()).count();
+}
+
+void setTargetFps(FramePacer_t &pacer, u32 fps) {
+    pacer.frameSeconds = fps > 0 ? 1.0 / fps : 0.0;
+    pacer.nextFrameTime = 0.0;
+}
+
+void waitForNextFrame(FramePacer_t &pacer) {
+    if (pacer.frameSeconds == 0.0) return;
+
+    f64 now = pacingClock();
+    if (pacer.nextFrameTime == 0.0 || now - pacer.nextFrameTime > pacer.frameSeconds) {
+        pacer.nextFrameTime = now + pacer.frameSeconds;
+        return;
+    }
+
+    const f64 spinSeconds = PACING_SPIN_MS * 1e-3;
+    while (pacer.nextFrameTime - now > spinSeconds) {
+        f64 sleepSeconds = pacer.nextFrameTime - now - spinSeconds;
+        std::this_thread::sleep_for(std::chrono::duration<f64>(sleepSeconds));
+        now = pacingClock();
+    }
+    while (now < pacer.nextFrameTime) {
+        std::this_thread::yield();
+        now = pacingClock();
+    }
+
+    // Scheduled from the target rather than from now so the error does not accumulate.
+    pacer.nextFrameTime += pacer.frameSeconds;
+}
+
+void stampLatency(LatencyStamp_t stamp) {
+    ASSERT(stamp < LatencyStamp_Count);
+    if (stamp == LatencyStamp_Input) {
+        for (u32 i = 0; i < LatencyStamp_Count; i++) {
+            g_stamps[i] = 0.0;
+        }
+    }
+    g_stamps[stamp] = pacingClock();
+}
+
+void finishLatencyFrame() {
+    for (u32 i = 0; i < LatencyStamp_Count; i++) {
+        if (g_stamps[i] == 0.0) return;
+    }
+
+    f64 input = g_stamps[LatencyStamp_Input];
+    LatencyStats_t frame;
+    frame.toSubmitMs = (g_stamps[LatencyStamp_Submit] - input) * 1e3;
+    frame.toPresentMs = (g_stamps[LatencyStamp_Present] - input) * 1e3;
+    frame.toGpuDoneMs = (g_stamps[LatencyStamp_GpuDone] - input) * 1e3;
+    g_lastFrame = frame;
+
+    if (!g_latencyValid) {
+        g_latency = frame;
+        g_latencyValid = true;
+    } else {
+        g_latency.toSubmitMs += (frame.toSubmitMs - g_latency.toSubmitMs) * LATENCY_SMOOTHING;
+        g_latency.toPresentMs += (frame.toPresentMs - g_latency.toPresentMs) * LATENCY_SMOOTHING;
+        g_latency.toGpuDoneMs += (frame.toGpuDoneMs - g_latency.toGpuDoneMs) * LATENCY_SMOOTHING;
+    }
+
+    for (u32 i = 0; i < LatencyStamp_Count; i++) {
+        g_stamps[i] = 0.0;
+    }
+}
+
+LatencyStats_t getLatencyStats() {
+    return g_latency;
+}
+
+LatencyStats_t getLastFrameLatency() {
+    return g_lastFrame;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "typedefs.h"
+
+// Frame pacing and latency measurement. The limiter caps the frame rate on top of whatever the
+// present mode does, waiting before input is sampled so that the wait does not add to latency.
+
+// Frames per second the limiter aims for, 0 leaves pacing to the present mode.
+#ifndef TARGET_FPS
+#define TARGET_FPS 0
+#endif
+
+// The last part of a wait is spun instead of slept. Sleeps overshoot by up to a scheduler tick,
+// spinning the end keeps the frame start within microseconds of the target.
+#ifndef PACING_SPIN_MS
+#define PACING_SPIN_MS 2.0
+#endif
+
+struct FramePacer_t {
+    f64 frameSeconds = 0.0; // 0 when off
+    f64 nextFrameTime = 0.0;
+};
+
+// Points in a frame, from the input being sampled to the GPU finishing the frame. The present is
+// only queued at LatencyStamp_Present, scanout follows one or more refreshes later depending on the
+// present mode, so the measured latency is a lower bound of input to photon.
+enum LatencyStamp_t : u32 {
+    LatencyStamp_Input,
+    LatencyStamp_Submit,
+    LatencyStamp_Present,
+    LatencyStamp_GpuDone,
+    LatencyStamp_Count
+};
+
+// Averages over recent frames, in milliseconds from the input stamp.
+struct LatencyStats_t {
+    f64 toSubmitMs;
+    f64 toPresentMs;
+    f64 toGpuDoneMs;
+};
+
+// Raises the timer resolution where the default makes sleeps too coarse for pacing.
+void initFramePacing();
+void shutdownFramePacing();
+
+// Seconds from a monotonic clock.
+f64 pacingClock();
+
+void setTargetFps(FramePacer_t &pacer, u32 fps);
+
+// Returns at the start of the next frame slot. A pacer that fell more than a frame behind, after
+// a stall or a minimized window, starts over from now instead of rushing frames to catch up.
+void waitForNextFrame(FramePacer_t &pacer);
+
+// The input stamp starts a new frame and clears the others.
+void stampLatency(LatencyStamp_t stamp);
+
+// Folds the stamps of the finished frame into the averages, frames missing a stamp are skipped.
+void finishLatencyFrame();
+LatencyStats_t getLatencyStats();
+
+// The last finished frame on its own, without the averaging.
+LatencyStats_t getLastFrameLatency();
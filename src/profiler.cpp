@@ -0,0 +1,222 @@
+#include <chrono>
+#include <cstdio>
+
+#include "anton_asserts.h"
+#include "jobs.h"
+#include "logger.h"
+#include "profiler.h"
+
+#define PROFILER_GPU_TRACK 1000 // Trace thread id of the GPU track
+
+struct ProfileEvent_t {
+    const char *name;
+    u64 start;
+    u64 end;
+};
+
+// Written only by the thread owning it. The exporter reads count events once the capture has
+// stopped, count is published after the event so it never sees a half written one.
+struct ProfilerThread_t {
+    char name[32];
+    std::atomic<u32> generation; // Capture the events belong to, older ones are thrown away on first use
+    std::atomic<u32> count;
+    u32 dropped;
+    ProfileEvent_t *events;
+};
+
+struct ProfilerGpuEvent_t {
+    const char *name;
+    u64 gpuStart;
+    u64 gpuEnd;
+    u64 cpuDone;
+};
+
+std::atomic<bool> g_profilerCapturing{false};
+
+static ProfilerThread_t *g_threads = nullptr;
+static std::atomic<u32> g_threadCount{0};
+static std::atomic<u32> g_generation{0};
+static std::atomic<u32> g_droppedThreads{0}; // Zones from threads past PROFILER_MAX_THREADS
+
+static ProfilerGpuEvent_t g_gpuEvents[PROFILER_GPU_EVENTS];
+static u32 g_gpuEventCount = 0;
+
+static u64 g_captureStart = 0;
+static u32 g_captureFrames = 0;
+static u32 g_framesLeft = 0;
+
+static thread_local ProfilerThread_t *t_thread = nullptr;
+static thread_local bool t_overflowed = false;
+static thread_local const char *t_threadName = nullptr;
+
+u64 profilerNow() {
+    using namespace std::chrono;
+    return (u64) duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static
+void nameThread(ProfilerThread_t &thread, u32 slot) {
+    u32 worker = getJobWorkerIndex();
+    if (t_threadName) {
+        snprintf(thread.name, sizeof(thread.name), "%s", t_threadName);
+    } else if (worker == 0) {
+        snprintf(thread.name, sizeof(thread.name), "main");
+    } else if (worker != U32_MAX) {
+        snprintf(thread.name, sizeof(thread.name), "worker %u", worker);
+    } else {
+        snprintf(thread.name, sizeof(thread.name), "thread %u", slot);
+    }
+}
+
+void profilerSetThreadName(const char *name) {
+    t_threadName = name;
+    if (t_thread) nameThread(*t_thread, 0);
+}
+
+void profilerStartCapture(u32 frameCount) {
+    if (g_profilerCapturing.load(std::memory_order_relaxed)) return;
+
+    if (!g_threads) {
+        g_threads = new ProfilerThread_t[PROFILER_MAX_THREADS];
+        for (u32 i = 0; i < PROFILER_MAX_THREADS; i++) {
+            g_threads[i].generation.store(0, std::memory_order_relaxed);
+            g_threads[i].count.store(0, std::memory_order_relaxed);
+            g_threads[i].events = new ProfileEvent_t[PROFILER_EVENTS_PER_THREAD];
+        }
+    }
+
+    g_generation.fetch_add(1, std::memory_order_relaxed);
+    g_droppedThreads.store(0, std::memory_order_relaxed);
+    g_gpuEventCount = 0;
+    g_captureStart = profilerNow();
+    g_captureFrames = frameCount;
+    g_framesLeft = frameCount;
+    g_profilerCapturing.store(true, std::memory_order_release);
+    Logger::Log("Capturing a trace of %i frames", frameCount);
+}
+
+bool profilerCapturing() {
+    return g_profilerCapturing.load(std::memory_order_relaxed);
+}
+
+void profilerRecordZone(const char *name, u64 start, u64 end) {
+    if (!g_profilerCapturing.load(std::memory_order_acquire)) return;
+
+    if (!t_thread) {
+        if (t_overflowed) return;
+        u32 slot = g_threadCount.fetch_add(1, std::memory_order_relaxed);
+        if (slot >= PROFILER_MAX_THREADS) {
+            t_overflowed = true;
+            g_droppedThreads.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        t_thread = &g_threads[slot];
+        nameThread(*t_thread, slot);
+    }
+
+    ProfilerThread_t &thread = *t_thread;
+    u32 generation = g_generation.load(std::memory_order_relaxed);
+    if (thread.generation.load(std::memory_order_relaxed) != generation) {
+        thread.count.store(0, std::memory_order_relaxed);
+        thread.dropped = 0;
+        thread.generation.store(generation, std::memory_order_release);
+    }
+
+    u32 count = thread.count.load(std::memory_order_relaxed);
+    if (count == PROFILER_EVENTS_PER_THREAD) {
+        thread.dropped++;
+        return;
+    }
+    thread.events[count] = {name, start, end};
+    thread.count.store(count + 1, std::memory_order_release);
+}
+
+void profilerRecordGpu(const char *name, u64 gpuStart, u64 gpuEnd, u64 cpuDone) {
+    if (!g_profilerCapturing.load(std::memory_order_relaxed) || g_gpuEventCount == PROFILER_GPU_EVENTS) return;
+    g_gpuEvents[g_gpuEventCount++] = {name, gpuStart, gpuEnd, cpuDone};
+}
+
+static
+void writeEvent(FILE *file, bool &first, const char *name, u32 tid, f64 startUs, f64 durationUs) {
+    fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            first ? "" : ",", name, tid, startUs, durationUs);
+    first = false;
+}
+
+static
+void writeThreadName(FILE *file, bool &first, const char *name, u32 tid) {
+    fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",", tid, name);
+    first = false;
+}
+
+// Timestamps are in microseconds from the start of the capture.
+static
+bool writeTrace(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) return false;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    u32 generation = g_generation.load(std::memory_order_relaxed);
+    u32 threadCount = g_threadCount.load(std::memory_order_relaxed);
+    if (threadCount > PROFILER_MAX_THREADS) threadCount = PROFILER_MAX_THREADS;
+
+    u64 dropped = 0;
+    u64 eventCount = 0;
+    for (u32 i = 0; i < threadCount; i++) {
+        ProfilerThread_t &thread = g_threads[i];
+        if (thread.generation.load(std::memory_order_acquire) != generation) continue; // Nothing this capture
+        u32 count = thread.count.load(std::memory_order_acquire);
+        writeThreadName(file, first, thread.name, i + 1);
+        for (u32 e = 0; e < count; e++) {
+            const ProfileEvent_t &event = thread.events[e];
+            if (event.start < g_captureStart) continue; // Zone opened before the capture
+            writeEvent(file, first, event.name, i + 1, (event.start - g_captureStart) * 1e-3,
+                       (event.end - event.start) * 1e-3);
+        }
+        eventCount += count;
+        dropped += thread.dropped;
+    }
+
+    // The GPU finished each span before the CPU saw it, so the tightest offset between the clocks is
+    // the smallest gap between a GPU end and the CPU noticing.
+    if (g_gpuEventCount > 0) {
+        i64 offset = INT64_MAX;
+        for (u32 i = 0; i < g_gpuEventCount; i++) {
+            i64 gap = (i64) g_gpuEvents[i].cpuDone - (i64) g_gpuEvents[i].gpuEnd;
+            if (gap < offset) offset = gap;
+        }
+        writeThreadName(file, first, "gpu", PROFILER_GPU_TRACK);
+        for (u32 i = 0; i < g_gpuEventCount; i++) {
+            const ProfilerGpuEvent_t &event = g_gpuEvents[i];
+            i64 start = (i64) event.gpuStart + offset - (i64) g_captureStart;
+            writeEvent(file, first, event.name, PROFILER_GPU_TRACK, start * 1e-3,
+                       (event.gpuEnd - event.gpuStart) * 1e-3);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    bool ok = ferror(file) == 0;
+    fclose(file);
+
+    Logger::Log("Trace of %i frames written to %s: %i zones on %i threads, %i GPU spans", g_captureFrames, path,
+                (u32) eventCount, threadCount, g_gpuEventCount);
+    if (dropped > 0 || g_droppedThreads.load(std::memory_order_relaxed) > 0) {
+        Logger::Warn("Trace dropped %i zones and %i threads, raise PROFILER_EVENTS_PER_THREAD or "
+                     "PROFILER_MAX_THREADS", (u32) dropped, g_droppedThreads.load(std::memory_order_relaxed));
+    }
+    return ok;
+}
+
+void profilerFrameEnd() {
+    if (!g_profilerCapturing.load(std::memory_order_relaxed)) return;
+    if (g_framesLeft > 0) g_framesLeft--;
+    if (g_framesLeft > 0) return;
+
+    // Zones still open on other threads see the flag and are not recorded.
+    g_profilerCapturing.store(false, std::memory_order_release);
+    if (!writeTrace(PROFILER_TRACE_PATH)) {
+        Logger::Error("Could not write the trace to %s", PROFILER_TRACE_PATH);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+
+#include "typedefs.h"
+
+// Scoped CPU zones, captured for a number of frames and written as Chrome trace JSON, which
+// chrome://tracing and ui.perfetto.dev open as one timeline per thread. Every thread records into
+// its own buffer, nothing is shared while recording. Outside a capture a zone is one relaxed load,
+// and with PROFILER 0 the macros compile to nothing.
+//
+// GPU frame times from the timestamp queries go on a track of their own, moved onto the CPU clock
+// by the earliest the CPU saw a frame finish.
+
+#ifndef PROFILER
+#define PROFILER 1
+#endif
+
+#define PROFILER_MAX_THREADS 32
+#define PROFILER_EVENTS_PER_THREAD (32 * 1024) // Later zones are dropped and counted
+#define PROFILER_GPU_EVENTS 1024
+#define PROFILER_CAPTURE_FRAMES 120
+#define PROFILER_TRACE_PATH "trace.json"
+
+extern std::atomic<bool> g_profilerCapturing;
+
+// Nanoseconds on steady_clock. Not RDTSC, that would need calibrating against a clock anyway and
+// steady_clock is a few tens of nanoseconds on the platforms this runs on.
+u64 profilerNow();
+
+// Zones on the calling thread show under this name. Job workers are named after their index.
+void profilerSetThreadName(const char *name);
+
+// Starts recording on every thread, the trace is written once frameCount frames have ended. The
+// buffers are allocated by the first capture.
+void profilerStartCapture(u32 frameCount);
+bool profilerCapturing();
+
+// Counts a frame towards the capture and writes the trace when it is complete.
+void profilerFrameEnd();
+
+// name has to outlive the capture, string literals in practice.
+void profilerRecordZone(const char *name, u64 start, u64 end);
+
+// A span of GPU work in nanoseconds on the GPU clock, and when the CPU saw it done.
+void profilerRecordGpu(const char *name, u64 gpuStart, u64 gpuEnd, u64 cpuDone);
+
+struct ProfileZone_t {
+    const char *name;
+    u64 start;
+
+    ProfileZone_t(const char *zoneName) : name(zoneName) {
+        start = g_profilerCapturing.load(std::memory_order_relaxed) ? profilerNow() : 0;
+    }
+    ~ProfileZone_t() {
+        if (start) profilerRecordZone(name, start, profilerNow());
+    }
+};
+
+#if PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileZone_t PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#endif
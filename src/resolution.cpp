@@ -0,0 +1,65 @@
+#include <cmath>
+
+#include "resolution.h"
+
+// Frames to wait after a change before the next one, the new cost needs to reach the average.
+#define RESOLUTION_SETTLE_FRAMES 8
+
+// Weight of a new sample in the GPU time average.
+#define RESOLUTION_SMOOTHING 0.1
+
+// Largest change of the scale in one step. Dropping is allowed to be faster than rising, a missed
+// frame is worse than a few frames at a lower resolution than needed.
+#define RESOLUTION_MAX_STEP_DOWN 0.15f
+#define RESOLUTION_MAX_STEP_UP 0.05f
+
+// Scale only goes up once the GPU time is below this fraction of the target. Together with going
+// down only when over the target this is the dead band that keeps the scale from oscillating.
+#define RESOLUTION_RAISE_THRESHOLD 0.85
+
+bool updateResolutionScale(ResolutionController_t &controller, f64 gpuMs) {
+    if (gpuMs <= 0.0) return false;
+
+    if (controller.smoothedMs == 0.0) {
+        controller.smoothedMs = gpuMs;
+    } else {
+        controller.smoothedMs += (gpuMs - controller.smoothedMs) * RESOLUTION_SMOOTHING;
+    }
+
+    controller.framesSinceChange += 1;
+    if (controller.framesSinceChange < RESOLUTION_SETTLE_FRAMES) return false;
+
+    f64 load = controller.smoothedMs / controller.targetMs;
+    bool overBudget = load > 1.0;
+    bool underBudget = load < RESOLUTION_RAISE_THRESHOLD;
+    if (!overBudget && !underBudget) return false;
+
+    // Fill cost goes with the pixel count, the square of the per axis scale.
+    f32 scale = controller.scale * (f32) sqrt(1.0 / load);
+    if (scale < controller.scale - RESOLUTION_MAX_STEP_DOWN) scale = controller.scale - RESOLUTION_MAX_STEP_DOWN;
+    if (scale > controller.scale + RESOLUTION_MAX_STEP_UP) scale = controller.scale + RESOLUTION_MAX_STEP_UP;
+    if (scale < DYNAMIC_RESOLUTION_MIN_SCALE) scale = DYNAMIC_RESOLUTION_MIN_SCALE;
+    if (scale > DYNAMIC_RESOLUTION_MAX_SCALE - 0.01f) scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+
+    if (fabsf(scale - controller.scale) < 0.01f) return false;
+
+    // Predict the new cost so the average does not drag the old resolution along for a while.
+    f64 ratio = (f64) scale / controller.scale;
+    controller.smoothedMs *= ratio * ratio;
+    controller.scale = scale;
+    controller.framesSinceChange = 0;
+    return true;
+}
+
+static
+u32 scaleDimension(u32 size, f32 scale) {
+    u32 scaled = ((u32) (size * scale + 4.0f)) & ~7u;
+    if (scaled < 8) scaled = 8;
+    return scaled < size ? scaled : size;
+}
+
+void scaledExtent(const ResolutionController_t &controller, u32 width, u32 height,
+                  u32 *scaledWidth, u32 *scaledHeight) {
+    *scaledWidth = scaleDimension(width, controller.scale);
+    *scaledHeight = scaleDimension(height, controller.scale);
+}
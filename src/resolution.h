@@ -0,0 +1,41 @@
+#pragma once
+
+#include "typedefs.h"
+
+// Render resolution as a fraction of the output size, steered by measured GPU frame time. The
+// render targets are allocated once at full size and the scene is drawn into a scaled viewport,
+// so changing the scale never reallocates anything.
+
+#ifndef DYNAMIC_RESOLUTION
+#define DYNAMIC_RESOLUTION 1
+#endif
+
+// GPU time the controller aims for. Leaves some headroom under a 60 Hz frame for the CPU side
+// and the present.
+#ifndef DYNAMIC_RESOLUTION_TARGET_MS
+#define DYNAMIC_RESOLUTION_TARGET_MS 14.0
+#endif
+
+#ifndef DYNAMIC_RESOLUTION_MIN_SCALE
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#endif
+
+#ifndef DYNAMIC_RESOLUTION_MAX_SCALE
+#define DYNAMIC_RESOLUTION_MAX_SCALE 1.0f
+#endif
+
+struct ResolutionController_t {
+    f32 scale = DYNAMIC_RESOLUTION_MAX_SCALE; // Per axis
+    f64 targetMs = DYNAMIC_RESOLUTION_TARGET_MS;
+    f64 smoothedMs = 0.0; // Exponential average of the GPU time, zero until the first sample
+    u32 framesSinceChange = 0;
+};
+
+// Feeds one GPU frame time and returns true if the scale changed. The time is averaged and the
+// scale only moves once the average is outside a dead band around the target, with a few frames
+// between changes so a change has shown up in the measurements before the next one.
+bool updateResolutionScale(ResolutionController_t &controller, f64 gpuMs);
+
+// Scaled size, rounded to a multiple of 8 and never larger than the output.
+void scaledExtent(const ResolutionController_t &controller, u32 width, u32 height,
+                  u32 *scaledWidth, u32 *scaledHeight);
@@ -1,85 +1,69 @@
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "../external/tiny_obj_loader.h"
-
+#include "cooked.h"
+#include "jobs.h"
+#include "profiler.h"
 #include "scene.h"
 
-static
-void loadObj(std::string ModelPath, Mesh_t* mmModel) {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-
-    Logger::Trace("Loading obj model from path %s", ModelPath.c_str());
+struct MeshLoad_t {
+    const char *name; // In the cooked asset manifest
+    Mesh_t mesh;
+    bool loaded;
+};
 
-    if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, ModelPath.c_str())) {
-        Logger::Fatal("tinyobj::LoadObj failed!");
+static
+void loadMeshJob(void *data, u32 begin, u32 end) {
+    PROFILE_ZONE("load cooked mesh");
+    MeshLoad_t *loads = (MeshLoad_t *) data;
+    for (u32 i = begin; i < end; i++) {
+        const char *path = findCookedAsset(CookedAsset_Mesh, loads[i].name);
+        loads[i].loaded = path && loadCookedMesh(path, loads[i].mesh);
     }
+}
 
-    std::unordered_map<Vertex_t, size_t> unique_vertices;
-
-    for (const auto& shape: shapes) {
-        for (const auto& index : shape.mesh.indices) {
-            Vertex_t vertex = {};
-
-            vertex.pos = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            vertex.normal = {
-                    attrib.normals[3 * index.normal_index + 0],
-                    attrib.normals[3 * index.normal_index + 1],
-                    attrib.normals[3 * index.normal_index + 2]
-            };
-
-            if(unique_vertices.count(vertex) == 0) {
-                unique_vertices[vertex] = (u32)mmModel->vertices.size();
-                mmModel->vertices.push_back(vertex);
-            }
-
-            mmModel->indices.push_back((u32)unique_vertices[vertex]);
+void setupScene(std::vector<Mesh_t> &meshList, TransformHierarchy_t &transforms, VPmatrices_t &vpMats,
+                u32 width, u32 height) {
+    PROFILE_FUNCTION();
+
+    // Cooked by anton_cook, parsing and meshlet building happen there. Loading is plain reads, one
+    // job per model still overlaps them.
+    MeshLoad_t loads[] = {
+            {"coords2_soft"},
+            {"cube"},
+            {"bunny_soft"},
+    };
+    u32 loadCount = (u32) (sizeof(loads) / sizeof(loads[0]));
+    parallelFor(loadCount, 1, loadMeshJob, loads);
+    for (u32 i = 0; i < loadCount; i++) {
+        if (!loads[i].loaded) {
+            Logger::Fatal("Mesh %s is not cooked, run anton_cook", loads[i].name);
         }
+        Logger::Trace("Mesh %s: %i vertices, %i indices, %i meshlets, %i submeshes", loads[i].name,
+                      (u32) loads[i].mesh.vertices.size(), loads[i].mesh.indexCount,
+                      (u32) loads[i].mesh.meshlets.size(), (u32) loads[i].mesh.submeshes.size());
     }
 
-
-    Logger::Trace("Number of vertices: %i", (u32)mmModel->vertices.size());
-    Logger::Trace("Number of indices: %i", (u32)mmModel->indices.size());
-    mmModel->indexCount = (u32)mmModel->indices.size();
-}
-
-void setupScene(std::vector<Mesh_t> &meshList, VPmatrices_t &vpMats, u32 width, u32 height) {
-
     {
-        Mesh_t mesh1;
-        loadObj("../../assets/coords2_soft.obj", &mesh1);
-
-        mesh1.modelMatrix = glm::mat4(1.0f);
-        meshList.push_back(mesh1);
+        Mesh_t mesh1 = std::move(loads[0].mesh);
 
         mesh1.isStatic = true;
+        mesh1.transformIndex = addTransform(transforms, U32_MAX, glm::mat4(1.0f));
+        meshList.push_back(mesh1);
     }
 
     {
-        Mesh_t mesh2;
-        loadObj("../../assets/cube.obj", &mesh2);
+        Mesh_t mesh2 = std::move(loads[1].mesh);
 
-        mesh2.modelMatrix = glm::mat4(1.0f);
+        // Spun by simulateStep, so not static.
+        mesh2.transformIndex = addTransform(transforms, U32_MAX, glm::mat4(1.0f));
         meshList.push_back(mesh2);
-
-        mesh2.isStatic = true;
     }
 
     {
-        Mesh_t mesh3;
-        loadObj("../../assets/bunny_soft.obj", &mesh3);
-
-        mesh3.modelMatrix = glm::mat4(1.0f);
-        mesh3.modelMatrix = glm::translate(mesh3.modelMatrix, glm::vec3(-2.0f, 0.0f, 0.0f));
-        meshList.push_back(mesh3);
+        Mesh_t mesh3 = std::move(loads[2].mesh);
 
         mesh3.isStatic = true;
+        glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(-2.0f, 0.0f, 0.0f));
+        mesh3.transformIndex = addTransform(transforms, U32_MAX, modelMatrix);
+        meshList.push_back(mesh3);
     }
 
     {
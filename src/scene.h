@@ -2,4 +2,5 @@
 
 #include "common.h"
 
-void setupScene(std::vector<Mesh_t> &meshList, VPmatrices_t &vpMats, u32 width, u32 height);
\ No newline at end of file
+void setupScene(std::vector<Mesh_t> &meshList, TransformHierarchy_t &transforms, VPmatrices_t &vpMats,
+                u32 width, u32 height);
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include <chrono>
+
+#include "arena.h"
+#include "profiler.h"
+#include "sim.h"
+
+#define SNAPSHOT_SLOT_MASK 0x3
+#define SNAPSHOT_FRESH_BIT 0x4
+
+SceneSnapshot_t &beginSnapshot(SnapshotBuffer_t &buffer) {
+    return buffer.slots[buffer.writeSlot];
+}
+
+void publishSnapshot(SnapshotBuffer_t &buffer) {
+    // Release makes the snapshot contents visible to the reader, acquire makes sure the reader is
+    // done with the slot we get back before we start writing into it.
+    u32 previous = buffer.shared.exchange(buffer.writeSlot | SNAPSHOT_FRESH_BIT, std::memory_order_acq_rel);
+    buffer.writeSlot = previous & SNAPSHOT_SLOT_MASK;
+}
+
+bool acquireSnapshot(SnapshotBuffer_t &buffer, SceneSnapshot_t &previous) {
+    if (!(buffer.shared.load(std::memory_order_relaxed) & SNAPSHOT_FRESH_BIT)) {
+        return false;
+    }
+
+    // The slot we are about to give away is still ours, so its contents can be moved out first.
+    std::swap(previous, buffer.slots[buffer.readSlot]);
+
+    u32 shared = buffer.shared.exchange(buffer.readSlot, std::memory_order_acq_rel);
+    buffer.readSlot = shared & SNAPSHOT_SLOT_MASK;
+    return true;
+}
+
+const SceneSnapshot_t &currentSnapshot(const SnapshotBuffer_t &buffer) {
+    return buffer.slots[buffer.readSlot];
+}
+
+f32 snapshotAlpha(const SceneSnapshot_t &previous, const SceneSnapshot_t &current, f64 renderTime) {
+    f64 span = current.time - previous.time;
+    if (span <= 0.0) return 1.0f;
+
+    f64 alpha = (renderTime - previous.time) / span;
+    if (alpha < 0.0) alpha = 0.0;
+    if (alpha > 1.0) alpha = 1.0;
+    return (f32) alpha;
+}
+
+f64 simulationClock() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::duration<f64> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static
+void publishStep(Simulation_t &sim, u64 step, f64 time) {
+    SceneSnapshot_t &snapshot = beginSnapshot(sim.snapshots);
+    snapshot.step = step;
+    snapshot.time = time;
+    sim.publish(snapshot, sim.data);
+    publishSnapshot(sim.snapshots);
+}
+
+static
+void simulationMain(Simulation_t *sim) {
+    profilerSetThreadName("simulation");
+    u64 step = 0;
+    f64 simTime = simulationClock();
+
+    while (sim->running.load(std::memory_order_acquire)) {
+        f64 now = simulationClock();
+
+        u32 steps = 0;
+        while (simTime + SIM_STEP_SECONDS <= now && steps < SIM_MAX_STEPS_PER_TICK) {
+            sim->step(simTime, SIM_STEP_SECONDS, sim->data);
+            simTime += SIM_STEP_SECONDS;
+            step += 1;
+            steps += 1;
+        }
+
+        if (steps == SIM_MAX_STEPS_PER_TICK && simTime + SIM_STEP_SECONDS <= now) {
+            Logger::Warn("Simulation fell behind by %f s, skipping ahead", now - simTime);
+            simTime = now;
+        }
+
+        if (steps > 0) {
+            publishStep(*sim, step, simTime);
+            resetArena(getFrameArena());
+        }
+
+        f64 wait = simTime + SIM_STEP_SECONDS - simulationClock();
+        if (wait > 0.0) {
+            std::this_thread::sleep_for(std::chrono::duration<f64>(wait));
+        }
+    }
+}
+
+void startSimulation(Simulation_t &sim, SimStepFunction_t step, SimPublishFunction_t publish, void *data) {
+    ASSERT(!sim.running.load());
+    ASSERT(step != nullptr && publish != nullptr);
+
+    sim.step = step;
+    sim.publish = publish;
+    sim.data = data;
+
+    publishStep(sim, 0, simulationClock());
+
+    sim.running.store(true, std::memory_order_release);
+    sim.thread = std::thread(simulationMain, &sim);
+    Logger::Trace("Simulation thread started, step %f s", SIM_STEP_SECONDS);
+}
+
+void stopSimulation(Simulation_t &sim) {
+    if (!sim.running.load()) return;
+
+    sim.running.store(false, std::memory_order_release);
+    sim.thread.join();
+}
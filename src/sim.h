@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include "common.h"
+
+// Run the scene update on its own thread at a fixed timestep instead of once per rendered frame.
+#ifndef DECOUPLED_SIMULATION
+#define DECOUPLED_SIMULATION 1
+#endif
+
+#define SIM_STEP_SECONDS (1.0 / 60.0)
+// After a stall the simulation drops time instead of trying to catch up with a burst of steps.
+#define SIM_MAX_STEPS_PER_TICK 8
+
+// Everything the renderer needs from one simulation step. Only ever written by the simulation
+// thread while it owns the slot, and read only by the render thread once published.
+struct SceneSnapshot_t {
+    u64 step = 0;
+    f64 time = 0.0; // simulationClock() time the step ends at
+    VPmatrices_t camera;
+    std::vector<glm::mat4> world;
+    std::vector<glm::mat4> normal;
+};
+
+// Lock free triple buffer. The writer and reader each own one slot, the third is handed over
+// through shared, which also has a bit set while it holds a snapshot the reader has not seen.
+struct SnapshotBuffer_t {
+    SceneSnapshot_t slots[3];
+    std::atomic<u32> shared{1};
+    u32 writeSlot = 0;
+    u32 readSlot = 2;
+};
+
+SceneSnapshot_t &beginSnapshot(SnapshotBuffer_t &buffer);
+void publishSnapshot(SnapshotBuffer_t &buffer);
+
+// Takes the newest published snapshot if there is one. The snapshot it replaces is swapped into
+// previous so the render thread can interpolate between the two without copying.
+bool acquireSnapshot(SnapshotBuffer_t &buffer, SceneSnapshot_t &previous);
+const SceneSnapshot_t &currentSnapshot(const SnapshotBuffer_t &buffer);
+
+// How far between previous and current renderTime lies, clamped to [0, 1].
+f32 snapshotAlpha(const SceneSnapshot_t &previous, const SceneSnapshot_t &current, f64 renderTime);
+
+// Advances the scene by dt seconds.
+typedef void (*SimStepFunction_t)(f64 time, f64 dt, void *data);
+// Copies the scene state into a snapshot, step and time are filled in by the simulation.
+typedef void (*SimPublishFunction_t)(SceneSnapshot_t &snapshot, void *data);
+
+struct Simulation_t {
+    SnapshotBuffer_t snapshots;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    SimStepFunction_t step = nullptr;
+    SimPublishFunction_t publish = nullptr;
+    void *data = nullptr;
+};
+
+// Seconds on a monotonic clock shared by the simulation and render threads.
+f64 simulationClock();
+
+// Publishes an initial snapshot before the thread starts, so the renderer always has one.
+void startSimulation(Simulation_t &sim, SimStepFunction_t step, SimPublishFunction_t publish, void *data);
+void stopSimulation(Simulation_t &sim);
@@ -0,0 +1,52 @@
+#include <atomic>
+
+#include "jobs.h"
+#include "logger.h"
+#include "pacing.h"
+#include "startup.h"
+
+static f64 g_startSeconds = 0.0;
+static StartupStep_t g_steps[MAX_STARTUP_STEPS];
+static std::atomic<u32> g_stepCount{0};
+static f64 g_firstFrameMs = 0.0;
+
+static
+f64 startupMs() {
+    return (pacingClock() - g_startSeconds) * 1000.0;
+}
+
+void startStartupTimeline() {
+    g_startSeconds = pacingClock();
+    g_stepCount = 0;
+    g_firstFrameMs = 0.0;
+}
+
+u32 beginStartupStep(const char *name) {
+    u32 step = g_stepCount.fetch_add(1);
+    if (step >= MAX_STARTUP_STEPS) return U32_MAX;
+    g_steps[step] = {name, startupMs(), 0.0, getJobWorkerIndex()};
+    return step;
+}
+
+void endStartupStep(u32 step) {
+    if (step == U32_MAX) return;
+    g_steps[step].endMs = startupMs();
+}
+
+void markFirstFrame() {
+    if (g_firstFrameMs > 0.0) return;
+    g_firstFrameMs = startupMs();
+
+    u32 count = g_stepCount < MAX_STARTUP_STEPS ? (u32) g_stepCount : MAX_STARTUP_STEPS;
+    Logger::Log("Startup timeline, %i steps:", count);
+    for (u32 i = 0; i < count; i++) {
+        const StartupStep_t &step = g_steps[i];
+        Logger::Log("  %f - %f ms (%f ms) worker %i: %s", step.beginMs, step.endMs, step.endMs - step.beginMs,
+                    step.worker, step.name);
+    }
+    Logger::Log("Time to first frame: %f ms", g_firstFrameMs);
+}
+
+f64 timeToFirstFrameMs() {
+    return g_firstFrameMs;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "typedefs.h"
+
+// Startup timeline. Steps are timed from startStartupTimeline on whichever thread runs them, so the
+// steps that overlap show up as overlapping. markFirstFrame logs the timeline together with the
+// time to the first frame.
+
+#define MAX_STARTUP_STEPS 64
+
+struct StartupStep_t {
+    const char *name; // String literal
+    f64 beginMs;
+    f64 endMs;
+    u32 worker; // Job system worker that ran it, U32_MAX before the job system is up
+};
+
+void startStartupTimeline();
+
+// Returns the step for endStartupStep, steps past MAX_STARTUP_STEPS are not recorded.
+u32 beginStartupStep(const char *name);
+void endStartupStep(u32 step);
+
+// Once the first frame has been submitted, logs the timeline the first time it is called.
+void markFirstFrame();
+
+// 0 until markFirstFrame.
+f64 timeToFirstFrameMs();
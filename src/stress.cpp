@@ -0,0 +1,208 @@
+#include <cmath>
+
+#include "jobs.h"
+#include "stress.h"
+
+static const char *g_cameraPathNames[CameraPath_Count] = {"orbit", "flythrough", "static"};
+
+// Set by generateStressScene for the camera paths.
+static glm::vec3 g_sceneCenter = glm::vec3(0.0f);
+static f32 g_sceneRadius = 1.0f;
+
+struct StressMesh_t {
+    u32 seed;
+    u32 rings;
+    Mesh_t *mesh;
+};
+
+const char *cameraPathName(CameraPath_t path) {
+    ASSERT(path < CameraPath_Count);
+    return g_cameraPathNames[path];
+}
+
+static
+u32 nextRandom(u32 &state) {
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static
+f32 randomUnit(u32 &state) {
+    return (f32) (nextRandom(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+// A unit sphere with rings x 2 * rings quads, pushed in and out by a few random bumps so the
+// unique meshes do not all look alike.
+static
+void buildDisplacedSphere(Mesh_t &mesh, u32 rings, u32 seed) {
+    const f32 pi = 3.14159265f;
+    u32 segments = rings * 2;
+    u32 state = seed * 2654435761u + 1;
+
+    const u32 bumpCount = 4;
+    glm::vec3 bumpDirections[bumpCount];
+    f32 bumpFrequencies[bumpCount];
+    for (u32 i = 0; i < bumpCount; i++) {
+        bumpDirections[i] = glm::normalize(glm::vec3(randomUnit(state) - 0.5f, randomUnit(state) - 0.5f,
+                                                     randomUnit(state) - 0.5f) + glm::vec3(0.001f));
+        bumpFrequencies[i] = 2.0f + 6.0f * randomUnit(state);
+    }
+
+    mesh.vertices.resize((rings + 1) * (segments + 1));
+    for (u32 ring = 0; ring <= rings; ring++) {
+        f32 theta = pi * ring / rings;
+        for (u32 segment = 0; segment <= segments; segment++) {
+            f32 phi = 2.0f * pi * segment / segments;
+            glm::vec3 direction = glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            f32 radius = 1.0f;
+            for (u32 i = 0; i < bumpCount; i++) {
+                radius += 0.08f * sinf(bumpFrequencies[i] * glm::dot(direction, bumpDirections[i]));
+            }
+
+            Vertex_t &vertex = mesh.vertices[ring * (segments + 1) + segment];
+            vertex.pos = direction * radius;
+            vertex.normal = glm::vec3(0.0f);
+            vertex.texCoord = glm::vec2((f32) segment / segments, (f32) ring / rings);
+        }
+    }
+
+    mesh.indices.reserve(rings * segments * 6);
+    for (u32 ring = 0; ring < rings; ring++) {
+        for (u32 segment = 0; segment < segments; segment++) {
+            u32 a = ring * (segments + 1) + segment;
+            u32 b = a + segments + 1;
+            // The pole rows collapse into degenerate triangles, those are left out.
+            if (ring > 0) {
+                mesh.indices.push_back(a);
+                mesh.indices.push_back(a + 1);
+                mesh.indices.push_back(b);
+            }
+            if (ring < rings - 1) {
+                mesh.indices.push_back(a + 1);
+                mesh.indices.push_back(b + 1);
+                mesh.indices.push_back(b);
+            }
+        }
+    }
+
+    // Area weighted face normals, the displaced surface is not a sphere any more.
+    for (u32 i = 0; i < mesh.indices.size(); i += 3) {
+        Vertex_t &a = mesh.vertices[mesh.indices[i + 0]];
+        Vertex_t &b = mesh.vertices[mesh.indices[i + 1]];
+        Vertex_t &c = mesh.vertices[mesh.indices[i + 2]];
+        glm::vec3 n = glm::cross(b.pos - a.pos, c.pos - a.pos);
+        a.normal += n;
+        b.normal += n;
+        c.normal += n;
+    }
+    for (Vertex_t &vertex : mesh.vertices) {
+        f32 length = glm::length(vertex.normal);
+        vertex.normal = length > 0.0f ? vertex.normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    mesh.indexCount = (u32) mesh.indices.size();
+    buildMeshlets(mesh.vertices, mesh.indices, mesh.meshlets);
+    mesh.boundingSphere = computeBoundingSphere(mesh.vertices);
+}
+
+static
+void buildStressMeshJob(void *data, u32 begin, u32 end) {
+    StressMesh_t *meshes = (StressMesh_t *) data;
+    for (u32 i = begin; i < end; i++) {
+        buildDisplacedSphere(*meshes[i].mesh, meshes[i].rings, meshes[i].seed);
+    }
+}
+
+void generateStressScene(const StressSceneParams_t &params, std::vector<Mesh_t> &meshList,
+                         TransformHierarchy_t &transforms, VPmatrices_t &vpMats, u32 width, u32 height) {
+    u32 objectCount = params.objectCount;
+    if (objectCount < 1) objectCount = 1;
+    if (objectCount > STRESS_MAX_OBJECTS) objectCount = STRESS_MAX_OBJECTS;
+    f32 ratio = params.instancingRatio < 0.0f ? 0.0f : (params.instancingRatio > 1.0f ? 1.0f : params.instancingRatio);
+    u32 uniqueCount = (u32) ((f32) objectCount * (1.0f - ratio) + 0.5f);
+    if (uniqueCount < 1) uniqueCount = 1;
+    if (uniqueCount > objectCount) uniqueCount = objectCount;
+
+    // Two triangles per quad, 2 * rings^2 quads.
+    u32 rings = (u32) sqrtf((f32) params.trianglesPerMesh / 4.0f);
+    if (rings < 3) rings = 3;
+
+    u32 first = (u32) meshList.size();
+    meshList.resize(first + objectCount);
+
+    // The unique meshes are the first uniqueCount objects, each one is a job.
+    std::vector<StressMesh_t> builds(uniqueCount);
+    for (u32 i = 0; i < uniqueCount; i++) {
+        builds[i] = {params.seed + i, rings, &meshList[first + i]};
+    }
+    parallelFor(uniqueCount, 1, buildStressMeshJob, builds.data());
+
+    u32 state = params.seed * 747796405u + 2891336453u;
+    u32 gridSize = (u32) ceilf(cbrtf((f32) objectCount));
+    f32 extent = gridSize * STRESS_GRID_SPACING;
+    glm::vec3 gridOrigin = glm::vec3(-0.5f * extent);
+    for (u32 i = 0; i < objectCount; i++) {
+        Mesh_t &mesh = meshList[first + i];
+        if (i >= uniqueCount) {
+            mesh.sharedGeometry = first + nextRandom(state) % uniqueCount;
+            mesh.boundingSphere = meshList[mesh.sharedGeometry].boundingSphere;
+        }
+
+        glm::vec3 cell = glm::vec3((f32) (i % gridSize), (f32) ((i / gridSize) % gridSize),
+                                   (f32) (i / (gridSize * gridSize)));
+        glm::vec3 jitter = glm::vec3(randomUnit(state), randomUnit(state), randomUnit(state)) - glm::vec3(0.5f);
+        glm::vec3 position = gridOrigin + (cell + glm::vec3(0.5f) + 0.5f * jitter) * STRESS_GRID_SPACING;
+        f32 scale = 0.5f + 0.5f * randomUnit(state);
+        f32 angle = 6.28318531f * randomUnit(state);
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+        model = glm::rotate(model, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(scale));
+        mesh.transformIndex = addTransform(transforms, U32_MAX, model);
+
+        // From its own hash, the rest of the scene stays the same whatever the ratio.
+        u32 staticState = (first + i) * 2654435761u + params.seed + 1;
+        mesh.isStatic = randomUnit(staticState) < params.staticRatio;
+    }
+
+    g_sceneCenter = glm::vec3(0.0f);
+    g_sceneRadius = 0.87f * extent; // Half the diagonal of the grid cube
+
+    u64 triangles = 0;
+    for (u32 i = 0; i < uniqueCount; i++) triangles += meshList[first + i].indexCount / 3;
+    Logger::Log("Stress scene: %i objects, %i unique meshes of %i triangles, seed %i",
+                objectCount, uniqueCount, (u32) (triangles / uniqueCount), params.seed);
+
+    vpMats.view = stressCameraView(params.cameraPath, 0.0f);
+    vpMats.proj = glm::perspective(glm::radians(40.0f), (f32) width / (f32) height,
+                                   0.1f, 4.0f * g_sceneRadius + 256.0f);
+    vpMats.proj *= -1; // Same flip as setupScene
+}
+
+glm::mat4 stressCameraView(CameraPath_t path, f32 t) {
+    const f32 twoPi = 6.28318531f;
+    glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+    f32 distance = 1.5f * g_sceneRadius + 4.0f;
+
+    switch (path) {
+        case CameraPath_Orbit: {
+            f32 angle = twoPi * t;
+            glm::vec3 eye = g_sceneCenter + glm::vec3(distance * cosf(angle), 0.3f * distance, distance * sinf(angle));
+            return glm::lookAt(eye, g_sceneCenter, up);
+        }
+        case CameraPath_Flythrough: {
+            // Diagonal through the grid, slightly off the cell centers so it does not fly into objects.
+            glm::vec3 start = g_sceneCenter + glm::vec3(-distance, 0.3f, -distance);
+            glm::vec3 end = g_sceneCenter + glm::vec3(distance, 0.3f, distance);
+            glm::vec3 eye = glm::mix(start, end, t);
+            return glm::lookAt(eye, eye + (end - start), up);
+        }
+        default: {
+            glm::vec3 eye = g_sceneCenter + glm::vec3(distance, 0.5f * distance, distance);
+            return glm::lookAt(eye, g_sceneCenter, up);
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "common.h"
+
+// Procedural stress scenes for the benchmark mode. Objects sit on a jittered grid, the unique
+// meshes are displaced spheres and the rest of the objects draw one of them through
+// Mesh_t::sharedGeometry. Everything comes from the seed, the same parameters give the same scene.
+
+#define STRESS_MAX_OBJECTS (1024 * 1024)
+#define STRESS_GRID_SPACING 3.0f
+
+enum CameraPath_t : u32 {
+    CameraPath_Orbit, // Circles the scene from outside
+    CameraPath_Flythrough, // Straight through the middle of the grid
+    CameraPath_Static,
+    CameraPath_Count
+};
+
+struct StressSceneParams_t {
+    u32 objectCount = 1000;
+    u32 trianglesPerMesh = 1000; // Roughly, the sphere rounds to whole rings
+    f32 instancingRatio = 0.9f; // Fraction of objects that share another object's mesh
+    f32 staticRatio = 0.0f; // Fraction of objects marked static, merged when STATIC_BATCHING is on
+    CameraPath_t cameraPath = CameraPath_Orbit;
+    u32 seed = 1;
+};
+
+const char *cameraPathName(CameraPath_t path);
+
+// Fills meshList and transforms the way setupScene does, with the camera at the start of the path.
+void generateStressScene(const StressSceneParams_t &params, std::vector<Mesh_t> &meshList,
+                         TransformHierarchy_t &transforms, VPmatrices_t &vpMats, u32 width, u32 height);
+
+// Camera at t in [0, 1] along the path around the last generated scene.
+glm::mat4 stressCameraView(CameraPath_t path, f32 t);
@@ -0,0 +1,163 @@
+#include <xmmintrin.h>
+
+#include "anton_asserts.h"
+#include "jobs.h"
+#include "transforms.h"
+
+// Levels smaller than this are cheaper to do inline than to hand out to the job system.
+#define TRANSFORM_PARALLEL_THRESHOLD 1024
+#define TRANSFORM_BATCH_SIZE 256
+
+u32 addTransform(TransformHierarchy_t &hierarchy, u32 parent, const glm::mat4 &local) {
+    u32 index = (u32) hierarchy.parent.size();
+    ASSERT_MSG(parent == U32_MAX || parent < index, "Parents must be added before their children");
+
+    hierarchy.parent.push_back(parent);
+    hierarchy.depth.push_back(parent == U32_MAX ? 0 : hierarchy.depth[parent] + 1);
+    hierarchy.local.push_back(local);
+    hierarchy.world.push_back(glm::mat4(1.0f));
+    hierarchy.normal.push_back(glm::mat4(1.0f));
+    hierarchy.dirty.push_back(1);
+
+    return index;
+}
+
+void setLocalTransform(TransformHierarchy_t &hierarchy, u32 index, const glm::mat4 &local) {
+    hierarchy.local[index] = local;
+    hierarchy.dirty[index] = 1;
+}
+
+void multiplyMatricesBatch(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        const f32 *ma = glm::value_ptr(a[i]);
+        const f32 *mb = glm::value_ptr(b[i]);
+        f32 *mo = (f32 *) &out[i];
+
+        __m128 a0 = _mm_loadu_ps(ma + 0);
+        __m128 a1 = _mm_loadu_ps(ma + 4);
+        __m128 a2 = _mm_loadu_ps(ma + 8);
+        __m128 a3 = _mm_loadu_ps(ma + 12);
+
+        // Column j of the result is a * column j of b.
+        for (u32 j = 0; j < 4; j++) {
+            __m128 col = _mm_mul_ps(a0, _mm_set1_ps(mb[4 * j + 0]));
+            col = _mm_add_ps(col, _mm_mul_ps(a1, _mm_set1_ps(mb[4 * j + 1])));
+            col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_set1_ps(mb[4 * j + 2])));
+            col = _mm_add_ps(col, _mm_mul_ps(a3, _mm_set1_ps(mb[4 * j + 3])));
+            _mm_storeu_ps(mo + 4 * j, col);
+        }
+    }
+}
+
+static
+glm::mat4 computeNormalMatrix(const glm::mat4 &world) {
+    glm::vec3 c0 = glm::vec3(world[0]);
+    glm::vec3 c1 = glm::vec3(world[1]);
+    glm::vec3 c2 = glm::vec3(world[2]);
+
+    // The columns of the inverse transpose are the cofactor columns divided by the determinant.
+    glm::vec3 x = glm::cross(c1, c2);
+    glm::vec3 y = glm::cross(c2, c0);
+    glm::vec3 z = glm::cross(c0, c1);
+    f32 det = glm::dot(c0, x);
+    f32 invDet = det != 0.0f ? 1.0f / det : 0.0f;
+
+    glm::mat4 normal = glm::mat4(1.0f);
+    normal[0] = glm::vec4(x * invDet, 0.0f);
+    normal[1] = glm::vec4(y * invDet, 0.0f);
+    normal[2] = glm::vec4(z * invDet, 0.0f);
+    return normal;
+}
+
+static
+void multiplyLevelJob(void *data, u32 begin, u32 end) {
+    TransformHierarchy_t &hierarchy = *(TransformHierarchy_t *) data;
+    multiplyMatricesBatch(hierarchy.scratchParents.data() + begin, hierarchy.scratchLocals.data() + begin,
+                          hierarchy.scratchWorlds.data() + begin, end - begin);
+}
+
+static
+void normalMatrixJob(void *data, u32 begin, u32 end) {
+    TransformHierarchy_t &hierarchy = *(TransformHierarchy_t *) data;
+    for (u32 i = begin; i < end; i++) {
+        u32 index = hierarchy.changed[i];
+        hierarchy.normal[index] = computeNormalMatrix(hierarchy.world[index]);
+        hierarchy.dirty[index] = 0;
+    }
+}
+
+void updateTransforms(TransformHierarchy_t &hierarchy) {
+    hierarchy.changed.clear();
+
+    u32 count = (u32) hierarchy.parent.size();
+    u32 maxDepth = 0;
+    for (u32 i = 0; i < count; i++) {
+        u32 parent = hierarchy.parent[i];
+        if (!hierarchy.dirty[i] && parent != U32_MAX && hierarchy.dirty[parent]) {
+            hierarchy.dirty[i] = 1;
+        }
+        if (hierarchy.dirty[i]) {
+            hierarchy.changed.push_back(i);
+            if (hierarchy.depth[i] > maxDepth) maxDepth = hierarchy.depth[i];
+        }
+    }
+
+    if (hierarchy.changed.empty()) return;
+
+    // Bucket the changed transforms by depth. Transforms on the same level never depend on each
+    // other, so every level can go through the batch kernel in one go.
+    std::vector<u32> &offsets = hierarchy.levelOffsets;
+    offsets.assign(maxDepth + 2, 0);
+    for (u32 index : hierarchy.changed) {
+        offsets[hierarchy.depth[index] + 1] += 1;
+    }
+    for (u32 d = 0; d <= maxDepth; d++) {
+        offsets[d + 1] += offsets[d];
+    }
+    hierarchy.levelOrder.resize(hierarchy.changed.size());
+    for (u32 index : hierarchy.changed) {
+        hierarchy.levelOrder[offsets[hierarchy.depth[index]]++] = index;
+    }
+    for (u32 d = maxDepth + 1; d > 0; d--) {
+        offsets[d] = offsets[d - 1];
+    }
+    offsets[0] = 0;
+
+    for (u32 i = offsets[0]; i < offsets[1]; i++) {
+        u32 index = hierarchy.levelOrder[i];
+        hierarchy.world[index] = hierarchy.local[index];
+    }
+
+    for (u32 d = 1; d <= maxDepth; d++) {
+        u32 first = offsets[d];
+        u32 levelCount = offsets[d + 1] - first;
+        if (levelCount == 0) continue;
+
+        hierarchy.scratchParents.resize(levelCount);
+        hierarchy.scratchLocals.resize(levelCount);
+        hierarchy.scratchWorlds.resize(levelCount);
+        for (u32 i = 0; i < levelCount; i++) {
+            u32 index = hierarchy.levelOrder[first + i];
+            hierarchy.scratchParents[i] = hierarchy.world[hierarchy.parent[index]];
+            hierarchy.scratchLocals[i] = hierarchy.local[index];
+        }
+
+        if (levelCount >= TRANSFORM_PARALLEL_THRESHOLD) {
+            parallelFor(levelCount, TRANSFORM_BATCH_SIZE, multiplyLevelJob, &hierarchy);
+        } else {
+            multiplyMatricesBatch(hierarchy.scratchParents.data(), hierarchy.scratchLocals.data(),
+                                  hierarchy.scratchWorlds.data(), levelCount);
+        }
+
+        for (u32 i = 0; i < levelCount; i++) {
+            hierarchy.world[hierarchy.levelOrder[first + i]] = hierarchy.scratchWorlds[i];
+        }
+    }
+
+    u32 changedCount = (u32) hierarchy.changed.size();
+    if (changedCount >= TRANSFORM_PARALLEL_THRESHOLD) {
+        parallelFor(changedCount, TRANSFORM_BATCH_SIZE, normalMatrixJob, &hierarchy);
+    } else {
+        normalMatrixJob(&hierarchy, 0, changedCount);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "typedefs.h"
+#include "vertex_type.h"
+
+// Scene transforms stored as parallel arrays. Parents are always stored before their children,
+// so a single forward pass is enough to propagate changes down the hierarchy.
+struct TransformHierarchy_t {
+    std::vector<u32> parent; // U32_MAX for roots
+    std::vector<u32> depth;
+    std::vector<glm::mat4> local;
+    std::vector<glm::mat4> world;
+    std::vector<glm::mat4> normal; // Inverse transpose of the upper 3x3 of world
+    std::vector<u8> dirty;
+
+    // Transforms whose world matrix was recomputed by the last updateTransforms call.
+    std::vector<u32> changed;
+
+    // Reused between updates so a steady state update does not allocate.
+    std::vector<u32> levelOrder;
+    std::vector<u32> levelOffsets;
+    std::vector<glm::mat4> scratchParents;
+    std::vector<glm::mat4> scratchLocals;
+    std::vector<glm::mat4> scratchWorlds;
+};
+
+u32 addTransform(TransformHierarchy_t &hierarchy, u32 parent, const glm::mat4 &local);
+
+void setLocalTransform(TransformHierarchy_t &hierarchy, u32 index, const glm::mat4 &local);
+
+// Recomputes world and normal matrices for dirty transforms and everything below them.
+void updateTransforms(TransformHierarchy_t &hierarchy);
+
+// out[i] = a[i] * b[i] for column major 4x4 matrices.
+void multiplyMatricesBatch(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, u32 count);
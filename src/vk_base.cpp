@@ -3,8 +3,16 @@
 #include "vk_surface.h"
 #include "vk_swapchain.h"
 #include "vk_resources.h"
+#include "vk_memory.h"
 #include "vk_render.h"
 #include "vk_renderprograms.h"
+#include "vk_bindless.h"
+#include "vk_textures.h"
+#include "vk_occlusion.h"
+#include "meshlet.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "startup.h"
 
 VulkanContext_t vk_context;
 GPUInfo_t vk_gpu;
@@ -16,22 +24,64 @@ VmaAllocator vk_vma;
 VkFormat vk_swapchainFormat, vk_depthFormat;
 VkSemaphore vk_acquireSemaphore;
 VkSemaphore vk_releaseSemaphore;
+VkFence vk_frameFence;
 
 VkRenderPass vk_renderPass;
 VkCommandPool vk_commandPool = 0;
 VkCommandBuffer vk_commandBuffer = 0;
+VkQueryPool vk_statsQueryPool = 0;
+VkQueryPool vk_timestampQueryPool = 0;
 
 Buffer_t vk_staticVertexBuffer = {};
 Buffer_t vk_staticIndexBuffer = {};
 Buffer_t vk_uniformBuffer = {};
+Buffer_t vk_meshletBuffer = {};
+Buffer_t vk_objectBuffer = {};
+Buffer_t vk_drawCommandBuffer = {};
+Buffer_t vk_cullStatsBuffer = {};
+Buffer_t vk_occlusionViewBuffer = {};
+Buffer_t vk_lightBuffer = {};
+Buffer_t vk_lightCountBuffer = {};
+Buffer_t vk_lightIndexBuffer = {};
 
 u32 vk_imageIndex = 0;
 
+static ObjectData_t *g_mappedObjectData = nullptr;
+static PointLight_t *g_mappedLights = nullptr;
+
 Uniforms_t vk_uniformData = {};
 
 PushConstants_t vk_pushConstants;
 
+static
+void createSwapchainJob(void *data, u32 begin, u32 end) {
+    PROFILE_ZONE("swapchain");
+    u32 step = beginStartupStep("swapchain");
+    createSwapchain(vk_swapchain, vk_gpu.device, vk_device, vk_context.surface,
+                    vk_swapchainFormat, DEFAULT_PRESENT_MODE, vk_gpu.gfxFamilyIndex,
+                    /*oldSwapchain=*/VK_NULL_HANDLE);
+    endStartupStep(step);
+}
+
+static
+void loadShadersJob(void *data, u32 begin, u32 end) {
+    PROFILE_ZONE("shader modules");
+    u32 step = beginStartupStep("shader modules");
+    initialShaderLoad();
+    endStartupStep(step);
+}
+
+static
+void createPipelinesJob(void *data, u32 begin, u32 end) {
+    PROFILE_ZONE("pipelines");
+    u32 step = beginStartupStep("pipelines");
+    initialPipelineCreation();
+    endStartupStep(step);
+}
+
 void initialiseVulkan(GLFWwindow *windowPtr) {
+    PROFILE_FUNCTION();
+    u32 step = beginStartupStep("instance and device");
     vk_context.instance = createInstance();
 
 #ifdef _DEBUG
@@ -44,31 +94,50 @@ void initialiseVulkan(GLFWwindow *windowPtr) {
 
     vk_device = createDevice(vk_context.instance, &vk_gpu);
 
-    vk_vma = createVMAallocator(vk_context.instance, vk_gpu.device, vk_device);
+    vk_vma = createVMAallocator(vk_context.instance, vk_gpu.device, vk_device, vk_gpu.props.apiVersion,
+                                vk_gpu.memoryBudgetSupported);
 
     vk_swapchainFormat = getSwapchainFormat(vk_gpu.device, vk_context.surface);
     vk_depthFormat = VK_FORMAT_D32_SFLOAT;
 
     vkGetDeviceQueue(vk_device, vk_gpu.gfxFamilyIndex, 0, &vk_queue);
 
-    vk_acquireSemaphore = createSemaphore(vk_device);
-    vk_releaseSemaphore = createSemaphore(vk_device);
+    // Pipelines are created against this one, the frame graph makes compatible render passes with
+    // the load and store ops the frame actually needs. Only needs the formats, not the swapchain.
+    vk_renderPass = createRenderPass(vk_device, vk_swapchainFormat, vk_depthFormat);
+    endStartupStep(step);
 
-    createSwapchain(vk_swapchain, vk_gpu.device, vk_device, vk_context.surface,
-                    vk_swapchainFormat, vk_gpu.gfxFamilyIndex, /*oldSwapchain=*/VK_NULL_HANDLE);
+    // From here the swapchain, the shader modules and then the pipelines build on workers while
+    // this thread sets up everything else. Only this thread touches the queue.
+    JobCounter_t swapchainDone, shadersDone, pipelinesDone;
+    JobDecl_t swapchainJob = {createSwapchainJob, nullptr, 0, 1};
+    JobDecl_t shadersJob = {loadShadersJob, nullptr, 0, 1};
+    runJobs(&swapchainJob, 1, &swapchainDone);
+    runJobs(&shadersJob, 1, &shadersDone);
 
-    vk_renderPass = createRenderPass(vk_device, vk_swapchainFormat, vk_depthFormat);
+    step = beginStartupStep("device resources");
+    vk_acquireSemaphore = createSemaphore(vk_device);
+    vk_releaseSemaphore = createSemaphore(vk_device);
+    vk_frameFence = createFence(vk_device);
 
     vk_commandPool = createCommandPool(vk_device, vk_gpu.gfxFamilyIndex);
     allocateCommandBuffer(vk_device, vk_commandPool, &vk_commandBuffer);
 
-    vk_pushConstants.model = glm::mat4(1.0f);
-    Logger::Trace("sizeof(vk_pushConstants) %i", sizeof(vk_pushConstants));
+    if (vk_gpu.features.pipelineStatisticsQuery) {
+        vk_statsQueryPool = createStatsQueryPool(vk_device);
+    } else {
+        Logger::Warn("Pipeline statistics queries not supported, no overdraw numbers");
+    }
+
+    if (vk_gpu.timestampValidBits > 0) {
+        vk_timestampQueryPool = createTimestampQueryPool(vk_device);
+    } else {
+        Logger::Warn("Graphics queue has no timestamps, dynamic resolution stays at full size");
+    }
+    initDynamicResolution();
 
-    glm::vec4 initLight1Pos = glm::vec4(-1.0f, 1.0f, 8.0f, 1.0f);
-    glm::vec4 initLight2Pos = glm::vec4(0.0f, 1.0f, -3.0f, 1.0f);
-    vk_pushConstants.lights[0] = initLight1Pos;
-    vk_pushConstants.lights[1] = initLight2Pos;
+    vk_pushConstants.objectIndex = 0;
+    Logger::Trace("sizeof(vk_pushConstants) %i", sizeof(vk_pushConstants));
 
     glm::vec3 initCameraPos = glm::vec3(4.0f, 3.0f, 7.0f);
 
@@ -82,11 +151,22 @@ void initialiseVulkan(GLFWwindow *windowPtr) {
     createBuffer(vk_uniformBuffer,
                  VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                  VMA_MEMORY_USAGE_CPU_TO_GPU,
-                 sizeof(vk_uniformData), vk_vma);
+                 sizeof(vk_uniformData), MemoryCategory_Uniforms, vk_vma);
+
+    createLightBuffers();
+    createBindlessTable();
+    initTextureStreaming();
 
     initialDescriptorSetup();
-    initialShaderLoad();
-    initialPipelineCreation();
+    endStartupStep(step);
+
+    // Pipelines need the descriptor set layouts from above as well as the modules.
+    JobDecl_t pipelinesJob = {createPipelinesJob, nullptr, 0, 1};
+    runJobsAfter(&shadersDone, &pipelinesJob, 1, &pipelinesDone);
+
+    waitForCounter(&swapchainDone);
+    waitForCounter(&shadersDone);
+    waitForCounter(&pipelinesDone);
 }
 
 u32 avk_prepareFrame(f64 time) {
@@ -100,41 +180,216 @@ void avk_drawMesh(u32 vertexOffset, u32 indexOffset, u32 indexCount, f64 time) {
     drawMesh(vertexOffset, indexOffset, indexCount, time);
 }
 
+void avk_cullClusters(u32 meshletCount) {
+    cullClusters(meshletCount);
+}
+
+void avk_binLights() {
+    binLights();
+}
+
+void avk_beginMainPass() {
+    beginMainPass();
+}
+
+void avk_beginLateMainPass() {
+    beginLateMainPass();
+}
+
+void avk_drawMeshClusters(u32 firstMeshlet, u32 meshletCount, f64 time) {
+    drawMeshClusters(firstMeshlet, meshletCount, time);
+}
+
+void avk_setMeshPass(MeshPass_t pass) {
+    setMeshPass(pass);
+}
+
+void avk_setShading(ShadingModel_t shading, u32 maxShadedLights) {
+    setShading(shading, maxShadedLights);
+}
+
+u32 avk_addTexture(const void *texels, u32 width, u32 height) {
+    return addBindlessTexture(texels, width, height);
+}
+
+u32 avk_addMaterial(const Material_t &material) {
+    return addMaterial(material);
+}
+
+void avk_setObjectMaterial(u32 objectIndex, u32 materialIndex) {
+    setObjectMaterial(objectIndex, materialIndex);
+}
+
+u32 avk_loadTexture(const char *path) {
+    return loadKtx2Texture(path);
+}
+
+u32 avk_textureSlot(u32 texture) {
+    return streamedTextureSlot(texture);
+}
+
+void avk_requestTextureResolution(u32 texture, f32 screenPixels) {
+    requestTextureResolution(texture, screenPixels);
+}
+
+void avk_updateTextureStreaming() {
+    updateTextureStreaming();
+}
+
+void avk_surfaceResized() {
+    surfaceResized();
+}
+
+void avk_setPresentMode(VkPresentModeKHR mode) {
+    setPresentMode(mode);
+}
+
+VkPresentModeKHR avk_getPresentMode() {
+    return vk_swapchain.presentMode;
+}
+
 void avk_endFrame() {
     submitFrame(vk_imageIndex);
+    updateMemoryStats();
+}
+
+ClusterCullStats_t avk_getClusterCullStats() {
+    return getClusterCullStats();
+}
+
+PipelineStats_t avk_getPipelineStats() {
+    return getPipelineStats();
+}
+
+TextureStreamingStats_t avk_getTextureStreamingStats() {
+    return getTextureStreamingStats();
+}
+
+ShaderVariantStats_t avk_getShaderVariantStats() {
+    return getShaderVariantStats();
+}
+
+void avk_logShaderVariants() {
+    logShaderVariants();
+}
+
+ResolutionStats_t avk_getResolutionStats() {
+    return getResolutionStats();
 }
 
 void createStaticBuffers(u32 vbSize, u32 ibSize) {
     createBuffer(vk_staticVertexBuffer,
                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                  VMA_MEMORY_USAGE_GPU_ONLY,
-                 vbSize, vk_vma);
+                 vbSize, MemoryCategory_StaticGeometry, vk_vma);
 
     Logger::Trace("Created static vertexbuffer of size %i", vbSize);
 
     createBuffer(vk_staticIndexBuffer,
                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                  VMA_MEMORY_USAGE_GPU_ONLY,
-                 ibSize, vk_vma);
+                 ibSize, MemoryCategory_StaticGeometry, vk_vma);
 
     Logger::Trace("Created static indexbuffer of size %i", ibSize);
 
 }
 
+void createClusterBuffers(u32 meshletCount, u32 objectCount) {
+    createBuffer(vk_meshletBuffer,
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VMA_MEMORY_USAGE_GPU_ONLY,
+                 meshletCount * sizeof(Meshlet_t), MemoryCategory_StaticGeometry, vk_vma);
+
+    createBuffer(vk_objectBuffer,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VMA_MEMORY_USAGE_CPU_TO_GPU,
+                 objectCount * sizeof(ObjectData_t), MemoryCategory_Uniforms, vk_vma);
+
+    // The late occlusion phase writes its commands after the early ones.
+    u32 drawCommandCount = OCCLUSION_CULLING ? 2 * meshletCount : meshletCount;
+    createBuffer(vk_drawCommandBuffer,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                 VMA_MEMORY_USAGE_GPU_ONLY,
+                 drawCommandCount * sizeof(VkDrawIndexedIndirectCommand), MemoryCategory_Indirect, vk_vma);
+
+    createBuffer(vk_cullStatsBuffer,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VMA_MEMORY_USAGE_GPU_TO_CPU,
+                 sizeof(ClusterCullStats_t), MemoryCategory_Indirect, vk_vma);
+
+    createBuffer(vk_occlusionViewBuffer,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VMA_MEMORY_USAGE_CPU_TO_GPU,
+                 2 * sizeof(OcclusionView_t), MemoryCategory_Uniforms, vk_vma);
+
+    // The object buffer stays mapped, uploads only touch the objects that changed.
+    vmaMapMemory(vk_vma, vk_objectBuffer.vmaAlloc, (void **) &g_mappedObjectData);
+
+    Logger::Trace("Created cluster buffers for %i meshlets and %i objects", meshletCount, objectCount);
+
+    updateClusterDescriptorSets();
+    createOcclusionResources();
+    createObjectMaterials(objectCount);
+}
+
+void uploadObjectData(const u32 *objectIndices, const ObjectData_t *objects, u32 count) {
+    PROFILE_FUNCTION();
+    ASSERT(g_mappedObjectData != nullptr);
+
+    for (u32 i = 0; i < count; i++) {
+        ASSERT_DEBUG((objectIndices[i] + 1) * sizeof(ObjectData_t) <= vk_objectBuffer.size);
+        g_mappedObjectData[objectIndices[i]] = objects[i];
+    }
+}
+
+void createLightBuffers() {
+    createBuffer(vk_lightBuffer,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VMA_MEMORY_USAGE_CPU_TO_GPU,
+                 MAX_LIGHTS * sizeof(PointLight_t), MemoryCategory_Uniforms, vk_vma);
+
+    createBuffer(vk_lightCountBuffer,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VMA_MEMORY_USAGE_GPU_ONLY,
+                 LIGHT_CLUSTER_COUNT * sizeof(u32), MemoryCategory_Indirect, vk_vma);
+
+    createBuffer(vk_lightIndexBuffer,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VMA_MEMORY_USAGE_GPU_ONLY,
+                 LIGHT_CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(u32), MemoryCategory_Indirect, vk_vma);
+
+    // Lights are rewritten every frame, the buffer stays mapped.
+    vmaMapMemory(vk_vma, vk_lightBuffer.vmaAlloc, (void **) &g_mappedLights);
+}
+
+void uploadLights(const PointLight_t *lights, u32 count) {
+    PROFILE_FUNCTION();
+    ASSERT(g_mappedLights);
+    if (count > MAX_LIGHTS) {
+        Logger::Warn("%i lights, only the first %i are used", count, MAX_LIGHTS);
+        count = MAX_LIGHTS;
+    }
+    memcpy(g_mappedLights, lights, count * sizeof(PointLight_t));
+    vk_uniformData.lightInfo.x = count;
+}
+
 void uploadUniformData(glm::mat4 view, glm::mat4 proj) {
+    PROFILE_FUNCTION();
 
     vk_uniformData.view = view;
+    vk_uniformData.cameraPos = glm::vec4(glm::vec3(glm::inverse(view)[3]), 1.0f);
 
     vk_uniformData.proj = proj;
 
     updateUniforms();
 }
 
-void uploadModelMatrix(glm::mat4 model) {
-    vk_pushConstants.model = model;
+void uploadObjectIndex(u32 objectIndex) {
+    vk_pushConstants.objectIndex = objectIndex;
 }
 
 void uploadVertices(u32 vbSize, u32 offset, const void *data) {
+    PROFILE_FUNCTION();
     Buffer_t vb_staging = {};
 
     ASSERT(vk_staticVertexBuffer.buffer != VK_NULL_HANDLE);
@@ -142,7 +397,7 @@ void uploadVertices(u32 vbSize, u32 offset, const void *data) {
     createBuffer(vb_staging,
                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                  VMA_MEMORY_USAGE_CPU_ONLY,
-                 vbSize, vk_vma);
+                 vbSize, MemoryCategory_Staging, vk_vma);
 
     Logger::Trace("Created static staging vertex buffer of size %i", vbSize);
 
@@ -153,11 +408,12 @@ void uploadVertices(u32 vbSize, u32 offset, const void *data) {
     Logger::Trace("Uploaded static vertex staging buffer of size %i at offset %i",
                   vbSize, offset);
 
-    vmaDestroyBuffer(vk_vma, vb_staging.buffer, vb_staging.vmaAlloc);
+    destroyBuffer(vb_staging, vk_vma);
     Logger::Trace("Destroyed static staging vertex buffer");
 }
 
 void uploadIndices(u32 ibSize, u32 offset, const void *data) {
+    PROFILE_FUNCTION();
     Buffer_t ib_staging = {};
 
     ASSERT(vk_staticIndexBuffer.buffer != VK_NULL_HANDLE);
@@ -165,7 +421,7 @@ void uploadIndices(u32 ibSize, u32 offset, const void *data) {
     createBuffer(ib_staging,
                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                  VMA_MEMORY_USAGE_CPU_ONLY,
-                 ibSize, vk_vma);
+                 ibSize, MemoryCategory_Staging, vk_vma);
 
     Logger::Trace("Created static staging index buffer of size %i at offset %i",
                   ibSize, offset);
@@ -176,18 +432,51 @@ void uploadIndices(u32 ibSize, u32 offset, const void *data) {
 
     Logger::Trace("Uploaded static index staging buffer of size %i", ibSize);
 
-    vmaDestroyBuffer(vk_vma, ib_staging.buffer, ib_staging.vmaAlloc);
+    destroyBuffer(ib_staging, vk_vma);
 
     Logger::Trace("Destroyed static staging index buffer");
 }
 
+void uploadMeshlets(u32 size, u32 offset, const void *data) {
+    PROFILE_FUNCTION();
+    Buffer_t staging = {};
+
+    ASSERT(vk_meshletBuffer.buffer != VK_NULL_HANDLE);
+
+    createBuffer(staging,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VMA_MEMORY_USAGE_CPU_ONLY,
+                 size, MemoryCategory_Staging, vk_vma);
+
+    uploadBuffer(vk_device, vk_commandPool, vk_commandBuffer, vk_queue,
+                 vk_meshletBuffer, staging,
+                 data, offset, size, vk_vma);
+
+    Logger::Trace("Uploaded meshlet buffer of size %i at offset %i", size, offset);
+
+    destroyBuffer(staging, vk_vma);
+}
+
 
 static
-VmaAllocator createVMAallocator(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device) {
+VmaAllocator createVMAallocator(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device,
+                                u32 deviceApiVersion, bool memoryBudget) {
+    // VMA may only call core entry points both the instance and the device have, and it does not
+    // use anything past 1.1. Without the patch number, that is how it compares versions.
+    u32 apiVersion = VK_MAKE_VERSION(VK_VERSION_MAJOR(deviceApiVersion), VK_VERSION_MINOR(deviceApiVersion), 0);
+    if (apiVersion > INSTANCE_API_VERSION) apiVersion = INSTANCE_API_VERSION;
+    if (apiVersion > VK_API_VERSION_1_1) apiVersion = VK_API_VERSION_1_1;
+
     VmaAllocatorCreateInfo vmaAllocCI = {};
     vmaAllocCI.physicalDevice = physicalDevice;
     vmaAllocCI.device = device;
     vmaAllocCI.instance = instance;
+    vmaAllocCI.vulkanApiVersion = apiVersion;
+    if (memoryBudget && apiVersion >= VK_API_VERSION_1_1) {
+        // Without it VMA estimates the budget as 80% of each heap and only counts its own blocks.
+        // Reading the budget goes through vkGetPhysicalDeviceMemoryProperties2, core since 1.1.
+        vmaAllocCI.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
 
     VmaAllocator vma_allocator = 0;
     vmaCreateAllocator(&vmaAllocCI, &vma_allocator);
@@ -204,6 +493,15 @@ VkSemaphore createSemaphore(VkDevice device) {
     return semaphore;
 }
 
+VkFence createFence(VkDevice device) {
+    VkFenceCreateInfo createInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+
+    VkFence fence = 0;
+    VK_CHECK(vkCreateFence(device, &createInfo, nullptr, &fence));
+
+    return fence;
+}
+
 static VkRenderPass
 createRenderPass(VkDevice device, VkFormat colorFormat, VkFormat depth_format) {
 
@@ -258,6 +556,16 @@ createRenderPass(VkDevice device, VkFormat colorFormat, VkFormat depth_format) {
     createInfo.dependencyCount = 1;
     createInfo.pDependencies = &dependency;
 
+    // One view per layer of the color and depth arrays. The eyes see nearly the same thing, so
+    // they are marked as correlated.
+    u32 viewMask = (1u << VIEW_COUNT) - 1;
+    VkRenderPassMultiviewCreateInfo multiviewInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO};
+    multiviewInfo.subpassCount = 1;
+    multiviewInfo.pViewMasks = &viewMask;
+    multiviewInfo.correlationMaskCount = 1;
+    multiviewInfo.pCorrelationMasks = &viewMask;
+    if (MULTIVIEW) createInfo.pNext = &multiviewInfo;
+
     VkRenderPass rp = 0;
     VK_CHECK(vkCreateRenderPass(device, &createInfo, nullptr, &rp));
     return rp;
@@ -275,6 +583,34 @@ VkCommandPool createCommandPool(VkDevice device, u32 familyIndex) {
     return cmdPool;
 }
 
+// One query over the main pass. Results come back in bit order, see PipelineStats_t.
+static
+VkQueryPool createStatsQueryPool(VkDevice device) {
+    VkQueryPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    createInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    createInfo.queryCount = 1;
+    createInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    VkQueryPool pool = 0;
+    VK_CHECK(vkCreateQueryPool(device, &createInfo, nullptr, &pool));
+
+    return pool;
+}
+
+// Start and end of the frame command buffer.
+static
+VkQueryPool createTimestampQueryPool(VkDevice device) {
+    VkQueryPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    createInfo.queryCount = 2;
+
+    VkQueryPool pool = 0;
+    VK_CHECK(vkCreateQueryPool(device, &createInfo, nullptr, &pool));
+
+    return pool;
+}
+
 void allocateCommandBuffer(VkDevice device, VkCommandPool pool, VkCommandBuffer *cmdBuffer) {
     VkCommandBufferAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
     allocInfo.commandPool = pool;
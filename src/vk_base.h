@@ -3,15 +3,20 @@
 #define VK_USE_PLATFORM_WIN32_KHR
 
 #include "vk_common.h"
+#include "vk_textures.h"
+#include "vk_variants.h"
 
 struct GLFWwindow; // Fwd declare
 
 void initialiseVulkan(GLFWwindow *winPtr);
 
-VmaAllocator createVMAallocator(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
+VmaAllocator createVMAallocator(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device,
+                                u32 deviceApiVersion, bool memoryBudget);
 
 VkSemaphore createSemaphore(VkDevice device);
 
+VkFence createFence(VkDevice device);
+
 static VkRenderPass createRenderPass(VkDevice device, VkFormat colorFormat, VkFormat depthFormat);
 
 static VkFramebuffer createFramebuffer(VkDevice device, VkRenderPass renderPass, VkImageView colorView,
@@ -19,6 +24,10 @@ static VkFramebuffer createFramebuffer(VkDevice device, VkRenderPass renderPass,
 
 static VkCommandPool createCommandPool(VkDevice device, u32 familyIndex);
 
+static VkQueryPool createStatsQueryPool(VkDevice device);
+
+static VkQueryPool createTimestampQueryPool(VkDevice device);
+
 void allocateCommandBuffer(VkDevice device, VkCommandPool pool, VkCommandBuffer *cmdBuffer);
 
 void uploadVertices(u32 vbSize, u32 offset, const void *data);
@@ -27,11 +36,78 @@ void uploadIndices(u32 ibSize, u32 offset, const void *data);
 
 void createStaticBuffers(u32 vbSize, u32 ibSize);
 
+void createClusterBuffers(u32 meshletCount, u32 objectCount);
+
+void uploadMeshlets(u32 size, u32 offset, const void *data);
+
+// Writes objects[i] to slot objectIndices[i] of the object buffer.
+void uploadObjectData(const u32 *objectIndices, const ObjectData_t *objects, u32 count);
+
+void createLightBuffers();
+
+// Before uploadUniformData, the light count goes in the uniforms. At most MAX_LIGHTS are used.
+void uploadLights(const PointLight_t *lights, u32 count);
+
 void uploadUniformData(glm::mat4 view, glm::mat4 proj);
-void uploadModelMatrix(glm::mat4 model);
+void uploadObjectIndex(u32 objectIndex);
 
 u32 avk_prepareFrame(f64 time);
 
 void avk_drawMesh(u32 vertexOffset, u32 indexOffset, u32 indexCount, f64 time);
 
-void avk_endFrame();
\ No newline at end of file
+void avk_cullClusters(u32 meshletCount);
+
+// Bins the lights into the cluster grid, after uploadLights and before the main pass.
+void avk_binLights();
+
+void avk_beginMainPass();
+
+// With OCCLUSION_CULLING, after the main pass draws. The mesh draws that follow add the clusters
+// the late occlusion phase found, see vk_occlusion.h.
+void avk_beginLateMainPass();
+
+void avk_drawMeshClusters(u32 firstMeshlet, u32 meshletCount, f64 time);
+
+// Selects the pipeline for the following mesh draws.
+void avk_setMeshPass(MeshPass_t pass);
+
+// Shading model and per fragment light cap of the color pass variants. Caps outside
+// g_shadedLightCaps still work, but build their pipeline on first use.
+void avk_setShading(ShadingModel_t shading, u32 maxShadedLights);
+
+// Bindless material table, see vk_bindless.h. Between frames only. Textures are RGBA8 sRGB, slot 0
+// and material 0 are plain white, and full tables hand those out instead.
+u32 avk_addTexture(const void *texels, u32 width, u32 height);
+u32 avk_addMaterial(const Material_t &material);
+void avk_setObjectMaterial(u32 objectIndex, u32 materialIndex);
+
+// Streamed KTX2 textures, see vk_textures.h. avk_loadTexture returns U32_MAX when the file can not
+// be used. Resolution requests go in before avk_updateTextureStreaming, which runs once per frame
+// after avk_prepareFrame and before avk_beginMainPass.
+u32 avk_loadTexture(const char *path);
+u32 avk_textureSlot(u32 texture);
+void avk_requestTextureResolution(u32 texture, f32 screenPixels);
+void avk_updateTextureStreaming();
+
+// From the framebuffer size callback. The swapchain is checked against the surface before the
+// next frame.
+void avk_surfaceResized();
+
+// Takes effect when the swapchain is recreated before the next frame. Unsupported modes fall back
+// to FIFO, avk_getPresentMode has the one in use.
+void avk_setPresentMode(VkPresentModeKHR mode);
+VkPresentModeKHR avk_getPresentMode();
+
+void avk_endFrame();
+
+ClusterCullStats_t avk_getClusterCullStats();
+
+// Zero when the device has no pipeline statistics queries.
+PipelineStats_t avk_getPipelineStats();
+
+ResolutionStats_t avk_getResolutionStats();
+
+TextureStreamingStats_t avk_getTextureStreamingStats();
+
+ShaderVariantStats_t avk_getShaderVariantStats();
+void avk_logShaderVariants();
\ No newline at end of file
@@ -0,0 +1,275 @@
+#include "arena.h"
+#include "vk_bindless.h"
+#include "vk_resources.h"
+
+#define ARRAYSIZE(a) \
+  ((sizeof(a) / sizeof(*(a))) / \
+  static_cast<size_t>(!(sizeof(a) % sizeof(*(a)))))
+
+VkDescriptorSetLayout vk_bindlessSetLayout = 0;
+VkDescriptorSet vk_bindlessSet = 0;
+
+static VkDescriptorPool g_bindlessPool = 0;
+static VkSampler g_textureSampler = 0;
+
+static Buffer_t g_materialBuffer = {};
+static Material_t *g_mappedMaterials = nullptr;
+static u32 g_materialCount = 0;
+
+static Buffer_t g_objectMaterialBuffer = {};
+static u32 *g_mappedObjectMaterials = nullptr;
+
+static std::vector<Image_t> g_textures; // Uploaded by addBindlessTexture, the first one is white
+static u32 g_textureCount = 0; // Slots in use, including the ones with streamed textures
+static u32 g_textureSlots = 0;
+
+static
+VkSampler createTextureSampler() {
+    VkSamplerCreateInfo createInfo = {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    createInfo.magFilter = VK_FILTER_LINEAR;
+    createInfo.minFilter = VK_FILTER_LINEAR;
+    createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    createInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    createInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    createInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    createInfo.anisotropyEnable = VK_TRUE; // pickGPU requires samplerAnisotropy
+    createInfo.maxAnisotropy = vk_gpu.props.limits.maxSamplerAnisotropy < 8.0f
+                               ? vk_gpu.props.limits.maxSamplerAnisotropy : 8.0f;
+    createInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    VkSampler sampler = 0;
+    VK_CHECK(vkCreateSampler(vk_device, &createInfo, nullptr, &sampler));
+    return sampler;
+}
+
+static
+VkDescriptorSetLayout createBindlessSetLayout(bool descriptorIndexing, u32 textureSlots) {
+    VkDescriptorSetLayoutBinding bindings[3] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    // Looked up with the object index push constant, which only the vertex shader sees.
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[2].descriptorCount = textureSlots;
+    bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    // Slots past the last texture stay unwritten, and textures go in while the set is bound in the
+    // command buffer being recorded. No submitted frame is pending then, submitFrame waits on the
+    // fence every frame. Writing while one is would also need UPDATE_UNUSED_WHILE_PENDING, and
+    // could still not touch slots that frame uses.
+    VkDescriptorBindingFlags bindingFlags[3] = {
+            0, 0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    flagsInfo.bindingCount = ARRAYSIZE(bindingFlags);
+    flagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo createInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    createInfo.bindingCount = ARRAYSIZE(bindings);
+    createInfo.pBindings = bindings;
+    if (descriptorIndexing) {
+        createInfo.pNext = &flagsInfo;
+        createInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    }
+
+    VkDescriptorSetLayout layout = 0;
+    VK_CHECK(vkCreateDescriptorSetLayout(vk_device, &createInfo, nullptr, &layout));
+    return layout;
+}
+
+static
+VkDescriptorPool createBindlessPool(bool descriptorIndexing, u32 textureSlots) {
+    VkDescriptorPoolSize poolSizes[2];
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = 2;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = textureSlots;
+
+    VkDescriptorPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    createInfo.poolSizeCount = ARRAYSIZE(poolSizes);
+    createInfo.pPoolSizes = poolSizes;
+    createInfo.maxSets = 1;
+    if (descriptorIndexing) {
+        createInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    }
+
+    VkDescriptorPool pool = 0;
+    VK_CHECK(vkCreateDescriptorPool(vk_device, &createInfo, nullptr, &pool));
+    return pool;
+}
+
+static
+void writeBufferDescriptor(const Buffer_t &buffer, u32 binding) {
+    VkDescriptorBufferInfo bufferInfo = {};
+    bufferInfo.buffer = buffer.buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = vk_bindlessSet;
+    write.dstBinding = binding;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.descriptorCount = 1;
+    write.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(vk_device, 1, &write, 0, nullptr);
+}
+
+static
+void writeTextureDescriptors(VkImageView view, u32 firstSlot, u32 slotCount) {
+    ASSERT(firstSlot + slotCount <= g_textureSlots);
+    ScratchScope_t scratch;
+    VkDescriptorImageInfo *imageInfos = arenaAllocArray<VkDescriptorImageInfo>(scratch.arena, slotCount);
+    for (u32 i = 0; i < slotCount; i++) {
+        imageInfos[i].sampler = g_textureSampler;
+        imageInfos[i].imageView = view;
+        imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = vk_bindlessSet;
+    write.dstBinding = 2;
+    write.dstArrayElement = firstSlot;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = slotCount;
+    write.pImageInfo = imageInfos;
+
+    vkUpdateDescriptorSets(vk_device, 1, &write, 0, nullptr);
+}
+
+void createBindlessTable() {
+    bool descriptorIndexing = vk_gpu.descriptorIndexingSupported;
+    g_textureSlots = FALLBACK_TEXTURE_SLOTS;
+    if (descriptorIndexing) {
+        g_textureSlots = vk_gpu.maxBindlessTextures < BINDLESS_TEXTURE_SLOTS
+                         ? vk_gpu.maxBindlessTextures : BINDLESS_TEXTURE_SLOTS;
+    } else {
+        Logger::Warn("No descriptor indexing, the texture table has %i slots", g_textureSlots);
+    }
+    if (!vk_gpu.features.shaderSampledImageArrayDynamicIndexing) {
+        Logger::Warn("No dynamic indexing of sampled image arrays, materials may sample the wrong texture");
+    }
+
+    g_textureSampler = createTextureSampler();
+    vk_bindlessSetLayout = createBindlessSetLayout(descriptorIndexing, g_textureSlots);
+    g_bindlessPool = createBindlessPool(descriptorIndexing, g_textureSlots);
+
+    VkDescriptorSetAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = g_bindlessPool;
+    allocInfo.pSetLayouts = &vk_bindlessSetLayout;
+    allocInfo.descriptorSetCount = 1;
+    VK_CHECK(vkAllocateDescriptorSets(vk_device, &allocInfo, &vk_bindlessSet));
+
+    createBuffer(g_materialBuffer,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VMA_MEMORY_USAGE_CPU_TO_GPU,
+                 MAX_MATERIALS * sizeof(Material_t), MemoryCategory_Uniforms, vk_vma);
+    vmaMapMemory(vk_vma, g_materialBuffer.vmaAlloc, (void **) &g_mappedMaterials);
+    writeBufferDescriptor(g_materialBuffer, 0);
+
+    const u32 white = 0xffffffff;
+    addBindlessTexture(&white, 1, 1);
+
+    // Without partially bound descriptors every slot the shader declares has to be valid.
+    if (!descriptorIndexing) {
+        writeTextureDescriptors(g_textures[0].view, 1, g_textureSlots - 1);
+    }
+
+    Material_t defaultMaterial = {};
+    defaultMaterial.baseColor = glm::vec4(1.0f);
+    defaultMaterial.baseColorTexture = 0;
+    addMaterial(defaultMaterial);
+
+    Logger::Trace("Created bindless table with %i texture slots and %i materials", g_textureSlots, MAX_MATERIALS);
+}
+
+void createObjectMaterials(u32 objectCount) {
+    ASSERT(vk_bindlessSet != VK_NULL_HANDLE);
+    createBuffer(g_objectMaterialBuffer,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VMA_MEMORY_USAGE_CPU_TO_GPU,
+                 objectCount * sizeof(u32), MemoryCategory_Uniforms, vk_vma);
+    vmaMapMemory(vk_vma, g_objectMaterialBuffer.vmaAlloc, (void **) &g_mappedObjectMaterials);
+    memset(g_mappedObjectMaterials, 0, objectCount * sizeof(u32));
+
+    writeBufferDescriptor(g_objectMaterialBuffer, 1);
+}
+
+u32 addBindlessTexture(const void *texels, u32 width, u32 height) {
+    if (g_textureCount >= g_textureSlots) {
+        Logger::Warn("Texture table full at %i slots, using the white texture", g_textureSlots);
+        return 0;
+    }
+
+    Image_t texture = {};
+    createImage(texture, vk_device, width, height, 1, VK_FORMAT_R8G8B8A8_SRGB,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT, MemoryCategory_Textures, vk_vma);
+
+    u32 size = width * height * 4;
+    Buffer_t staging = {};
+    createBuffer(staging,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VMA_MEMORY_USAGE_CPU_ONLY,
+                 size, MemoryCategory_Staging, vk_vma);
+    uploadImage(vk_device, vk_commandPool, vk_commandBuffer, vk_queue,
+                texture, width, height, staging, texels, size, vk_vma);
+    destroyBuffer(staging, vk_vma);
+
+    u32 slot = g_textureCount++;
+    g_textures.push_back(texture);
+    writeTextureDescriptors(texture.view, slot, 1);
+    return slot;
+}
+
+u32 reserveBindlessTexture() {
+    if (g_textureCount >= g_textureSlots) {
+        Logger::Warn("Texture table full at %i slots, using the white texture", g_textureSlots);
+        return 0;
+    }
+    u32 slot = g_textureCount++;
+    writeTextureDescriptors(g_textures[0].view, slot, 1);
+    return slot;
+}
+
+void setBindlessTexture(u32 slot, VkImageView view) {
+    ASSERT(slot > 0 && slot < g_textureCount);
+    writeTextureDescriptors(view, slot, 1);
+}
+
+u32 addMaterial(const Material_t &material) {
+    ASSERT(g_mappedMaterials);
+    if (g_materialCount >= MAX_MATERIALS) {
+        Logger::Warn("Material table full at %i materials, using material 0", MAX_MATERIALS);
+        return 0;
+    }
+    ASSERT_MSG(material.baseColorTexture < g_textureCount, "Material uses a texture slot that is not filled");
+
+    g_mappedMaterials[g_materialCount] = material;
+    return g_materialCount++;
+}
+
+void setObjectMaterial(u32 objectIndex, u32 materialIndex) {
+    ASSERT(g_mappedObjectMaterials);
+    ASSERT_DEBUG((objectIndex + 1) * sizeof(u32) <= g_objectMaterialBuffer.size);
+    ASSERT(materialIndex < g_materialCount);
+    g_mappedObjectMaterials[objectIndex] = materialIndex;
+}
+
+BindlessStats_t getBindlessStats() {
+    BindlessStats_t stats = {};
+    stats.textureCount = g_textureCount;
+    stats.textureSlots = g_textureSlots;
+    stats.materialCount = g_materialCount;
+    stats.descriptorIndexing = vk_gpu.descriptorIndexingSupported;
+    return stats;
+}
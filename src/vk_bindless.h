@@ -0,0 +1,42 @@
+#pragma once
+
+#include "vk_common.h"
+
+// Material and texture table shared by every mesh draw, set 1 of the mesh pipeline layout.
+// 0: materials, 1: material index per object, 2: base color textures.
+// The set is bound once per frame and draws reach their material through the object index, so
+// new materials and textures never add descriptor binds. Call the add and set functions between
+// frames, they write mapped buffers the previous frame may still read otherwise.
+
+struct BindlessStats_t {
+    u32 textureCount;
+    u32 textureSlots; // Size of the texture array, specialization constant 2 of the mesh shaders
+    u32 materialCount;
+    bool descriptorIndexing; // Otherwise the array is small and every slot holds a texture
+};
+
+// After the device and before the mesh pipelines. Texture slot 0 is plain white and so is
+// material 0.
+void createBindlessTable();
+
+// One entry per scene object, all of them start out with material 0.
+void createObjectMaterials(u32 objectCount);
+
+// Tightly packed RGBA8 sRGB texels. Returns the slot, 0 when the table is full.
+u32 addBindlessTexture(const void *texels, u32 width, u32 height);
+
+// A slot for a texture owned elsewhere, it shows the white texture until setBindlessTexture.
+// Returns 0 when the table is full.
+u32 reserveBindlessTexture();
+
+// Points a reserved slot at another view. With descriptor indexing this is fine while the set is
+// bound in the frame being recorded, without it only before the main pass binds the set. Never
+// while a submitted frame is still pending.
+void setBindlessTexture(u32 slot, VkImageView view);
+
+// Returns the material index, 0 when the table is full.
+u32 addMaterial(const Material_t &material);
+
+void setObjectMaterial(u32 objectIndex, u32 materialIndex);
+
+BindlessStats_t getBindlessStats();
@@ -14,8 +14,71 @@
 
 #include "anton_asserts.h"
 
-#ifndef NUM_LIGHTS
-#define NUM_LIGHTS 2
+// Point lights live in a storage buffer and are binned into a grid of view frustum clusters every
+// frame, the fragment shaders only loop over the lights of their cluster. The grid has to match
+// shaders/light_clusters.glsl.
+#ifndef MAX_LIGHTS
+#define MAX_LIGHTS 4096
+#endif
+
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24 // Exponential depth slices
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+// Materials and their textures live in one descriptor set that is bound once per frame, draws
+// pick their material through the object index. With descriptor indexing the texture array is
+// large and partially bound, without it every slot of a small array has to hold a texture.
+#ifndef MAX_MATERIALS
+#define MAX_MATERIALS 4096
+#endif
+
+#ifndef BINDLESS_TEXTURE_SLOTS
+#define BINDLESS_TEXTURE_SLOTS 4096
+#endif
+
+#define FALLBACK_TEXTURE_SLOTS 16 // Guaranteed per stage sampler and sampled image limit
+
+// Cull meshlet clusters in a compute pass and draw the survivors with indirect draws.
+#ifndef CLUSTER_CULLING
+#define CLUSTER_CULLING 1
+#endif
+
+// Backface cone test for clusters, assumes counter clockwise outward facing triangles.
+#ifndef CLUSTER_CONE_CULLING
+#define CLUSTER_CONE_CULLING 1
+#endif
+
+// Stereo in a single pass with multiview. Color and depth are two layer arrays, every draw goes to
+// both and the .multiview build of the vertex shaders picks the eye's matrix with gl_ViewIndex.
+// The eyes end up side by side in the swapchain, each with half its width. Only then does the
+// device need Vulkan 1.1 and multiview. Works headless on software drivers like lavapipe, see
+// --bench headless=1.
+#ifndef MULTIVIEW
+#define MULTIVIEW 0
+#endif
+
+#define MULTIVIEW_EYE_SEPARATION 0.064f // World units between the eyes
+#define MAX_VIEWS 2
+#define VIEW_COUNT (MULTIVIEW ? 2 : 1)
+
+// Two phase occlusion culling of clusters against a depth pyramid, see vk_occlusion.h. Needs
+// CLUSTER_CULLING. The pyramid only has one view, so it is off with MULTIVIEW.
+#ifndef OCCLUSION_CULLING
+#define OCCLUSION_CULLING (!MULTIVIEW)
+#endif
+static_assert(!(MULTIVIEW && OCCLUSION_CULLING), "Occlusion culling only works with a single view");
+
+// Lay down depth with a position only pipeline first, then shade with an EQUAL depth test and no
+// depth writes, so every pixel runs the fragment shader once. Can be toggled at runtime.
+#ifndef DEPTH_PREPASS
+#define DEPTH_PREPASS 1
+#endif
+
+// Cull back faces in the mesh pipelines, assumes counter clockwise outward facing triangles.
+#ifndef BACKFACE_CULLING
+#define BACKFACE_CULLING 1
 #endif
 
 #ifndef NUM_PUSH_CONSTANT_MAT4
@@ -39,6 +102,10 @@ struct GPUInfo_t {
     VkPhysicalDeviceMemoryProperties memProps = {};
     u32 gfxFamilyIndex = U32_MAX;
     u32 presentFamilyIndex = U32_MAX;
+    bool memoryBudgetSupported = false; // VK_EXT_memory_budget
+    bool descriptorIndexingSupported = false; // VK_EXT_descriptor_indexing with the features the bindless table needs
+    u32 maxBindlessTextures = 0; // Update after bind sampler limit per stage, zero without descriptor indexing
+    u32 timestampValidBits = 0; // Of the graphics queue, zero means no timestamps
 };
 
 struct Buffer_t {
@@ -63,6 +130,12 @@ struct Shader_t {
 struct Uniforms_t {
     glm::mat4 view;
     glm::mat4 proj;
+    glm::vec4 cameraPos;
+    glm::vec4 renderSize; // xy in pixels
+    glm::vec4 clusterDepth; // near, far, slice scale, slice bias: slice = log(depth) * scale + bias
+    glm::uvec4 lightInfo; // x = light count
+    glm::vec4 viewInfo; // x = how far an eye is from the camera, y = view count
+    glm::mat4 viewProj[MAX_VIEWS]; // Indexed by gl_ViewIndex, only the first one without MULTIVIEW
 };
 
 struct Swapchain_t
@@ -71,6 +144,7 @@ struct Swapchain_t
     std::vector<VkImage> images;
     u32 width, height;
     u32 imageCount;
+    VkPresentModeKHR presentMode;
 };
 
 enum SwapchainStatus_t
@@ -83,8 +157,85 @@ enum SwapchainStatus_t
 
 struct PushConstants_t {
     //glm::mat4 mat4_pushConst[NUM_PUSH_CONSTANT_MAT4];
+    u32 objectIndex;
+    u32 pad[3];
+};
+
+// Per object data, one entry per scene transform. Read by the vertex shader and the cluster culling pass.
+struct ObjectData_t {
     glm::mat4 model;
-    glm::vec4 lights[NUM_LIGHTS];
+    glm::mat4 normal;
+};
+
+// Has to match shaders/materials.glsl.
+struct Material_t {
+    glm::vec4 baseColor; // Multiplies the base color texture
+    u32 baseColorTexture; // Slot in the texture table, 0 is plain white
+    u32 pad[3];
+};
+
+struct PointLight_t {
+    glm::vec4 positionRadius; // World space, nothing is lit past the radius
+    glm::vec4 colorIntensity;
+};
+
+struct ClusterCullPushConstants_t {
+    glm::vec4 frustumPlanes[6]; // World space, xyz = normal, w = distance
+    glm::vec4 cameraPos;
+    u32 meshletCount;
+    u32 coneCulling;
+    u32 phase; // CullPhase_t
+    u32 pad;
+};
+
+// Without occlusion culling there is one phase. With it the early phase draws what passes against
+// the previous frame's depth pyramid, and the late phase re-tests the rest against this frame's.
+enum CullPhase_t : u32 {
+    CullPhase_Single,
+    CullPhase_Early,
+    CullPhase_Late,
+};
+
+#define DEPTH_PYRAMID_MAX_LEVELS 16 // Enough for a 32768 pixel wide target
+
+struct DepthPyramidPushConstants_t {
+    glm::uvec2 sourceSize; // Region of the source level to cover
+    glm::uvec2 destinationSize;
+    u32 sourceLevel;
+};
+
+struct ClusterCullStats_t {
+    u32 visibleClusters; // Drawn by either phase
+    u32 visibleTriangles;
+    u32 occludedClusters; // In the frustum but rejected by the late phase
+    u32 occludedTriangles;
+    u32 lateClusters; // Rejected by the early phase and drawn by the late one
+};
+
+// Fixed function state that differs between the mesh pipelines.
+struct PipelineState_t {
+    VkCullModeFlags cullMode;
+    VkCompareOp depthCompareOp;
+    VkBool32 depthWrite;
+    VkBool32 colorWrite;
+};
+
+enum MeshPass_t {
+    MeshPass_Color, // Depth test LESS with writes, no pre-pass
+    MeshPass_DepthPrepass,
+    MeshPass_ColorEqual, // Depth test EQUAL against the pre-pass, no writes
+};
+
+struct ResolutionStats_t {
+    f64 gpuMs; // Timestamps around the whole frame command buffer
+    f32 scale;
+    u32 width, height; // Rendered size, before upscaling to the swapchain
+};
+
+// From a pipeline statistics query around the main pass.
+struct PipelineStats_t {
+    u64 clippingPrimitives; // Primitives that made it to the rasterizer
+    u64 fragmentInvocations;
 };
 
 extern VulkanContext_t vk_context;
@@ -97,8 +248,8 @@ extern VmaAllocator vk_vma;
 extern VkFormat vk_swapchainFormat, vk_depthFormat;
 extern VkSemaphore vk_acquireSemaphore;
 extern VkSemaphore vk_releaseSemaphore;
+extern VkFence vk_frameFence;
 extern VkRenderPass vk_renderPass;
-extern VkFramebuffer vk_targetFramebuffer;
 extern VkCommandPool vk_commandPool;
 extern VkCommandBuffer vk_commandBuffer;
 extern VkDescriptorPool vk_descPool;
@@ -106,20 +257,40 @@ extern VkDescriptorSetLayout vk_descSetLayout;
 extern VkDescriptorSet vk_descSets[1];
 extern VkPipelineCache vk_pipelineCache;
 extern VkPipelineLayout vk_gfxPipeLayout;
-extern VkPipeline vk_meshPipeline ;
+extern VkDescriptorSetLayout vk_bindlessSetLayout;
+extern VkDescriptorSet vk_bindlessSet;
+extern VkDescriptorSetLayout vk_cullDescSetLayout;
+extern VkDescriptorSet vk_cullDescSet;
+extern VkPipelineLayout vk_cullPipeLayout;
+extern VkPipeline vk_clusterCullPipeline;
+extern VkDescriptorSetLayout vk_pyramidDescSetLayout;
+extern VkDescriptorSet vk_pyramidDescSets[DEPTH_PYRAMID_MAX_LEVELS]; // One per level
+extern VkPipelineLayout vk_pyramidPipeLayout;
+extern VkPipeline vk_depthPyramidPipeline;
+extern VkPipeline vk_lightBinPipeline;
+extern VkQueryPool vk_statsQueryPool;
+extern VkQueryPool vk_timestampQueryPool;
 
-extern Image_t vk_colorTarget;
-extern Image_t vk_depthTarget;
 
 extern Buffer_t vk_staticVertexBuffer;
 extern Buffer_t vk_staticIndexBuffer;
 extern Buffer_t vk_uniformBuffer;
+extern Buffer_t vk_meshletBuffer;
+extern Buffer_t vk_objectBuffer;
+extern Buffer_t vk_drawCommandBuffer;
+extern Buffer_t vk_cullStatsBuffer;
+extern Buffer_t vk_occlusionViewBuffer;
+extern Buffer_t vk_lightBuffer;
+extern Buffer_t vk_lightCountBuffer;
+extern Buffer_t vk_lightIndexBuffer;
 
 extern Uniforms_t vk_uniformData;
 extern PushConstants_t vk_pushConstants;
 
 extern Shader_t vk_meshVS;
+extern Shader_t vk_depthOnlyVS;
 extern Shader_t vk_goochFS;
 extern Shader_t vk_lambertFS;
+extern Shader_t vk_clusterCullCS;
 
 
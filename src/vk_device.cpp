@@ -11,7 +11,7 @@ VkInstance createInstance()
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "TBA";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_2;
+    appInfo.apiVersion = INSTANCE_API_VERSION;
 
     VkInstanceCreateInfo createInfo = { VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
     createInfo.pApplicationInfo = &appInfo;
@@ -42,6 +42,59 @@ VkInstance createInstance()
     return instance;
 }
 
+// Only needed with MULTIVIEW, the other vertex shader build does not use gl_ViewIndex. Core and
+// required since Vulkan 1.1, devices older than that are skipped then.
+static
+bool supportsMultiview(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    if (props.apiVersion < VK_API_VERSION_1_1) return false;
+
+    VkPhysicalDeviceMultiviewFeatures multiviewFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES };
+    VkPhysicalDeviceFeatures2 features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+    features.pNext = &multiviewFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    return multiviewFeatures.multiview;
+}
+
+// The texture table needs a partially bound array that can be written while frames using it are
+// in flight. Everything else about descriptor indexing is left off.
+static
+void queryDescriptorIndexing(GPUInfo_t &gpu, const std::vector<VkExtensionProperties> &availableExtensions)
+{
+    bool extensionFound = false;
+    for (const VkExtensionProperties &extension : availableExtensions) {
+        if (strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0) {
+            extensionFound = true;
+        }
+    }
+    if (!extensionFound) return;
+
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+    VkPhysicalDeviceFeatures2 features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+    features.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(gpu.device, &features);
+
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProps = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES };
+    VkPhysicalDeviceProperties2 props = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+    props.pNext = &indexingProps;
+    vkGetPhysicalDeviceProperties2(gpu.device, &props);
+
+    gpu.descriptorIndexingSupported = indexingFeatures.descriptorBindingPartiallyBound &&
+                                      indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+    if (gpu.descriptorIndexingSupported) {
+        u32 limit = indexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages;
+        if (indexingProps.maxPerStageDescriptorUpdateAfterBindSamplers < limit) {
+            limit = indexingProps.maxPerStageDescriptorUpdateAfterBindSamplers;
+        }
+        if (indexingProps.maxDescriptorSetUpdateAfterBindSampledImages < limit) {
+            limit = indexingProps.maxDescriptorSetUpdateAfterBindSampledImages;
+        }
+        gpu.maxBindlessTextures = limit;
+    }
+}
+
 GPUInfo_t pickGPU(VkInstance instance, VkSurfaceKHR surface)
 {
     // Get number of devices from first call to
@@ -152,13 +205,15 @@ GPUInfo_t pickGPU(VkInstance instance, VkSurfaceKHR surface)
         }
 
         // We also want to query for the features, properties or memory properties we are
-        // interested in. For now we only check for samplerAnisotropy (a feature).
+        // interested in. For now we only check for samplerAnisotropy, and multiview with MULTIVIEW
+        // (features).
         VkPhysicalDeviceFeatures features;
         vkGetPhysicalDeviceFeatures(physicalDevice, &features);
 
         bool physicalDeviceMeetsRequirements = (queueFamilyIndicesFound &&
                                                 requiredExtensionsAreSupported &&
-                                                features.samplerAnisotropy);
+                                                features.samplerAnisotropy &&
+                                                (!MULTIVIEW || supportsMultiview(physicalDevice)));
 
         if (physicalDeviceMeetsRequirements)
         {
@@ -174,6 +229,18 @@ GPUInfo_t pickGPU(VkInstance instance, VkSurfaceKHR surface)
             // Save the queue family indices for future reference
             gpu.gfxFamilyIndex = graphicsIndex;
             gpu.presentFamilyIndex = presentIndex;
+            gpu.timestampValidBits = familyProperties[graphicsIndex].timestampValidBits;
+
+            for (u32 j = 0; j < extensionCount; j++) {
+                if (strcmp(availableExtensions[j].extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+                    gpu.memoryBudgetSupported = true;
+                }
+            }
+            Logger::Trace("VK_EXT_memory_budget %s", gpu.memoryBudgetSupported ? "supported" : "not supported");
+
+            queryDescriptorIndexing(gpu, availableExtensions);
+            Logger::Trace("VK_EXT_descriptor_indexing %s, %i bindless textures",
+                          gpu.descriptorIndexingSupported ? "supported" : "not supported", gpu.maxBindlessTextures);
             break;
         }
     }
@@ -196,6 +263,17 @@ VkDevice createDevice(VkInstance instance, const GPUInfo_t* gpu)
     queueInfo.pQueuePriorities = queuePriorities;
 
     std::vector<const char*> extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    if (gpu->memoryBudgetSupported) {
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    // Only what the bindless texture table uses, see queryDescriptorIndexing.
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+    if (gpu->descriptorIndexingSupported) {
+        extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    }
 
     VkDeviceCreateInfo createInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
     createInfo.queueCreateInfoCount = 1;
@@ -205,6 +283,15 @@ VkDevice createDevice(VkInstance instance, const GPUInfo_t* gpu)
     createInfo.enabledExtensionCount = (u32)extensions.size();
 
     createInfo.pEnabledFeatures = &gpu->features;
+    createInfo.pNext = gpu->descriptorIndexingSupported ? &indexingFeatures : nullptr;
+
+    // Only with MULTIVIEW, see supportsMultiview.
+    VkPhysicalDeviceMultiviewFeatures multiviewFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES };
+    if (MULTIVIEW) {
+        multiviewFeatures.multiview = VK_TRUE;
+        multiviewFeatures.pNext = (void*)createInfo.pNext;
+        createInfo.pNext = &multiviewFeatures;
+    }
 
     VkDevice device = 0;
     VK_CHECK( vkCreateDevice(gpu->device, &createInfo, nullptr, &device) );
@@ -223,13 +310,13 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     {
         default:
         case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
-            Logger::Error(pCallbackData->pMessage);
+            Logger::Error("%s", pCallbackData->pMessage);
             break;
         case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
-            Logger::Warn(pCallbackData->pMessage);
+            Logger::Warn("%s", pCallbackData->pMessage);
             break;
         case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
-            Logger::Log(pCallbackData->pMessage);
+            Logger::Log("%s", pCallbackData->pMessage);
             break;
     }
 
@@ -2,6 +2,9 @@
 
 #include "vk_common.h"
 
+// Requested by the instance. The device can be older, see pickGPU.
+#define INSTANCE_API_VERSION VK_API_VERSION_1_2
+
 VkInstance createInstance();
 GPUInfo_t pickGPU(VkInstance instance, VkSurfaceKHR surface);
 VkDevice createDevice(VkInstance instance, const GPUInfo_t* gpu);
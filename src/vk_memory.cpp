@@ -0,0 +1,151 @@
+#include <atomic>
+
+#include "vk_memory.h"
+
+static const char *g_categoryNames[MemoryCategory_Count] = {
+        "static geometry",
+        "staging",
+        "uniforms",
+        "render targets",
+        "textures",
+        "indirect",
+};
+
+// Allocations can come from loading threads, so the running totals are atomics.
+static std::atomic<u64> g_categoryBytes[MemoryCategory_Count];
+static std::atomic<u32> g_categoryAllocations[MemoryCategory_Count];
+
+static MemoryStats_t g_memoryStats = {};
+static u32 g_memoryFrameIndex = 0;
+
+struct PressureCallback_t {
+    MemoryPressureCallback_t callback;
+    void *data;
+};
+
+static PressureCallback_t g_pressureCallbacks[MAX_MEMORY_PRESSURE_CALLBACKS];
+static u32 g_pressureCallbackCount = 0;
+
+const char *memoryCategoryName(MemoryCategory_t category) {
+    ASSERT(category < MemoryCategory_Count);
+    return g_categoryNames[category];
+}
+
+void *memoryCategoryUserData(MemoryCategory_t category) {
+    ASSERT(category < MemoryCategory_Count);
+    return (void *) (size_t) category;
+}
+
+void trackAllocation(VmaAllocation allocation) {
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(vk_vma, allocation, &info);
+    MemoryCategory_t category = (MemoryCategory_t) (size_t) info.pUserData;
+    ASSERT(category < MemoryCategory_Count);
+    g_categoryBytes[category].fetch_add(info.size, std::memory_order_relaxed);
+    g_categoryAllocations[category].fetch_add(1, std::memory_order_relaxed);
+}
+
+void trackFree(VmaAllocation allocation) {
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(vk_vma, allocation, &info);
+    MemoryCategory_t category = (MemoryCategory_t) (size_t) info.pUserData;
+    ASSERT(category < MemoryCategory_Count);
+    g_categoryBytes[category].fetch_sub(info.size, std::memory_order_relaxed);
+    g_categoryAllocations[category].fetch_sub(1, std::memory_order_relaxed);
+}
+
+void addMemoryPressureCallback(MemoryPressureCallback_t callback, void *data) {
+    ASSERT(g_pressureCallbackCount < MAX_MEMORY_PRESSURE_CALLBACKS);
+    g_pressureCallbacks[g_pressureCallbackCount++] = {callback, data};
+}
+
+static
+MemoryPressure_t pressureForUsage(VkDeviceSize usage, VkDeviceSize budget) {
+    if (budget == 0) return MemoryPressure_None;
+    f32 fraction = (f32) ((f64) usage / (f64) budget);
+    if (fraction >= MEMORY_PRESSURE_CRITICAL) return MemoryPressure_Critical;
+    if (fraction >= MEMORY_PRESSURE_HIGH) return MemoryPressure_High;
+    return MemoryPressure_None;
+}
+
+bool deviceMemoryFitsBudget(VkDeviceSize size) {
+    for (u32 i = 0; i < g_memoryStats.heapCount; i++) {
+        const HeapBudget_t &heap = g_memoryStats.heaps[i];
+        if (!heap.deviceLocal) continue;
+        if (pressureForUsage(heap.usage + size, heap.budget) != MemoryPressure_Critical) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void updateMemoryStats() {
+    // Lets VMA refresh its budget numbers from the driver.
+    vmaSetCurrentFrameIndex(vk_vma, g_memoryFrameIndex);
+
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetBudget(vk_vma, budgets);
+
+    bool detailed = g_memoryFrameIndex % MEMORY_DETAILED_STATS_INTERVAL == 0;
+    VmaStats vmaStats;
+    if (detailed) {
+        vmaCalculateStats(vk_vma, &vmaStats);
+    }
+
+    g_memoryStats.heapCount = vk_gpu.memProps.memoryHeapCount;
+    for (u32 i = 0; i < g_memoryStats.heapCount; i++) {
+        HeapBudget_t &heap = g_memoryStats.heaps[i];
+        heap.size = vk_gpu.memProps.memoryHeaps[i].size;
+        heap.deviceLocal = (vk_gpu.memProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heap.budget = budgets[i].budget;
+        heap.usage = budgets[i].usage;
+        heap.blockBytes = budgets[i].blockBytes;
+        heap.allocationBytes = budgets[i].allocationBytes;
+
+        if (detailed) {
+            const VmaStatInfo &info = vmaStats.memoryHeap[i];
+            heap.blockCount = info.blockCount;
+            heap.allocationCount = info.allocationCount;
+            heap.fragmentation = info.unusedBytes > 0
+                                 ? 1.0f - (f32) ((f64) info.unusedRangeSizeMax / (f64) info.unusedBytes)
+                                 : 0.0f;
+        }
+
+        MemoryPressure_t pressure = pressureForUsage(heap.usage, heap.budget);
+        if (pressure != heap.pressure) {
+            heap.pressure = pressure;
+            for (u32 c = 0; c < g_pressureCallbackCount; c++) {
+                g_pressureCallbacks[c].callback(i, pressure, heap, g_pressureCallbacks[c].data);
+            }
+        }
+    }
+
+    for (u32 c = 0; c < MemoryCategory_Count; c++) {
+        g_memoryStats.categoryBytes[c] = g_categoryBytes[c].load(std::memory_order_relaxed);
+        g_memoryStats.categoryAllocations[c] = g_categoryAllocations[c].load(std::memory_order_relaxed);
+    }
+
+    g_memoryFrameIndex += 1;
+}
+
+const MemoryStats_t &getMemoryStats() {
+    return g_memoryStats;
+}
+
+void logMemoryStats() {
+    const f64 MB = 1024.0 * 1024.0;
+    const MemoryStats_t &stats = g_memoryStats;
+
+    for (u32 i = 0; i < stats.heapCount; i++) {
+        const HeapBudget_t &heap = stats.heaps[i];
+        Logger::Log("Heap %i%s: usage %f / %f MB budget (%f MB heap), %i blocks %f MB, %i allocations %f MB, fragmentation %f",
+                    i, heap.deviceLocal ? " (device local)" : "",
+                    heap.usage / MB, heap.budget / MB, heap.size / MB,
+                    heap.blockCount, heap.blockBytes / MB,
+                    heap.allocationCount, heap.allocationBytes / MB, heap.fragmentation);
+    }
+    for (u32 c = 0; c < MemoryCategory_Count; c++) {
+        Logger::Log("  %s: %i allocations, %f MB", g_categoryNames[c], stats.categoryAllocations[c],
+                    stats.categoryBytes[c] / MB);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "vk_common.h"
+
+// Device memory accounting. Every buffer and image is created with a category so usage can be
+// broken down by what it is for, and VMA's per heap budget (backed by VK_EXT_memory_budget when
+// the device has it, an estimate otherwise) is refreshed once per frame.
+
+// Fraction of a heap's budget at which pressure callbacks fire.
+#ifndef MEMORY_PRESSURE_HIGH
+#define MEMORY_PRESSURE_HIGH 0.85f
+#endif
+#ifndef MEMORY_PRESSURE_CRITICAL
+#define MEMORY_PRESSURE_CRITICAL 0.95f
+#endif
+
+// Walking every block for fragmentation is not free, so it is only done this often.
+#define MEMORY_DETAILED_STATS_INTERVAL 60
+
+#define MAX_MEMORY_PRESSURE_CALLBACKS 8
+
+enum MemoryCategory_t : u32 {
+    MemoryCategory_StaticGeometry,
+    MemoryCategory_Staging,
+    MemoryCategory_Uniforms,
+    MemoryCategory_RenderTargets,
+    MemoryCategory_Textures,
+    MemoryCategory_Indirect, // Draw commands and cull results written by compute
+    MemoryCategory_Count
+};
+
+enum MemoryPressure_t : u32 {
+    MemoryPressure_None,
+    MemoryPressure_High,
+    MemoryPressure_Critical,
+};
+
+struct HeapBudget_t {
+    VkDeviceSize size;
+    VkDeviceSize budget; // What the driver says we can use, 80% of size without the extension
+    VkDeviceSize usage; // By this process, including memory not allocated through VMA
+    VkDeviceSize blockBytes; // Allocated from Vulkan by VMA
+    VkDeviceSize allocationBytes; // Handed out from those blocks
+    u32 blockCount;
+    u32 allocationCount;
+    f32 fragmentation; // 1 - largest free range / total free, from the last detailed update
+    bool deviceLocal;
+    MemoryPressure_t pressure;
+};
+
+struct MemoryStats_t {
+    u32 heapCount;
+    HeapBudget_t heaps[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize categoryBytes[MemoryCategory_Count];
+    u32 categoryAllocations[MemoryCategory_Count];
+};
+
+typedef void (*MemoryPressureCallback_t)(u32 heapIndex, MemoryPressure_t pressure, const HeapBudget_t &heap,
+                                         void *data);
+
+const char *memoryCategoryName(MemoryCategory_t category);
+
+// The category travels with the allocation as its VMA user data, see memoryCategoryUserData.
+void *memoryCategoryUserData(MemoryCategory_t category);
+void trackAllocation(VmaAllocation allocation);
+void trackFree(VmaAllocation allocation);
+
+// Called when a heap's pressure level changes, in either direction. Systems that can shed memory
+// (texture mips, cached data) use this to back off before allocations start failing.
+void addMemoryPressureCallback(MemoryPressureCallback_t callback, void *data);
+
+// Whether size more bytes fits in the budget of the device local heaps without going critical.
+bool deviceMemoryFitsBudget(VkDeviceSize size);
+
+void updateMemoryStats();
+const MemoryStats_t &getMemoryStats();
+void logMemoryStats();
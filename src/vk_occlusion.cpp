@@ -0,0 +1,210 @@
+#include "vk_occlusion.h"
+#include "vk_render.h"
+#include "vk_resources.h"
+#include "profiler.h"
+
+struct DepthPyramid_t {
+    Image_t image; // The view covers every level, for the cull shader
+    VkImageView levelViews[DEPTH_PYRAMID_MAX_LEVELS]; // Storage views the levels are written through
+    u32 width, height;
+    u32 levelCount;
+};
+
+static DepthPyramid_t g_pyramid = {};
+static VkSampler g_pyramidSampler = 0;
+static OcclusionView_t *g_mappedViews = nullptr;
+static OcclusionView_t g_currentView = {};
+static bool g_pyramidBuilt = false; // Since it was created, the early phase can test against it
+static bool g_pyramidFresh = false; // Still in the undefined layout
+
+static
+u32 previousPowerOfTwo(u32 value) {
+    u32 result = 1;
+    while (result * 2 <= value) result *= 2;
+    return result;
+}
+
+static
+void destroyRetiredPyramid(void *object) {
+    DepthPyramid_t *pyramid = (DepthPyramid_t *) object;
+    for (u32 i = 0; i < pyramid->levelCount; i++) {
+        vkDestroyImageView(vk_device, pyramid->levelViews[i], nullptr);
+    }
+    vkDestroyImageView(vk_device, pyramid->image.view, nullptr);
+    destroyImage(pyramid->image, vk_device, vk_vma);
+    delete pyramid;
+}
+
+void createOcclusionResources() {
+    // Only read with texelFetch, the filter does not matter.
+    VkSamplerCreateInfo samplerInfo = {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VK_CHECK(vkCreateSampler(vk_device, &samplerInfo, nullptr, &g_pyramidSampler));
+
+    // The frame fence is waited on before the next frame records, so one copy is enough.
+    ASSERT(vk_occlusionViewBuffer.buffer != VK_NULL_HANDLE);
+    vmaMapMemory(vk_vma, vk_occlusionViewBuffer.vmaAlloc, (void **) &g_mappedViews);
+    memset(g_mappedViews, 0, 2 * sizeof(OcclusionView_t));
+}
+
+void createDepthPyramid(u32 targetWidth, u32 targetHeight) {
+    if (g_pyramid.image.image) {
+        deferDestroy(frameNumber(), destroyRetiredPyramid, new DepthPyramid_t(g_pyramid));
+    }
+
+    DepthPyramid_t &pyramid = g_pyramid;
+    pyramid = {};
+    pyramid.width = previousPowerOfTwo(targetWidth);
+    pyramid.height = previousPowerOfTwo(targetHeight);
+    pyramid.levelCount = 1;
+    while ((pyramid.width >> pyramid.levelCount) > 0 || (pyramid.height >> pyramid.levelCount) > 0) {
+        pyramid.levelCount++;
+    }
+    ASSERT(pyramid.levelCount <= DEPTH_PYRAMID_MAX_LEVELS);
+
+    createImage(pyramid.image, vk_device, pyramid.width, pyramid.height, pyramid.levelCount, VK_FORMAT_R32_SFLOAT,
+                VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+                MemoryCategory_RenderTargets, vk_vma);
+
+    for (u32 i = 0; i < pyramid.levelCount; i++) {
+        VkImageViewCreateInfo viewInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        viewInfo.image = pyramid.image.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = i;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+        VK_CHECK(vkCreateImageView(vk_device, &viewInfo, nullptr, &pyramid.levelViews[i]));
+    }
+
+    // Level i reads level i - 1 through the full view and writes its own. Level 0 reads the depth
+    // target, see setDepthPyramidSource.
+    VkDescriptorImageInfo imageInfos[DEPTH_PYRAMID_MAX_LEVELS * 2] = {};
+    VkWriteDescriptorSet writes[DEPTH_PYRAMID_MAX_LEVELS * 2 + 1] = {};
+    u32 writeCount = 0;
+    for (u32 i = 0; i < pyramid.levelCount; i++) {
+        VkDescriptorImageInfo &source = imageInfos[i * 2];
+        source = {g_pyramidSampler, pyramid.image.view, VK_IMAGE_LAYOUT_GENERAL};
+        VkDescriptorImageInfo &destination = imageInfos[i * 2 + 1];
+        destination = {VK_NULL_HANDLE, pyramid.levelViews[i], VK_IMAGE_LAYOUT_GENERAL};
+
+        if (i > 0) {
+            VkWriteDescriptorSet &write = writes[writeCount++];
+            write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            write.dstSet = vk_pyramidDescSets[i];
+            write.dstBinding = 0;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write.descriptorCount = 1;
+            write.pImageInfo = &source;
+        }
+
+        VkWriteDescriptorSet &write = writes[writeCount++];
+        write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        write.dstSet = vk_pyramidDescSets[i];
+        write.dstBinding = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        write.descriptorCount = 1;
+        write.pImageInfo = &destination;
+    }
+
+    // The cull shader reads any level.
+    VkWriteDescriptorSet &cullWrite = writes[writeCount++];
+    cullWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    cullWrite.dstSet = vk_cullDescSet;
+    cullWrite.dstBinding = 4;
+    cullWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    cullWrite.descriptorCount = 1;
+    cullWrite.pImageInfo = &imageInfos[0];
+
+    vkUpdateDescriptorSets(vk_device, writeCount, writes, 0, nullptr);
+
+    g_pyramidBuilt = false;
+    g_pyramidFresh = true;
+    Logger::Trace("Depth pyramid %ix%i, %i levels", pyramid.width, pyramid.height, pyramid.levelCount);
+}
+
+VkImage depthPyramidImage() {
+    return g_pyramid.image.image;
+}
+
+void setDepthPyramidSource(VkImageView depthView) {
+    VkDescriptorImageInfo imageInfo = {g_pyramidSampler, depthView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+    VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = vk_pyramidDescSets[0];
+    write.dstBinding = 0;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(vk_device, 1, &write, 0, nullptr);
+}
+
+void updateOcclusionViews(const glm::mat4 &view, const glm::mat4 &proj) {
+    ASSERT(g_mappedViews != nullptr);
+
+    OcclusionView_t previous = g_currentView;
+    previous.pyramid.w = g_pyramidBuilt ? 1.0f : 0.0f;
+
+    g_currentView.view = view;
+    g_currentView.projection = glm::vec4(proj[0][0], proj[1][1], proj[2][2], proj[3][2]);
+    g_currentView.pyramid = glm::vec4((f32) g_pyramid.width, (f32) g_pyramid.height, (f32) g_pyramid.levelCount,
+                                      1.0f);
+
+    g_mappedViews[0] = previous;
+    g_mappedViews[1] = g_currentView;
+}
+
+void prepareDepthPyramid(VkCommandBuffer cmd) {
+    if (!g_pyramidFresh) return;
+
+    // Reads before the first build see garbage, the early phase does not test until there is one.
+    VkImageMemoryBarrier barrier = imageMemoryBarrier(g_pyramid.image.image, 0, VK_ACCESS_SHADER_READ_BIT,
+                                                      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                                                      VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+    g_pyramidFresh = false;
+}
+
+void recordDepthPyramid(VkCommandBuffer cmd, u32 renderWidth, u32 renderHeight) {
+    PROFILE_FUNCTION();
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, vk_depthPyramidPipeline);
+
+    u32 sourceWidth = renderWidth;
+    u32 sourceHeight = renderHeight;
+    for (u32 i = 0; i < g_pyramid.levelCount; i++) {
+        DepthPyramidPushConstants_t pushConstants = {};
+        pushConstants.sourceSize = glm::uvec2(sourceWidth, sourceHeight);
+        pushConstants.destinationSize = glm::uvec2(g_pyramid.width >> i, g_pyramid.height >> i);
+        pushConstants.destinationSize = glm::max(pushConstants.destinationSize, glm::uvec2(1));
+        pushConstants.sourceLevel = i > 0 ? i - 1 : 0;
+
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, vk_pyramidPipeLayout,
+                                0, 1, &vk_pyramidDescSets[i], 0, nullptr);
+        vkCmdPushConstants(cmd, vk_pyramidPipeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(pushConstants), &pushConstants);
+        vkCmdDispatch(cmd, (pushConstants.destinationSize.x + 7) / 8, (pushConstants.destinationSize.y + 7) / 8, 1);
+
+        // The next level reads this one. The graph covers the reads after the last level.
+        if (i + 1 < g_pyramid.levelCount) {
+            VkImageMemoryBarrier barrier = imageMemoryBarrier(g_pyramid.image.image, VK_ACCESS_SHADER_WRITE_BIT,
+                                                              VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL,
+                                                              VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        sourceWidth = pushConstants.destinationSize.x;
+        sourceHeight = pushConstants.destinationSize.y;
+    }
+
+    g_pyramidBuilt = true;
+}
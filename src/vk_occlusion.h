@@ -0,0 +1,45 @@
+#pragma once
+
+#include "vk_common.h"
+
+// Hierarchical-Z occlusion culling for the cluster cull. The depth pyramid is a mip chain holding
+// the farthest depth of the rendered region, built by compute from the depth target. A frame
+// culls clusters twice:
+//
+//   early: clusters that pass against the previous frame's pyramid, seen with the previous
+//          frame's view, are drawn in the main pass.
+//   late:  the pyramid is rebuilt from that depth, the clusters the early phase rejected are
+//          tested again with this frame's view and the ones that show up are drawn on top.
+//
+// The late test only trusts depth that was really drawn this frame, so nothing visible stays
+// culled, the early test only decides what goes first. The pyramid built mid frame is the one the
+// next frame's early phase tests against.
+
+// Matches OcclusionView in cluster_cull.comp.glsl (std430).
+struct OcclusionView_t {
+    glm::mat4 view;
+    glm::vec4 projection; // proj[0][0], proj[1][1], proj[2][2], proj[3][2]
+    glm::vec4 pyramid; // Level 0 width and height, level count, 0 when there is no pyramid yet
+};
+
+// After the cluster buffers, they hold the view buffer.
+void createOcclusionResources();
+
+// For render targets of targetWidth x targetHeight, any earlier pyramid is freed once the frames
+// using it are done. Level 0 is the largest power of two that fits, it covers the rendered region
+// whatever its scale. The next early phase has nothing to test against.
+void createDepthPyramid(u32 targetWidth, u32 targetHeight);
+VkImage depthPyramidImage();
+
+// The depth target level 0 is built from. Between frames, it changes with the frame graph.
+void setDepthPyramidSource(VkImageView depthView);
+
+// Before the early phase. What was this frame's view becomes the previous one.
+void updateOcclusionViews(const glm::mat4 &view, const glm::mat4 &proj);
+
+// Moves a new pyramid out of the undefined layout, nothing else in the frame has to know.
+void prepareDepthPyramid(VkCommandBuffer cmd);
+
+// Every level from the depth of the renderWidth x renderHeight region, inside the frame graph pass
+// that reads the depth and writes the pyramid.
+void recordDepthPyramid(VkCommandBuffer cmd, u32 renderWidth, u32 renderHeight);
@@ -1,78 +1,301 @@
 #include <cmath>
 
+#define M_PI 3.14159265f
 
-#define ARRAYSIZE(a) \
-  ((sizeof(a) / sizeof(*(a))) / \
-  static_cast<size_t>(!(sizeof(a) % sizeof(*(a)))))
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 256.0f
 
-#define M_PI 3.14159265f
+#define TWO_PHASE_CULLING (CLUSTER_CULLING && OCCLUSION_CULLING)
 
 #include "vk_common.h"
 #include "vk_swapchain.h"
 #include "vk_resources.h"
 #include "vk_render.h"
 #include "vk_renderprograms.h"
-
-Image_t vk_colorTarget = {};
-Image_t vk_depthTarget = {};
-
-VkFramebuffer vk_targetFramebuffer = 0;
+#include "vk_rendergraph.h"
+#include "vk_occlusion.h"
+#include "resolution.h"
+#include "pacing.h"
+#include "profiler.h"
+
+static RenderGraph_t g_frameGraph;
+static RGResource_t g_colorResource;
+static RGResource_t g_swapchainResource;
+static RGPass_t g_clearCullStatsPass;
+static RGPass_t g_cullPass;
+static RGPass_t g_lightBinPass;
+static RGPass_t g_mainPass;
+static RGPass_t g_depthPyramidPass;
+static RGPass_t g_lateCullPass;
+static RGPass_t g_lateMainPass;
+static RGPass_t g_presentPass;
+static RGPass_t g_openMainPass; // The one the mesh draws go into, ended by submitFrame
+
+// The targets only ever grow, the frame is rendered into the top left renderWidth x renderHeight.
+static u32 g_targetWidth = 0;
+static u32 g_targetHeight = 0;
+static u32 g_renderWidth = 0;
+static u32 g_renderHeight = 0;
+static ResolutionController_t g_resolution;
+static bool g_dynamicResolution = false;
+static f64 g_gpuFrameMs = 0.0;
+
+static ClusterCullStats_t g_clusterCullStats = {};
+static ClusterCullPushConstants_t g_cullData = {}; // Of the early phase, the late one only changes the phase
+static u32 g_drawCommandOffset = 0; // Where the draw commands of the current phase start
+static PipelineStats_t g_pipelineStats = {};
+static MeshPass_t g_meshPass = MeshPass_Color;
+
+// Picks the mesh pipeline variant together with g_meshPass.
+static ShadingModel_t g_shadingModel = ShadingModel_Lambert;
+static u32 g_maxShadedLights = MAX_LIGHTS_PER_CLUSTER;
+
+// Frames submitted so far, the last one is also the last completed since submitFrame waits on it.
+static u64 g_frameNumber = 0;
+
+// The swapchain is only checked against the surface after one of these, never per frame.
+static bool g_surfaceResized = false;
+static bool g_swapchainOutOfDate = false;
+static VkPresentModeKHR g_presentMode = DEFAULT_PRESENT_MODE; // Requested, vk_swapchain has the one in use
+
+// Each view gets its own part of the swapchain, side by side.
+static
+u32 outputViewWidth() {
+    return vk_swapchain.width / VIEW_COUNT;
+}
 
 void updateUniforms() {
 
-    auto updateUBO = [&](Uniforms_t uniforms, Buffer_t &ubo_buffer, u32 width, u32 height,
+    auto updateUBO = [&](Uniforms_t &uniforms, Buffer_t &ubo_buffer, u32 width, u32 height,
                          VmaAllocator &vma_allocator) {
 
         uniforms.proj = glm::perspective(glm::radians(40.0f),
                                          (f32) width / (f32) height,
-                                        0.1f, 256.0f);
+                                         CAMERA_NEAR, CAMERA_FAR);
         uniforms.proj[1][1] *= -1;
 
+        // The eyes sit to the left and right of the camera and look the same way. Everything that
+        // is not per view, the light clusters and the cluster slices for one, uses the camera.
+        f32 eyeDistance = MULTIVIEW ? MULTIVIEW_EYE_SEPARATION * 0.5f : 0.0f;
+        for (u32 i = 0; i < VIEW_COUNT; i++) {
+            f32 eyeX = i == 0 ? -eyeDistance : eyeDistance;
+            uniforms.viewProj[i] = uniforms.proj * glm::translate(glm::mat4(1.0f), glm::vec3(-eyeX, 0.0f, 0.0f)) *
+                                   uniforms.view;
+        }
+        uniforms.viewInfo = glm::vec4(eyeDistance, (f32) VIEW_COUNT, 0.0f, 0.0f);
+
+        // Clusters cover the rendered part of the targets. Slice k starts at near * (far / near)^(k / Z).
+        f32 logRange = logf(CAMERA_FAR / CAMERA_NEAR);
+        uniforms.renderSize = glm::vec4((f32) g_renderWidth, (f32) g_renderHeight, 0.0f, 0.0f);
+        uniforms.clusterDepth = glm::vec4(CAMERA_NEAR, CAMERA_FAR, LIGHT_CLUSTERS_Z / logRange,
+                                          -LIGHT_CLUSTERS_Z * logf(CAMERA_NEAR) / logRange);
+
         void *data;
         vmaMapMemory(vma_allocator, ubo_buffer.vmaAlloc, &data);
         memcpy(data, &uniforms, sizeof(uniforms));
         vmaUnmapMemory(vma_allocator, ubo_buffer.vmaAlloc);
     };
 
-    updateUBO(vk_uniformData, vk_uniformBuffer, vk_swapchain.width, vk_swapchain.height, vk_vma);
+    updateUBO(vk_uniformData, vk_uniformBuffer, outputViewWidth(), vk_swapchain.height, vk_vma);
 }
 
-u32 prepareFrame() {
+// Scaling needs timestamps to steer by and a linear blit from the color target to the swapchain,
+// both use the swapchain format.
+void initDynamicResolution() {
+    VkFormatProperties formatProps;
+    vkGetPhysicalDeviceFormatProperties(vk_gpu.device, vk_swapchainFormat, &formatProps);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    bool canBlit = (formatProps.optimalTilingFeatures & blitFeatures) == blitFeatures;
+
+    g_dynamicResolution = DYNAMIC_RESOLUTION && canBlit && vk_timestampQueryPool;
+    g_resolution = ResolutionController_t();
+    if (DYNAMIC_RESOLUTION && !canBlit) {
+        Logger::Warn("Swapchain format can't be blitted with a linear filter, no dynamic resolution");
+    }
+    Logger::Trace("Dynamic resolution %s, target %f ms", g_dynamicResolution ? "on" : "off", g_resolution.targetMs);
+}
 
-    SwapchainStatus_t swapchainStatus = updateSwapchain(vk_swapchain, vk_gpu.device, vk_device,
-                                                        vk_context.surface, vk_swapchainFormat,
-                                                        vk_gpu.gfxFamilyIndex);
+// The whole frame: cluster culling, the main pass into the render targets and the copy to the
+// swapchain. With occlusion culling the depth pyramid is built after the main pass, followed by
+// the late cull and a second main pass that adds what it found. Rebuilt when the targets grow.
+static
+void destroyRetiredGraph(void *object) {
+    RenderGraph_t *graph = (RenderGraph_t *) object;
+    destroyRenderGraph(*graph, vk_device, vk_vma);
+    delete graph;
+}
 
-    if (swapchainStatus == Swapchain_NotReady) {
-        return U32_MAX; // surface size is zero, don't render anything this iteration.
+static
+void destroyRetiredSwapchain(void *object) {
+    Swapchain_t *swapchain = (Swapchain_t *) object;
+    destroySwapchain(vk_device, *swapchain);
+    delete swapchain;
+}
+
+static
+void buildFrameGraph(u32 width, u32 height) {
+    // The old graph goes once the last frame using it is done instead of idling the device.
+    if (g_frameGraph.compiled) {
+        deferDestroy(g_frameNumber, destroyRetiredGraph, new RenderGraph_t(std::move(g_frameGraph)));
+        g_frameGraph = RenderGraph_t();
     }
+    RenderGraph_t &graph = g_frameGraph;
+
+    // A layer per view, the main passes draw all of them at once.
+    g_colorResource = createTransientImage(graph, "color", {width, height, vk_swapchainFormat,
+                                                            VK_IMAGE_ASPECT_COLOR_BIT, VIEW_COUNT});
+    RGResource_t depth = createTransientImage(graph, "depth", {width, height, vk_depthFormat,
+                                                               VK_IMAGE_ASPECT_DEPTH_BIT, VIEW_COUNT});
+    g_swapchainResource = importImage(graph, "swapchain", {vk_swapchain.width, vk_swapchain.height,
+                                                           vk_swapchainFormat, VK_IMAGE_ASPECT_COLOR_BIT},
+                                      RGAccess_None, RGAccess_Present);
+
+    RGResource_t drawCommands = 0;
+    RGResource_t cullStats = 0;
+    RGResource_t pyramid = 0;
+#if CLUSTER_CULLING
+    // The cull shader always binds a pyramid, without occlusion culling it is a single texel.
+    createDepthPyramid(OCCLUSION_CULLING ? width : 1, OCCLUSION_CULLING ? height : 1);
+
+    drawCommands = importBuffer(graph, "draw commands", vk_drawCommandBuffer.buffer, vk_drawCommandBuffer.size,
+                                RGAccess_None, RGAccess_None);
+    cullStats = importBuffer(graph, "cull stats", vk_cullStatsBuffer.buffer, vk_cullStatsBuffer.size,
+                             RGAccess_None, RGAccess_HostRead);
+
+    g_clearCullStatsPass = addGraphPass(graph, "clear cull stats", RGPass_Transfer);
+    writeResource(graph, g_clearCullStatsPass, cullStats, RGAccess_TransferWrite);
+
+    g_cullPass = addGraphPass(graph, "cluster cull", RGPass_Compute);
+    writeResource(graph, g_cullPass, drawCommands, RGAccess_ComputeWrite);
+    writeResource(graph, g_cullPass, cullStats, RGAccess_ComputeReadWrite);
+#endif
+#if TWO_PHASE_CULLING
+    // Kept from one frame to the next, the early cull reads the previous frame's.
+    pyramid = importImage(graph, "depth pyramid", {width, height, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT},
+                          RGAccess_ComputeRead, RGAccess_ComputeRead);
+    readResource(graph, g_cullPass, pyramid, RGAccess_ComputeRead);
+#endif
+
+    VkClearColorValue clearColor = {48.0f / 255.0f, 10.0f / 255.0f, 36.0f / 255.0f, 1};
+    RGResource_t lightCounts = importBuffer(graph, "light counts", vk_lightCountBuffer.buffer,
+                                            vk_lightCountBuffer.size, RGAccess_None, RGAccess_None);
+    RGResource_t lightIndices = importBuffer(graph, "light indices", vk_lightIndexBuffer.buffer,
+                                             vk_lightIndexBuffer.size, RGAccess_None, RGAccess_None);
+
+    g_lightBinPass = addGraphPass(graph, "light binning", RGPass_Compute);
+    writeResource(graph, g_lightBinPass, lightCounts, RGAccess_ComputeWrite);
+    writeResource(graph, g_lightBinPass, lightIndices, RGAccess_ComputeWrite);
+
+    VkClearDepthStencilValue clearDepth = {1.0f, 0};
+    g_mainPass = addGraphPass(graph, "main", RGPass_Graphics);
+    addColorAttachment(graph, g_mainPass, g_colorResource, &clearColor);
+    setDepthAttachment(graph, g_mainPass, depth, &clearDepth);
+#if CLUSTER_CULLING
+    readResource(graph, g_mainPass, drawCommands, RGAccess_IndirectRead);
+#endif
+    readResource(graph, g_mainPass, lightCounts, RGAccess_FragmentRead);
+    readResource(graph, g_mainPass, lightIndices, RGAccess_FragmentRead);
+
+#if TWO_PHASE_CULLING
+    g_depthPyramidPass = addGraphPass(graph, "depth pyramid", RGPass_Compute);
+    readResource(graph, g_depthPyramidPass, depth, RGAccess_ComputeSampled);
+    writeResource(graph, g_depthPyramidPass, pyramid, RGAccess_ComputeReadWrite);
+
+    g_lateCullPass = addGraphPass(graph, "late cluster cull", RGPass_Compute);
+    readResource(graph, g_lateCullPass, pyramid, RGAccess_ComputeRead);
+    writeResource(graph, g_lateCullPass, drawCommands, RGAccess_ComputeReadWrite);
+    writeResource(graph, g_lateCullPass, cullStats, RGAccess_ComputeReadWrite);
+
+    // Loads what the main pass drew.
+    g_lateMainPass = addGraphPass(graph, "late main", RGPass_Graphics);
+    addColorAttachment(graph, g_lateMainPass, g_colorResource, nullptr);
+    setDepthAttachment(graph, g_lateMainPass, depth, nullptr);
+    readResource(graph, g_lateMainPass, drawCommands, RGAccess_IndirectRead);
+    readResource(graph, g_lateMainPass, lightCounts, RGAccess_FragmentRead);
+    readResource(graph, g_lateMainPass, lightIndices, RGAccess_FragmentRead);
+#endif
+
+    g_presentPass = addGraphPass(graph, "present copy", RGPass_Transfer);
+    readResource(graph, g_presentPass, g_colorResource, RGAccess_TransferRead);
+    writeResource(graph, g_presentPass, g_swapchainResource, RGAccess_TransferWrite);
+
+    compileRenderGraph(graph, vk_device, vk_vma);
+
+#if TWO_PHASE_CULLING
+    setImportedImage(graph, pyramid, depthPyramidImage(), VK_NULL_HANDLE);
+    setDepthPyramidSource(graph.resources[depth].view);
+#endif
+}
 
-    if (swapchainStatus == Swapchain_Resized || !vk_targetFramebuffer) {
-        if (vk_colorTarget.image) {
-            destroyImage(vk_colorTarget, vk_device, vk_vma);
-        }
-        if (vk_depthTarget.image) {
-            destroyImage(vk_depthTarget, vk_device, vk_vma);
+u64 frameNumber() {
+    return g_frameNumber;
+}
+
+void surfaceResized() {
+    g_surfaceResized = true;
+}
+
+void setPresentMode(VkPresentModeKHR mode) {
+    if (mode == g_presentMode) return;
+    g_presentMode = mode;
+    g_swapchainOutOfDate = true;
+}
+
+u32 prepareFrame() {
+    PROFILE_FUNCTION();
+
+    if (g_surfaceResized || g_swapchainOutOfDate) {
+        Swapchain_t retired = {};
+        SwapchainStatus_t swapchainStatus = updateSwapchain(vk_swapchain, retired, vk_gpu.device, vk_device,
+                                                            vk_context.surface, vk_swapchainFormat, g_presentMode,
+                                                            vk_gpu.gfxFamilyIndex, g_swapchainOutOfDate);
+
+        if (swapchainStatus == Swapchain_NotReady) {
+            return U32_MAX; // surface size is zero, don't render anything this iteration.
         }
-        if (vk_targetFramebuffer) {
-            vkDestroyFramebuffer(vk_device, vk_targetFramebuffer, nullptr);
+
+        if (swapchainStatus == Swapchain_Resized) {
+            // Images of the old swapchain can still be waiting for the presentation engine, which
+            // no fence covers. Presents are in order and the engine holds at most imageCount of
+            // them, so they are through once that many frames on the new swapchain have finished.
+            deferDestroy(g_frameNumber + vk_swapchain.imageCount, destroyRetiredSwapchain,
+                         new Swapchain_t(retired));
+            Logger::Trace("Swapchain %ix%i, %i images, %s", vk_swapchain.width, vk_swapchain.height,
+                          vk_swapchain.imageCount, presentModeName(vk_swapchain.presentMode));
         }
+        g_surfaceResized = false;
+        g_swapchainOutOfDate = false;
+    }
+
+    // Shrinking the window keeps the old targets, only growing past them reallocates.
+    u32 viewWidth = outputViewWidth();
+    if (viewWidth > g_targetWidth || vk_swapchain.height > g_targetHeight || !g_frameGraph.compiled) {
+        g_targetWidth = viewWidth > g_targetWidth ? viewWidth : g_targetWidth;
+        g_targetHeight = vk_swapchain.height > g_targetHeight ? vk_swapchain.height : g_targetHeight;
+        Logger::Trace("Render targets %ix%i, %i views", g_targetWidth, g_targetHeight, VIEW_COUNT);
 
-        createImage(vk_colorTarget, vk_device, vk_swapchain.width, vk_swapchain.height, vk_swapchainFormat,
-                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
-                    vk_vma);
-        createImage(vk_depthTarget, vk_device, vk_swapchain.width, vk_swapchain.height, vk_depthFormat,
-                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, vk_vma);
-        vk_targetFramebuffer = createFramebuffer(vk_device, vk_renderPass, vk_colorTarget.view, vk_depthTarget.view,
-                                                 vk_swapchain.width,
-                                                 vk_swapchain.height);
+        buildFrameGraph(g_targetWidth, g_targetHeight);
     }
 
+    scaledExtent(g_resolution, viewWidth, vk_swapchain.height, &g_renderWidth, &g_renderHeight);
+
     u32 imageIndex = 0;
-    VK_CHECK(
-            vkAcquireNextImageKHR(vk_device, vk_swapchain.swapchain, U64_MAX,
-                                  vk_acquireSemaphore, /*fence=*/VK_NULL_HANDLE, &imageIndex)
-    );
+    VkResult acquireResult = vkAcquireNextImageKHR(vk_device, vk_swapchain.swapchain, U64_MAX,
+                                                   vk_acquireSemaphore, /*fence=*/VK_NULL_HANDLE, &imageIndex);
+    if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+        // Nothing was acquired and the semaphore is not signaled, skip the frame and recreate.
+        g_swapchainOutOfDate = true;
+        return U32_MAX;
+    }
+    if (acquireResult == VK_SUBOPTIMAL_KHR) {
+        // Still presentable, recreate before the next frame.
+        g_swapchainOutOfDate = true;
+    } else {
+        VK_CHECK(acquireResult);
+    }
+
+    setImportedImage(g_frameGraph, g_swapchainResource, vk_swapchain.images[imageIndex], VK_NULL_HANDLE);
 
     VK_CHECK(vkResetCommandPool(vk_device, vk_commandPool, 0)); //TODO(anton): Find out if I need it and why.
 
@@ -81,61 +304,111 @@ u32 prepareFrame() {
 
     VK_CHECK(vkBeginCommandBuffer(vk_commandBuffer, &cmdBeginInfo));
 
-    VkImageMemoryBarrier renderBeginBarriers[2] =
-            {
-                    imageMemoryBarrier(vk_colorTarget.image,
-                                       0,
-                                       0,
-                                       VK_IMAGE_LAYOUT_UNDEFINED,
-                                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                       VK_IMAGE_ASPECT_COLOR_BIT),
-
-                    imageMemoryBarrier(vk_depthTarget.image,
-                                       0,
-                                       0,
-                                       VK_IMAGE_LAYOUT_UNDEFINED,
-                                       VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                                       VK_IMAGE_ASPECT_DEPTH_BIT)
-            };
-
-    vkCmdPipelineBarrier(vk_commandBuffer,
-                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                         VK_DEPENDENCY_BY_REGION_BIT,
-                         0, 0, 0, 0, ARRAYSIZE(renderBeginBarriers), renderBeginBarriers);
-
-    VkClearColorValue color = {48.0f / 255.0f, 10.0f / 255.0f, 36.0f / 255.0f, 1};
-    VkClearValue clearVals[2];
-    clearVals[0].color = color;
-    clearVals[1].depthStencil = {1.0f, 0};
-
-    VkRenderPassBeginInfo rpBeginInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
-    rpBeginInfo.renderPass = vk_renderPass;
-    rpBeginInfo.framebuffer = vk_targetFramebuffer;
-    rpBeginInfo.renderArea.offset.x = 0;
-    rpBeginInfo.renderArea.offset.y = 0;
-    rpBeginInfo.renderArea.extent.width = vk_swapchain.width;
-    rpBeginInfo.renderArea.extent.height = vk_swapchain.height;
-    rpBeginInfo.clearValueCount = ARRAYSIZE(clearVals);
-    rpBeginInfo.pClearValues = clearVals;
-
-    vkCmdBeginRenderPass(vk_commandBuffer, &rpBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if (vk_statsQueryPool) {
+        vkCmdResetQueryPool(vk_commandBuffer, vk_statsQueryPool, 0, 1);
+    }
+    if (vk_timestampQueryPool) {
+        vkCmdResetQueryPool(vk_commandBuffer, vk_timestampQueryPool, 0, 2);
+        vkCmdWriteTimestamp(vk_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, vk_timestampQueryPool, 0);
+    }
+
+    return imageIndex;
+}
+
+// Gribb/Hartmann plane extraction, for a [0, 1] depth range.
+static
+void extractFrustumPlanes(const glm::mat4 &viewProj, glm::vec4 *planes) {
+    glm::vec4 rows[4];
+    for (u32 i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    }
+
+    planes[0] = rows[3] + rows[0]; // left
+    planes[1] = rows[3] - rows[0]; // right
+    planes[2] = rows[3] + rows[1]; // bottom
+    planes[3] = rows[3] - rows[1]; // top
+    planes[4] = rows[2];           // near
+    planes[5] = rows[3] - rows[2]; // far
+
+    for (u32 i = 0; i < 6; i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
+
+static
+void recordClusterCull(RGPass_t pass, const ClusterCullPushConstants_t &cullData) {
+    if (!beginGraphPass(g_frameGraph, vk_commandBuffer, pass)) return;
+
+    vkCmdBindPipeline(vk_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_clusterCullPipeline);
+    vkCmdBindDescriptorSets(vk_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_cullPipeLayout,
+                            0, 1, &vk_cullDescSet, 0, nullptr);
+    vkCmdPushConstants(vk_commandBuffer, vk_cullPipeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(cullData), &cullData);
+
+    vkCmdDispatch(vk_commandBuffer, (cullData.meshletCount + 63) / 64, 1, 1);
+
+    endGraphPass(g_frameGraph, vk_commandBuffer, pass);
+}
+
+void cullClusters(u32 meshletCount) {
+    PROFILE_FUNCTION();
+    ClusterCullPushConstants_t &cullData = g_cullData;
+    cullData = {};
+    extractFrustumPlanes(vk_uniformData.viewProj[0], cullData.frustumPlanes);
+#if MULTIVIEW
+    // Both eyes in one pass. The eyes only differ by a sideways shift, so the left eye's frustum
+    // with the right eye's right plane holds everything either of them sees. The cone test is made
+    // from the camera position and can't speak for both eyes.
+    glm::vec4 rightEyePlanes[6];
+    extractFrustumPlanes(vk_uniformData.viewProj[1], rightEyePlanes);
+    cullData.frustumPlanes[1] = rightEyePlanes[1];
+#endif
+    cullData.cameraPos = glm::vec4(glm::vec3(glm::inverse(vk_uniformData.view)[3]), 1.0f);
+    cullData.meshletCount = meshletCount;
+    cullData.coneCulling = CLUSTER_CONE_CULLING && !MULTIVIEW;
+    cullData.phase = TWO_PHASE_CULLING ? CullPhase_Early : CullPhase_Single;
+
+    updateOcclusionViews(vk_uniformData.view, vk_uniformData.proj);
+    prepareDepthPyramid(vk_commandBuffer);
+
+    if (beginGraphPass(g_frameGraph, vk_commandBuffer, g_clearCullStatsPass)) {
+        vkCmdFillBuffer(vk_commandBuffer, vk_cullStatsBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+        endGraphPass(g_frameGraph, vk_commandBuffer, g_clearCullStatsPass);
+    }
+
+    recordClusterCull(g_cullPass, cullData);
+}
+
+void binLights() {
+    PROFILE_FUNCTION();
+    if (!beginGraphPass(g_frameGraph, vk_commandBuffer, g_lightBinPass)) return;
 
+    vkCmdBindPipeline(vk_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_lightBinPipeline);
+    vkCmdBindDescriptorSets(vk_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_gfxPipeLayout,
+                            0, 1, vk_descSets, 0, nullptr);
+
+    vkCmdDispatch(vk_commandBuffer, (LIGHT_CLUSTER_COUNT + 63) / 64, 1, 1);
+
+    endGraphPass(g_frameGraph, vk_commandBuffer, g_lightBinPass);
+}
 
+// Viewport and bindings for the mesh draws, at the start of either main pass.
+static
+void setMainPassState() {
     //NOTE(anton): swap the height here to account for Vulkan
     //screenspace layout? This is probably faster than multiplying
     //proj matrix by -1? -- not used right now.
     VkViewport viewport = {};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = (f32) vk_swapchain.width;
-    viewport.height = (f32) vk_swapchain.height;
+    viewport.width = (f32) g_renderWidth;
+    viewport.height = (f32) g_renderHeight;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
 
     VkRect2D scissor = {
             {0,                        0},
-            {(u32) vk_swapchain.width, (u32) vk_swapchain.height}
+            {g_renderWidth, g_renderHeight}
     };
 
     vkCmdSetViewport(vk_commandBuffer, 0, 1, &viewport);
@@ -148,86 +421,164 @@ u32 prepareFrame() {
     vkCmdBindVertexBuffers(vk_commandBuffer, 0, 1, &vk_staticVertexBuffer.buffer, &vtxOffset);
     vkCmdBindIndexBuffer(vk_commandBuffer, vk_staticIndexBuffer.buffer, idxOffset, VK_INDEX_TYPE_UINT32);
 
-    return imageIndex;
+    // Every mesh pipeline variant shares vk_gfxPipeLayout, so both sets stay bound across pipeline
+    // changes. Materials are picked through the object index, no draw binds anything itself.
+    VkDescriptorSet meshSets[2] = {vk_descSets[0], vk_bindlessSet};
+    vkCmdBindDescriptorSets(vk_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_gfxPipeLayout,
+                            0, 2, meshSets, 0, nullptr);
 }
 
-void drawMesh(u32 startVertex, u32 startIndex, u32 indexCount, f64 time) {
-//
-//    Logger::Trace("startVertex %i, startIndex %i, indexCount %i",
-//            startVertex, startIndex, indexCount);
-    auto updateLightsPushConstants = [&](glm::vec4 &lights, f64 t) {
-        f64 scale = 0.3f;
-        f64 angle = 2.0f * M_PI * t;
-        lights.x += scale * cos(angle / 4.0f);
-    };
+void beginMainPass() {
+    // Outside the render pass, it spans the late main pass as well.
+    if (vk_statsQueryPool) {
+        vkCmdBeginQuery(vk_commandBuffer, vk_statsQueryPool, 0, 0);
+    }
+
+    VkRect2D renderArea = {{0, 0}, {g_renderWidth, g_renderHeight}};
+    bool recording = beginGraphPass(g_frameGraph, vk_commandBuffer, g_mainPass, &renderArea);
+    ASSERT(recording);
+
+    setMainPassState();
+    g_openMainPass = g_mainPass;
+    g_drawCommandOffset = 0;
+}
+
+void beginLateMainPass() {
+    PROFILE_FUNCTION();
+    ASSERT_MSG(TWO_PHASE_CULLING, "The late main pass needs occlusion culling");
+    endGraphPass(g_frameGraph, vk_commandBuffer, g_mainPass);
+
+    if (beginGraphPass(g_frameGraph, vk_commandBuffer, g_depthPyramidPass)) {
+        recordDepthPyramid(vk_commandBuffer, g_renderWidth, g_renderHeight);
+        endGraphPass(g_frameGraph, vk_commandBuffer, g_depthPyramidPass);
+    }
+
+    ClusterCullPushConstants_t lateCullData = g_cullData;
+    lateCullData.phase = CullPhase_Late;
+    recordClusterCull(g_lateCullPass, lateCullData);
 
-    updateLightsPushConstants(vk_pushConstants.lights[0], time);
+    VkRect2D renderArea = {{0, 0}, {g_renderWidth, g_renderHeight}};
+    bool recording = beginGraphPass(g_frameGraph, vk_commandBuffer, g_lateMainPass, &renderArea);
+    ASSERT(recording);
 
+    setMainPassState();
+    g_openMainPass = g_lateMainPass;
+    g_drawCommandOffset = g_cullData.meshletCount;
+}
+
+void setShading(ShadingModel_t shading, u32 maxShadedLights) {
+    g_shadingModel = shading;
+    g_maxShadedLights = maxShadedLights;
+}
+
+void setMeshPass(MeshPass_t pass) {
+    g_meshPass = pass;
+}
+
+static
+void bindMeshDrawState(f64 time) {
     vkCmdPushConstants(vk_commandBuffer, vk_gfxPipeLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
                        sizeof(vk_pushConstants), &vk_pushConstants);
 
-    vkCmdBindPipeline(vk_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_meshPipeline);
+    u32 features = g_shadingModel == ShadingModel_Gooch ? (u32) VariantFeature_Specular : 0;
+    VkPipeline pipeline = getShaderVariant({g_meshPass, g_shadingModel, g_maxShadedLights, features});
+    vkCmdBindPipeline(vk_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+}
 
-    vkCmdBindDescriptorSets(vk_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_gfxPipeLayout,
-                            0, 1, vk_descSets, 0, nullptr);
+void drawMesh(u32 startVertex, u32 startIndex, u32 indexCount, f64 time) {
+    PROFILE_FUNCTION();
+//
+//    Logger::Trace("startVertex %i, startIndex %i, indexCount %i",
+//            startVertex, startIndex, indexCount);
+    bindMeshDrawState(time);
 
     vkCmdDrawIndexed(vk_commandBuffer, indexCount, 1, startIndex, startVertex, 0);
 }
 
+void drawMeshClusters(u32 firstMeshlet, u32 meshletCount, f64 time) {
+    PROFILE_FUNCTION();
+    bindMeshDrawState(time);
+
+    // One indirect command per cluster, culled clusters were written with indexCount = 0.
+    VkDeviceSize offset = (g_drawCommandOffset + firstMeshlet) * sizeof(VkDrawIndexedIndirectCommand);
+    if (vk_gpu.features.multiDrawIndirect) {
+        vkCmdDrawIndexedIndirect(vk_commandBuffer, vk_drawCommandBuffer.buffer, offset,
+                                 meshletCount, sizeof(VkDrawIndexedIndirectCommand));
+    } else {
+        for (u32 i = 0; i < meshletCount; i++) {
+            vkCmdDrawIndexedIndirect(vk_commandBuffer, vk_drawCommandBuffer.buffer,
+                                     offset + i * sizeof(VkDrawIndexedIndirectCommand),
+                                     1, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+}
+
 void submitFrame(u32 imageIndex) {
-    vkCmdEndRenderPass(vk_commandBuffer);
-
-    VkImageMemoryBarrier copyBarriers[2] =
-            {
-                    imageMemoryBarrier(vk_colorTarget.image,
-                                       VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                       VK_ACCESS_TRANSFER_READ_BIT,
-                                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                                       VK_IMAGE_ASPECT_COLOR_BIT),
-
-                    imageMemoryBarrier(vk_swapchain.images[imageIndex],
-                                       0,
-                                       VK_ACCESS_TRANSFER_WRITE_BIT,
-                                       VK_IMAGE_LAYOUT_UNDEFINED,
-                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                       VK_IMAGE_ASPECT_COLOR_BIT)
-            };
-
-    vkCmdPipelineBarrier(vk_commandBuffer,
-                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                         VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_DEPENDENCY_BY_REGION_BIT,
-                         0, nullptr, 0, nullptr, ARRAYSIZE(copyBarriers), copyBarriers);
-
-    VkImageCopy copyRegion = {};
-    copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copyRegion.srcSubresource.layerCount = 1;
-    copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copyRegion.dstSubresource.layerCount = 1;
-    copyRegion.extent = {vk_swapchain.width, vk_swapchain.height, 1};
-
-    vkCmdCopyImage(vk_commandBuffer,
-                   vk_colorTarget.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                   vk_swapchain.images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                   1, &copyRegion);
-
-    VkImageMemoryBarrier presentBarrier = imageMemoryBarrier(vk_swapchain.images[imageIndex],
-                                                             VK_ACCESS_TRANSFER_WRITE_BIT,
-                                                             0,
-                                                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                                             VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-                                                             VK_IMAGE_ASPECT_COLOR_BIT);
-
-    vkCmdPipelineBarrier(vk_commandBuffer,
-                         VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                         VK_DEPENDENCY_BY_REGION_BIT,
-                         0, 0, 0, 0, 1, &presentBarrier);
+    PROFILE_FUNCTION();
+    endGraphPass(g_frameGraph, vk_commandBuffer, g_openMainPass);
+
+    if (vk_statsQueryPool) {
+        vkCmdEndQuery(vk_commandBuffer, vk_statsQueryPool, 0);
+    }
+
+    // Stops before the copy to the swapchain. That part waits on the acquire and its cost does not
+    // depend on the render scale, so it would only confuse the resolution controller.
+    if (vk_timestampQueryPool) {
+        vkCmdWriteTimestamp(vk_commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, vk_timestampQueryPool, 1);
+    }
+
+    bool recording = beginGraphPass(g_frameGraph, vk_commandBuffer, g_presentPass);
+    ASSERT(recording);
+
+    // Layer i goes to the i-th part of the swapchain image, the same as the whole image with a
+    // single view.
+    VkImage colorTarget = graphImage(g_frameGraph, g_colorResource);
+    u32 viewWidth = outputViewWidth();
+    if (g_renderWidth == viewWidth && g_renderHeight == vk_swapchain.height) {
+        VkImageCopy copyRegions[MAX_VIEWS] = {};
+        for (u32 i = 0; i < VIEW_COUNT; i++) {
+            VkImageCopy &copyRegion = copyRegions[i];
+            copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copyRegion.srcSubresource.baseArrayLayer = i;
+            copyRegion.srcSubresource.layerCount = 1;
+            copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copyRegion.dstSubresource.layerCount = 1;
+            copyRegion.dstOffset = {(i32) (i * viewWidth), 0, 0};
+            copyRegion.extent = {viewWidth, vk_swapchain.height, 1};
+        }
+
+        vkCmdCopyImage(vk_commandBuffer,
+                       colorTarget, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       vk_swapchain.images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       VIEW_COUNT, copyRegions);
+    } else {
+        // Bilinear upscale of the rendered region to the whole part.
+        VkImageBlit blitRegions[MAX_VIEWS] = {};
+        for (u32 i = 0; i < VIEW_COUNT; i++) {
+            VkImageBlit &blitRegion = blitRegions[i];
+            blitRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blitRegion.srcSubresource.baseArrayLayer = i;
+            blitRegion.srcSubresource.layerCount = 1;
+            blitRegion.srcOffsets[1] = {(i32) g_renderWidth, (i32) g_renderHeight, 1};
+            blitRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blitRegion.dstSubresource.layerCount = 1;
+            blitRegion.dstOffsets[0] = {(i32) (i * viewWidth), 0, 0};
+            blitRegion.dstOffsets[1] = {(i32) ((i + 1) * viewWidth), (i32) vk_swapchain.height, 1};
+        }
+
+        vkCmdBlitImage(vk_commandBuffer,
+                       colorTarget, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       vk_swapchain.images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       VIEW_COUNT, blitRegions, VK_FILTER_LINEAR);
+    }
+
+    endGraphPass(g_frameGraph, vk_commandBuffer, g_presentPass);
+    finishRenderGraph(g_frameGraph, vk_commandBuffer);
 
     VK_CHECK(vkEndCommandBuffer(vk_commandBuffer));
 
-    VkPipelineStageFlags waitDstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // Only the passes touching the swapchain image wait for it, the copy at the end.
+    VkPipelineStageFlags waitDstStageMask = g_frameGraph.resources[g_swapchainResource].firstUseStages;
 
     VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
     submitInfo.waitSemaphoreCount = 1;
@@ -238,7 +589,9 @@ void submitFrame(u32 imageIndex) {
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = &vk_releaseSemaphore;
 
-    vkQueueSubmit(vk_queue, 1, &submitInfo, /*fence*/VK_NULL_HANDLE);
+    VK_CHECK(vkQueueSubmit(vk_queue, 1, &submitInfo, vk_frameFence));
+    g_frameNumber += 1;
+    stampLatency(LatencyStamp_Submit);
 
     VkPresentInfoKHR presentInfo = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
     presentInfo.waitSemaphoreCount = 1;
@@ -247,27 +600,73 @@ void submitFrame(u32 imageIndex) {
     presentInfo.pSwapchains = &vk_swapchain.swapchain;
     presentInfo.pImageIndices = &imageIndex;
 
-    VK_CHECK(vkQueuePresentKHR(vk_queue, &presentInfo));
+    VkResult presentResult = vkQueuePresentKHR(vk_queue, &presentInfo);
+    stampLatency(LatencyStamp_Present);
+    if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
+        g_swapchainOutOfDate = true;
+    } else {
+        VK_CHECK(presentResult);
+    }
 
-    VK_CHECK(vkDeviceWaitIdle(vk_device));
+    {
+        PROFILE_ZONE("wait for gpu");
+        VK_CHECK(vkWaitForFences(vk_device, 1, &vk_frameFence, VK_TRUE, U64_MAX));
+    }
+    u64 gpuDoneSeen = profilerNow();
+    VK_CHECK(vkResetFences(vk_device, 1, &vk_frameFence));
+    stampLatency(LatencyStamp_GpuDone);
+    runDeferredDestroys(g_frameNumber);
 
-}
+    if (vk_cullStatsBuffer.buffer) {
+        void *data;
+        vmaMapMemory(vk_vma, vk_cullStatsBuffer.vmaAlloc, &data);
+        memcpy(&g_clusterCullStats, data, sizeof(g_clusterCullStats));
+        vmaUnmapMemory(vk_vma, vk_cullStatsBuffer.vmaAlloc);
+    }
+
+    if (vk_statsQueryPool) {
+        u64 results[2] = {};
+        VkResult res = vkGetQueryPoolResults(vk_device, vk_statsQueryPool, 0, 1, sizeof(results), results,
+                                             sizeof(results), VK_QUERY_RESULT_64_BIT);
+        if (res == VK_SUCCESS) {
+            g_pipelineStats.clippingPrimitives = results[0];
+            g_pipelineStats.fragmentInvocations = results[1];
+        }
+    }
 
+    if (vk_timestampQueryPool) {
+        u64 timestamps[2] = {};
+        VkResult res = vkGetQueryPoolResults(vk_device, vk_timestampQueryPool, 0, 2, sizeof(timestamps), timestamps,
+                                             sizeof(u64), VK_QUERY_RESULT_64_BIT);
+        if (res == VK_SUCCESS) {
+            u64 mask = vk_gpu.timestampValidBits >= 64 ? U64_MAX : (1ull << vk_gpu.timestampValidBits) - 1;
+            u64 ticks = (timestamps[1] - timestamps[0]) & mask;
+            g_gpuFrameMs = ticks * (f64) vk_gpu.props.limits.timestampPeriod * 1e-6;
+            if (profilerCapturing()) {
+                f64 period = vk_gpu.props.limits.timestampPeriod; // ns per tick
+                u64 start = (u64) ((timestamps[0] & mask) * period);
+                profilerRecordGpu("gpu frame", start, start + (u64) (ticks * period), gpuDoneSeen);
+            }
+            if (g_dynamicResolution && updateResolutionScale(g_resolution, g_gpuFrameMs)) {
+                Logger::Trace("Resolution scale %f at %f ms", g_resolution.scale, g_resolution.smoothedMs);
+            }
+        }
+    }
+}
 
-static VkFramebuffer
-createFramebuffer(VkDevice device, VkRenderPass renderPass, VkImageView colorView,
-                  VkImageView depthView, u32 width, u32 height) {
-    VkImageView attachments[2] = {colorView, depthView};
-    VkFramebufferCreateInfo createInfo = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
-    createInfo.renderPass = renderPass;
-    createInfo.attachmentCount = ARRAYSIZE(attachments);
-    createInfo.pAttachments = attachments;
-    createInfo.width = width;
-    createInfo.height = height;
-    createInfo.layers = 1;
+ClusterCullStats_t getClusterCullStats() {
+    return g_clusterCullStats;
+}
 
-    VkFramebuffer fb = 0;
-    VK_CHECK(vkCreateFramebuffer(device, &createInfo, nullptr, &fb));
+PipelineStats_t getPipelineStats() {
+    return g_pipelineStats;
+}
 
-    return fb;
-}
\ No newline at end of file
+ResolutionStats_t getResolutionStats() {
+    ResolutionStats_t stats;
+    stats.gpuMs = g_gpuFrameMs;
+    stats.scale = g_resolution.scale;
+    stats.width = g_renderWidth;
+    stats.height = g_renderHeight;
+    return stats;
+}
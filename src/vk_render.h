@@ -1,14 +1,29 @@
 #pragma once
 
 #include "vk_common.h"
+#include "vk_variants.h"
 
-static VkFramebuffer
-createFramebuffer(VkDevice device, VkRenderPass renderPass, VkImageView colorView,
-                  VkImageView depthView, u32 width, u32 height);
-
+void initDynamicResolution();
+void surfaceResized();
+void setPresentMode(VkPresentModeKHR mode);
 u32 prepareFrame();
+
+// Frames submitted so far. The one being recorded becomes frameNumber() + 1 once submitted.
+u64 frameNumber();
+void cullClusters(u32 meshletCount);
+void binLights();
+void beginMainPass();
+// Ends the main pass, culls again against the new depth pyramid and begins the late main pass.
+void beginLateMainPass();
+void setMeshPass(MeshPass_t pass);
+void setShading(ShadingModel_t shading, u32 maxShadedLights);
 void drawMesh(u32 startVertex, u32 startIndex, u32 indexCount, f64 time);
+void drawMeshClusters(u32 firstMeshlet, u32 meshletCount, f64 time);
 void submitFrame(u32 imageIndex);
 
+ClusterCullStats_t getClusterCullStats();
+PipelineStats_t getPipelineStats();
+ResolutionStats_t getResolutionStats();
+
 void updateUniforms();
 
@@ -0,0 +1,708 @@
+#include <algorithm>
+
+#include "vk_rendergraph.h"
+#include "vk_resources.h"
+
+struct RGAccessInfo_t {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    VkImageUsageFlags imageUsage;
+    VkBufferUsageFlags bufferUsage;
+};
+
+static const RGAccessInfo_t g_accessInfo[RGAccess_Count] = {
+        // None
+        {0, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0},
+        // TransferRead
+        {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+         VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT},
+        // TransferWrite
+        {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+         VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT},
+        // ComputeRead
+        {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL,
+         VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT},
+        // ComputeWrite
+        {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+         VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT},
+        // ComputeReadWrite
+        {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+         VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT},
+        // ComputeSampled
+        {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         VK_IMAGE_USAGE_SAMPLED_BIT, 0},
+        // IndirectRead
+        {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+         0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT},
+        // FragmentRead
+        {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+         VK_IMAGE_USAGE_SAMPLED_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT},
+        // ColorAttachment
+        {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+         VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0},
+        // DepthAttachment
+        {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0},
+        // HostRead
+        {VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, 0, 0},
+        // Present
+        {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, 0},
+};
+
+static const VkAccessFlags WRITE_ACCESS_MASK = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                               VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT;
+
+static
+RGResource_t addResource(RenderGraph_t &graph, const char *name, bool isImage, bool imported) {
+    RGResourceNode_t node = {};
+    node.name = name;
+    node.isImage = isImage;
+    node.imported = imported;
+    node.firstPass = U32_MAX;
+    node.lastPass = U32_MAX;
+    node.memorySlot = U32_MAX;
+    graph.resources.push_back(node);
+    graph.compiled = false;
+    return (RGResource_t) graph.resources.size() - 1;
+}
+
+RGResource_t importImage(RenderGraph_t &graph, const char *name, const RGImageDesc_t &desc,
+                         RGAccess_t initialAccess, RGAccess_t finalAccess) {
+    RGResource_t resource = addResource(graph, name, true, true);
+    RGResourceNode_t &node = graph.resources[resource];
+    node.imageDesc = desc;
+    node.initialAccess = initialAccess;
+    node.finalAccess = finalAccess;
+    return resource;
+}
+
+RGResource_t importBuffer(RenderGraph_t &graph, const char *name, VkBuffer buffer, VkDeviceSize size,
+                          RGAccess_t initialAccess, RGAccess_t finalAccess) {
+    RGResource_t resource = addResource(graph, name, false, true);
+    RGResourceNode_t &node = graph.resources[resource];
+    node.buffer = buffer;
+    node.bufferSize = size;
+    node.initialAccess = initialAccess;
+    node.finalAccess = finalAccess;
+    return resource;
+}
+
+RGResource_t createTransientImage(RenderGraph_t &graph, const char *name, const RGImageDesc_t &desc) {
+    RGResource_t resource = addResource(graph, name, true, false);
+    graph.resources[resource].imageDesc = desc;
+    return resource;
+}
+
+RGResource_t createTransientBuffer(RenderGraph_t &graph, const char *name, VkDeviceSize size) {
+    RGResource_t resource = addResource(graph, name, false, false);
+    graph.resources[resource].bufferSize = size;
+    return resource;
+}
+
+void setImportedImage(RenderGraph_t &graph, RGResource_t resource, VkImage image, VkImageView view) {
+    RGResourceNode_t &node = graph.resources[resource];
+    ASSERT(node.imported && node.isImage);
+    node.image = image;
+    node.view = view;
+}
+
+RGPass_t addGraphPass(RenderGraph_t &graph, const char *name, RGPassType_t type) {
+    RGPassNode_t pass = {};
+    pass.name = name;
+    pass.type = type;
+    graph.passes.push_back(pass);
+    graph.compiled = false;
+    return (RGPass_t) graph.passes.size() - 1;
+}
+
+// One use per resource and pass, a pass can't have two layouts for the same image anyway.
+static
+void addUse(RenderGraph_t &graph, RGPass_t pass, RGResource_t resource, RGAccess_t access, bool write) {
+    ASSERT(pass < graph.passes.size() && resource < graph.resources.size());
+    for (RGUse_t &use : graph.passes[pass].uses) {
+        if (use.resource != resource) continue;
+        bool computePair = (use.access == RGAccess_ComputeRead && access == RGAccess_ComputeWrite) ||
+                           (use.access == RGAccess_ComputeWrite && access == RGAccess_ComputeRead);
+        if (use.access != access && !computePair) {
+            Logger::Error("Render graph: conflicting accesses to %s in pass %s", graph.resources[resource].name,
+                          graph.passes[pass].name);
+            ASSERT_MSG(false, "Conflicting resource accesses in one pass");
+        }
+        if (computePair) use.access = RGAccess_ComputeReadWrite;
+        use.write = use.write || write;
+        return;
+    }
+    graph.passes[pass].uses.push_back({resource, access, write});
+    graph.compiled = false;
+}
+
+void readResource(RenderGraph_t &graph, RGPass_t pass, RGResource_t resource, RGAccess_t access) {
+    addUse(graph, pass, resource, access, false);
+}
+
+void writeResource(RenderGraph_t &graph, RGPass_t pass, RGResource_t resource, RGAccess_t access) {
+    addUse(graph, pass, resource, access, true);
+}
+
+void addColorAttachment(RenderGraph_t &graph, RGPass_t pass, RGResource_t resource,
+                        const VkClearColorValue *clear) {
+    RGPassNode_t &node = graph.passes[pass];
+    ASSERT(node.type == RGPass_Graphics && node.colorAttachmentCount < RG_MAX_COLOR_ATTACHMENTS);
+    RGAttachment_t &attachment = node.colorAttachments[node.colorAttachmentCount++];
+    attachment.resource = resource;
+    attachment.clear = clear != nullptr;
+    if (clear) attachment.clearValue.color = *clear;
+    addUse(graph, pass, resource, RGAccess_ColorAttachment, true);
+}
+
+void setDepthAttachment(RenderGraph_t &graph, RGPass_t pass, RGResource_t resource,
+                        const VkClearDepthStencilValue *clear) {
+    RGPassNode_t &node = graph.passes[pass];
+    ASSERT(node.type == RGPass_Graphics && !node.hasDepthAttachment);
+    node.hasDepthAttachment = true;
+    node.depthAttachment.resource = resource;
+    node.depthAttachment.clear = clear != nullptr;
+    if (clear) node.depthAttachment.clearValue.depthStencil = *clear;
+    addUse(graph, pass, resource, RGAccess_DepthAttachment, true);
+}
+
+static
+bool usesAsAttachment(const RGPassNode_t &pass, RGResource_t resource, bool *clears) {
+    for (u32 i = 0; i < pass.colorAttachmentCount; i++) {
+        if (pass.colorAttachments[i].resource == resource) {
+            *clears = pass.colorAttachments[i].clear;
+            return true;
+        }
+    }
+    if (pass.hasDepthAttachment && pass.depthAttachment.resource == resource) {
+        *clears = pass.depthAttachment.clear;
+        return true;
+    }
+    return false;
+}
+
+// Walks back from the outputs. A pass is kept when it writes something that is needed, and then
+// everything it reads is needed too. Attachments that are not cleared count as read.
+static
+void cullPasses(RenderGraph_t &graph) {
+    for (RGResourceNode_t &resource : graph.resources) {
+        resource.needed = resource.imported && resource.finalAccess != RGAccess_None;
+    }
+
+    for (u32 p = (u32) graph.passes.size(); p-- > 0;) {
+        RGPassNode_t &pass = graph.passes[p];
+        pass.culled = true;
+        for (const RGUse_t &use : pass.uses) {
+            if (use.write && graph.resources[use.resource].needed) pass.culled = false;
+        }
+        if (pass.culled) {
+            Logger::Trace("Render graph: culled pass %s", pass.name);
+            continue;
+        }
+
+        for (const RGUse_t &use : pass.uses) {
+            bool clears = false;
+            bool attachment = usesAsAttachment(pass, use.resource, &clears);
+            bool reads = !use.write || use.access == RGAccess_ComputeReadWrite || (attachment && !clears);
+            if (reads) graph.resources[use.resource].needed = true;
+        }
+    }
+}
+
+static
+void computeLifetimes(RenderGraph_t &graph) {
+    for (u32 p = 0; p < graph.passes.size(); p++) {
+        const RGPassNode_t &pass = graph.passes[p];
+        if (pass.culled) continue;
+        for (const RGUse_t &use : pass.uses) {
+            RGResourceNode_t &resource = graph.resources[use.resource];
+            if (resource.firstPass == U32_MAX) resource.firstPass = p;
+            resource.lastPass = p;
+            resource.imageUsage |= g_accessInfo[use.access].imageUsage;
+            resource.bufferUsage |= g_accessInfo[use.access].bufferUsage;
+        }
+    }
+}
+
+// Transient attachments that live in a single pass and are neither loaded nor stored never need
+// real memory on tiled GPUs.
+static
+bool canBeLazy(const RenderGraph_t &graph, RGResource_t index) {
+    const RGResourceNode_t &resource = graph.resources[index];
+    if (resource.imported || !resource.isImage || resource.firstPass != resource.lastPass) return false;
+    bool clears = false;
+    if (!usesAsAttachment(graph.passes[resource.firstPass], index, &clears)) return false;
+    for (const RGUse_t &use : graph.passes[resource.firstPass].uses) {
+        if (use.resource == index && use.access != RGAccess_ColorAttachment &&
+            use.access != RGAccess_DepthAttachment) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static
+void createTransients(RenderGraph_t &graph, VkDevice device, VmaAllocator vma) {
+    std::vector<RGResource_t> aliased;
+    std::vector<VkMemoryRequirements> requirements(graph.resources.size());
+
+    for (RGResource_t i = 0; i < graph.resources.size(); i++) {
+        RGResourceNode_t &resource = graph.resources[i];
+        if (resource.imported || resource.firstPass == U32_MAX) continue;
+
+        bool lazy = canBeLazy(graph, i);
+
+        if (resource.isImage) {
+            VkImageCreateInfo createInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+            createInfo.imageType = VK_IMAGE_TYPE_2D;
+            createInfo.format = resource.imageDesc.format;
+            createInfo.extent = {resource.imageDesc.width, resource.imageDesc.height, 1};
+            createInfo.mipLevels = 1;
+            createInfo.arrayLayers = resource.imageDesc.layers;
+            createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            createInfo.usage = resource.imageUsage | (lazy ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+            createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VK_CHECK(vkCreateImage(device, &createInfo, nullptr, &resource.image));
+            vkGetImageMemoryRequirements(device, resource.image, &requirements[i]);
+        } else {
+            VkBufferCreateInfo createInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+            createInfo.size = resource.bufferSize;
+            createInfo.usage = resource.bufferUsage;
+            createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            VK_CHECK(vkCreateBuffer(device, &createInfo, nullptr, &resource.buffer));
+            vkGetBufferMemoryRequirements(device, resource.buffer, &requirements[i]);
+        }
+
+        if (lazy) {
+            VmaAllocationCreateInfo allocInfo = {};
+            allocInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+            allocInfo.pUserData = memoryCategoryUserData(MemoryCategory_RenderTargets);
+            if (vmaAllocateMemoryForImage(vma, resource.image, &allocInfo, &resource.lazyMemory, nullptr) == VK_SUCCESS) {
+                trackAllocation(resource.lazyMemory);
+                VK_CHECK(vmaBindImageMemory(vma, resource.lazyMemory, resource.image));
+                Logger::Trace("Render graph: %s is lazily allocated", resource.name);
+                continue;
+            }
+            // No lazily allocated memory type on this device, alias it like the rest.
+            resource.lazyMemory = VK_NULL_HANDLE;
+        }
+        aliased.push_back(i);
+    }
+
+    // Largest first, each resource goes into the first slot it fits in without its lifetime
+    // overlapping any other member.
+    std::sort(aliased.begin(), aliased.end(), [&](RGResource_t a, RGResource_t b) {
+        return requirements[a].size > requirements[b].size;
+    });
+
+    for (RGResource_t index : aliased) {
+        RGResourceNode_t &resource = graph.resources[index];
+        const VkMemoryRequirements &req = requirements[index];
+
+        u32 slotIndex = U32_MAX;
+        for (u32 s = 0; s < graph.memory.size() && slotIndex == U32_MAX; s++) {
+            RGMemorySlot_t &slot = graph.memory[s];
+            if ((slot.requirements.memoryTypeBits & req.memoryTypeBits) == 0) continue;
+            bool overlaps = false;
+            for (RGResource_t member : slot.members) {
+                const RGResourceNode_t &other = graph.resources[member];
+                if (resource.firstPass <= other.lastPass && other.firstPass <= resource.lastPass) {
+                    overlaps = true;
+                    break;
+                }
+            }
+            if (!overlaps) slotIndex = s;
+        }
+
+        if (slotIndex == U32_MAX) {
+            graph.memory.push_back({req, VK_NULL_HANDLE, {}});
+            slotIndex = (u32) graph.memory.size() - 1;
+        } else {
+            RGMemorySlot_t &slot = graph.memory[slotIndex];
+            slot.requirements.size = std::max(slot.requirements.size, req.size);
+            slot.requirements.alignment = std::max(slot.requirements.alignment, req.alignment);
+            slot.requirements.memoryTypeBits &= req.memoryTypeBits;
+            Logger::Trace("Render graph: %s aliases %s", resource.name, graph.resources[slot.members[0]].name);
+        }
+        graph.memory[slotIndex].members.push_back(index);
+        resource.memorySlot = slotIndex;
+    }
+
+    for (RGMemorySlot_t &slot : graph.memory) {
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        allocInfo.pUserData = memoryCategoryUserData(MemoryCategory_RenderTargets);
+        VK_CHECK(vmaAllocateMemory(vma, &slot.requirements, &allocInfo, &slot.allocation, nullptr));
+        trackAllocation(slot.allocation);
+
+        for (RGResource_t member : slot.members) {
+            RGResourceNode_t &resource = graph.resources[member];
+            if (resource.isImage) {
+                VK_CHECK(vmaBindImageMemory(vma, slot.allocation, resource.image));
+            } else {
+                VK_CHECK(vmaBindBufferMemory(vma, slot.allocation, resource.buffer));
+            }
+        }
+    }
+
+    for (RGResourceNode_t &resource : graph.resources) {
+        if (resource.imported || !resource.isImage || !resource.image) continue;
+        VkImageViewCreateInfo viewCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        viewCreateInfo.image = resource.image;
+        viewCreateInfo.viewType = resource.imageDesc.layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        viewCreateInfo.format = resource.imageDesc.format;
+        viewCreateInfo.subresourceRange.aspectMask = resource.imageDesc.aspect;
+        viewCreateInfo.subresourceRange.levelCount = 1;
+        viewCreateInfo.subresourceRange.layerCount = resource.imageDesc.layers;
+        VK_CHECK(vkCreateImageView(device, &viewCreateInfo, nullptr, &resource.view));
+    }
+}
+
+// Tracked per resource while walking the passes in order.
+struct RGState_t {
+    VkImageLayout layout;
+    VkPipelineStageFlags writeStages; // Last write, not yet made visible everywhere
+    VkAccessFlags writeAccess;
+    VkPipelineStageFlags readStages; // Reads since the last write, for write after read
+    VkPipelineStageFlags visibleStages; // Stages the last write has been made visible to
+    VkAccessFlags visibleAccess;
+};
+
+// Adds what is needed to go from state to the access to batch, and updates state.
+static
+void transition(RGState_t &state, RGResource_t resource, bool isImage, RGAccess_t access, bool write,
+                RGBarrierBatch_t &batch) {
+    const RGAccessInfo_t &info = g_accessInfo[access];
+
+    bool layoutChange = isImage && state.layout != info.layout;
+    bool hazard = state.writeStages &&
+                  ((info.stages & ~state.visibleStages) || (info.access & ~state.visibleAccess));
+    bool writeAfterRead = write && state.readStages;
+
+    if (layoutChange || hazard || writeAfterRead) {
+        VkPipelineStageFlags srcStages = state.writeStages;
+        if (layoutChange || write) srcStages |= state.readStages;
+        // Nothing before this in the frame. Waiting on the destination stages still chains with a
+        // semaphore wait at those stages, which is what acquired swapchain images need.
+        if (!srcStages) srcStages = info.stages;
+        batch.srcStages |= srcStages;
+        batch.dstStages |= info.stages;
+
+        if (layoutChange || hazard) {
+            RGBarrier_t barrier;
+            barrier.resource = resource;
+            barrier.srcAccess = state.writeAccess;
+            barrier.dstAccess = info.access;
+            barrier.oldLayout = state.layout;
+            barrier.newLayout = isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+            batch.barriers.push_back(barrier);
+        }
+    }
+
+    if (isImage) state.layout = info.layout;
+    if (write) {
+        state.writeStages = info.stages;
+        state.writeAccess = info.access & WRITE_ACCESS_MASK;
+        state.readStages = 0;
+        state.visibleStages = 0;
+        state.visibleAccess = 0;
+    } else {
+        state.readStages |= info.stages;
+        state.visibleStages |= info.stages;
+        state.visibleAccess |= info.access;
+    }
+}
+
+static
+void computeBarriers(RenderGraph_t &graph) {
+    std::vector<RGState_t> states(graph.resources.size());
+    for (u32 i = 0; i < graph.resources.size(); i++) {
+        RGResourceNode_t &resource = graph.resources[i];
+        states[i] = {};
+        states[i].layout = resource.imported ? g_accessInfo[resource.initialAccess].layout : VK_IMAGE_LAYOUT_UNDEFINED;
+        resource.firstUseStages = 0;
+    }
+
+    for (u32 p = 0; p < graph.passes.size(); p++) {
+        RGPassNode_t &pass = graph.passes[p];
+        pass.before = {};
+        if (pass.culled) continue;
+
+        for (const RGUse_t &use : pass.uses) {
+            RGResourceNode_t &resource = graph.resources[use.resource];
+            RGState_t &state = states[use.resource];
+
+            if (resource.firstPass == p) {
+                resource.firstUseStages = g_accessInfo[use.access].stages;
+
+                // Memory shared with an earlier transient, its last accesses have to finish
+                // first. The contents are garbage either way, so the layout starts undefined.
+                if (resource.memorySlot != U32_MAX) {
+                    const RGResourceNode_t *previous = nullptr;
+                    RGState_t *previousState = nullptr;
+                    for (RGResource_t member : graph.memory[resource.memorySlot].members) {
+                        const RGResourceNode_t &other = graph.resources[member];
+                        if (other.lastPass < p && (!previous || other.lastPass > previous->lastPass)) {
+                            previous = &other;
+                            previousState = &states[member];
+                        }
+                    }
+                    if (previous) {
+                        state.writeStages = previousState->writeStages;
+                        state.writeAccess = previousState->writeAccess;
+                        state.readStages = previousState->readStages | previousState->writeStages;
+                    }
+                }
+            }
+
+            transition(state, use.resource, resource.isImage, use.access, use.write, pass.before);
+        }
+    }
+
+    graph.final = {};
+    for (u32 i = 0; i < graph.resources.size(); i++) {
+        const RGResourceNode_t &resource = graph.resources[i];
+        if (!resource.imported || resource.finalAccess == RGAccess_None) continue;
+        transition(states[i], i, resource.isImage, resource.finalAccess, false, graph.final);
+    }
+}
+
+static
+VkRenderPass createPassRenderPass(const RenderGraph_t &graph, u32 passIndex, VkDevice device) {
+    const RGPassNode_t &pass = graph.passes[passIndex];
+
+    VkAttachmentDescription attachments[RG_MAX_COLOR_ATTACHMENTS + 1] = {};
+    VkAttachmentReference colorRefs[RG_MAX_COLOR_ATTACHMENTS] = {};
+    VkAttachmentReference depthRef = {};
+    u32 attachmentCount = 0;
+    u32 layers = 0;
+
+    auto describe = [&](const RGAttachment_t &attachment, VkImageLayout layout) {
+        const RGResourceNode_t &resource = graph.resources[attachment.resource];
+        ASSERT_MSG(layers == 0 || layers == resource.imageDesc.layers, "Attachments with different layer counts");
+        layers = resource.imageDesc.layers;
+        // Contents only exist if something earlier in the frame wrote them, or they were imported.
+        bool hasContents = resource.imported || resource.firstPass < passIndex;
+        bool readLater = resource.lastPass > passIndex || (resource.imported && resource.finalAccess != RGAccess_None);
+
+        VkAttachmentDescription &desc = attachments[attachmentCount++];
+        desc.format = resource.imageDesc.format;
+        desc.samples = VK_SAMPLE_COUNT_1_BIT;
+        desc.loadOp = attachment.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                                       : (hasContents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+        desc.storeOp = readLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        // The barrier in front of the pass already moved it to the attachment layout.
+        desc.initialLayout = layout;
+        desc.finalLayout = layout;
+    };
+
+    for (u32 i = 0; i < pass.colorAttachmentCount; i++) {
+        colorRefs[i] = {attachmentCount, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        describe(pass.colorAttachments[i], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    }
+    if (pass.hasDepthAttachment) {
+        depthRef = {attachmentCount, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+        describe(pass.depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    }
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = pass.colorAttachmentCount;
+    subpass.pColorAttachments = colorRefs;
+    subpass.pDepthStencilAttachment = pass.hasDepthAttachment ? &depthRef : nullptr;
+
+    VkRenderPassCreateInfo createInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+    createInfo.attachmentCount = attachmentCount;
+    createInfo.pAttachments = attachments;
+    createInfo.subpassCount = 1;
+    createInfo.pSubpasses = &subpass;
+
+    // Layered attachments draw every layer at once, each as its own view. Has to match the
+    // multiview setup of vk_renderPass, which the pipelines are created with.
+    u32 viewMask = (1u << layers) - 1;
+    VkRenderPassMultiviewCreateInfo multiviewInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO};
+    multiviewInfo.subpassCount = 1;
+    multiviewInfo.pViewMasks = &viewMask;
+    multiviewInfo.correlationMaskCount = 1;
+    multiviewInfo.pCorrelationMasks = &viewMask;
+    if (layers > 1) createInfo.pNext = &multiviewInfo;
+
+    VkRenderPass renderPass = 0;
+    VK_CHECK(vkCreateRenderPass(device, &createInfo, nullptr, &renderPass));
+    return renderPass;
+}
+
+static
+void createRenderPasses(RenderGraph_t &graph, VkDevice device) {
+    for (u32 p = 0; p < graph.passes.size(); p++) {
+        RGPassNode_t &pass = graph.passes[p];
+        if (pass.culled || pass.type != RGPass_Graphics) continue;
+        ASSERT_MSG(pass.colorAttachmentCount > 0 || pass.hasDepthAttachment, "Graphics pass without attachments");
+
+        pass.renderPass = createPassRenderPass(graph, p, device);
+
+        VkImageView views[RG_MAX_COLOR_ATTACHMENTS + 1];
+        u32 viewCount = 0;
+        const RGResourceNode_t *first = nullptr;
+        for (u32 i = 0; i < pass.colorAttachmentCount; i++) {
+            first = &graph.resources[pass.colorAttachments[i].resource];
+            views[viewCount++] = first->view;
+        }
+        if (pass.hasDepthAttachment) {
+            if (!first) first = &graph.resources[pass.depthAttachment.resource];
+            views[viewCount++] = graph.resources[pass.depthAttachment.resource].view;
+        }
+        for (u32 i = 0; i < viewCount; i++) {
+            ASSERT_MSG(views[i], "Rendering to imported images is not supported");
+        }
+
+        pass.width = first->imageDesc.width;
+        pass.height = first->imageDesc.height;
+
+        VkFramebufferCreateInfo createInfo = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+        createInfo.renderPass = pass.renderPass;
+        createInfo.attachmentCount = viewCount;
+        createInfo.pAttachments = views;
+        createInfo.width = pass.width;
+        createInfo.height = pass.height;
+        createInfo.layers = 1; // Also with multiview, the views pick the layers
+        VK_CHECK(vkCreateFramebuffer(device, &createInfo, nullptr, &pass.framebuffer));
+    }
+}
+
+void compileRenderGraph(RenderGraph_t &graph, VkDevice device, VmaAllocator vma) {
+    ASSERT(!graph.compiled);
+
+    cullPasses(graph);
+    computeLifetimes(graph);
+    createTransients(graph, device, vma);
+    computeBarriers(graph);
+    createRenderPasses(graph, device);
+
+    u32 keptPasses = 0;
+    for (const RGPassNode_t &pass : graph.passes) {
+        if (!pass.culled) keptPasses += 1;
+    }
+    Logger::Trace("Render graph: %i/%i passes, %i resources in %i memory slots", keptPasses,
+                  (u32) graph.passes.size(), (u32) graph.resources.size(), (u32) graph.memory.size());
+
+    graph.compiled = true;
+}
+
+void destroyRenderGraph(RenderGraph_t &graph, VkDevice device, VmaAllocator vma) {
+    for (RGPassNode_t &pass : graph.passes) {
+        if (pass.framebuffer) vkDestroyFramebuffer(device, pass.framebuffer, nullptr);
+        if (pass.renderPass) vkDestroyRenderPass(device, pass.renderPass, nullptr);
+    }
+
+    for (RGResourceNode_t &resource : graph.resources) {
+        if (resource.imported) continue;
+        if (resource.view) vkDestroyImageView(device, resource.view, nullptr);
+        if (resource.image) vkDestroyImage(device, resource.image, nullptr);
+        if (resource.buffer) vkDestroyBuffer(device, resource.buffer, nullptr);
+        if (resource.lazyMemory) {
+            trackFree(resource.lazyMemory);
+            vmaFreeMemory(vma, resource.lazyMemory);
+        }
+    }
+
+    for (RGMemorySlot_t &slot : graph.memory) {
+        trackFree(slot.allocation);
+        vmaFreeMemory(vma, slot.allocation);
+    }
+
+    graph.resources.clear();
+    graph.passes.clear();
+    graph.memory.clear();
+    graph.final = {};
+    graph.compiled = false;
+}
+
+static
+void recordBarriers(const RenderGraph_t &graph, VkCommandBuffer cmd, const RGBarrierBatch_t &batch) {
+    if (!batch.srcStages) return;
+
+    VkImageMemoryBarrier imageBarriers[RG_MAX_BARRIERS];
+    VkBufferMemoryBarrier bufferBarriers[RG_MAX_BARRIERS];
+    u32 imageBarrierCount = 0;
+    u32 bufferBarrierCount = 0;
+
+    ASSERT(batch.barriers.size() <= RG_MAX_BARRIERS);
+    for (const RGBarrier_t &barrier : batch.barriers) {
+        const RGResourceNode_t &resource = graph.resources[barrier.resource];
+        if (resource.isImage) {
+            ASSERT_MSG(resource.image, "Imported image not set for this frame");
+            imageBarriers[imageBarrierCount++] = imageMemoryBarrier(resource.image, barrier.srcAccess, barrier.dstAccess,
+                                                                    barrier.oldLayout, barrier.newLayout,
+                                                                    resource.imageDesc.aspect);
+        } else {
+            bufferBarriers[bufferBarrierCount++] = bufferMemoryBarrier(resource.buffer, barrier.srcAccess,
+                                                                       barrier.dstAccess);
+        }
+    }
+
+    vkCmdPipelineBarrier(cmd, batch.srcStages, batch.dstStages, 0,
+                         0, nullptr, bufferBarrierCount, bufferBarriers, imageBarrierCount, imageBarriers);
+}
+
+bool beginGraphPass(RenderGraph_t &graph, VkCommandBuffer cmd, RGPass_t passIndex, const VkRect2D *renderArea) {
+    ASSERT(graph.compiled && passIndex < graph.passes.size());
+    const RGPassNode_t &pass = graph.passes[passIndex];
+    if (pass.culled) return false;
+
+    recordBarriers(graph, cmd, pass.before);
+
+    if (pass.type == RGPass_Graphics) {
+        VkClearValue clearValues[RG_MAX_COLOR_ATTACHMENTS + 1];
+        u32 clearValueCount = 0;
+        for (u32 i = 0; i < pass.colorAttachmentCount; i++) {
+            clearValues[clearValueCount++] = pass.colorAttachments[i].clearValue;
+        }
+        if (pass.hasDepthAttachment) {
+            clearValues[clearValueCount++] = pass.depthAttachment.clearValue;
+        }
+
+        VkRenderPassBeginInfo beginInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        beginInfo.renderPass = pass.renderPass;
+        beginInfo.framebuffer = pass.framebuffer;
+        if (renderArea) {
+            beginInfo.renderArea = *renderArea;
+        } else {
+            beginInfo.renderArea.extent = {pass.width, pass.height};
+        }
+        beginInfo.clearValueCount = clearValueCount;
+        beginInfo.pClearValues = clearValues;
+
+        vkCmdBeginRenderPass(cmd, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
+    return true;
+}
+
+void endGraphPass(RenderGraph_t &graph, VkCommandBuffer cmd, RGPass_t passIndex) {
+    const RGPassNode_t &pass = graph.passes[passIndex];
+    ASSERT(!pass.culled);
+    if (pass.type == RGPass_Graphics) {
+        vkCmdEndRenderPass(cmd);
+    }
+}
+
+void finishRenderGraph(RenderGraph_t &graph, VkCommandBuffer cmd) {
+    recordBarriers(graph, cmd, graph.final);
+}
+
+VkImage graphImage(const RenderGraph_t &graph, RGResource_t resource) {
+    ASSERT(graph.resources[resource].isImage);
+    return graph.resources[resource].image;
+}
+
+VkBuffer graphBuffer(const RenderGraph_t &graph, RGResource_t resource) {
+    ASSERT(!graph.resources[resource].isImage);
+    return graph.resources[resource].buffer;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "vk_common.h"
+
+// Frame graph. Passes declare which resources they read and write and how, compileRenderGraph
+// works out the barriers and layout transitions between them, drops passes whose results nobody
+// uses, and places transient resources with non overlapping lifetimes in the same memory.
+//
+// The graph is built and compiled once, and again only when resources change size. Recording
+// stays with the caller: beginGraphPass emits the barriers for a pass and begins its render pass
+// for graphics passes, the caller records into the command buffer, endGraphPass closes it, and
+// finishRenderGraph moves imported outputs to their final state.
+
+typedef u32 RGResource_t;
+typedef u32 RGPass_t;
+
+#define RG_MAX_COLOR_ATTACHMENTS 4
+#define RG_MAX_BARRIERS 32 // Per pass
+
+enum RGPassType_t : u32 {
+    RGPass_Graphics,
+    RGPass_Compute,
+    RGPass_Transfer,
+};
+
+// How a pass touches a resource. Each maps to a stage, access mask and image layout.
+enum RGAccess_t : u32 {
+    RGAccess_None,
+    RGAccess_TransferRead,
+    RGAccess_TransferWrite,
+    RGAccess_ComputeRead,
+    RGAccess_ComputeWrite,
+    RGAccess_ComputeReadWrite,
+    RGAccess_ComputeSampled, // Images read through a sampler, depth for one
+    RGAccess_IndirectRead,
+    RGAccess_FragmentRead, // Storage buffers and images read while shading
+    RGAccess_ColorAttachment,
+    RGAccess_DepthAttachment,
+    RGAccess_HostRead,
+    RGAccess_Present,
+    RGAccess_Count
+};
+
+struct RGImageDesc_t {
+    u32 width, height;
+    VkFormat format;
+    VkImageAspectFlags aspect;
+    u32 layers = 1; // An array of more than one is rendered to with multiview, one view per layer
+};
+
+struct RGResourceNode_t {
+    const char *name;
+    bool isImage;
+    bool imported;
+    RGImageDesc_t imageDesc;
+    VkDeviceSize bufferSize;
+
+    // Imported resources start in initialAccess each frame, and are left in finalAccess when it
+    // is not None. A final access makes the resource an output of the graph.
+    RGAccess_t initialAccess;
+    RGAccess_t finalAccess;
+
+    // Filled in by compile for transients, by the caller for imported resources.
+    VkImage image;
+    VkImageView view;
+    VkBuffer buffer;
+
+    // Compiled
+    VkImageUsageFlags imageUsage;
+    VkBufferUsageFlags bufferUsage;
+    u32 firstPass, lastPass; // Lifetime over the kept passes, U32_MAX if unused
+    VkPipelineStageFlags firstUseStages; // Where a semaphore guarding an imported resource should wait
+    u32 memorySlot; // Index into RenderGraph_t::memory, U32_MAX for imported and lazy resources
+    VmaAllocation lazyMemory; // Lazily allocated attachments get their own allocation
+    bool needed;
+};
+
+struct RGUse_t {
+    RGResource_t resource;
+    RGAccess_t access;
+    bool write;
+};
+
+struct RGAttachment_t {
+    RGResource_t resource;
+    bool clear;
+    VkClearValue clearValue;
+};
+
+struct RGBarrier_t {
+    RGResource_t resource;
+    VkAccessFlags srcAccess, dstAccess;
+    VkImageLayout oldLayout, newLayout;
+};
+
+struct RGBarrierBatch_t {
+    VkPipelineStageFlags srcStages, dstStages;
+    std::vector<RGBarrier_t> barriers; // Empty with stages set means an execution dependency only
+};
+
+struct RGPassNode_t {
+    const char *name;
+    RGPassType_t type;
+    std::vector<RGUse_t> uses;
+    RGAttachment_t colorAttachments[RG_MAX_COLOR_ATTACHMENTS];
+    u32 colorAttachmentCount;
+    RGAttachment_t depthAttachment;
+    bool hasDepthAttachment;
+
+    // Compiled
+    bool culled;
+    RGBarrierBatch_t before;
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+    u32 width, height; // Of the attachments
+};
+
+// Transients sharing memory. Members never have overlapping lifetimes.
+struct RGMemorySlot_t {
+    VkMemoryRequirements requirements;
+    VmaAllocation allocation;
+    std::vector<RGResource_t> members;
+};
+
+struct RenderGraph_t {
+    std::vector<RGResourceNode_t> resources;
+    std::vector<RGPassNode_t> passes;
+    std::vector<RGMemorySlot_t> memory;
+    RGBarrierBatch_t final; // To the final access of imported outputs
+    bool compiled = false;
+};
+
+RGResource_t importImage(RenderGraph_t &graph, const char *name, const RGImageDesc_t &desc,
+                         RGAccess_t initialAccess, RGAccess_t finalAccess);
+RGResource_t importBuffer(RenderGraph_t &graph, const char *name, VkBuffer buffer, VkDeviceSize size,
+                          RGAccess_t initialAccess, RGAccess_t finalAccess);
+RGResource_t createTransientImage(RenderGraph_t &graph, const char *name, const RGImageDesc_t &desc);
+RGResource_t createTransientBuffer(RenderGraph_t &graph, const char *name, VkDeviceSize size);
+
+// Imported images can change between frames, swapchain images for one.
+void setImportedImage(RenderGraph_t &graph, RGResource_t resource, VkImage image, VkImageView view);
+
+RGPass_t addGraphPass(RenderGraph_t &graph, const char *name, RGPassType_t type);
+void readResource(RenderGraph_t &graph, RGPass_t pass, RGResource_t resource, RGAccess_t access);
+void writeResource(RenderGraph_t &graph, RGPass_t pass, RGResource_t resource, RGAccess_t access);
+
+// A null clear value loads the previous contents, or leaves them undefined if nothing wrote them.
+void addColorAttachment(RenderGraph_t &graph, RGPass_t pass, RGResource_t resource,
+                        const VkClearColorValue *clear);
+void setDepthAttachment(RenderGraph_t &graph, RGPass_t pass, RGResource_t resource,
+                        const VkClearDepthStencilValue *clear);
+
+// Render passes made by the graph only differ from vk_renderPass in load/store ops and layouts,
+// so pipelines created against it stay compatible.
+void compileRenderGraph(RenderGraph_t &graph, VkDevice device, VmaAllocator vma);
+void destroyRenderGraph(RenderGraph_t &graph, VkDevice device, VmaAllocator vma);
+
+// Returns false for culled passes, nothing should be recorded for them then. renderArea defaults
+// to the whole attachment size for graphics passes.
+bool beginGraphPass(RenderGraph_t &graph, VkCommandBuffer cmd, RGPass_t pass, const VkRect2D *renderArea = nullptr);
+void endGraphPass(RenderGraph_t &graph, VkCommandBuffer cmd, RGPass_t pass);
+void finishRenderGraph(RenderGraph_t &graph, VkCommandBuffer cmd);
+
+VkImage graphImage(const RenderGraph_t &graph, RGResource_t resource);
+VkBuffer graphBuffer(const RenderGraph_t &graph, RGResource_t resource);
@@ -1,7 +1,11 @@
 #include <fstream>
 #include <string>
+#include "arena.h"
+#include "cooked.h"
+#include "jobs.h"
 #include "vk_renderprograms.h"
 #include "vertex_type.h"
+#include "vk_bindless.h"
 
 #define ARRAYSIZE(a) \
   ((sizeof(a) / sizeof(*(a))) / \
@@ -9,8 +13,8 @@
 
 struct VertexDescriptions_t {
     VkPipelineVertexInputStateCreateInfo inputState;
-    std::vector<VkVertexInputBindingDescription> bindings;
-    std::vector<VkVertexInputAttributeDescription> attributes;
+    VkVertexInputBindingDescription *bindings;
+    VkVertexInputAttributeDescription *attributes;
 };
 
 //Fwd declares
@@ -18,50 +22,193 @@ bool loadShader(Shader_t &shader, VkDevice device, std::string fileName, VkShade
 
 static VkShaderModule loadShaderModule(const char *fileName, VkDevice device);
 
-static VertexDescriptions_t getVertexDescriptions();
+static VkShaderModule createShaderModule(VkDevice device, const u32 *code, u64 size);
+
+static VertexDescriptions_t getVertexDescriptions(Arena_t &arena, bool positionOnly);
 
 Shader_t vk_meshVS = {};
+Shader_t vk_depthOnlyVS = {};
 Shader_t vk_goochFS = {};
 Shader_t vk_lambertFS = {};
 Shader_t vk_vertexColorFS = {};
+Shader_t vk_clusterCullCS = {};
+Shader_t vk_lightBinCS = {};
+Shader_t vk_depthPyramidCS = {};
 
 VkDescriptorPool vk_descPool = 0;
 VkDescriptorSetLayout vk_descSetLayout;
 VkDescriptorSet vk_descSets[1];
 VkPipelineCache vk_pipelineCache = 0;
 VkPipelineLayout vk_gfxPipeLayout = 0;
-VkPipeline vk_meshPipeline = 0;
+
+VkDescriptorSetLayout vk_cullDescSetLayout = 0;
+VkDescriptorSet vk_cullDescSet = 0;
+VkPipelineLayout vk_cullPipeLayout = 0;
+VkPipeline vk_clusterCullPipeline = 0;
+VkPipeline vk_lightBinPipeline = 0;
+
+VkDescriptorSetLayout vk_pyramidDescSetLayout = 0;
+VkDescriptorSet vk_pyramidDescSets[DEPTH_PYRAMID_MAX_LEVELS] = {};
+VkPipelineLayout vk_pyramidPipeLayout = 0;
+VkPipeline vk_depthPyramidPipeline = 0;
 
 bool g_shaders_loaded = false;
 
-void initialShaderLoad() {
-    bool res = false;
-    res = loadShader(vk_meshVS, vk_device, "../mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-    ASSERT(res);
+struct ShaderFile_t {
+    Shader_t *shader;
+    const char *name; // Source file name without .glsl, plus the build suffix if it has one
+    VkShaderStageFlagBits stage;
+};
+
+// The vertex shaders are also built with MULTIVIEW defined, only those use gl_ViewIndex. The
+// single view build runs on devices without multiview.
+#if MULTIVIEW
+#define VERTEX_SHADER_SUFFIX ".multiview"
+#else
+#define VERTEX_SHADER_SUFFIX ""
+#endif
+
+// Every SPIR-V module, cooked by anton_cook or built by shaders/build.bat. Variants of these are
+// made with specialization constants, see vk_variants.h.
+static const ShaderFile_t g_shaderFiles[] = {
+        {&vk_meshVS,         "mesh.vert" VERTEX_SHADER_SUFFIX,       VK_SHADER_STAGE_VERTEX_BIT},
+        {&vk_depthOnlyVS,    "depth_only.vert" VERTEX_SHADER_SUFFIX, VK_SHADER_STAGE_VERTEX_BIT},
+        {&vk_goochFS,        "gooch.frag",        VK_SHADER_STAGE_FRAGMENT_BIT},
+        {&vk_lambertFS,      "lambert.frag",      VK_SHADER_STAGE_FRAGMENT_BIT},
+        {&vk_vertexColorFS,  "vertexColors.frag", VK_SHADER_STAGE_FRAGMENT_BIT},
+        {&vk_clusterCullCS,  "cluster_cull.comp", VK_SHADER_STAGE_COMPUTE_BIT},
+        {&vk_lightBinCS,     "light_bin.comp",    VK_SHADER_STAGE_COMPUTE_BIT},
+        {&vk_depthPyramidCS, "depth_pyramid.comp", VK_SHADER_STAGE_COMPUTE_BIT},
+};
+
+// Values for the fragment shader specialization constants of a variant.
+struct VariantConstants_t {
+    u32 maxShadedLights; // constant_id 0
+    VkBool32 specular; // constant_id 1
+    u32 textureSlots; // constant_id 2, fixed per device by the bindless table
+};
+
+// Straight from the mapped shader pack when it has the module, else the cooked .spv, else where
+// build.bat puts it.
+static
+void loadShaderFilesJob(void *data, u32 begin, u32 end) {
+    for (u32 i = begin; i < end; i++) {
+        const ShaderFile_t &file = g_shaderFiles[i];
+        u64 size = 0;
+        const u32 *packed = findPackedShader(file.name, size);
+        if (packed) {
+            file.shader->stage = file.stage;
+            file.shader->module = createShaderModule(vk_device, packed, size);
+            continue;
+        }
+
+        const char *cooked = findCookedAsset(CookedAsset_Shader, file.name);
+        std::string path = cooked ? cooked : std::string("../") + file.name + ".spv";
+        bool res = loadShader(*file.shader, vk_device, path, file.stage);
+        ASSERT(res);
+    }
+}
 
-    res = loadShader(vk_goochFS, vk_device, "../gooch.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-    ASSERT(res);
-    res = loadShader(vk_lambertFS, vk_device, "../lambert.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-    ASSERT(res);
-    res = loadShader(vk_vertexColorFS, vk_device, "../vertexColors.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-    ASSERT(res);
+void initialShaderLoad() {
+    bool packed = openShaderPack();
+    parallelFor(ARRAYSIZE(g_shaderFiles), 1, loadShaderFilesJob, nullptr);
+    // The modules have their own copy of the code.
+    if (packed) closeShaderPack();
 
     g_shaders_loaded = true;
 }
 
+VkPipeline createVariantPipeline(const ShaderVariantKey_t &key) {
+    ASSERT(g_shaders_loaded);
+    ScratchScope_t scratch;
+    VkCullModeFlags cullMode = BACKFACE_CULLING ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+
+    // No fragment shader and no color writes, only depth.
+    if (key.pass == MeshPass_DepthPrepass) {
+        VertexDescriptions_t positionDescs = getVertexDescriptions(scratch.arena, true);
+        PipelineState_t prepassState = {cullMode, VK_COMPARE_OP_LESS, VK_TRUE, VK_FALSE};
+        return createGraphicsPipeline(vk_device, vk_pipelineCache, vk_renderPass,
+                                      vk_depthOnlyVS, nullptr, nullptr, vk_gfxPipeLayout,
+                                      &positionDescs, prepassState);
+    }
+
+    VertexDescriptions_t vtxDescs = getVertexDescriptions(scratch.arena, false);
+
+    // Color after the pre-pass tests EQUAL against its depth and writes none.
+    PipelineState_t state = key.pass == MeshPass_ColorEqual
+                            ? PipelineState_t{cullMode, VK_COMPARE_OP_EQUAL, VK_FALSE, VK_TRUE}
+                            : PipelineState_t{cullMode, VK_COMPARE_OP_LESS, VK_TRUE, VK_TRUE};
+
+    Shader_t *fs = key.shading == ShadingModel_Gooch ? &vk_goochFS : &vk_lambertFS;
+
+    VariantConstants_t constants = {};
+    constants.maxShadedLights = key.maxShadedLights;
+    constants.specular = (key.features & VariantFeature_Specular) ? VK_TRUE : VK_FALSE;
+    constants.textureSlots = getBindlessStats().textureSlots;
+
+    VkSpecializationMapEntry entries[3] = {
+            {0, offsetof(VariantConstants_t, maxShadedLights), sizeof(u32)},
+            {1, offsetof(VariantConstants_t, specular), sizeof(VkBool32)},
+            {2, offsetof(VariantConstants_t, textureSlots), sizeof(u32)},
+    };
+
+    VkSpecializationInfo specialization = {};
+    specialization.mapEntryCount = ARRAYSIZE(entries);
+    specialization.pMapEntries = entries;
+    specialization.dataSize = sizeof(constants);
+    specialization.pData = &constants;
+
+    return createGraphicsPipeline(vk_device, vk_pipelineCache, vk_renderPass,
+                                  vk_meshVS, fs, &specialization, vk_gfxPipeLayout,
+                                  &vtxDescs, state);
+}
+
 void initialPipelineCreation() {
     VkPushConstantRange pcRange;
     pcRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     pcRange.size = sizeof(vk_pushConstants);
     pcRange.offset = 0;
 
-    vk_gfxPipeLayout = createPipelineLayout(vk_device, &vk_descSetLayout, &pcRange);
+    // Set 1 is the bindless material table, see vk_bindless.h.
+    ASSERT(vk_bindlessSetLayout != VK_NULL_HANDLE);
+    VkDescriptorSetLayout meshSetLayouts[2] = {vk_descSetLayout, vk_bindlessSetLayout};
+    vk_gfxPipeLayout = createPipelineLayout(vk_device, meshSetLayouts, ARRAYSIZE(meshSetLayouts), &pcRange);
 
     ASSERT(g_shaders_loaded);
-    VertexDescriptions_t vtxDescs = getVertexDescriptions();
-    vk_meshPipeline = createGraphicsPipeline(vk_device, vk_pipelineCache, vk_renderPass,
-                                             vk_meshVS, vk_lambertFS, vk_gfxPipeLayout,
-                                             &vtxDescs);
+
+    // Every variant the runtime toggles can reach, so none of them is built mid frame.
+    ShaderVariantKey_t keys[MeshPass_ColorEqual + 1][ShadingModel_Count][ARRAYSIZE(g_shadedLightCaps)];
+    for (u32 pass = 0; pass <= MeshPass_ColorEqual; pass++) {
+        for (u32 shading = 0; shading < ShadingModel_Count; shading++) {
+            for (u32 cap = 0; cap < ARRAYSIZE(g_shadedLightCaps); cap++) {
+                keys[pass][shading][cap] = {(MeshPass_t) pass, (ShadingModel_t) shading, g_shadedLightCaps[cap],
+                                            shading == ShadingModel_Gooch ? (u32) VariantFeature_Specular : 0};
+            }
+        }
+    }
+    prewarmShaderVariants(&keys[0][0][0], sizeof(keys) / sizeof(keys[0][0][0]));
+
+    VkPushConstantRange cullPcRange;
+    cullPcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullPcRange.size = sizeof(ClusterCullPushConstants_t);
+    cullPcRange.offset = 0;
+
+    vk_cullPipeLayout = createPipelineLayout(vk_device, &vk_cullDescSetLayout, 1, &cullPcRange);
+    vk_clusterCullPipeline = createComputePipeline(vk_device, vk_pipelineCache, vk_clusterCullCS,
+                                                   vk_cullPipeLayout);
+
+    // Light binning reads the uniforms and light buffers of the mesh set and has no push constants,
+    // so it shares the mesh pipeline layout.
+    vk_lightBinPipeline = createComputePipeline(vk_device, vk_pipelineCache, vk_lightBinCS, vk_gfxPipeLayout);
+
+    VkPushConstantRange pyramidPcRange;
+    pyramidPcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pyramidPcRange.size = sizeof(DepthPyramidPushConstants_t);
+    pyramidPcRange.offset = 0;
+
+    vk_pyramidPipeLayout = createPipelineLayout(vk_device, &vk_pyramidDescSetLayout, 1, &pyramidPcRange);
+    vk_depthPyramidPipeline = createComputePipeline(vk_device, vk_pipelineCache, vk_depthPyramidCS,
+                                                    vk_pyramidPipeLayout);
 }
 
 void initialDescriptorSetup() {
@@ -72,20 +219,89 @@ void initialDescriptorSetup() {
     allocateDescriptorSet(vk_descPool, vk_descSetLayout, vk_descSets, /*num desc sets*/1);
 
     updateDescriptorSet(vk_uniformBuffer, 0, vk_uniformBuffer.size, vk_descSets);
+    updateLightDescriptorSet();
+
+    // The storage buffer bindings are written once the cluster buffers exist, see updateClusterDescriptorSets.
+    vk_cullDescSetLayout = createCullDescriptorSetLayout();
+    allocateDescriptorSet(vk_descPool, vk_cullDescSetLayout, &vk_cullDescSet, /*num desc sets*/1);
 
+    // Written whenever the depth pyramid is created, see vk_occlusion.h.
+    vk_pyramidDescSetLayout = createPyramidDescriptorSetLayout();
+    for (u32 i = 0; i < DEPTH_PYRAMID_MAX_LEVELS; i++) {
+        allocateDescriptorSet(vk_descPool, vk_pyramidDescSetLayout, &vk_pyramidDescSets[i], /*num desc sets*/1);
+    }
+}
+
+void updateClusterDescriptorSets() {
+    Buffer_t *buffers[5] = {&vk_meshletBuffer, &vk_objectBuffer, &vk_drawCommandBuffer, &vk_cullStatsBuffer,
+                            &vk_occlusionViewBuffer};
+    u32 bindings[5] = {0, 1, 2, 3, 5}; // 4 is the depth pyramid
+
+    VkDescriptorBufferInfo bufferInfos[5] = {};
+    VkWriteDescriptorSet writes[5] = {};
+    for (u32 i = 0; i < ARRAYSIZE(buffers); i++) {
+        ASSERT(buffers[i]->buffer != VK_NULL_HANDLE);
+        bufferInfos[i].buffer = buffers[i]->buffer;
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+
+        writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[i].dstSet = vk_cullDescSet;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].dstBinding = bindings[i];
+        writes[i].pBufferInfo = &bufferInfos[i];
+        writes[i].descriptorCount = 1;
+    }
+
+    vkUpdateDescriptorSets(vk_device, ARRAYSIZE(writes), writes, 0, nullptr);
+
+    // The vertex shader reads the object transforms from binding 1 of the mesh set.
+    VkWriteDescriptorSet objectWrite = writes[1];
+    objectWrite.dstSet = vk_descSets[0];
+    objectWrite.dstBinding = 1;
 
+    vkUpdateDescriptorSets(vk_device, 1, &objectWrite, 0, nullptr);
+}
+
+void updateLightDescriptorSet() {
+    Buffer_t *buffers[3] = {&vk_lightBuffer, &vk_lightCountBuffer, &vk_lightIndexBuffer};
+
+    VkDescriptorBufferInfo bufferInfos[3] = {};
+    VkWriteDescriptorSet writes[3] = {};
+    for (u32 i = 0; i < ARRAYSIZE(buffers); i++) {
+        ASSERT(buffers[i]->buffer != VK_NULL_HANDLE);
+        bufferInfos[i].buffer = buffers[i]->buffer;
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+
+        writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[i].dstSet = vk_descSets[0];
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].dstBinding = 2 + i;
+        writes[i].pBufferInfo = &bufferInfos[i];
+        writes[i].descriptorCount = 1;
+    }
+
+    vkUpdateDescriptorSets(vk_device, ARRAYSIZE(writes), writes, 0, nullptr);
 }
 
 static
 VkDescriptorPool createDescriptorPool() {
-    VkDescriptorPoolSize poolSizes[1];
+    VkDescriptorPoolSize poolSizes[4];
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     poolSizes[0].descriptorCount = 1;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = 9;
+    // The pyramid for the cull set, and a source and destination per pyramid level.
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[2].descriptorCount = 1 + DEPTH_PYRAMID_MAX_LEVELS;
+    poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[3].descriptorCount = DEPTH_PYRAMID_MAX_LEVELS;
 
     VkDescriptorPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
     createInfo.poolSizeCount = ARRAYSIZE(poolSizes);
     createInfo.pPoolSizes = poolSizes;
-    createInfo.maxSets = 16;
+    createInfo.maxSets = 16 + DEPTH_PYRAMID_MAX_LEVELS;
 
     VkDescriptorPool pool = 0;
     VK_CHECK(vkCreateDescriptorPool(vk_device, &createInfo, nullptr, &pool));
@@ -98,9 +314,68 @@ VkDescriptorSetLayout createDescriptorSetLayout() {
     uboLayoutBinding.binding = 0;
     uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT |
+                                  VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutBinding objectLayoutBinding = {};
+    objectLayoutBinding.binding = 1;
+    objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    objectLayoutBinding.descriptorCount = 1;
+    objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutBinding bindings[5] = {uboLayoutBinding, objectLayoutBinding};
+
+    // 2: lights, 3: light counts per cluster, 4: light indices per cluster. Written by the light
+    // binning pass, read while shading.
+    for (u32 i = 2; i < ARRAYSIZE(bindings); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    }
 
-    VkDescriptorSetLayoutBinding bindings[1] = {uboLayoutBinding};
+    VkDescriptorSetLayoutCreateInfo createInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    createInfo.bindingCount = ARRAYSIZE(bindings);
+    createInfo.pBindings = bindings;
+
+    VkDescriptorSetLayout layout = 0;
+    VK_CHECK(vkCreateDescriptorSetLayout(vk_device, &createInfo, nullptr, &layout));
+    return layout;
+}
+
+static
+VkDescriptorSetLayout createCullDescriptorSetLayout() {
+    // 0: meshlets, 1: object data, 2: draw commands, 3: stats, 4: depth pyramid, 5: occlusion views
+    VkDescriptorSetLayoutBinding bindings[6] = {};
+    for (u32 i = 0; i < ARRAYSIZE(bindings); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorSetLayoutCreateInfo createInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    createInfo.bindingCount = ARRAYSIZE(bindings);
+    createInfo.pBindings = bindings;
+
+    VkDescriptorSetLayout layout = 0;
+    VK_CHECK(vkCreateDescriptorSetLayout(vk_device, &createInfo, nullptr, &layout));
+    return layout;
+}
+
+static
+VkDescriptorSetLayout createPyramidDescriptorSetLayout() {
+    // 0: the level below, or the depth target for level 0, 1: the level written
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
     VkDescriptorSetLayoutCreateInfo createInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
     createInfo.bindingCount = ARRAYSIZE(bindings);
@@ -146,11 +421,11 @@ void updateDescriptorSet(Buffer_t ubo_buffer, u32 offset, u32 range,
 }
 
 static
-VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout *dcLayout,
+VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout *dcLayout, u32 dcLayoutCount,
                                       VkPushConstantRange *pcRange) {
     VkPipelineLayout layout = 0;
     VkPipelineLayoutCreateInfo CI = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-    CI.setLayoutCount = 1;
+    CI.setLayoutCount = dcLayoutCount;
     CI.pSetLayouts = dcLayout;
     CI.pushConstantRangeCount = 1;
     CI.pPushConstantRanges = pcRange;
@@ -170,7 +445,9 @@ VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout *dc
 static
 VkPipeline
 createGraphicsPipeline(VkDevice device, VkPipelineCache cache, VkRenderPass rp, Shader_t &vs,
-                       Shader_t &fs, VkPipelineLayout layout, VertexDescriptions_t *vtxDescs) {
+                       Shader_t *fs, const VkSpecializationInfo *fsSpecialization,
+                       VkPipelineLayout layout, VertexDescriptions_t *vtxDescs,
+                       const PipelineState_t &state) {
     VkGraphicsPipelineCreateInfo createInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
 
     std::vector<VkPipelineShaderStageCreateInfo> stages;
@@ -181,11 +458,14 @@ createGraphicsPipeline(VkDevice device, VkPipelineCache cache, VkRenderPass rp,
         v_stage.pName = "main";
         stages.push_back(v_stage);
 
-        VkPipelineShaderStageCreateInfo f_stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
-        f_stage.stage = fs.stage;
-        f_stage.module = fs.module;
-        f_stage.pName = "main";
-        stages.push_back(f_stage);
+        if (fs) {
+            VkPipelineShaderStageCreateInfo f_stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+            f_stage.stage = fs->stage;
+            f_stage.module = fs->module;
+            f_stage.pName = "main";
+            f_stage.pSpecializationInfo = fsSpecialization;
+            stages.push_back(f_stage);
+        }
     }
 
     createInfo.stageCount = (u32) stages.size();
@@ -207,7 +487,7 @@ createGraphicsPipeline(VkDevice device, VkPipelineCache cache, VkRenderPass rp,
             VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
     rasterizationState.lineWidth = 1.f;
     rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizationState.cullMode = VK_CULL_MODE_NONE; //VK_CULL_MODE_BACK_BIT;
+    rasterizationState.cullMode = state.cullMode;
     createInfo.pRasterizationState = &rasterizationState;
 
     VkPipelineMultisampleStateCreateInfo multisampleState = {VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
@@ -217,16 +497,16 @@ createGraphicsPipeline(VkDevice device, VkPipelineCache cache, VkRenderPass rp,
     VkPipelineDepthStencilStateCreateInfo depthStencilState = {
             VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
     depthStencilState.depthTestEnable = VK_TRUE;
-    depthStencilState.depthWriteEnable = VK_TRUE;
-    depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencilState.depthWriteEnable = state.depthWrite;
+    depthStencilState.depthCompareOp = state.depthCompareOp;
     depthStencilState.minDepthBounds = 0.0f; // Optional
     depthStencilState.maxDepthBounds = 1.0f; // Optional
     createInfo.pDepthStencilState = &depthStencilState;
 
     VkPipelineColorBlendAttachmentState colorAttachmentState = {};
-    colorAttachmentState.colorWriteMask =
-            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorAttachmentState.colorWriteMask = state.colorWrite
+            ? VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+            : 0;
 
     VkPipelineColorBlendStateCreateInfo colorBlendState = {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
     colorBlendState.attachmentCount = 1;
@@ -250,57 +530,88 @@ createGraphicsPipeline(VkDevice device, VkPipelineCache cache, VkRenderPass rp,
 }
 
 static
-VertexDescriptions_t getVertexDescriptions() {
+VkPipeline createComputePipeline(VkDevice device, VkPipelineCache cache, Shader_t &cs, VkPipelineLayout layout) {
+    ASSERT(cs.stage == VK_SHADER_STAGE_COMPUTE_BIT);
+
+    VkPipelineShaderStageCreateInfo stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    stage.stage = cs.stage;
+    stage.module = cs.module;
+    stage.pName = "main";
+
+    VkComputePipelineCreateInfo createInfo = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    createInfo.stage = stage;
+    createInfo.layout = layout;
+
+    VkPipeline pipeline = 0;
+    VK_CHECK(vkCreateComputePipelines(device, cache, 1, &createInfo, 0, &pipeline));
+
+    return pipeline;
+}
+
+static
+VertexDescriptions_t getVertexDescriptions(Arena_t &arena, bool positionOnly) {
     VertexDescriptions_t vtx_descs = {};
+    u32 bindingCount = 1;
+    u32 attributeCount = positionOnly ? 1 : 3;
 
-    vtx_descs.bindings.resize(1);
+    vtx_descs.bindings = arenaAllocArray<VkVertexInputBindingDescription>(arena, bindingCount);
     vtx_descs.bindings[0].binding = 0;
     vtx_descs.bindings[0].stride = sizeof(Vertex_t);
     vtx_descs.bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-    vtx_descs.attributes.resize(2);
+    vtx_descs.attributes = arenaAllocArray<VkVertexInputAttributeDescription>(arena, attributeCount);
     vtx_descs.attributes[0].binding = 0;
     vtx_descs.attributes[0].location = 0;
     vtx_descs.attributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
     vtx_descs.attributes[0].offset = offsetof(Vertex_t, pos);
 
-    vtx_descs.attributes[1].binding = 0;
-    vtx_descs.attributes[1].location = 1;
-    vtx_descs.attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vtx_descs.attributes[1].offset = offsetof(Vertex_t, normal);
+    if (!positionOnly) {
+        vtx_descs.attributes[1].binding = 0;
+        vtx_descs.attributes[1].location = 1;
+        vtx_descs.attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        vtx_descs.attributes[1].offset = offsetof(Vertex_t, normal);
+
+        vtx_descs.attributes[2].binding = 0;
+        vtx_descs.attributes[2].location = 2;
+        vtx_descs.attributes[2].format = VK_FORMAT_R32G32_SFLOAT;
+        vtx_descs.attributes[2].offset = offsetof(Vertex_t, texCoord);
+    }
 
     vtx_descs.inputState = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-    vtx_descs.inputState.vertexBindingDescriptionCount = (u32) vtx_descs.bindings.size();
-    vtx_descs.inputState.pVertexBindingDescriptions = vtx_descs.bindings.data();
-    vtx_descs.inputState.vertexAttributeDescriptionCount = (u32) vtx_descs.attributes.size();
-    vtx_descs.inputState.pVertexAttributeDescriptions = vtx_descs.attributes.data();
+    vtx_descs.inputState.vertexBindingDescriptionCount = bindingCount;
+    vtx_descs.inputState.pVertexBindingDescriptions = vtx_descs.bindings;
+    vtx_descs.inputState.vertexAttributeDescriptionCount = attributeCount;
+    vtx_descs.inputState.pVertexAttributeDescriptions = vtx_descs.attributes;
 
     return vtx_descs;
 }
 
+static VkShaderModule createShaderModule(VkDevice device, const u32 *code, u64 size) {
+    ASSERT(size > 0);
+
+    VkShaderModule shaderModule;
+    VkShaderModuleCreateInfo moduleCreateInfo{};
+    moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleCreateInfo.codeSize = size;
+    moduleCreateInfo.pCode = code;
+
+    VK_CHECK(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
+
+    return shaderModule;
+}
+
 static VkShaderModule loadShaderModule(const char *fileName, VkDevice device) {
     std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
 
     if (is.is_open()) {
         size_t size = is.tellg();
         is.seekg(0, std::ios::beg);
-        char *shaderCode = new char[size];
-        is.read(shaderCode, size);
+        ScratchScope_t scratch;
+        u32 *shaderCode = arenaAllocArray<u32>(scratch.arena, (size + 3) / 4);
+        is.read((char *) shaderCode, size);
         is.close();
 
-        ASSERT(size > 0);
-
-        VkShaderModule shaderModule;
-        VkShaderModuleCreateInfo moduleCreateInfo{};
-        moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        moduleCreateInfo.codeSize = size;
-        moduleCreateInfo.pCode = (u32 *) shaderCode;
-
-        VK_CHECK(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
-
-        delete[] shaderCode;
-
-        return shaderModule;
+        return createShaderModule(device, shaderCode, size);
     } else {
         Logger::Fatal("Could not open shader file %s", fileName);
         return VK_NULL_HANDLE;
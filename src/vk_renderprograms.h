@@ -1,5 +1,9 @@
 #pragma once
 #include "vk_common.h"
+#include "vk_variants.h"
+
+// Per fragment light caps the variants are prewarmed for.
+static const u32 g_shadedLightCaps[] = {8, 32, MAX_LIGHTS_PER_CLUSTER};
 
 void setupFirstTimeRenderprogs(u32 uboSize, std::vector<glm::vec4> &pc);
 
@@ -9,6 +13,12 @@ VkDescriptorPool createDescriptorPool();
 static
 VkDescriptorSetLayout createDescriptorSetLayout();
 
+static
+VkDescriptorSetLayout createCullDescriptorSetLayout();
+
+static
+VkDescriptorSetLayout createPyramidDescriptorSetLayout();
+
 static
 void allocateDescriptorSet(VkDescriptorPool pool, VkDescriptorSetLayout layout,
                            VkDescriptorSet *descSets, u32 numDescSets);
@@ -19,13 +29,23 @@ void updateDescriptorSet(Buffer_t ubo_buffer, u32 offset, u32 range, VkDescripto
 struct VertexDescriptions_t; //Fwd declare
 static
 VkPipeline createGraphicsPipeline(VkDevice device, VkPipelineCache cache,
-                                  VkRenderPass rp, Shader_t& vs, Shader_t& fs,
-                                  VkPipelineLayout layout, VertexDescriptions_t* vtxDescs);
+                                  VkRenderPass rp, Shader_t& vs, Shader_t* fs,
+                                  const VkSpecializationInfo* fsSpecialization,
+                                  VkPipelineLayout layout, VertexDescriptions_t* vtxDescs,
+                                  const PipelineState_t& state);
+
+static
+VkPipeline createComputePipeline(VkDevice device, VkPipelineCache cache, Shader_t& cs, VkPipelineLayout layout);
 
 static
-VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout *dcLayout,
+VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout *dcLayout, u32 dcLayoutCount,
                                       VkPushConstantRange *pcRange);
 
 void initialDescriptorSetup();
 void initialShaderLoad();
-void initialPipelineCreation();
\ No newline at end of file
+void initialPipelineCreation();
+
+// Mesh pipeline for a variant, called by the variant cache.
+VkPipeline createVariantPipeline(const ShaderVariantKey_t &key);
+void updateClusterDescriptorSets();
+void updateLightDescriptorSet();
\ No newline at end of file
@@ -1,8 +1,35 @@
+#include "jobs.h"
 #include "vk_resources.h"
 
+// Staging copies above this size are split into chunks and copied on all workers.
+#define PARALLEL_COPY_THRESHOLD (1024 * 1024)
+#define PARALLEL_COPY_CHUNK (256 * 1024)
+
+struct ParallelCopy_t {
+    u8 *dst;
+    const u8 *src;
+    u32 size;
+};
+
+struct DeferredDestroy_t {
+    u64 lastUseFrame;
+    DeferredDestroyFn_t destroy;
+    void *object;
+};
+
+static std::vector<DeferredDestroy_t> g_deferredDestroys;
+
+static
+void copyChunksJob(void *data, u32 begin, u32 end) {
+    ParallelCopy_t *copy = (ParallelCopy_t *) data;
+    u32 first = begin * PARALLEL_COPY_CHUNK;
+    u32 last = end * PARALLEL_COPY_CHUNK < copy->size ? end * PARALLEL_COPY_CHUNK : copy->size;
+    memcpy(copy->dst + first, copy->src + first, last - first);
+}
+
 void createBuffer(Buffer_t& result,
                   VkBufferUsageFlags usage, VmaMemoryUsage vmaUsage,
-                  u32 size,
+                  u32 size, MemoryCategory_t category,
                   VmaAllocator& vma_allocator)
 {
     VkBufferCreateInfo createInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
@@ -12,6 +39,7 @@ void createBuffer(Buffer_t& result,
 
     VmaAllocationCreateInfo vmaCreateInfo = {};
     vmaCreateInfo.usage = vmaUsage; //NOTE(anton): If I specify usage they memory type flags will be setup automatically
+    vmaCreateInfo.pUserData = memoryCategoryUserData(category);
 
     result.vmaAlloc = VK_NULL_HANDLE;
     result.vmaInfo = {};
@@ -20,10 +48,19 @@ void createBuffer(Buffer_t& result,
                               &result.buffer,
                               &result.vmaAlloc,
                               &result.vmaInfo) );
+    trackAllocation(result.vmaAlloc);
 
     result.size = size;
 }
 
+void destroyBuffer(Buffer_t& buffer, VmaAllocator& vma_allocator)
+{
+    trackFree(buffer.vmaAlloc);
+    vmaDestroyBuffer(vma_allocator, buffer.buffer, buffer.vmaAlloc);
+    buffer.buffer = VK_NULL_HANDLE;
+    buffer.vmaAlloc = VK_NULL_HANDLE;
+}
+
 void uploadBuffer(VkDevice device, VkCommandPool commandPool,
                   VkCommandBuffer commandBuffer,
                   VkQueue queue,
@@ -33,7 +70,13 @@ void uploadBuffer(VkDevice device, VkCommandPool commandPool,
     void *mappedData;
     vmaMapMemory(vma_allocator, scratch.vmaAlloc, &mappedData);
     ASSERT(scratch.size >= size);
-    memcpy(mappedData, data, size);
+    if (size > PARALLEL_COPY_THRESHOLD) {
+        ParallelCopy_t copy = { (u8 *) mappedData, (const u8 *) data, size };
+        u32 chunkCount = (size + PARALLEL_COPY_CHUNK - 1) / PARALLEL_COPY_CHUNK;
+        parallelFor(chunkCount, 1, copyChunksJob, &copy);
+    } else {
+        memcpy(mappedData, data, size);
+    }
     vmaUnmapMemory(vma_allocator, scratch.vmaAlloc);
 
     VK_CHECK( vkResetCommandPool(device, commandPool, 0));
@@ -57,16 +100,68 @@ void uploadBuffer(VkDevice device, VkCommandPool commandPool,
     VK_CHECK(vkDeviceWaitIdle(device));
 }
 
+void uploadImage(VkDevice device, VkCommandPool commandPool,
+                 VkCommandBuffer commandBuffer,
+                 VkQueue queue,
+                 const Image_t& image, u32 width, u32 height, const Buffer_t& scratch,
+                 const void* data, u32 size, VmaAllocator& vma_allocator)
+{
+    void *mappedData;
+    vmaMapMemory(vma_allocator, scratch.vmaAlloc, &mappedData);
+    ASSERT(scratch.size >= size);
+    memcpy(mappedData, data, size);
+    vmaUnmapMemory(vma_allocator, scratch.vmaAlloc);
+
+    VK_CHECK( vkResetCommandPool(device, commandPool, 0));
+
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VK_CHECK( vkBeginCommandBuffer(commandBuffer, &beginInfo) );
+
+    VkImageMemoryBarrier toTransfer = imageMemoryBarrier(image.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                                         VK_IMAGE_LAYOUT_UNDEFINED,
+                                                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                         VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { width, height, 1 };
+    vkCmdCopyBufferToImage(commandBuffer, scratch.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           1, &region);
+
+    VkImageMemoryBarrier toShader = imageMemoryBarrier(image.image, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                                       VK_ACCESS_SHADER_READ_BIT,
+                                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                       VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toShader);
+
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+    VK_CHECK(vkDeviceWaitIdle(device));
+}
+
 void createImage(Image_t& result, VkDevice device,
-                 u32 width, u32 height, VkFormat format, VkImageUsageFlags usage,
-                 VkImageAspectFlags aspectMask, VmaAllocator& vma_allocator)
+                 u32 width, u32 height, u32 mipLevels, VkFormat format, VkImageUsageFlags usage,
+                 VkImageAspectFlags aspectMask, MemoryCategory_t category, VmaAllocator& vma_allocator)
 {
     VkImageCreateInfo createInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
 
     createInfo.imageType = VK_IMAGE_TYPE_2D;
     createInfo.format = format;
     createInfo.extent = { width, height, 1 };
-    createInfo.mipLevels = 1;
+    createInfo.mipLevels = mipLevels;
     createInfo.arrayLayers = 1;
     createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -76,6 +171,7 @@ void createImage(Image_t& result, VkDevice device,
     VmaAllocationCreateInfo vmaCreateInfo = {};
     vmaCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    vmaCreateInfo.pUserData = memoryCategoryUserData(category);
 
     result.vmaAlloc = VK_NULL_HANDLE;
     result.vmaInfo = {};
@@ -84,6 +180,7 @@ void createImage(Image_t& result, VkDevice device,
                              &result.image,
                              &result.vmaAlloc,
                              &result.vmaInfo) );
+    trackAllocation(result.vmaAlloc);
 
     VkImageViewCreateInfo viewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
     viewCreateInfo.image = result.image;
@@ -91,7 +188,7 @@ void createImage(Image_t& result, VkDevice device,
     viewCreateInfo.format = format;
     viewCreateInfo.subresourceRange.aspectMask = aspectMask;
     viewCreateInfo.subresourceRange.baseMipLevel = 0;
-    viewCreateInfo.subresourceRange.levelCount = 1;
+    viewCreateInfo.subresourceRange.levelCount = mipLevels;
     viewCreateInfo.subresourceRange.layerCount = 1;
 
     VK_CHECK(vkCreateImageView(device, &viewCreateInfo, 0, &result.view));
@@ -99,6 +196,7 @@ void createImage(Image_t& result, VkDevice device,
 
 void destroyImage(Image_t& image, VkDevice device, VmaAllocator& vma_allocator)
 {
+    trackFree(image.vmaAlloc);
     vmaDestroyImage(vma_allocator, image.image, image.vmaAlloc);
 }
 
@@ -118,3 +216,34 @@ VkImageMemoryBarrier imageMemoryBarrier(VkImage image, VkAccessFlags srcAccessMa
 
     return barrier;
 }
+
+VkBufferMemoryBarrier bufferMemoryBarrier(VkBuffer buffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask)
+{
+    VkBufferMemoryBarrier barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    barrier.srcAccessMask = srcAccessMask;
+    barrier.dstAccessMask = dstAccessMask;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    return barrier;
+}
+
+void deferDestroy(u64 lastUseFrame, DeferredDestroyFn_t destroy, void *object) {
+    g_deferredDestroys.push_back({lastUseFrame, destroy, object});
+}
+
+void runDeferredDestroys(u64 completedFrame) {
+    u32 kept = 0;
+    for (u32 i = 0; i < g_deferredDestroys.size(); i++) {
+        DeferredDestroy_t &entry = g_deferredDestroys[i];
+        if (entry.lastUseFrame <= completedFrame) {
+            entry.destroy(entry.object);
+        } else {
+            g_deferredDestroys[kept++] = entry;
+        }
+    }
+    g_deferredDestroys.resize(kept);
+}
@@ -1,17 +1,21 @@
 #pragma once
 
 #include "vk_common.h"
+#include "vk_memory.h"
 
 VkImageMemoryBarrier imageMemoryBarrier(VkImage image, VkAccessFlags srcAccessMask,
                                         VkAccessFlags dstAccessMask,
                                         VkImageLayout oldLayout, VkImageLayout newLayout,
                                         VkImageAspectFlags aspectMask);
 
+VkBufferMemoryBarrier bufferMemoryBarrier(VkBuffer buffer, VkAccessFlags srcAccessMask,
+                                          VkAccessFlags dstAccessMask);
+
 void destroyImage(Image_t &image, VkDevice device, VmaAllocator &vma_allocator);
 
 void createImage(Image_t &result, VkDevice device,
-                 u32 width, u32 height, VkFormat format, VkImageUsageFlags usage,
-                 VkImageAspectFlags aspectMask, VmaAllocator &vma_allocator);
+                 u32 width, u32 height, u32 mipLevels, VkFormat format, VkImageUsageFlags usage,
+                 VkImageAspectFlags aspectMask, MemoryCategory_t category, VmaAllocator &vma_allocator);
 
 void uploadBuffer(VkDevice device, VkCommandPool commandPool,
                   VkCommandBuffer commandBuffer,
@@ -19,7 +23,26 @@ void uploadBuffer(VkDevice device, VkCommandPool commandPool,
                   const Buffer_t &buffer, const Buffer_t &scratch,
                   const void *data, u32 dstOffset, u32 size, VmaAllocator &vma_allocator);
 
+// Copies tightly packed texels into mip 0 of a sampled image and leaves it in
+// SHADER_READ_ONLY_OPTIMAL. Waits for the device like uploadBuffer.
+void uploadImage(VkDevice device, VkCommandPool commandPool,
+                 VkCommandBuffer commandBuffer,
+                 VkQueue queue,
+                 const Image_t &image, u32 width, u32 height, const Buffer_t &scratch,
+                 const void *data, u32 size, VmaAllocator &vma_allocator);
+
 void createBuffer(Buffer_t &result,
                   VkBufferUsageFlags usage, VmaMemoryUsage vmaUsage,
-                  u32 size,
-                  VmaAllocator &vma_allocator);
\ No newline at end of file
+                  u32 size, MemoryCategory_t category,
+                  VmaAllocator &vma_allocator);
+
+void destroyBuffer(Buffer_t &buffer, VmaAllocator &vma_allocator);
+
+typedef void (*DeferredDestroyFn_t)(void *object);
+
+// For objects frames in flight may still use. destroy(object) runs once the GPU has finished frame
+// lastUseFrame, from runDeferredDestroys.
+void deferDestroy(u64 lastUseFrame, DeferredDestroyFn_t destroy, void *object);
+
+// Runs everything queued for frames up to completedFrame.
+void runDeferredDestroys(u64 completedFrame);
@@ -51,6 +51,34 @@ VkFormat getDepthFormat(VkPhysicalDevice physicalDevice) {
 }
 
 
+const char *presentModeName(VkPresentModeKHR mode) {
+    switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo relaxed";
+        default: return "unknown";
+    }
+}
+
+VkPresentModeKHR choosePresentMode(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface,
+                                   VkPresentModeKHR requested) {
+    u32 modeCount = 0;
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &modeCount, nullptr));
+    std::vector<VkPresentModeKHR> modes(modeCount);
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &modeCount, modes.data()));
+
+    for (VkPresentModeKHR mode : modes) {
+        if (mode == requested) {
+            return mode;
+        }
+    }
+
+    // FIFO is the only mode every surface has to support.
+    Logger::Warn("Present mode %s not supported, using fifo", presentModeName(requested));
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
 void destroySwapchain(VkDevice device, const Swapchain_t &swapchain) {
     vkDestroySwapchainKHR(device, swapchain.swapchain, 0);
 }
@@ -58,11 +86,17 @@ void destroySwapchain(VkDevice device, const Swapchain_t &swapchain) {
 static
 VkSwapchainKHR createSwapchainKHR(VkDevice device, VkSurfaceKHR surface,
                                   VkSurfaceCapabilitiesKHR surfaceCaps,
-                                  VkFormat format, u32 width, u32 height,
+                                  VkFormat format, u32 width, u32 height, VkPresentModeKHR presentMode,
                                   u32 familyIndex, VkSwapchainKHR oldSwapchain) {
+    // Mailbox needs a third image to have somewhere to render while one is queued and one is on
+    // screen, with two it stalls like FIFO.
+    u32 imageCount = presentMode == VK_PRESENT_MODE_MAILBOX_KHR ? 3 : 2;
+    if (imageCount < surfaceCaps.minImageCount) imageCount = surfaceCaps.minImageCount;
+    if (surfaceCaps.maxImageCount > 0 && imageCount > surfaceCaps.maxImageCount) imageCount = surfaceCaps.maxImageCount;
+
     VkSwapchainCreateInfoKHR createInfo = {VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR};
     createInfo.surface = surface;
-    createInfo.minImageCount = 2;
+    createInfo.minImageCount = imageCount;
     createInfo.imageFormat = format;
     createInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
     createInfo.imageExtent.width = width;
@@ -72,8 +106,7 @@ VkSwapchainKHR createSwapchainKHR(VkDevice device, VkSurfaceKHR surface,
     createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
     createInfo.queueFamilyIndexCount = 1;
     createInfo.pQueueFamilyIndices = &familyIndex;
-    //TODO(anton): Mailbox instead of FIFO? FIFO is more widely supported.
-    createInfo.presentMode = VSYNC ? VK_PRESENT_MODE_FIFO_KHR : VK_PRESENT_MODE_IMMEDIATE_KHR;
+    createInfo.presentMode = presentMode;
     createInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     //createInfo.clipped = VK_TRUE;
@@ -88,15 +121,18 @@ VkSwapchainKHR createSwapchainKHR(VkDevice device, VkSurfaceKHR surface,
 
 void createSwapchain(Swapchain_t &result, VkPhysicalDevice physicalDevice,
                      VkDevice device, VkSurfaceKHR surface,
-                     VkFormat format, u32 familyIndex, VkSwapchainKHR oldSwapchain) {
+                     VkFormat format, VkPresentModeKHR presentMode, u32 familyIndex,
+                     VkSwapchainKHR oldSwapchain) {
     VkSurfaceCapabilitiesKHR surfaceCaps;
     VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCaps));
 
     u32 width = surfaceCaps.currentExtent.width;
     u32 height = surfaceCaps.currentExtent.height;
 
+    presentMode = choosePresentMode(physicalDevice, surface, presentMode);
+
     VkSwapchainKHR swapchain = createSwapchainKHR(device, surface, surfaceCaps,
-                                                  format, width, height,
+                                                  format, width, height, presentMode,
                                                   familyIndex, oldSwapchain);
     ASSERT(swapchain != VK_NULL_HANDLE);
 
@@ -111,11 +147,13 @@ void createSwapchain(Swapchain_t &result, VkPhysicalDevice physicalDevice,
     result.width = width;
     result.height = height;
     result.imageCount = imageCount;
+    result.presentMode = presentMode;
 }
 
 SwapchainStatus_t
-updateSwapchain(Swapchain_t &result, VkPhysicalDevice physicalDevice, VkDevice device, VkSurfaceKHR surface,
-                VkFormat format, u32 familyIndex) {
+updateSwapchain(Swapchain_t &result, Swapchain_t &retired, VkPhysicalDevice physicalDevice, VkDevice device,
+                VkSurfaceKHR surface, VkFormat format, VkPresentModeKHR presentMode, u32 familyIndex,
+                bool outOfDate) {
     VkSurfaceCapabilitiesKHR surfaceCaps;
     VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCaps));
 
@@ -125,17 +163,12 @@ updateSwapchain(Swapchain_t &result, VkPhysicalDevice physicalDevice, VkDevice d
     if (newWidth == 0 || newHeight == 0)
         return Swapchain_NotReady;
 
-    if (result.width == newWidth && result.height == newHeight)
+    if (!outOfDate && result.width == newWidth && result.height == newHeight)
         return Swapchain_Ready;
 
-    Swapchain_t old = result;
+    retired = result;
 
-    createSwapchain(result, physicalDevice, device, surface, format, familyIndex, old.swapchain);
-
-    VK_CHECK(vkDeviceWaitIdle(device));
-
-    destroySwapchain(device, old);
+    createSwapchain(result, physicalDevice, device, surface, format, presentMode, familyIndex, retired.swapchain);
 
     return Swapchain_Resized;
 }
-
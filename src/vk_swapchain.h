@@ -2,23 +2,37 @@
 
 #include "vk_common.h"
 
-#define VSYNC 1
+// Present mode at startup, FIFO is vsync and always available.
+#ifndef DEFAULT_PRESENT_MODE
+#define DEFAULT_PRESENT_MODE VK_PRESENT_MODE_FIFO_KHR
+#endif
 
 VkFormat getSwapchainFormat(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
 
 VkFormat getDepthFormat(VkPhysicalDevice physicalDevice);
 
+const char *presentModeName(VkPresentModeKHR mode);
+
+// The requested mode if the surface supports it, FIFO otherwise.
+VkPresentModeKHR choosePresentMode(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface,
+                                   VkPresentModeKHR requested);
+
 void destroySwapchain(VkDevice device, const Swapchain_t &swapchain);
 
 void createSwapchain(Swapchain_t &result, VkPhysicalDevice physicalDevice,
                      VkDevice device, VkSurfaceKHR surface,
-                     VkFormat format, u32 familyIndex, VkSwapchainKHR oldSwapchain);
+                     VkFormat format, VkPresentModeKHR presentMode, u32 familyIndex,
+                     VkSwapchainKHR oldSwapchain);
 
 VkSwapchainKHR createSwapchainKHR(VkDevice device, VkSurfaceKHR surface,
                                   VkSurfaceCapabilitiesKHR surfaceCaps,
-                                  VkFormat format, u32 width, u32 height,
+                                  VkFormat format, u32 width, u32 height, VkPresentModeKHR presentMode,
                                   u32 familyIndex, VkSwapchainKHR oldSwapchain);
 
-SwapchainStatus_t updateSwapchain(Swapchain_t &result, VkPhysicalDevice physicalDevice,
+// Only called when the surface may have changed, after a resize event or an out of date or
+// suboptimal result from acquire or present. Recreates the swapchain if the size changed, or always
+// when outOfDate, which is also how a new present mode takes effect. The old swapchain is handed back in retired, its images can still be queued for
+// presentation so destroying it is up to the caller.
+SwapchainStatus_t updateSwapchain(Swapchain_t &result, Swapchain_t &retired, VkPhysicalDevice physicalDevice,
                                   VkDevice device, VkSurfaceKHR surface, VkFormat format,
-                                  u32 familyIndex);
\ No newline at end of file
+                                  VkPresentModeKHR presentMode, u32 familyIndex, bool outOfDate);
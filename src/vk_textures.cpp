@@ -0,0 +1,469 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include "arena.h"
+#include "cooked.h"
+#include "jobs.h"
+#include "ktx2.h"
+#include "profiler.h"
+#include "vk_bindless.h"
+#include "vk_memory.h"
+#include "vk_render.h"
+#include "vk_resources.h"
+#include "vk_textures.h"
+
+// Offsets in the staging buffer, copies of block compressed data have to start on a block.
+#define TEXTURE_STAGING_ALIGNMENT 16
+
+// One half of the staging buffer, the mips planned in one update. The other half is read by the
+// copies of the frame recording meanwhile.
+#define TEXTURE_UPLOAD_BYTES ((VkDeviceSize) TEXTURE_UPLOAD_KB_PER_FRAME * 1024)
+
+struct StreamedTexture_t {
+    std::string path;
+    MappedFile_t file; // Mapped for the texture's lifetime, the mips are read from here
+    Ktx2Info_t info;
+    VkFormat format;
+    u32 slot;
+
+    Image_t image; // Holds mips residentMip to levelCount - 1, mip 0 of the image is residentMip
+    bool hasImage;
+    u32 residentMip; // levelCount while nothing is resident
+    u32 targetMip; // Where the planned update is taking it
+    u32 desiredMip;
+    u32 tailMip; // First mip of the always resident tail
+    u32 finestMip; // The finest mip that fits the staging buffer
+
+    f32 requestedPixels; // Largest request since the last update
+};
+
+// A mip the read job copies into the staging buffer, in the order the copies are recorded.
+struct MipRead_t {
+    u32 texture;
+    u32 mip;
+    VkDeviceSize stagingOffset; // From the start of the buffer
+};
+
+static std::vector<StreamedTexture_t> g_textures;
+
+static Buffer_t g_staging = {};
+static u8 *g_mappedStaging = nullptr;
+static u32 g_stagingHalf = 0; // The next plan reads into this half
+
+// Residency changes planned by the last update. Their mips are read on a job while the rest of
+// that frame records, the next update waits for it and records the copies.
+static std::vector<MipRead_t> g_reads;
+static JobCounter_t g_readsDone;
+static bool g_planPending = false;
+static MemoryPressure_t g_pressure = MemoryPressure_None;
+static TextureStreamingStats_t g_stats = {};
+
+static
+void destroyTextureImage(void *object) {
+    Image_t *image = (Image_t *) object;
+    destroyImage(*image, vk_device, vk_vma);
+    delete image;
+}
+
+static
+VkDeviceSize mipBytes(const StreamedTexture_t &texture, u32 mip) {
+    return texture.info.levels[mip].length;
+}
+
+// Bytes of the mips from mip to the end of the chain.
+static
+VkDeviceSize residentBytes(const StreamedTexture_t &texture, u32 mip) {
+    VkDeviceSize bytes = 0;
+    for (u32 i = mip; i < texture.info.levelCount; i++) {
+        bytes += mipBytes(texture, i);
+    }
+    return bytes;
+}
+
+static
+VkDeviceSize textureBudget() {
+    VkDeviceSize budget = (VkDeviceSize) TEXTURE_BUDGET_MB * 1024 * 1024;
+    if (g_pressure == MemoryPressure_High) return budget * 3 / 4;
+    if (g_pressure == MemoryPressure_Critical) return budget / 2;
+    return budget;
+}
+
+// Only the device local heaps hold textures. The budget shrinks here, the next update evicts.
+static
+void onTextureMemoryPressure(u32 heapIndex, MemoryPressure_t pressure, const HeapBudget_t &heap, void *data) {
+    if (!heap.deviceLocal) return;
+    g_pressure = pressure;
+}
+
+void initTextureStreaming() {
+    createBuffer(g_staging,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VMA_MEMORY_USAGE_CPU_ONLY,
+                 2 * TEXTURE_UPLOAD_BYTES, MemoryCategory_Staging, vk_vma);
+    // The halves alternate per update, the read job fills one while the frame being recorded copies
+    // from the other. The frame that copied from a half has finished before the job refills it.
+    vmaMapMemory(vk_vma, g_staging.vmaAlloc, (void **) &g_mappedStaging);
+
+    g_textures.reserve(MAX_STREAMED_TEXTURES);
+    addMemoryPressureCallback(onTextureMemoryPressure, nullptr);
+
+    if (!vk_gpu.features.textureCompressionBC) {
+        Logger::Warn("No BC texture compression, KTX2 textures will not load");
+    }
+}
+
+u32 loadKtx2Texture(const char *path) {
+    ASSERT(g_mappedStaging);
+    if (g_textures.size() >= MAX_STREAMED_TEXTURES) {
+        Logger::Warn("Streamed texture limit of %i reached, not loading %s", MAX_STREAMED_TEXTURES, path);
+        return U32_MAX;
+    }
+
+    StreamedTexture_t texture = {};
+    if (!mapFile(path, texture.file)) {
+        Logger::Warn("Could not open texture %s", path);
+        return U32_MAX;
+    }
+    u64 headerSize = KTX2_HEADER_SIZE + KTX2_MAX_LEVELS * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+    if (texture.file.size < headerSize) headerSize = texture.file.size;
+
+    Ktx2Result_t result = parseKtx2(texture.file.data, headerSize, texture.file.size, texture.info);
+    if (result != Ktx2_Ok) {
+        Logger::Warn("Texture %s: %s", path, ktx2ResultName(result));
+        unmapFile(texture.file);
+        return U32_MAX;
+    }
+
+    texture.format = (VkFormat) texture.info.vkFormat;
+    VkFormatProperties formatProps;
+    vkGetPhysicalDeviceFormatProperties(vk_gpu.device, texture.format, &formatProps);
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT |
+                                  VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    if ((formatProps.optimalTilingFeatures & needed) != needed) {
+        Logger::Warn("Texture %s: format %i can not be sampled on this device", path, texture.info.vkFormat);
+        unmapFile(texture.file);
+        return U32_MAX;
+    }
+
+    const Ktx2Info_t &info = texture.info;
+    texture.tailMip = info.levelCount - 1;
+    for (u32 mip = 0; mip < info.levelCount; mip++) {
+        u32 size = std::max(ktx2MipSize(info.width, mip), ktx2MipSize(info.height, mip));
+        if (size <= TEXTURE_MIN_RESIDENT_SIZE) {
+            texture.tailMip = mip;
+            break;
+        }
+    }
+    texture.finestMip = texture.tailMip;
+    while (texture.finestMip > 0 &&
+           mipBytes(texture, texture.finestMip - 1) + TEXTURE_STAGING_ALIGNMENT <= TEXTURE_UPLOAD_BYTES) {
+        texture.finestMip -= 1;
+    }
+    if (residentBytes(texture, texture.tailMip) + info.levelCount * TEXTURE_STAGING_ALIGNMENT > TEXTURE_UPLOAD_BYTES) {
+        Logger::Warn("Texture %s: the coarse mips alone do not fit the staging buffer", path);
+        unmapFile(texture.file);
+        return U32_MAX;
+    }
+    if (texture.finestMip > 0) {
+        Logger::Warn("Texture %s: mips finer than %i are larger than the staging buffer and never stream",
+                     path, texture.finestMip);
+    }
+
+    texture.path = path;
+    texture.slot = reserveBindlessTexture();
+    texture.residentMip = info.levelCount;
+    texture.targetMip = info.levelCount;
+    texture.desiredMip = texture.tailMip;
+
+    Logger::Trace("Texture %s: %ix%i, %i mips, format %i, slot %i", path, info.width, info.height,
+                  info.levelCount, info.vkFormat, texture.slot);
+
+    g_textures.push_back(texture);
+    return (u32) g_textures.size() - 1;
+}
+
+u32 streamedTextureSlot(u32 texture) {
+    ASSERT(texture < g_textures.size());
+    return g_textures[texture].slot;
+}
+
+void requestTextureResolution(u32 texture, f32 screenPixels) {
+    ASSERT(texture < g_textures.size());
+    StreamedTexture_t &streamed = g_textures[texture];
+    if (screenPixels > streamed.requestedPixels) {
+        streamed.requestedPixels = screenPixels;
+    }
+}
+
+// The finest mip worth having for the largest on screen size requested, one texel per pixel.
+static
+u32 desiredMip(const StreamedTexture_t &texture) {
+    if (texture.requestedPixels <= 0.0f) return texture.tailMip;
+    f32 size = (f32) std::max(texture.info.width, texture.info.height);
+    f32 mip = floorf(log2f(size / texture.requestedPixels));
+    if (mip <= (f32) texture.finestMip) return texture.finestMip;
+    if (mip >= (f32) texture.tailMip) return texture.tailMip;
+    return (u32) mip;
+}
+
+// Drops the largest finest mip among the textures holding more than they need, or more than
+// their tail when evenIfNeeded. Returns the bytes freed, 0 when nothing qualified.
+static
+VkDeviceSize evictFinestMip(bool evenIfNeeded) {
+    StreamedTexture_t *victim = nullptr;
+    VkDeviceSize victimBytes = 0;
+    for (StreamedTexture_t &texture : g_textures) {
+        if (texture.targetMip >= texture.tailMip) continue;
+        if (!evenIfNeeded && texture.targetMip >= texture.desiredMip) continue;
+        VkDeviceSize bytes = mipBytes(texture, texture.targetMip);
+        if (bytes > victimBytes) {
+            victim = &texture;
+            victimBytes = bytes;
+        }
+    }
+    if (!victim) return 0;
+    victim->targetMip += 1;
+    g_stats.evictedMips += 1;
+    return victimBytes;
+}
+
+// Page faults on the mappings wait for the disk here instead of on the render thread. Only reads
+// the file and info of the textures, nothing else touches those after loading.
+static
+void readMipsJob(void *data, u32 begin, u32 end) {
+    PROFILE_ZONE("read texture mips");
+    for (u32 i = begin; i < end; i++) {
+        const MipRead_t &read = g_reads[i];
+        const StreamedTexture_t &texture = g_textures[read.texture];
+        memcpy(g_mappedStaging + read.stagingOffset, texture.file.data + texture.info.levels[read.mip].offset,
+               mipBytes(texture, read.mip));
+    }
+}
+
+static
+VkDeviceSize alignStaging(VkDeviceSize offset) {
+    return (offset + TEXTURE_STAGING_ALIGNMENT - 1) & ~((VkDeviceSize) TEXTURE_STAGING_ALIGNMENT - 1);
+}
+
+// Picks the mips every texture should hold next, sets targetMip and lists the mips to read.
+static
+void planResidency() {
+    VkDeviceSize budget = textureBudget();
+    VkDeviceSize resident = 0;
+    u32 pendingMips = 0;
+    for (StreamedTexture_t &texture : g_textures) {
+        texture.desiredMip = desiredMip(texture);
+        texture.requestedPixels = 0.0f;
+        texture.targetMip = texture.residentMip;
+        if (texture.residentMip < texture.info.levelCount) {
+            resident += residentBytes(texture, texture.residentMip);
+        }
+    }
+
+    // Over budget, after a pressure change or with more demand than fits: finest mips first, the
+    // ones nothing asked for before the rest.
+    while (resident > budget) {
+        VkDeviceSize freed = evictFinestMip(false);
+        if (freed == 0) freed = evictFinestMip(true);
+        if (freed == 0) break;
+        resident -= freed;
+    }
+
+    // New textures get their tail right away, it is small and they show white until then.
+    VkDeviceSize stagingUsed = 0;
+    for (StreamedTexture_t &texture : g_textures) {
+        if (texture.targetMip < texture.info.levelCount) continue;
+        VkDeviceSize bytes = residentBytes(texture, texture.tailMip);
+        VkDeviceSize staged = bytes + (texture.info.levelCount - texture.tailMip) * TEXTURE_STAGING_ALIGNMENT;
+        if (stagingUsed + staged > TEXTURE_UPLOAD_BYTES) break;
+        texture.targetMip = texture.tailMip;
+        stagingUsed += staged;
+        resident += bytes;
+    }
+
+    // Coarse to fine over all textures, the smallest missing mip is always the next one in.
+    for (;;) {
+        StreamedTexture_t *next = nullptr;
+        for (StreamedTexture_t &texture : g_textures) {
+            if (texture.targetMip > texture.tailMip || texture.targetMip <= texture.desiredMip) continue;
+            if (!next || mipBytes(texture, texture.targetMip - 1) < mipBytes(*next, next->targetMip - 1)) {
+                next = &texture;
+            }
+        }
+        if (!next) break;
+
+        VkDeviceSize bytes = mipBytes(*next, next->targetMip - 1);
+        if (stagingUsed + bytes + TEXTURE_STAGING_ALIGNMENT > TEXTURE_UPLOAD_BYTES) break;
+        while (resident + bytes > budget) {
+            VkDeviceSize freed = evictFinestMip(false);
+            if (freed == 0) break;
+            resident -= freed;
+        }
+        if (resident + bytes > budget || !deviceMemoryFitsBudget(residentBytes(*next, next->targetMip - 1))) break;
+
+        next->targetMip -= 1;
+        stagingUsed += bytes + TEXTURE_STAGING_ALIGNMENT;
+        resident += bytes;
+    }
+
+    for (const StreamedTexture_t &texture : g_textures) {
+        if (texture.targetMip > texture.desiredMip) pendingMips += texture.targetMip - texture.desiredMip;
+    }
+
+    g_stats.residentBytes = resident;
+    g_stats.budgetBytes = budget;
+    g_stats.pendingMips = pendingMips;
+    g_stats.textureCount = (u32) g_textures.size();
+
+    // Mips the old image holds are copied on the GPU, the rest come from the file.
+    g_reads.clear();
+    VkDeviceSize stagingBegin = g_stagingHalf * TEXTURE_UPLOAD_BYTES;
+    VkDeviceSize stagingOffset = stagingBegin;
+    for (u32 i = 0; i < (u32) g_textures.size(); i++) {
+        const StreamedTexture_t &texture = g_textures[i];
+        if (texture.targetMip == texture.residentMip) continue;
+        for (u32 mip = texture.targetMip; mip < texture.info.levelCount; mip++) {
+            if (texture.hasImage && mip >= texture.residentMip) continue;
+            stagingOffset = alignStaging(stagingOffset);
+            g_reads.push_back({i, mip, stagingOffset});
+            stagingOffset += mipBytes(texture, mip);
+        }
+    }
+    ASSERT(stagingOffset - stagingBegin <= TEXTURE_UPLOAD_BYTES);
+    g_stagingHalf ^= 1;
+}
+
+// The changes planResidency made, once the read job has staged their mips. Every change in one
+// batch: transitions in, copies, transitions out.
+static
+void recordResidencyChanges() {
+    ScratchScope_t scratch;
+    u32 changeCount = 0;
+    for (const StreamedTexture_t &texture : g_textures) {
+        if (texture.targetMip != texture.residentMip) changeCount += 1;
+    }
+
+    g_stats.uploadedBytes = 0;
+    if (changeCount == 0) return;
+
+    Image_t *newImages = arenaAllocArray<Image_t>(scratch.arena, changeCount);
+    VkImageMemoryBarrier *before = arenaAllocArray<VkImageMemoryBarrier>(scratch.arena, changeCount * 2);
+    VkImageMemoryBarrier *after = arenaAllocArray<VkImageMemoryBarrier>(scratch.arena, changeCount);
+    u32 beforeCount = 0;
+
+    u32 change = 0;
+    for (StreamedTexture_t &texture : g_textures) {
+        if (texture.targetMip == texture.residentMip) continue;
+        u32 mipCount = texture.info.levelCount - texture.targetMip;
+        createImage(newImages[change], vk_device,
+                    ktx2MipSize(texture.info.width, texture.targetMip),
+                    ktx2MipSize(texture.info.height, texture.targetMip), mipCount, texture.format,
+                    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                    VK_IMAGE_ASPECT_COLOR_BIT, MemoryCategory_Textures, vk_vma);
+
+        VkImageMemoryBarrier &toTransfer = before[beforeCount++];
+        toTransfer = imageMemoryBarrier(newImages[change].image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        VK_IMAGE_ASPECT_COLOR_BIT);
+        toTransfer.subresourceRange.levelCount = mipCount;
+
+        if (texture.hasImage) {
+            VkImageMemoryBarrier &toSource = before[beforeCount++];
+            toSource = imageMemoryBarrier(texture.image.image, 0, VK_ACCESS_TRANSFER_READ_BIT,
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+            toSource.subresourceRange.levelCount = texture.info.levelCount - texture.residentMip;
+        }
+
+        after[change] = imageMemoryBarrier(newImages[change].image, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                           VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+        after[change].subresourceRange.levelCount = mipCount;
+        change += 1;
+    }
+
+    // Earlier frames that sampled the old images have finished, only the layouts change here. Reads
+    // make nothing available and TOP_OF_PIPE has no accesses, so there is no source access.
+    vkCmdPipelineBarrier(vk_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, beforeCount, before);
+
+    // Same order as planResidency listed the reads in.
+    u32 readIndex = 0;
+    change = 0;
+    for (u32 i = 0; i < (u32) g_textures.size(); i++) {
+        const StreamedTexture_t &texture = g_textures[i];
+        if (texture.targetMip == texture.residentMip) continue;
+        const Image_t &image = newImages[change];
+
+        for (u32 mip = texture.targetMip; mip < texture.info.levelCount; mip++) {
+            VkExtent3D extent = {ktx2MipSize(texture.info.width, mip), ktx2MipSize(texture.info.height, mip), 1};
+            VkImageSubresourceLayers dstLayers = {VK_IMAGE_ASPECT_COLOR_BIT, mip - texture.targetMip, 0, 1};
+
+            if (texture.hasImage && mip >= texture.residentMip) {
+                VkImageCopy copy = {};
+                copy.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - texture.residentMip, 0, 1};
+                copy.dstSubresource = dstLayers;
+                copy.extent = extent;
+                vkCmdCopyImage(vk_commandBuffer, texture.image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+                continue;
+            }
+
+            ASSERT(readIndex < g_reads.size());
+            const MipRead_t &read = g_reads[readIndex++];
+            ASSERT(read.texture == i && read.mip == mip);
+
+            VkBufferImageCopy region = {};
+            region.bufferOffset = read.stagingOffset;
+            region.imageSubresource = dstLayers;
+            region.imageExtent = extent;
+            vkCmdCopyBufferToImage(vk_commandBuffer, g_staging.buffer, image.image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+            g_stats.uploadedBytes += mipBytes(texture, mip);
+            g_stats.streamedMips += 1;
+        }
+        change += 1;
+    }
+    ASSERT(readIndex == g_reads.size());
+
+    vkCmdPipelineBarrier(vk_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, changeCount, after);
+
+    // The copies above read the old images, they go once this frame has finished.
+    change = 0;
+    for (StreamedTexture_t &texture : g_textures) {
+        if (texture.targetMip == texture.residentMip) continue;
+        if (texture.hasImage) {
+            deferDestroy(frameNumber() + 1, destroyTextureImage, new Image_t(texture.image));
+        }
+        texture.image = newImages[change];
+        texture.hasImage = true;
+        texture.residentMip = texture.targetMip;
+        setBindlessTexture(texture.slot, texture.image.view);
+        change += 1;
+    }
+}
+
+void updateTextureStreaming() {
+    PROFILE_FUNCTION();
+    // Had the whole last frame, waiting here is rare.
+    if (g_planPending) {
+        waitForCounter(&g_readsDone);
+        recordResidencyChanges();
+        g_planPending = false;
+    }
+
+    planResidency();
+    if (!g_reads.empty()) {
+        JobDecl_t job = {readMipsJob, nullptr, 0, (u32) g_reads.size()};
+        runJobs(&job, 1, &g_readsDone);
+    }
+    g_planPending = true;
+}
+
+TextureStreamingStats_t getTextureStreamingStats() {
+    return g_stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "vk_common.h"
+
+// Block compressed (BC1 to BC7) textures streamed from KTX2 files into the bindless table.
+// The coarse mips load with the texture and never leave. Finer mips stream in coarse to fine as
+// far as draws ask for them, one staging buffer's worth per frame. When the resident mips pass the
+// budget the finest ones go first. A residency change reallocates the image with the new mip
+// count, copies the mips both images share on the GPU and repoints the texture's bindless slot,
+// the old image is freed once the frame that copied from it has finished. The files stay mapped and
+// the mips are read on a job, an update's changes reach the GPU with the next update.
+
+#ifndef TEXTURE_BUDGET_MB
+#define TEXTURE_BUDGET_MB 256
+#endif
+
+// The most mip data uploaded per frame, the staging buffer holds two frames of it. Mips larger than
+// this never become resident.
+#ifndef TEXTURE_UPLOAD_KB_PER_FRAME
+#define TEXTURE_UPLOAD_KB_PER_FRAME 16384
+#endif
+
+// Mips this size and smaller are loaded with the texture and always resident.
+#define TEXTURE_MIN_RESIDENT_SIZE 64
+
+#define MAX_STREAMED_TEXTURES 1024
+
+struct TextureStreamingStats_t {
+    u32 textureCount;
+    VkDeviceSize residentBytes;
+    VkDeviceSize budgetBytes; // Shrinks while the device local heaps are under memory pressure
+    VkDeviceSize uploadedBytes; // Last update
+    u32 pendingMips; // Requested but not resident yet
+    u32 streamedMips; // Totals since start
+    u32 evictedMips;
+};
+
+// Before the first texture. Needs the device and the bindless table.
+void initTextureStreaming();
+
+// Maps the file and reads the header and level index, the mips are read when they stream in. Returns the
+// texture, U32_MAX when the file can not be used, draws should fall back to bindless slot 0 then.
+u32 loadKtx2Texture(const char *path);
+
+// Bindless slot of the texture, fixed for its lifetime. White until the coarse mips are in.
+u32 streamedTextureSlot(u32 texture);
+
+// How many pixels the texture's full width covers on screen for a draw this frame. The largest
+// request of the frame picks the mips the texture needs.
+void requestTextureResolution(u32 texture, f32 screenPixels);
+
+// Once per frame, after prepareFrame and before the main pass. Records the copies the last update
+// planned into the frame command buffer and repoints the bindless slots that changed, then plans
+// the next evictions and uploads and starts the job reading their mips.
+void updateTextureStreaming();
+
+TextureStreamingStats_t getTextureStreamingStats();
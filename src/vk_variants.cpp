@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+#include "jobs.h"
+#include "vk_variants.h"
+#include "vk_renderprograms.h"
+
+struct ShaderVariant_t {
+    ShaderVariantKey_t key;
+    VkPipeline pipeline;
+    f64 buildMs;
+    bool onDemand;
+};
+
+static std::unordered_map<u64, ShaderVariant_t> g_variants;
+static ShaderVariantStats_t g_variantStats = {};
+
+// Draws mostly repeat the previous key, this skips the hash lookup for them.
+static u64 g_lastKey = U64_MAX;
+static VkPipeline g_lastPipeline = VK_NULL_HANDLE;
+
+static const char *g_passNames[] = {"color", "depth pre-pass", "color equal"};
+static const char *g_shadingNames[ShadingModel_Count] = {"lambert", "gooch"};
+
+ShaderVariantKey_t normalizeVariantKey(ShaderVariantKey_t key) {
+    if (key.pass == MeshPass_DepthPrepass) {
+        key.shading = ShadingModel_Lambert;
+        key.maxShadedLights = 0;
+        key.features = 0;
+    }
+    // lambert.frag has no highlight.
+    if (key.shading == ShadingModel_Lambert) {
+        key.features &= ~(u32) VariantFeature_Specular;
+    }
+    if (key.maxShadedLights > MAX_LIGHTS_PER_CLUSTER) {
+        key.maxShadedLights = MAX_LIGHTS_PER_CLUSTER;
+    }
+    return key;
+}
+
+u64 packVariantKey(const ShaderVariantKey_t &key) {
+    ASSERT(key.pass < 4 && key.shading < 4 && key.maxShadedLights <= 0xffff && key.features <= 0xff);
+    return (u64) key.pass | ((u64) key.shading << 2) | ((u64) key.features << 4) |
+           ((u64) key.maxShadedLights << 12);
+}
+
+static
+f64 buildVariant(const ShaderVariantKey_t &key, VkPipeline *pipeline) {
+    auto start = std::chrono::steady_clock::now();
+    *pipeline = createVariantPipeline(key);
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static
+void addVariant(const ShaderVariantKey_t &key, VkPipeline pipeline, f64 buildMs, bool onDemand) {
+    g_variants[packVariantKey(key)] = {key, pipeline, buildMs, onDemand};
+
+    g_variantStats.variantCount += 1;
+    g_variantStats.onDemandBuilds += onDemand ? 1 : 0;
+    g_variantStats.totalBuildMs += buildMs;
+    g_variantStats.slowestBuildMs = std::max(g_variantStats.slowestBuildMs, buildMs);
+}
+
+VkPipeline getShaderVariant(const ShaderVariantKey_t &key) {
+    ShaderVariantKey_t normalized = normalizeVariantKey(key);
+    u64 packed = packVariantKey(normalized);
+    if (packed == g_lastKey) return g_lastPipeline;
+
+    auto it = g_variants.find(packed);
+    if (it == g_variants.end()) {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        f64 buildMs = buildVariant(normalized, &pipeline);
+        Logger::Warn("Shader variant %s %s, %i lights, features %x built on demand in %f ms",
+                     g_passNames[normalized.pass], g_shadingNames[normalized.shading],
+                     normalized.maxShadedLights, normalized.features, buildMs);
+        addVariant(normalized, pipeline, buildMs, true);
+        it = g_variants.find(packed);
+    }
+
+    g_lastKey = packed;
+    g_lastPipeline = it->second.pipeline;
+    return g_lastPipeline;
+}
+
+struct VariantBuild_t {
+    ShaderVariantKey_t key;
+    VkPipeline pipeline;
+    f64 buildMs;
+};
+
+static
+void buildVariantsJob(void *data, u32 begin, u32 end) {
+    VariantBuild_t *builds = (VariantBuild_t *) data;
+    for (u32 i = begin; i < end; i++) {
+        builds[i].buildMs = buildVariant(builds[i].key, &builds[i].pipeline);
+    }
+}
+
+void prewarmShaderVariants(const ShaderVariantKey_t *keys, u32 count) {
+    // Pipeline creation is thread safe, the cache is not. Workers build, the caller inserts.
+    std::vector<VariantBuild_t> builds;
+    for (u32 i = 0; i < count; i++) {
+        ShaderVariantKey_t key = normalizeVariantKey(keys[i]);
+        u64 packed = packVariantKey(key);
+        if (g_variants.count(packed)) continue;
+
+        bool queued = false;
+        for (const VariantBuild_t &build : builds) {
+            queued = queued || packVariantKey(build.key) == packed;
+        }
+        if (!queued) builds.push_back({key, VK_NULL_HANDLE, 0.0});
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    parallelFor((u32) builds.size(), 1, buildVariantsJob, builds.data());
+    f64 wallMs = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (const VariantBuild_t &build : builds) {
+        addVariant(build.key, build.pipeline, build.buildMs, false);
+    }
+    Logger::Trace("Prewarmed %i shader variants in %f ms", (u32) builds.size(), wallMs);
+}
+
+ShaderVariantStats_t getShaderVariantStats() {
+    return g_variantStats;
+}
+
+void logShaderVariants() {
+    std::vector<const ShaderVariant_t *> sorted;
+    for (const auto &entry : g_variants) {
+        sorted.push_back(&entry.second);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const ShaderVariant_t *a, const ShaderVariant_t *b) {
+        return a->buildMs > b->buildMs;
+    });
+
+    Logger::Log("%i shader variants, %f ms to build, slowest %f ms, %i built on demand",
+                g_variantStats.variantCount, g_variantStats.totalBuildMs, g_variantStats.slowestBuildMs,
+                g_variantStats.onDemandBuilds);
+    for (const ShaderVariant_t *variant : sorted) {
+        const ShaderVariantKey_t &key = variant->key;
+        Logger::Log("  %s %s, %i lights, features %x: %f ms%s", g_passNames[key.pass], g_shadingNames[key.shading],
+                    key.maxShadedLights, key.features, variant->buildMs, variant->onDemand ? " (on demand)" : "");
+    }
+}
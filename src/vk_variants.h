@@ -0,0 +1,48 @@
+#pragma once
+
+#include "vk_common.h"
+
+// Mesh pipeline variants. A key picks the pipeline state and the shader modules, and fills in the
+// specialization constants of the fragment shader, so no variant needs the GLSL recompiled.
+// Pipelines are built on first use, or ahead of time by prewarmShaderVariants, and stay cached.
+
+enum ShadingModel_t : u32 {
+    ShadingModel_Lambert,
+    ShadingModel_Gooch,
+    ShadingModel_Count
+};
+
+// Specialization constants 1 onwards, shaders ignore the ones they do not declare.
+enum VariantFeature_t : u32 {
+    VariantFeature_Specular = 1 << 0, // Gooch highlight
+};
+
+struct ShaderVariantKey_t {
+    MeshPass_t pass; // Pipeline state and vertex format, the pre-pass only reads positions
+    ShadingModel_t shading; // Fragment shader
+    u32 maxShadedLights; // Per fragment, specialization constant 0
+    u32 features; // VariantFeature_t bits
+};
+
+struct ShaderVariantStats_t {
+    u32 variantCount;
+    u32 onDemandBuilds; // Built while rendering instead of during prewarm, each one is a hitch
+    f64 totalBuildMs;
+    f64 slowestBuildMs;
+};
+
+// Clears the fields that do not matter for the pass or shading model, the pre-pass has no fragment
+// shader at all and Lambert no specular, so keys that would build the same pipeline share one.
+ShaderVariantKey_t normalizeVariantKey(ShaderVariantKey_t key);
+u64 packVariantKey(const ShaderVariantKey_t &key);
+
+// Builds the pipeline if it is not cached yet. Render thread only.
+VkPipeline getShaderVariant(const ShaderVariantKey_t &key);
+
+// Builds the missing variants of keys on all job workers.
+void prewarmShaderVariants(const ShaderVariantKey_t *keys, u32 count);
+
+ShaderVariantStats_t getShaderVariantStats();
+
+// Every variant with its build time, slowest first.
+void logShaderVariants();